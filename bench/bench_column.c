@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "bench_util.h"
+#include "log.h"
+#include "data_parser.h"
+#include "data_agg.h"
+#include "data_column.h"
+#include "model_parser.h"
+
+static const char *COLUMN_MODEL_JSON = "{\"Data\": {\"@attr\": {\"mtype\": \"container\"},"
+        "\"PortList\": {\"@attr\": {\"mtype\": \"list\", \"index\": \"ordered\", \"snapshot\": \"columnar\"},"
+        "\"Id\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"int\"}},"
+        "\"Speed\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"int\"}},"
+        "\"Mtu\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"int\"}},"
+        "\"Desc\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"string\"}}}}}";
+
+/* large arrays are mapped apart from the arena */
+static size_t heap_bytes(void)
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+static char* port_json(int cnt)
+{
+    struct bench_buf buf = {NULL, 0, 0};
+    char tmp[160];
+    bench_append(&buf, "{\"Data\": {\"PortList\": [");
+    for (int i = 0; i < cnt; i++) {
+        snprintf(tmp, sizeof(tmp), "%s{\"Id\": %d, \"Speed\": %d, \"Mtu\": %d, \"Desc\": \"port-%d\"}", i ? "," : "",
+                i, i % 4 * 10000, 1500 + i % 9000, i % 128);
+        bench_append(&buf, tmp);
+    }
+    bench_append(&buf, "]}}");
+    return buf.data;
+}
+
+/* aggregates and key lookups over one flat list, through the nodes and through its columns */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 500000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+    set_log_level(LOG_LEVEL_ERR);
+
+    struct mds_node *schema = mds_load_model(COLUMN_MODEL_JSON);
+    struct mds_node *lists = mds_find_child_schema(schema, "PortList");
+    struct mds_node *speed = mds_find_child_schema(lists, "Speed");
+    char *json = port_json(cnt);
+
+    size_t before = heap_bytes();
+    struct mdd_node *root = mdd_parse_data(schema, json);
+    size_t tree_heap = heap_bytes() - before;
+    free(json);
+    struct mdd_node *data = mdd_get_data(root, "Data");
+
+    before = heap_bytes();
+    double begin = bench_now_ms();
+    struct mdd_columns *cols = mdd_columns_snapshot(data, lists, 0);
+    double build = bench_now_ms() - begin;
+    size_t col_heap = heap_bytes() - before;
+
+    long long node_sum = 0, col_sum = 0, val = 0;
+    begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        for (mdd_agg_type type = MDD_AGG_SUM; type <= MDD_AGG_MAX; type++) {
+            struct mdd_agg *agg = mdd_agg_create(schema, "Data/PortList", "Speed", type);
+            mdd_agg_load(agg, root);
+            mdd_agg_value(agg, &val);
+            node_sum += val;
+            mdd_agg_free(agg);
+        }
+    }
+    double node_agg = (bench_now_ms() - begin) / rounds;
+
+    begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        for (mdd_agg_type type = MDD_AGG_SUM; type <= MDD_AGG_MAX; type++) {
+            mdd_columns_agg(cols, speed, type, &val);
+            col_sum += val;
+        }
+    }
+    double col_agg = (bench_now_ms() - begin) / rounds;
+
+    long long node_hits = 0, col_hits = 0;
+    begin = bench_now_ms();
+    for (long long k = 0; k < cnt; k++) {
+        node_hits += mdd_find_list(data, lists, k * 7919 % cnt) ? 1 : 0;
+    }
+    double node_find = bench_now_ms() - begin;
+    begin = bench_now_ms();
+    for (long long k = 0; k < cnt; k++) {
+        col_hits += mdd_columns_find(cols, k * 7919 % cnt) >= 0 ? 1 : 0;
+    }
+    double col_find = bench_now_ms() - begin;
+
+    printf("rows:%d rounds:%d sums %s finds %s\n", cnt, rounds, node_sum == col_sum ? "agree" : "DIFFER",
+            node_hits == col_hits ? "agree" : "DIFFER");
+    printf("heap     : tree %zu bytes, columns %zu bytes, build %.3f ms\n", tree_heap, col_heap, build);
+    printf("sum+min+max : nodes %9.3f ms  columns %9.3f ms\n", node_agg, col_agg);
+    printf("find x%d : nodes %9.3f ms  columns %9.3f ms\n", cnt, node_find, col_find);
+
+    mdd_columns_free(cols);
+    mdd_free_data(root);
+    mds_free_model(schema);
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_util.h"
+#include "log.h"
+#include "data_parser.h"
+#include "model_parser.h"
+
+/* the bench model with ChildList declared as an ordered list, so edits find instances by key */
+static char* ordered_model()
+{
+    const char *attr = "\"ChildList\": {\"@attr\": {\"mtype\": \"list\"";
+    const char *pos = strstr(BENCH_MODEL_JSON, attr) + strlen(attr);
+    size_t len = strlen(BENCH_MODEL_JSON) + 32;
+    char *model = malloc(len);
+    snprintf(model, len, "%.*s, \"index\": \"ordered\"%s", (int) (pos - BENCH_MODEL_JSON), BENCH_MODEL_JSON, pos);
+    return model;
+}
+
+static void walk_tree(struct mdd_node *node, size_t *cnt, long long *sum)
+{
+    for (; node; node = node->next) {
+        (*cnt)++;
+        if (is_leaf_node(node->schema)) {
+            *sum += is_str_leaf((struct mds_leaf*) node->schema) ? 0 : ((struct mdd_leaf*) node)->value.intv;
+        } else {
+            walk_tree(node->child, cnt, sum);
+        }
+    }
+}
+
+static double walk_ms(struct mdd_node *root, int rounds, size_t *cnt, long long *sum)
+{
+    *cnt = 0;
+    *sum = 0;
+    double begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        walk_tree(root, cnt, sum);
+    }
+    return (bench_now_ms() - begin) / rounds;
+}
+
+static struct mdd_node* parse_child(struct mds_node *schema, const char *str)
+{
+    cJSON *json = cJSON_Parse(str);
+    struct mdd_node *node = mdd_parse_child(schema, json);
+    cJSON_Delete(json);
+    return node;
+}
+
+/*
+ * Replaces the sub entry and the string leaf of instances picked at random, committing every
+ * batch as a steady edit load would, so the new nodes land wherever the heap has room.
+ */
+static void churn(struct mdd_node *root, struct mdd_track *track, int cnt, int edits)
+{
+    struct mds_node *lists = mds_find_child_schema(root->schema, "ChildList");
+    struct mds_node *subs = mds_find_child_schema(lists, "SubChildList");
+    struct mds_node *str = mds_find_child_schema(lists, "StrLeaf");
+    char tmp[96];
+    unsigned int seed = 12345;
+    for (int e = 0; e < edits; e++) {
+        seed = seed * 1103515245 + 12345;
+        int id = (int) ((seed >> 8) % (unsigned int) cnt);
+        struct mdd_node *inst = mdd_find_list(root, lists, id);
+        for (struct mdd_node *child = inst->child, *next = NULL; child; child = next) {
+            next = child->next;
+            if (child->schema == subs || child->schema == str) {
+                mdd_delete_node(track, child);
+            }
+        }
+        snprintf(tmp, sizeof(tmp), "{\"Id\": %d, \"StrLeaf\": \"sub-%d-%d\"}", e % 4, id, e);
+        mdd_insert_node(track, inst, parse_child(subs, tmp));
+        snprintf(tmp, sizeof(tmp), "\"name-%d\"", e);
+        mdd_insert_node(track, inst, parse_child(str, tmp));
+        if (e % 64 == 63) {
+            mdd_free_diff(mdd_get_dirty_diff(track));
+        }
+    }
+    mdd_free_diff(mdd_get_dirty_diff(track));
+}
+
+/* pre-order walk of a list tree freshly parsed, after a run of random edits, and after mdd_compact_tree */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 200000;
+    int edits = argc > 2 ? atoi(argv[2]) : cnt;
+    int rounds = argc > 3 ? atoi(argv[3]) : 10;
+    set_log_level(LOG_LEVEL_ERR);
+
+    char *model = ordered_model();
+    struct mds_node *schema = mds_load_model(model);
+    free(model);
+    char *json = bench_list_json(cnt, 0, 0);
+    struct mdd_node *root = mdd_parse_data(schema, json);
+    free(json);
+    struct mdd_track track;
+    mdd_track_init(&track);
+
+    size_t nodes = 0;
+    long long sum = 0;
+    double parsed = walk_ms(root, rounds, &nodes, &sum);
+    churn(root, &track, cnt, edits);
+    size_t edited_nodes = 0;
+    long long edited_sum = 0;
+    double edited = walk_ms(root, rounds, &edited_nodes, &edited_sum);
+
+    double begin = bench_now_ms();
+    root = mdd_compact_tree(root, NULL);
+    double compact = bench_now_ms() - begin;
+    size_t compact_nodes = 0;
+    long long compact_sum = 0;
+    double compacted = walk_ms(root, rounds, &compact_nodes, &compact_sum);
+
+    printf("nodes:%zu edits:%d rounds:%d walks %s\n", nodes / rounds, edits, rounds,
+            edited_nodes == compact_nodes && edited_sum == compact_sum ? "agree" : "DIFFER");
+    printf("walk : parsed %9.3f ms  edited %9.3f ms  compacted %9.3f ms\n", parsed, edited, compacted);
+    printf("compact: %.3f ms\n", compact);
+
+    mdd_track_free(&track);
+    mdd_free_data(root);
+    mds_free_model(schema);
+    return 0;
+}
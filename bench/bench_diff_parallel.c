@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "log.h"
+#include "data_parser.h"
+#include "model_parser.h"
+#include "thread_pool.h"
+
+static int same_diff(mdd_diff *d1, mdd_diff *d2)
+{
+    if (d1->size != d2->size) {
+        return 0;
+    }
+    for (size_t i = 0; i < d1->size; i++) {
+        struct mdd_mo_diff *m1 = (struct mdd_mo_diff*) d1->vec[i];
+        struct mdd_mo_diff *m2 = (struct mdd_mo_diff*) d2->vec[i];
+        if (m1->type != m2->type || m1->run_data != m2->run_data || m1->edit_data != m2->edit_data
+                || m1->leaf_cnt != m2->leaf_cnt) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 200000;
+    set_log_level(LOG_LEVEL_ERR);
+
+    struct mds_node *schema = mds_load_model(BENCH_MODEL_JSON);
+    char *json1 = bench_list_json(cnt, 0, 0);
+    char *json2 = bench_list_json(cnt, 3, 1);
+    struct mdd_node *run = mdd_parse_data(schema, json1);
+    struct mdd_node *edit = mdd_parse_data(schema, json2);
+    free(json1);
+    free(json2);
+
+    /* sequential list matching is quadratic, only use it as the reference on small inputs */
+    double begin = bench_now_ms();
+    mdd_diff *expect = cnt <= 20000 ? mdd_get_diff(schema, run, edit) : NULL;
+    if (expect) {
+        printf("entries:%d changes:%zu\n", cnt, expect->size);
+        printf("sequential    : %10.2f ms\n", bench_now_ms() - begin);
+    }
+
+    double base = 0;
+    for (int threads = 1; threads <= 16; threads *= 2) {
+        struct mdd_pool *pool = pool_create(threads);
+        begin = bench_now_ms();
+        mdd_diff *diff = mdd_get_diff_parallel(schema, run, edit, pool);
+        double cost = bench_now_ms() - begin;
+        base = threads == 1 ? cost : base;
+        if (!expect) {
+            printf("entries:%d changes:%zu\n", cnt, diff->size);
+            expect = diff;
+            diff = NULL;
+        }
+        printf("threads %2d    : %10.2f ms  speedup %5.2fx  %s\n", threads, cost, base / cost,
+                !diff || same_diff(expect, diff) ? "same" : "MISMATCH");
+        mdd_free_diff(diff);
+        pool_destroy(pool);
+    }
+
+    mdd_free_diff(expect);
+    mdd_free_data(run);
+    mdd_free_data(edit);
+    mds_free_model(schema);
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_util.h"
+#include "log.h"
+#include "data_parser.h"
+#include "model_parser.h"
+
+static double dump_ms(struct mdd_frag_cache *frags, struct mdd_node *root, size_t *len)
+{
+    char *json = NULL;
+    double begin = bench_now_ms();
+    mdd_dump_data_cached(frags, root, &json);
+    double cost = bench_now_ms() - begin;
+    *len = json ? strlen(json) : 0;
+    free(json);
+    return cost;
+}
+
+/* full dumps with a cold fragment cache, an unchanged tree and after one leaf edit, one entry dumps, and the cache size */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 100000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+    set_log_level(LOG_LEVEL_ERR);
+
+    struct mds_node *schema = mds_load_model(BENCH_MODEL_JSON);
+    char *json = bench_list_json(cnt, 0, 0);
+    struct mdd_node *root = mdd_parse_data(schema, json);
+    free(json);
+
+    struct mdd_frag_cache frags;
+    mdd_frag_init(&frags);
+    struct mdd_track track;
+    mdd_track_init(&track);
+    track.frags = &frags;
+
+    size_t len = 0;
+    double cold = dump_ms(&frags, root, &len);
+    double warm = 0;
+    double edited = 0;
+    char path[128];
+    for (int r = 0; r < rounds; r++) {
+        warm += dump_ms(&frags, root, &len);
+        snprintf(path, sizeof(path), "Data/ChildList[Id=%d]/IntLeaf", (int) ((long long) r * 7919 % cnt));
+        mdd_set_int(&track, mdd_get_data(root, path), -r);
+        edited += dump_ms(&frags, root, &len);
+    }
+
+    struct mdd_node *entries[64];
+    for (int i = 0; i < 64; i++) {
+        snprintf(path, sizeof(path), "Data/ChildList[Id=%d]", (int) ((long long) i * 7919 % cnt));
+        entries[i] = mdd_get_data(root, path);
+    }
+    double begin = bench_now_ms();
+    for (int r = 0; r < rounds * 1000; r++) {
+        char *frag = NULL;
+        mdd_dump_subtree_cached(&frags, entries[r % 64], &frag);
+        free(frag);
+    }
+    double entry = (bench_now_ms() - begin) / (rounds * 1000);
+    dump_ms(&frags, root, &len);
+    size_t bytes = mdd_frag_bytes(&frags);
+
+    printf("entries:%d bytes:%zu rounds:%d\n", cnt, len, rounds);
+    printf("cold      : %10.3f ms/dump\n", cold);
+    printf("unchanged : %10.3f ms/dump  speedup %8.2fx\n", warm / rounds, cold * rounds / warm);
+    printf("one edit  : %10.3f ms/dump  speedup %8.2fx\n", edited / rounds, cold * rounds / edited);
+    printf("entry     : %10.4f ms/get\n", entry);
+    printf("fragments : %10zu bytes resident, %.2fx the dump\n", bytes, (double) bytes / len);
+
+    mdd_track_free(&track);
+    mdd_frag_free(&frags);
+    mdd_free_data(root);
+    mds_free_model(schema);
+    return 0;
+}
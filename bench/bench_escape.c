@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_util.h"
+#include "log.h"
+#include "common.h"
+#include "data_parser.h"
+#include "model_parser.h"
+
+/* the escaper before json_escape_span, one branch per byte */
+static size_t escape_bytewise(char *dst, const char *src, size_t len)
+{
+    size_t out = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) src[i];
+        if (c == '"' || c == '\\') {
+            dst[out++] = '\\';
+            dst[out++] = (char) c;
+        } else if (c < 0x20) {
+            out += sprintf(dst + out, "\\u%04x", c);
+        } else {
+            dst[out++] = (char) c;
+        }
+    }
+    return out;
+}
+
+/* the same output through the span scan with bulk copies */
+static size_t escape_span(char *dst, const char *src, size_t len)
+{
+    size_t out = 0;
+    while (len) {
+        size_t span = json_escape_span(src, len);
+        memcpy(dst + out, src, span);
+        out += span;
+        if (span == len) {
+            break;
+        }
+        unsigned char c = (unsigned char) src[span];
+        if (c == '"' || c == '\\') {
+            dst[out++] = '\\';
+            dst[out++] = (char) c;
+        } else {
+            out += sprintf(dst + out, "\\u%04x", c);
+        }
+        src += span + 1;
+        len -= span + 1;
+    }
+    return out;
+}
+
+static size_t unescape_bytewise(char *dst, const char *src, size_t len)
+{
+    size_t out = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (src[i] == '\\' && i + 1 < len) {
+            char c = src[++i];
+            dst[out++] = c == 'n' ? '\n' : c == 't' ? '\t' : c;
+        } else {
+            dst[out++] = src[i];
+        }
+    }
+    return out;
+}
+
+/* string-heavy text: lines of `width` bytes with a quote or backslash in every `every`-th line */
+static char* make_text(int cnt, int width, int every, size_t *len)
+{
+    char *text = malloc((size_t) cnt * width + 1);
+    for (int i = 0; i < cnt; i++) {
+        char *line = text + (size_t) i * width;
+        for (int j = 0; j < width; j++) {
+            line[j] = (char) ('a' + (i + j) % 26);
+        }
+        if (every > 0 && i % every == 0) {
+            line[width / 2] = i % 2 ? '"' : '\\';
+        }
+    }
+    *len = (size_t) cnt * width;
+    text[*len] = '\0';
+    return text;
+}
+
+static double dump_tree_ms(struct mds_node *schema, int cnt, int width, int every)
+{
+    struct bench_buf buf = {NULL, 0, 0};
+    char tmp[64];
+    char *str = malloc(width + 8);
+    bench_append(&buf, "{\"Data\": {\"ChildList\": [");
+    for (int i = 0; i < cnt; i++) {
+        snprintf(tmp, sizeof(tmp), "%s{\"Id\": %d, \"StrLeaf\": \"", i ? "," : "", i);
+        bench_append(&buf, tmp);
+        for (int j = 0; j < width; j++) {
+            str[j] = (char) ('a' + (i + j) % 26);
+        }
+        str[width] = '\0';
+        if (every > 0 && i % every == 0) {
+            memcpy(str + width / 2, "\\\"", 2);
+        }
+        bench_append(&buf, str);
+        bench_append(&buf, "\"}");
+    }
+    bench_append(&buf, "]}}");
+    free(str);
+
+    struct mdd_node *root = mdd_parse_data(schema, buf.data);
+    free(buf.data);
+    char *json = NULL;
+    double begin = bench_now_ms();
+    mdd_dump_data(root, &json);
+    double cost = bench_now_ms() - begin;
+    free(json);
+    mdd_free_data(root);
+    return cost;
+}
+
+/* escape and unescape throughput on string-heavy text, bytewise against span scans, and a cold tree dump */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 100000;
+    int width = argc > 2 ? atoi(argv[2]) : 200;
+    int every = argc > 3 ? atoi(argv[3]) : 10;
+    int rounds = argc > 4 ? atoi(argv[4]) : 10;
+    set_log_level(LOG_LEVEL_ERR);
+
+    size_t len = 0;
+    char *text = make_text(cnt, width, every, &len);
+    char *escaped = malloc(len * 6 + 1);
+    char *plain = malloc(len + 1);
+    size_t esc_len = 0, out_len = 0;
+
+    double begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        esc_len = escape_bytewise(escaped, text, len);
+    }
+    double esc_byte = (bench_now_ms() - begin) / rounds;
+
+    begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        esc_len = escape_span(escaped, text, len);
+    }
+    double esc_span = (bench_now_ms() - begin) / rounds;
+
+    begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        out_len = unescape_bytewise(plain, escaped, esc_len);
+    }
+    double unesc_byte = (bench_now_ms() - begin) / rounds;
+
+    begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        out_len = (size_t) json_unescape(plain, escaped, esc_len);
+    }
+    double unesc_fast = (bench_now_ms() - begin) / rounds;
+    if (out_len != len || memcmp(plain, text, len)) {
+        printf("round trip mismatch\n");
+    }
+
+    struct mds_node *schema = mds_load_model(BENCH_MODEL_JSON);
+    double dump = dump_tree_ms(schema, cnt, width, every);
+    mds_free_model(schema);
+
+    double mb = len / 1048576.0;
+    printf("strings:%d width:%d escape every:%d rounds:%d, %.1f MB\n", cnt, width, every, rounds, mb);
+    printf("escape   bytewise : %8.3f ms %8.0f MB/s\n", esc_byte, mb * 1000 / esc_byte);
+    printf("escape   span     : %8.3f ms %8.0f MB/s  speedup %6.2fx\n", esc_span, mb * 1000 / esc_span,
+            esc_byte / esc_span);
+    printf("unescape bytewise : %8.3f ms %8.0f MB/s\n", unesc_byte, mb * 1000 / unesc_byte);
+    printf("unescape runs     : %8.3f ms %8.0f MB/s  speedup %6.2fx\n", unesc_fast, mb * 1000 / unesc_fast,
+            unesc_byte / unesc_fast);
+    printf("cold tree dump    : %8.3f ms\n", dump);
+
+    free(text);
+    free(escaped);
+    free(plain);
+    return 0;
+}
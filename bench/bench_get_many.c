@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "log.h"
+#include "data_parser.h"
+#include "model_parser.h"
+
+/* repo_get and repo_get_many are thin wrappers, so this measures mdd_get_data against mdd_get_many */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 10000;
+    int npaths = argc > 2 ? atoi(argv[2]) : 500;
+    int rounds = argc > 3 ? atoi(argv[3]) : 20;
+    set_log_level(LOG_LEVEL_ERR);
+
+    struct mds_node *schema = mds_load_model(BENCH_MODEL_JSON);
+    char *json = bench_list_json(cnt, 0, 0);
+    struct mdd_node *root = mdd_parse_data(schema, json);
+    free(json);
+
+    /* collector style: two leaves of each polled entry, spread over the whole list */
+    const char **paths = calloc(npaths, sizeof(char*));
+    struct mdd_node **expect = calloc(npaths, sizeof(struct mdd_node*));
+    struct mdd_node **out = calloc(npaths, sizeof(struct mdd_node*));
+    for (int i = 0; i < npaths; i++) {
+        char *path = malloc(96);
+        int id = (int) ((long long) (i / 2) * 2 * cnt / npaths % cnt);
+        snprintf(path, 96, "Data/ChildList[Id=%d]/%s", id, i % 2 ? "StrLeaf" : "IntLeaf");
+        paths[i] = path;
+    }
+
+    double begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < npaths; i++) {
+            expect[i] = mdd_get_data(root, paths[i]);
+        }
+    }
+    double single = (bench_now_ms() - begin) / rounds;
+
+    begin = bench_now_ms();
+    int found = 0;
+    for (int r = 0; r < rounds; r++) {
+        found = mdd_get_many(root, paths, npaths, out);
+    }
+    double many = (bench_now_ms() - begin) / rounds;
+
+    int same = found == npaths;
+    for (int i = 0; i < npaths && same; i++) {
+        same = expect[i] == out[i];
+    }
+    printf("entries:%d paths:%d rounds:%d\n", cnt, npaths, rounds);
+    printf("get x N   : %10.3f ms/round\n", single);
+    printf("get_many  : %10.3f ms/round  speedup %6.2fx  %s\n", many, single / many, same ? "same" : "MISMATCH");
+
+    for (int i = 0; i < npaths; i++) {
+        free((char*) paths[i]);
+    }
+    free(paths);
+    free(expect);
+    free(out);
+    mdd_free_data(root);
+    mds_free_model(schema);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_util.h"
+#include "log.h"
+#include "cjson/cJSON.h"
+#include "json_scan.h"
+#include "data_parser.h"
+#include "model_parser.h"
+
+static const char *KERNEL_NAMES[] = {"auto", "scalar", "sse2", "avx2"};
+
+static double gbps(size_t len, double ms)
+{
+    return len / ms / 1e6;
+}
+
+/* structural indexing per kernel, then whole loads through the index and through cJSON, in GB/s of input */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 1000000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 3;
+    set_log_level(LOG_LEVEL_ERR);
+
+    struct mds_node *schema = mds_load_model(BENCH_MODEL_JSON);
+    char *json = bench_list_json(cnt, 0, 0);
+    size_t len = strlen(json);
+    printf("entries:%d rounds:%d json:%.1f MB best kernel:%s\n", cnt, rounds, len / 1048576.0,
+            KERNEL_NAMES[json_kernel_best()]);
+
+    struct json_index index;
+    for (json_kernel kernel = JSON_KERNEL_SCALAR; kernel <= JSON_KERNEL_AVX2; kernel++) {
+        if (!json_kernel_supported(kernel)) {
+            continue;
+        }
+        double begin = bench_now_ms();
+        for (int r = 0; r < rounds; r++) {
+            json_index_build(&index, json, len, kernel);
+            json_index_free(&index);
+        }
+        double cost = (bench_now_ms() - begin) / rounds;
+        printf("index %-6s      : %9.3f ms %7.2f GB/s\n", KERNEL_NAMES[kernel], cost, gbps(len, cost));
+    }
+
+    double begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        mdd_free_data(mdd_parse_data(schema, json));
+    }
+    double scan = (bench_now_ms() - begin) / rounds;
+
+    begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        cJSON *root = cJSON_Parse(json);
+        mdd_free_data(mdd_parse_json(schema, root));
+        cJSON_Delete(root);
+    }
+    double cjson = (bench_now_ms() - begin) / rounds;
+
+    printf("load via index    : %9.3f ms %7.2f GB/s\n", scan, gbps(len, scan));
+    printf("load via cJSON    : %9.3f ms %7.2f GB/s  speedup %6.2fx\n", cjson, gbps(len, cjson), cjson / scan);
+
+    free(json);
+    mds_free_model(schema);
+    return 0;
+}
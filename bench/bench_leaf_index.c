@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "bench_util.h"
+#include "log.h"
+#include "data_parser.h"
+#include "model_parser.h"
+
+/* the bench model with an index attr added to one leaf of ChildList */
+static char* indexed_model(const char *leaf, const char *kind)
+{
+    char attr[128];
+    snprintf(attr, sizeof(attr), "    \"%s\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"%s\"", leaf,
+            strcmp(leaf, "StrLeaf") ? "int" : "string");
+    const char *pos = strstr(strstr(BENCH_MODEL_JSON, "\"ChildList\""), attr) + strlen(attr);
+    size_t len = strlen(BENCH_MODEL_JSON) + 32;
+    char *model = malloc(len);
+    snprintf(model, len, "%.*s, \"index\": \"%s\"%s", (int) (pos - BENCH_MODEL_JSON), BENCH_MODEL_JSON, kind, pos);
+    return model;
+}
+
+static struct mdd_node* parse_measured(struct mds_node *schema, const char *json, size_t *bytes, double *ms)
+{
+    size_t before = mallinfo2().uordblks;
+    double begin = bench_now_ms();
+    struct mdd_node *root = mdd_parse_data(schema, json);
+    *ms = bench_now_ms() - begin;
+    *bytes = mallinfo2().uordblks - before;
+    return root;
+}
+
+static double lookup(struct mdd_node *root, int cnt, int rounds, long long *sum)
+{
+    char path[128];
+    double begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        snprintf(path, sizeof(path), "Data/ChildList[StrLeaf=name-%d]/Id", (int) ((long long) r * 7919 % cnt));
+        struct mdd_node *node = mdd_get_data(root, path);
+        *sum += node ? ((struct mdd_leaf*) node)->value.intv : -1;
+    }
+    return (bench_now_ms() - begin) / rounds;
+}
+
+/* memory cost of a unique index on StrLeaf and of a multi index on IntLeaf, and lookup by StrLeaf */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 100000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 200;
+    set_log_level(LOG_LEVEL_ERR);
+
+    char *unique_json = indexed_model("StrLeaf", "unique");
+    char *multi_json = indexed_model("IntLeaf", "multi");
+    struct mds_node *plain = mds_load_model(BENCH_MODEL_JSON);
+    struct mds_node *unique = mds_load_model(unique_json);
+    struct mds_node *multi = mds_load_model(multi_json);
+    free(unique_json);
+    free(multi_json);
+
+    /* every 4th entry shares its IntLeaf with the next one */
+    char *json = bench_list_json(cnt, 4, 1);
+    size_t plain_bytes, unique_bytes, multi_bytes;
+    double plain_ms, unique_ms, multi_ms;
+    struct mdd_node *plain_root = parse_measured(plain, json, &plain_bytes, &plain_ms);
+    struct mdd_node *unique_root = parse_measured(unique, json, &unique_bytes, &unique_ms);
+    struct mdd_node *multi_root = parse_measured(multi, json, &multi_bytes, &multi_ms);
+    free(json);
+
+    long long scan_sum = 0, index_sum = 0;
+    double scan = lookup(plain_root, cnt, rounds, &scan_sum);
+    double indexed = lookup(unique_root, cnt, rounds, &index_sum);
+
+    printf("entries:%d rounds:%d\n", cnt, rounds);
+    printf("plain     : %10.3f ms parse %10zu bytes\n", plain_ms, plain_bytes);
+    printf("unique    : %10.3f ms parse %10zu bytes  +%.1f bytes/entry\n", unique_ms, unique_bytes,
+            ((double) unique_bytes - plain_bytes) / cnt);
+    printf("multi     : %10.3f ms parse %10zu bytes  +%.1f bytes/entry\n", multi_ms, multi_bytes,
+            ((double) multi_bytes - plain_bytes) / cnt);
+    printf("scan      : %10.4f ms/lookup\n", scan);
+    printf("index     : %10.4f ms/lookup  speedup %8.2fx  %s\n", indexed, scan / indexed,
+            scan_sum == index_sum ? "same" : "MISMATCH");
+
+    mdd_free_data(plain_root);
+    mdd_free_data(unique_root);
+    mdd_free_data(multi_root);
+    mds_free_model(plain);
+    mds_free_model(unique);
+    mds_free_model(multi);
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_util.h"
+#include "log.h"
+#include "common.h"
+#include "data_parser.h"
+#include "model_parser.h"
+
+static long scalar_find(const int32_t *keys, size_t cnt, int32_t key)
+{
+    for (size_t i = 0; i < cnt; i++) {
+        if (keys[i] == key) {
+            return (long) i;
+        }
+    }
+    return -1;
+}
+
+/* ChildList with cnt instances, in key order or reversed */
+static char* list_json(int cnt, int reversed, int value)
+{
+    struct bench_buf buf = {NULL, 0, 0};
+    char tmp[96];
+    bench_append(&buf, "{\"Data\": {\"Name\": \"bench\", \"ChildList\": [");
+    for (int i = 0; i < cnt; i++) {
+        int id = reversed ? cnt - 1 - i : i;
+        snprintf(tmp, sizeof(tmp), "%s{\"Id\": %d, \"IntLeaf\": %d}", i ? "," : "", id, id % 16 ? id : value);
+        bench_append(&buf, tmp);
+    }
+    bench_append(&buf, "]}}");
+    return buf.data;
+}
+
+static double diff_ms(struct mds_node *schema, int cnt, int reversed, int rounds)
+{
+    char *run_json = list_json(cnt, 0, 0);
+    char *edit_json = list_json(cnt, reversed, 1);
+    struct mdd_node *run = mdd_parse_data(schema, run_json);
+    struct mdd_node *edit = mdd_parse_data(schema, edit_json);
+    double begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        mdd_free_diff(mdd_get_diff(schema, run, edit));
+    }
+    double ms = (bench_now_ms() - begin) / rounds;
+    mdd_free_data(run);
+    mdd_free_data(edit);
+    free(run_json);
+    free(edit_json);
+    return ms;
+}
+
+/* key search kernel against a plain loop, and the diff of an unordered list in the same and in reversed order */
+int main(int argc, char **argv)
+{
+    int max = argc > 1 ? atoi(argv[1]) : 4096;
+    set_log_level(LOG_LEVEL_ERR);
+    struct mds_node *schema = mds_load_model(BENCH_MODEL_JSON);
+
+    printf("%8s %12s %12s %14s %14s\n", "keys", "loop ns", "kernel ns", "diff same ms", "diff rev ms");
+    for (int cnt = 8; cnt <= max; cnt *= 4) {
+        int32_t *keys = malloc(cnt * sizeof(int32_t));
+        for (int i = 0; i < cnt; i++) {
+            keys[i] = i;
+        }
+        int probes = 4000000 / cnt + 1000;
+        long hits = 0;
+        double begin = bench_now_ms();
+        for (int p = 0; p < probes; p++) {
+            hits += scalar_find(keys, cnt, (int32_t) ((long long) p * 7919 % cnt));
+        }
+        double loop = (bench_now_ms() - begin) * 1e6 / probes;
+        begin = bench_now_ms();
+        for (int p = 0; p < probes; p++) {
+            hits -= keys_find(keys, cnt, (int32_t) ((long long) p * 7919 % cnt));
+        }
+        double kernel = (bench_now_ms() - begin) * 1e6 / probes;
+        free(keys);
+
+        int rounds = cnt > 1024 ? 3 : 20;
+        printf("%8d %12.1f %12.1f %14.3f %14.3f%s\n", cnt, loop, kernel, diff_ms(schema, cnt, 0, rounds),
+                diff_ms(schema, cnt, 1, rounds), hits ? " MISMATCH" : "");
+    }
+    mds_free_model(schema);
+    return 0;
+}
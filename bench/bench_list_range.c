@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_util.h"
+#include "log.h"
+#include "data_parser.h"
+#include "data_query.h"
+#include "model_parser.h"
+
+/* the bench model with ChildList declared as an ordered list */
+static char* ordered_model()
+{
+    const char *attr = "\"ChildList\": {\"@attr\": {\"mtype\": \"list\"";
+    const char *pos = strstr(BENCH_MODEL_JSON, attr) + strlen(attr);
+    size_t len = strlen(BENCH_MODEL_JSON) + 32;
+    char *model = malloc(len);
+    snprintf(model, len, "%.*s, \"index\": \"ordered\"%s", (int) (pos - BENCH_MODEL_JSON), BENCH_MODEL_JSON, pos);
+    return model;
+}
+
+/* range reads as a predicate query over the sibling list against a cursor over the ordered index */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 100000;
+    int width = argc > 2 ? atoi(argv[2]) : 100;
+    int rounds = argc > 3 ? atoi(argv[3]) : 200;
+    set_log_level(LOG_LEVEL_ERR);
+
+    char *model = ordered_model();
+    struct mds_node *plain = mds_load_model(BENCH_MODEL_JSON);
+    struct mds_node *ordered = mds_load_model(model);
+    free(model);
+
+    char *json = bench_list_json(cnt, 0, 0);
+    double begin = bench_now_ms();
+    struct mdd_node *plain_root = mdd_parse_data(plain, json);
+    double parse_plain = bench_now_ms() - begin;
+    begin = bench_now_ms();
+    struct mdd_node *ordered_root = mdd_parse_data(ordered, json);
+    double parse_ordered = bench_now_ms() - begin;
+    free(json);
+
+    char expr[128];
+    long long scan_sum = 0;
+    begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        int lo = (int) ((long long) r * 7919 % (cnt - width));
+        snprintf(expr, sizeof(expr), "Data/ChildList[Id>=%d][Id<%d]", lo, lo + width);
+        struct mdd_query_iter *iter = mdd_query_open_expr(expr, plain_root);
+        for (struct mdd_node *node = mdd_query_next(iter); node; node = mdd_query_next(iter)) {
+            scan_sum += ((struct mdd_leaf*) node->child)->value.intv;
+        }
+        mdd_query_close(iter);
+    }
+    double scan = (bench_now_ms() - begin) / rounds;
+
+    struct mds_node *lists = mds_find_child_schema(ordered, "ChildList");
+    long long index_sum = 0;
+    begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        int lo = (int) ((long long) r * 7919 % (cnt - width));
+        struct mdd_list_cursor cursor;
+        mdd_list_range(ordered_root, lists, lo, lo + width - 1, &cursor);
+        for (struct mdd_node *node = mdd_list_next(&cursor); node; node = mdd_list_next(&cursor)) {
+            index_sum += ((struct mdd_leaf*) node->child)->value.intv;
+        }
+    }
+    double indexed = (bench_now_ms() - begin) / rounds;
+
+    printf("entries:%d width:%d rounds:%d\n", cnt, width, rounds);
+    printf("parse     : %10.3f ms plain  %10.3f ms ordered\n", parse_plain, parse_ordered);
+    printf("scan      : %10.3f ms/range\n", scan);
+    printf("index     : %10.3f ms/range  speedup %8.2fx  %s\n", indexed, scan / indexed,
+            scan_sum == index_sum ? "same" : "MISMATCH");
+
+    mdd_free_data(plain_root);
+    mdd_free_data(ordered_root);
+    mds_free_model(plain);
+    mds_free_model(ordered);
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_util.h"
+#include "log.h"
+#include "common.h"
+#include "data_parser.h"
+#include "model_parser.h"
+
+/* repo_edit over and over: parse the edit, diff it against running, free running, keep the edit */
+static void edit_rounds(struct mds_node *schema, char **jsons, struct mdd_node **running, int edits)
+{
+    for (int e = 0; e < edits; e++) {
+        struct mdd_node *editing = mdd_parse_data(schema, jsons[e % 2]);
+        mdd_free_diff(mdd_get_diff(schema, *running, editing));
+        mdd_free_data(*running);
+        *running = editing;
+    }
+}
+
+static void run(struct mds_node *schema, char **jsons, int edits, size_t limit)
+{
+    nodepool_set_limit(limit);
+    struct mdd_node *running = mdd_parse_data(schema, jsons[0]);
+    edit_rounds(schema, jsons, &running, 2);
+
+    struct nodepool_stats before, after;
+    nodepool_get_stats(&before);
+    double begin = bench_now_ms();
+    edit_rounds(schema, jsons, &running, edits);
+    double ms = (bench_now_ms() - begin) / edits;
+    nodepool_get_stats(&after);
+
+    printf("%-8s %10.0f %10.0f %10.0f %10.0f %10.3f\n", limit ? "pool" : "malloc",
+            (double) (after.allocs - before.allocs) / edits, (double) (after.releases - before.releases) / edits,
+            (double) (after.mallocs - before.mallocs) / edits, (double) (after.frees - before.frees) / edits, ms);
+    mdd_free_data(running);
+}
+
+/* node, slot and diff block traffic per edit of a steady repo_edit load, with recycling off and on */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 20000;
+    int edits = argc > 2 ? atoi(argv[2]) : 20;
+    set_log_level(LOG_LEVEL_ERR);
+
+    struct mds_node *schema = mds_load_model(BENCH_MODEL_JSON);
+    char *jsons[2] = {bench_list_json(cnt, 0, 0), bench_list_json(cnt, 10, 1)};
+
+    printf("instances:%d edits:%d\n", cnt, edits);
+    printf("%-8s %10s %10s %10s %10s %10s\n", "", "allocs", "releases", "mallocs", "frees", "ms/edit");
+    run(schema, jsons, edits, 0);
+    run(schema, jsons, edits, NODEPOOL_LIMIT);
+
+    free(jsons[0]);
+    free(jsons[1]);
+    mds_free_model(schema);
+    return 0;
+}
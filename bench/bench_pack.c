@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "bench_util.h"
+#include "log.h"
+#include "data_parser.h"
+#include "data_pack.h"
+#include "model_parser.h"
+
+/* large arrays are mapped apart from the arena */
+static size_t heap_bytes(void)
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+/* the bench model with ChildList declared as an ordered list */
+static char* ordered_model()
+{
+    const char *attr = "\"ChildList\": {\"@attr\": {\"mtype\": \"list\"";
+    const char *pos = strstr(BENCH_MODEL_JSON, attr) + strlen(attr);
+    size_t len = strlen(BENCH_MODEL_JSON) + 32;
+    char *model = malloc(len);
+    snprintf(model, len, "%.*s, \"index\": \"ordered\"%s", (int) (pos - BENCH_MODEL_JSON), BENCH_MODEL_JSON, pos);
+    return model;
+}
+
+static void walk_tree(struct mdd_node *node, size_t *cnt, long long *sum)
+{
+    for (; node; node = node->next) {
+        (*cnt)++;
+        if (is_leaf_node(node->schema)) {
+            *sum += is_str_leaf((struct mds_leaf*) node->schema) ? 0 : ((struct mdd_leaf*) node)->value.intv;
+        } else {
+            walk_tree(node->child, cnt, sum);
+        }
+    }
+}
+
+static void walk_pack(const struct mdd_pack *pack, mdd_ref ref, size_t *cnt, long long *sum)
+{
+    long long val = 0;
+    for (; ref != MDD_REF_NULL; ref = mdd_pack_next(pack, ref)) {
+        (*cnt)++;
+        if (!mdd_ref_is_leaf(ref)) {
+            walk_pack(pack, mdd_pack_child(pack, ref), cnt, sum);
+        } else if (!mdd_pack_int(pack, ref, &val)) {
+            *sum += val;
+        }
+    }
+}
+
+/* heap, a full pre-order walk and leaf reads by path of a tree of about 5M nodes, as nodes and as a pack */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 715000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 5;
+    set_log_level(LOG_LEVEL_ERR);
+
+    char *model = ordered_model();
+    struct mds_node *schema = mds_load_model(model);
+    free(model);
+    char *json = bench_list_json(cnt, 0, 0);
+    size_t before = heap_bytes();
+    struct mdd_node *root = mdd_parse_data(schema, json);
+    size_t tree_heap = heap_bytes() - before;
+    free(json);
+
+    double begin = bench_now_ms();
+    struct mdd_pack *pack = mdd_pack_build(root);
+    double build = bench_now_ms() - begin;
+
+    size_t tree_nodes = 0, pack_nodes = 0;
+    long long tree_sum = 0, pack_sum = 0;
+    begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        walk_tree(root, &tree_nodes, &tree_sum);
+    }
+    double tree_walk = (bench_now_ms() - begin) / rounds;
+    begin = bench_now_ms();
+    for (int r = 0; r < rounds; r++) {
+        walk_pack(pack, mdd_pack_root(pack), &pack_nodes, &pack_sum);
+    }
+    double pack_walk = (bench_now_ms() - begin) / rounds;
+
+    int reads = rounds * 100000;
+    char path[128];
+    long long tree_vals = 0, pack_vals = 0, val = 0;
+    begin = bench_now_ms();
+    for (int r = 0; r < reads; r++) {
+        snprintf(path, sizeof(path), "Data/ChildList[Id=%d]/IntLeaf", (int) ((long long) r * 7919 % cnt));
+        struct mdd_node *leaf = mdd_get_data(root, path);
+        tree_vals += leaf ? ((struct mdd_leaf*) leaf)->value.intv : 0;
+    }
+    double tree_read = (bench_now_ms() - begin) * 1000 / reads;
+    begin = bench_now_ms();
+    for (int r = 0; r < reads; r++) {
+        snprintf(path, sizeof(path), "Data/ChildList[Id=%d]/IntLeaf", (int) ((long long) r * 7919 % cnt));
+        pack_vals += mdd_pack_int(pack, mdd_pack_get(pack, path), &val) ? 0 : val;
+    }
+    double pack_read = (bench_now_ms() - begin) * 1000 / reads;
+
+    printf("nodes:%zu rounds:%d walks %s, reads %s\n", tree_nodes / rounds, rounds,
+            tree_nodes == pack_nodes && tree_sum == pack_sum ? "agree" : "DIFFER", tree_vals == pack_vals ? "agree" : "DIFFER");
+    printf("heap : tree %zu bytes, pack %zu bytes, pack build %.3f ms\n", tree_heap, mdd_pack_bytes(pack), build);
+    printf("walk : tree %9.3f ms  pack %9.3f ms\n", tree_walk, pack_walk);
+    printf("read : tree %9.3f us  pack %9.3f us\n", tree_read, pack_read);
+
+    mdd_pack_free(pack);
+    mdd_free_data(root);
+    mds_free_model(schema);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "bench_util.h"
+#include "log.h"
+#include "data_repo.h"
+
+static int write_text(const char *path, const char *text)
+{
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        return -1;
+    }
+    fputs(text, fp);
+    fclose(fp);
+    return 0;
+}
+
+static long file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) ? -1 : st.st_size;
+}
+
+static double restart_ms(const char *model, const char *data, int rounds)
+{
+    double total = 0;
+    for (int r = 0; r < rounds; r++) {
+        double begin = bench_now_ms();
+        if (repo_init(model, data)) {
+            printf("failed to init from %s\n", data);
+        }
+        total += bench_now_ms() - begin;
+        repo_free();
+    }
+    return total / rounds;
+}
+
+/* repo_init from the JSON data file against the binary snapshot of the same tree, 100k entries is about 10 MB of JSON */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 100000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 3;
+    const char *dir = argc > 3 ? argv[3] : "/tmp";
+    set_log_level(LOG_LEVEL_ERR);
+
+    char model[256], json[256], snap[256];
+    snprintf(model, sizeof(model), "%s/bench_restart_model.json", dir);
+    snprintf(json, sizeof(json), "%s/bench_restart_data.json", dir);
+    snprintf(snap, sizeof(snap), "%s/bench_restart_data.snap", dir);
+
+    char *data = bench_list_json(cnt, 0, 0);
+    if (write_text(model, BENCH_MODEL_JSON) || write_text(json, data)) {
+        printf("failed to write bench files under %s\n", dir);
+        return 1;
+    }
+    free(data);
+
+    repo_init(model, json);
+    repo_save_snapshot(snap);
+    repo_free();
+
+    double from_json = restart_ms(model, json, rounds);
+    double from_snap = restart_ms(model, snap, rounds);
+
+    printf("entries:%d rounds:%d\n", cnt, rounds);
+    printf("json      : %10.3f ms/init  %10ld bytes\n", from_json, file_size(json));
+    printf("snapshot  : %10.3f ms/init  %10ld bytes  speedup %8.2fx\n", from_snap, file_size(snap),
+            from_json / from_snap);
+
+    remove(model);
+    remove(json);
+    remove(snap);
+    return 0;
+}
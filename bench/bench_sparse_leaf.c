@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "bench_util.h"
+#include "log.h"
+#include "data_parser.h"
+#include "model_parser.h"
+
+/* a list whose schema declares `leafs` int leaves besides Id */
+static char* sparse_model(int leafs)
+{
+    struct bench_buf buf = {NULL, 0, 0};
+    char tmp[128];
+    bench_append(&buf, "{\"Data\": {\"@attr\": {\"mtype\": \"container\"},"
+            "\"PortList\": {\"@attr\": {\"mtype\": \"list\", \"index\": \"ordered\"},"
+            "\"Id\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"int\"}}");
+    for (int i = 0; i < leafs; i++) {
+        snprintf(tmp, sizeof(tmp), ",\"L%d\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"int\"}}", i);
+        bench_append(&buf, tmp);
+    }
+    bench_append(&buf, "}}}");
+    return buf.data;
+}
+
+/* each instance sets `set` of the leaves, picked apart so they spread over the schema */
+static char* sparse_json(int cnt, int leafs, int set)
+{
+    struct bench_buf buf = {NULL, 0, 0};
+    char tmp[64];
+    bench_append(&buf, "{\"Data\": {\"PortList\": [");
+    for (int i = 0; i < cnt; i++) {
+        snprintf(tmp, sizeof(tmp), "%s{\"Id\": %d", i ? "," : "", i);
+        bench_append(&buf, tmp);
+        for (int k = 0; k < set; k++) {
+            snprintf(tmp, sizeof(tmp), ", \"L%d\": %d", (i + k * leafs / set) % leafs, i + k);
+            bench_append(&buf, tmp);
+        }
+        bench_append(&buf, "}");
+    }
+    bench_append(&buf, "]}}");
+    return buf.data;
+}
+
+/* parse, diff and free of a list whose instances hold few of the leaves their schema declares */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 200000;
+    int leafs = argc > 2 ? atoi(argv[2]) : 40;
+    int set = argc > 3 ? atoi(argv[3]) : 3;
+    int rounds = argc > 4 ? atoi(argv[4]) : 5;
+    set_log_level(LOG_LEVEL_ERR);
+
+    char *model = sparse_model(leafs);
+    struct mds_node *schema = mds_load_model(model);
+    free(model);
+    char *json = sparse_json(cnt, leafs, set);
+    double parse = 0, diff = 0, release = 0;
+    size_t heap = 0;
+    for (int r = 0; r < rounds; r++) {
+        struct mallinfo2 before = mallinfo2();
+        double begin = bench_now_ms();
+        struct mdd_node *run = mdd_parse_data(schema, json);
+        parse += bench_now_ms() - begin;
+        /* later rounds parse into blocks recycled by the node pool */
+        struct mallinfo2 after = mallinfo2();
+        heap = r ? heap : after.uordblks + after.hblkhd - before.uordblks - before.hblkhd;
+
+        struct mdd_node *edit = mdd_parse_data(schema, json);
+        begin = bench_now_ms();
+        mdd_free_diff(mdd_get_diff(schema, run, edit));
+        diff += bench_now_ms() - begin;
+
+        begin = bench_now_ms();
+        mdd_free_data(run);
+        release += bench_now_ms() - begin;
+        mdd_free_data(edit);
+    }
+
+    printf("entries:%d schema leaves:%d set:%d rounds:%d\n", cnt, leafs + 1, set + 1, rounds);
+    printf("parse : %9.3f ms  heap %zu bytes, %zu per entry\n", parse / rounds, heap, heap / cnt);
+    printf("diff  : %9.3f ms\n", diff / rounds);
+    printf("free  : %9.3f ms\n", release / rounds);
+
+    free(json);
+    mds_free_model(schema);
+    return 0;
+}
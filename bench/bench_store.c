@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "bench_util.h"
+#include "log.h"
+#include "data_repo.h"
+
+static int write_text(const char *path, const char *text)
+{
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        return -1;
+    }
+    fputs(text, fp);
+    fclose(fp);
+    return 0;
+}
+
+static long file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) ? -1 : st.st_size;
+}
+
+static double restart_ms(const char *model, const char *data, int rounds)
+{
+    double total = 0;
+    for (int r = 0; r < rounds; r++) {
+        double begin = bench_now_ms();
+        if (repo_init(model, data)) {
+            printf("failed to init from %s\n", data);
+        }
+        total += bench_now_ms() - begin;
+        repo_free();
+    }
+    return total / rounds;
+}
+
+/* one leaf set and commit per round, the commit persists the running tree to the data file */
+static double commit_ms(const char *model, const char *data, int cnt, int rounds)
+{
+    char path[64];
+    double total = 0;
+    repo_init(model, data);
+    for (int r = 0; r < rounds; r++) {
+        snprintf(path, sizeof(path), "Data/ChildList[Id=%d]/IntLeaf", (r * 7919) % cnt);
+        double begin = bench_now_ms();
+        if (repo_set_int(path, -r) || repo_commit()) {
+            printf("failed to commit %s\n", path);
+        }
+        total += bench_now_ms() - begin;
+    }
+    repo_free();
+    return total / rounds;
+}
+
+/* restart and single-edit commit on the JSON file, the binary snapshot and the mapped store of one tree */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 100000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 3;
+    const char *dir = argc > 3 ? argv[3] : "/tmp";
+    set_log_level(LOG_LEVEL_ERR);
+
+    char model[256], json[256], snap[256], store[256];
+    snprintf(model, sizeof(model), "%s/bench_store_model.json", dir);
+    snprintf(json, sizeof(json), "%s/bench_store_data.json", dir);
+    snprintf(snap, sizeof(snap), "%s/bench_store_data.snap", dir);
+    snprintf(store, sizeof(store), "%s/bench_store_data.mdm", dir);
+
+    char *data = bench_list_json(cnt, 0, 0);
+    if (write_text(model, BENCH_MODEL_JSON) || write_text(json, data)) {
+        printf("failed to write bench files under %s\n", dir);
+        return 1;
+    }
+    free(data);
+
+    repo_init(model, json);
+    repo_save_snapshot(snap);
+    repo_save_store(store);
+    repo_free();
+
+    printf("entries:%d rounds:%d\n", cnt, rounds);
+    const char *names[] = {"json", "snapshot", "store"};
+    const char *files[] = {json, snap, store};
+    for (int i = 0; i < 3; i++) {
+        double init = restart_ms(model, files[i], rounds);
+        double commit = commit_ms(model, files[i], cnt, rounds * 10);
+        printf("%-9s : %10.3f ms/init  %10.3f ms/commit  %10ld bytes\n", names[i], init, commit,
+                file_size(files[i]));
+    }
+
+    remove(model);
+    remove(json);
+    remove(snap);
+    remove(store);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "bench_util.h"
+#include "log.h"
+#include "data_parser.h"
+#include "model_parser.h"
+
+/* the bench model with ChildList ordered, so the diff pairs instances by key */
+static char* ordered_model(void)
+{
+    const char *attr = "\"ChildList\": {\"@attr\": {\"mtype\": \"list\"";
+    const char *pos = strstr(BENCH_MODEL_JSON, attr) + strlen(attr);
+    size_t len = strlen(BENCH_MODEL_JSON) + 32;
+    char *model = malloc(len);
+    snprintf(model, len, "%.*s, \"index\": \"ordered\"%s", (int) (pos - BENCH_MODEL_JSON), BENCH_MODEL_JSON, pos);
+    return model;
+}
+
+/* parse, diff and free of trees whose string leaves are short names, with the heap they take */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 200000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 5;
+    set_log_level(LOG_LEVEL_ERR);
+
+    char *model = ordered_model();
+    struct mds_node *schema = mds_load_model(model);
+    free(model);
+    char *json = bench_list_json(cnt, 0, 0);
+    double parse = 0, diff = 0, release = 0;
+    size_t heap = 0;
+    for (int r = 0; r < rounds; r++) {
+        size_t before = mallinfo2().uordblks;
+        double begin = bench_now_ms();
+        struct mdd_node *run = mdd_parse_data(schema, json);
+        parse += bench_now_ms() - begin;
+        heap = mallinfo2().uordblks - before;
+
+        struct mdd_node *edit = mdd_parse_data(schema, json);
+        begin = bench_now_ms();
+        mdd_free_diff(mdd_get_diff(schema, run, edit));
+        diff += bench_now_ms() - begin;
+
+        begin = bench_now_ms();
+        mdd_free_data(run);
+        release += bench_now_ms() - begin;
+        mdd_free_data(edit);
+    }
+
+    printf("entries:%d rounds:%d string leaves:%d\n", cnt, rounds, cnt * 2);
+    printf("parse : %9.3f ms  heap %zu bytes\n", parse / rounds, heap);
+    printf("diff  : %9.3f ms\n", diff / rounds);
+    printf("free  : %9.3f ms\n", release / rounds);
+
+    free(json);
+    mds_free_model(schema);
+    return 0;
+}
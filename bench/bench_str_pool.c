@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "bench_util.h"
+#include "log.h"
+#include "data_parser.h"
+#include "model_parser.h"
+
+/* the bench model with ChildList ordered, so the diff pairs instances by key */
+static char* ordered_model(void)
+{
+    const char *attr = "\"ChildList\": {\"@attr\": {\"mtype\": \"list\"";
+    const char *pos = strstr(BENCH_MODEL_JSON, attr) + strlen(attr);
+    size_t len = strlen(BENCH_MODEL_JSON) + 32;
+    char *model = malloc(len);
+    snprintf(model, len, "%.*s, \"index\": \"ordered\"%s", (int) (pos - BENCH_MODEL_JSON), BENCH_MODEL_JSON, pos);
+    return model;
+}
+
+/* ChildList whose string leaves repeat one of `distinct` long values, like profile names in a config */
+static char* repeated_json(int cnt, int distinct)
+{
+    struct bench_buf buf = {NULL, 0, 0};
+    char tmp[256];
+    bench_append(&buf, "{\"Data\": {\"Name\": \"bench\", \"Value\": 1, \"ChildData\": {\"IntLeaf\": 1}, \"ChildList\": [");
+    for (int i = 0; i < cnt; i++) {
+        snprintf(tmp, sizeof(tmp), "%s{\"Id\": %d, \"IntLeaf\": %d, \"StrLeaf\": \"qos-profile-default-gold-%d\","
+                "\"SubChildList\": [{\"Id\": 1, \"StrLeaf\": \"GigabitEthernet0/0/%d\"}]}", i ? "," : "", i, i,
+                i % distinct, i % distinct);
+        bench_append(&buf, tmp);
+    }
+    bench_append(&buf, "]}}");
+    return buf.data;
+}
+
+/* heap of a running and an editing tree parsed from the same config, and the diff between them */
+int main(int argc, char **argv)
+{
+    int cnt = argc > 1 ? atoi(argv[1]) : 200000;
+    int distinct = argc > 2 ? atoi(argv[2]) : 64;
+    int rounds = argc > 3 ? atoi(argv[3]) : 5;
+    set_log_level(LOG_LEVEL_ERR);
+
+    char *model = ordered_model();
+    struct mds_node *schema = mds_load_model(model);
+    free(model);
+    char *json = repeated_json(cnt, distinct);
+    double parse = 0, diff = 0;
+    size_t heap = 0;
+    for (int r = 0; r < rounds; r++) {
+        size_t before = mallinfo2().uordblks;
+        double begin = bench_now_ms();
+        struct mdd_node *run = mdd_parse_data(schema, json);
+        struct mdd_node *edit = mdd_parse_data(schema, json);
+        parse += bench_now_ms() - begin;
+        heap = mallinfo2().uordblks - before;
+
+        begin = bench_now_ms();
+        mdd_free_diff(mdd_get_diff(schema, run, edit));
+        diff += bench_now_ms() - begin;
+
+        mdd_free_data(run);
+        mdd_free_data(edit);
+    }
+
+    printf("entries:%d distinct values:%d rounds:%d string leaves:%d\n", cnt, distinct, rounds, cnt * 4);
+    printf("parse x2 : %9.3f ms  heap %zu bytes\n", parse / rounds, heap);
+    printf("diff     : %9.3f ms\n", diff / rounds);
+
+    free(json);
+    mds_free_model(schema);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef _BENCH_UTIL_H_
+#define _BENCH_UTIL_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *BENCH_MODEL_JSON __attribute__((unused)) = "{\"Data\": {\"@attr\": {\"mtype\": \"container\"},"
+        "\"Name\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"string\"}},"
+        "\"Value\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"int\"}},"
+        "\"ChildData\": {\"@attr\": {\"mtype\": \"container\"},"
+        "    \"IntLeaf\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"int\"}}},"
+        "\"ChildList\": {\"@attr\": {\"mtype\": \"list\"},"
+        "    \"Id\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"int\"}},"
+        "    \"IntLeaf\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"int\"}},"
+        "    \"StrLeaf\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"string\"}},"
+        "    \"SubChildList\": {\"@attr\": {\"mtype\": \"list\"},"
+        "        \"Id\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"int\"}},"
+        "        \"StrLeaf\": {\"@attr\": {\"mtype\": \"leaf\", \"dtype\": \"string\"}}}}}}";
+
+struct bench_buf{
+    char *data;
+    size_t size;
+    size_t len;
+};
+
+static inline double bench_now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static inline void bench_append(struct bench_buf *buf, const char *str)
+{
+    size_t len = strlen(str);
+    if (buf->len + len + 1 > buf->size) {
+        buf->size = (buf->size + len + 1) * 2;
+        buf->data = realloc(buf->data, buf->size);
+    }
+    memcpy(buf->data + buf->len, str, len + 1);
+    buf->len += len;
+}
+
+/* ChildList with cnt entries; every `every`-th entry gets IntLeaf bumped by `shift` */
+static inline char* bench_list_json(int cnt, int every, int shift)
+{
+    struct bench_buf buf = {NULL, 0, 0};
+    char tmp[256];
+    bench_append(&buf, "{\"Data\": {\"Name\": \"bench\", \"Value\": 1, \"ChildData\": {\"IntLeaf\": 1}, \"ChildList\": [");
+    for (int i = 0; i < cnt; i++) {
+        int val = (every > 0 && i % every == 0) ? i + shift : i;
+        snprintf(tmp, sizeof(tmp), "%s{\"Id\": %d, \"IntLeaf\": %d, \"StrLeaf\": \"name-%d\","
+                "\"SubChildList\": [{\"Id\": 1, \"StrLeaf\": \"sub-%d\"}]}", i ? "," : "", i, val, i, i);
+        bench_append(&buf, tmp);
+    }
+    bench_append(&buf, "]}}");
+    return buf.data;
+}
+
+#endif
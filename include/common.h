@@ -2,6 +2,7 @@
 #define __MDM_COMMON_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 struct mdd_vector{
     size_t capacity;
@@ -13,4 +14,97 @@ int vector_init(struct mdd_vector *vec, void *ele);
 int vector_add(struct mdd_vector *vec, void *ele);
 void vector_free(struct mdd_vector *vec);
 
+/* open addressing map keyed by non-zero integers or pointers */
+struct mdd_hmap{
+    size_t capacity;
+    size_t size;
+    uintptr_t *keys;
+    void **vals;
+};
+
+int hmap_init(struct mdd_hmap *map, size_t capacity);
+int hmap_put(struct mdd_hmap *map, uintptr_t key, void *val);
+void* hmap_get(const struct mdd_hmap *map, uintptr_t key);
+void* hmap_del(struct mdd_hmap *map, uintptr_t key);
+void hmap_clear(struct mdd_hmap *map);
+void hmap_free(struct mdd_hmap *map);
+
+/* bump allocator, everything allocated from it is released at once */
+struct arena_block;
+
+struct mdd_arena{
+    struct arena_block *head;
+    size_t block_size;
+};
+
+int arena_init(struct mdd_arena *arena, size_t block_size);
+void* arena_alloc(struct mdd_arena *arena, size_t size);
+void arena_merge(struct mdd_arena *dst, struct mdd_arena *src);
+size_t arena_used(const struct mdd_arena *arena);
+void arena_free(struct mdd_arena *arena);
+
+/* B+ tree keyed by long long with non-NULL values, leaves are chained for ordered scans */
+struct btree_node;
+
+struct mdd_btree{
+    struct btree_node *root;
+    size_t size;
+};
+
+/* a position in the leaf chain, invalidated by any put or del */
+struct mdd_btree_iter{
+    const struct btree_node *node;
+    unsigned int pos;
+};
+
+int btree_init(struct mdd_btree *tree);
+int btree_put(struct mdd_btree *tree, long long key, void *val);
+void* btree_get(const struct mdd_btree *tree, long long key);
+void* btree_del(struct mdd_btree *tree, long long key);
+void btree_seek(const struct mdd_btree *tree, long long key, struct mdd_btree_iter *iter);
+int btree_next(struct mdd_btree_iter *iter, long long *key, void **val);
+int btree_last(const struct mdd_btree *tree, long long *key, void **val);
+void btree_free(struct mdd_btree *tree);
+
+/*
+ * Process wide pool of immutable strings with reference counts. Equal strings intern to the
+ * same pointer, so interned strings compare by address. Every intern or ref takes one release.
+ */
+const char* strpool_intern(const char *str, size_t len);
+const char* strpool_ref(const char *str);
+void strpool_release(const char *str);
+size_t strpool_count(void);
+
+/*
+ * Process wide recycling of the fixed size blocks behind nodes, slots and diff arenas, in size
+ * classes of 16 bytes up to 512 and of 512 up to 16K. A thread keeps a cache per class in front
+ * of a shared depot and trades whole batches with it, so it only locks once per batch. Larger
+ * blocks and blocks beyond the depot limit go straight to malloc and free. Blocks are zeroed.
+ */
+struct nodepool_stats{
+    unsigned long long allocs;
+    unsigned long long releases;
+    unsigned long long mallocs;
+    unsigned long long frees;
+    size_t depot_bytes;
+};
+
+void* nodepool_alloc(size_t size);
+void nodepool_free(void *ptr, size_t size);
+/* bytes the depot may keep, NODEPOOL_LIMIT by default, 0 turns recycling off */
+#define NODEPOOL_LIMIT (64 * 1024 * 1024)
+void nodepool_set_limit(size_t bytes);
+/* gives the depot and the cache of the calling thread back to malloc */
+void nodepool_trim(void);
+void nodepool_get_stats(struct nodepool_stats *stats);
+
+/* int32 keys in list order: the first position holding key or -1, and the first position where a and b differ or cnt */
+long keys_find(const int32_t *keys, size_t cnt, int32_t key);
+size_t keys_mismatch(const int32_t *a, const int32_t *b, size_t cnt);
+
+/* JSON string bodies without the quotes; the span is the leading run that needs no escape */
+size_t json_escape_span(const char *str, size_t len);
+/* dst needs len bytes at most, returns the decoded length or -1 on a bad escape */
+long json_unescape(char *dst, const char *src, size_t len);
+
 #endif
@@ -0,0 +1,28 @@
+#ifndef __MDM_DATA_AGG_H_
+#define __MDM_DATA_AGG_H_
+
+#include "data_parser.h"
+
+typedef enum {
+    MDD_AGG_COUNT, MDD_AGG_SUM, MDD_AGG_MIN, MDD_AGG_MAX
+} mdd_agg_type;
+
+/*
+ * An aggregate over one leaf of every instance of a list, named by its schema path
+ * such as Data/ChildList/SubChildList. COUNT without a leaf counts the instances,
+ * otherwise only instances holding the leaf take part; SUM, MIN and MAX need an int
+ * leaf. The value is loaded by one walk and then kept current from commit diffs,
+ * MIN and MAX keep the values in a B-tree so removals never rescan.
+ */
+struct mdd_agg;
+
+struct mdd_agg* mdd_agg_create(struct mds_node *schema, const char *list_path, const char *leaf, mdd_agg_type type);
+void mdd_agg_free(struct mdd_agg *agg);
+int mdd_agg_load(struct mdd_agg *agg, struct mdd_node *root);
+int mdd_agg_apply(struct mdd_agg *agg, const mdd_diff *diff);
+/* returns -1 for MIN and MAX over no values */
+int mdd_agg_value(const struct mdd_agg *agg, long long *val);
+/* the list the aggregate runs over, its leaf, NULL for a COUNT without one, and its type */
+void mdd_agg_target(const struct mdd_agg *agg, struct mds_node **lists, struct mds_node **leaf, mdd_agg_type *type);
+
+#endif
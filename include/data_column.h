@@ -0,0 +1,47 @@
+#ifndef __MDM_DATA_COLUMN_H_
+#define __MDM_DATA_COLUMN_H_
+
+#include "data_parser.h"
+#include "data_agg.h"
+
+/*
+ * A read-only column snapshot of the instances of one list declared with "snapshot": "columnar"
+ * under one parent. It is derived from the tree and never replaces it: the nodes stay the storage,
+ * edits go to them and do not reach a snapshot taken before. Rows are kept in key order, the Id
+ * values form the key column and every other leaf gets an array of its type with a bitmap of the
+ * rows holding it; string values are shared through the string pool. Key lookups are a binary
+ * search, scans and aggregates run over the arrays without touching nodes, and a row turns back
+ * into a list instance on demand. A snapshot carries the version of the tree it was taken from,
+ * e.g. repo_version(), and is stale once the list changed in a later one; repo_agg_register
+ * keeps its aggregates over such lists this way.
+ */
+struct mdd_columns;
+
+/* rows with lo <= key <= hi in key order */
+struct mdd_column_cursor{
+    const struct mdd_columns *cols;
+    size_t row;
+    long long hi;
+};
+
+struct mdd_columns* mdd_columns_snapshot(struct mdd_node *parent, struct mds_node *lists, unsigned long long version);
+void mdd_columns_free(struct mdd_columns *cols);
+/* the version passed to mdd_columns_snapshot */
+unsigned long long mdd_columns_version(const struct mdd_columns *cols);
+size_t mdd_columns_rows(const struct mdd_columns *cols);
+long long mdd_columns_key(const struct mdd_columns *cols, size_t row);
+/* the row holding key, or -1 */
+long mdd_columns_find(const struct mdd_columns *cols, long long key);
+int mdd_columns_range(const struct mdd_columns *cols, long long lo, long long hi, struct mdd_column_cursor *cursor);
+/* the next row, or -1 at the end */
+long mdd_columns_next(struct mdd_column_cursor *cursor);
+/* the value of an int leaf or the code of an enum leaf, -1 when the row lacks the leaf */
+int mdd_columns_int(const struct mdd_columns *cols, size_t row, const struct mds_node *leaf, long long *val);
+/* the value of a string leaf or the name of an enum leaf, NULL when the row lacks the leaf */
+const char* mdd_columns_str(const struct mdd_columns *cols, size_t row, const struct mds_node *leaf);
+/* same rules as mdd_agg_value, leaf may be NULL for COUNT */
+int mdd_columns_agg(const struct mdd_columns *cols, const struct mds_node *leaf, mdd_agg_type type, long long *val);
+/* a detached list instance holding the leaves of row, for mdd_insert_node or the dump */
+struct mdd_node* mdd_columns_node(const struct mdd_columns *cols, size_t row);
+
+#endif
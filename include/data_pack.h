@@ -0,0 +1,48 @@
+#ifndef __MDM_DATA_PACK_H_
+#define __MDM_DATA_PACK_H_
+
+#include <stdint.h>
+#include "data_parser.h"
+
+/*
+ * A read only copy of a data tree for large configs that are mostly read. Mos sit in one slab in
+ * pre-order and link to each other by 32 bit refs instead of pointers, a mo names its schema by a
+ * 16 bit id into the schema table, and string values share one arena. A mo keeps its leaves as a
+ * fixed array of 8 byte values in schema order behind a presence bitmap, so a mo takes 20 bytes
+ * and a leaf 8 where the tree spends 72 and 64 plus the allocator header. A leaf has no record of
+ * its own: its ref names its mo and position, it is read in place and materialized as a node by
+ * mdd_pack_view or mdd_pack_node only where a node is asked for. The leaves of a mo come first in
+ * schema order, then its mos in tree order; a repeated leaf keeps its first value. The repo serves
+ * repo_read_int and repo_read_str from a pack of its committed tree.
+ */
+struct mdd_pack;
+
+/* 0 is no node, the low bit tells a leaf from a mo */
+typedef uint32_t mdd_ref;
+#define MDD_REF_NULL 0
+#define mdd_ref_is_leaf(ref) ((ref) & 1)
+
+struct mdd_pack* mdd_pack_build(struct mdd_node *root);
+void mdd_pack_free(struct mdd_pack *pack);
+/* bytes held by the slabs, the string arena, the schema table and the key index */
+size_t mdd_pack_bytes(const struct mdd_pack *pack);
+
+mdd_ref mdd_pack_root(const struct mdd_pack *pack);
+mdd_ref mdd_pack_parent(const struct mdd_pack *pack, mdd_ref ref);
+mdd_ref mdd_pack_child(const struct mdd_pack *pack, mdd_ref ref);
+mdd_ref mdd_pack_next(const struct mdd_pack *pack, mdd_ref ref);
+struct mds_node* mdd_pack_schema(const struct mdd_pack *pack, mdd_ref ref);
+/* the first child of a mo with the given schema, a leaf in one step */
+mdd_ref mdd_pack_find(const struct mdd_pack *pack, mdd_ref ref, const struct mds_node *schema);
+/* the node at a path as taken by mdd_get_data */
+mdd_ref mdd_pack_get(const struct mdd_pack *pack, const char *path);
+/* the value of an int leaf or the code of an enum leaf */
+int mdd_pack_int(const struct mdd_pack *pack, mdd_ref ref, long long *val);
+/* the value of a string leaf or the name of an enum leaf */
+const char* mdd_pack_str(const struct mdd_pack *pack, mdd_ref ref);
+/* the leaf at ref as a node in view, valid while the pack lives, never linked, edited or freed */
+int mdd_pack_view(const struct mdd_pack *pack, mdd_ref ref, struct mdd_leaf *view);
+/* a detached copy of the subtree at ref as nodes, freed by mdd_free_data */
+struct mdd_node* mdd_pack_node(const struct mdd_pack *pack, mdd_ref ref);
+
+#endif
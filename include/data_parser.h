@@ -1,15 +1,31 @@
 #ifndef __DATA_PARSER_H
 #define __DATA_PARSER_H
 
+#include <stdint.h>
+#include <pthread.h>
 #include <cjson/cJSON.h>
 #include "model_parser.h"
 #include "common.h"
 
-typedef struct mdd_vector mdd_diff;
+struct mdd_pool;
+
+struct mdd_mo_diff;
+
+/* the header, vec and every record live in the arena and go away with mdd_free_diff */
+typedef struct mdd_diff{
+    size_t capacity;
+    size_t size;
+    struct mdd_mo_diff **vec;
+    struct mdd_arena arena;
+} mdd_diff;
+
+/* strings up to MDD_SSO_LEN bytes live inline, the last byte is set when strv points into the string pool */
+#define MDD_SSO_LEN 15
 
 typedef union {
     long long intv;
-    char *strv;
+    const char *strv;
+    char sso[MDD_SSO_LEN + 1];
 } mdd_dvalue;
 
 struct mdd_node{
@@ -19,8 +35,12 @@ struct mdd_node{
     struct mdd_node *child;
     struct mdd_node *prev;
     struct mdd_node *next;
+
+    unsigned int flags;
 };
 
+struct mdd_index;
+
 struct mdd_mo{
     struct mds_node *schema;
 
@@ -28,6 +48,17 @@ struct mdd_mo{
     struct mdd_node *child;
     struct mdd_node *prev;
     struct mdd_node *next;
+
+    unsigned int flags;
+
+    /* key indexes of the ordered lists below this mo */
+    struct mdd_index *index;
+    /*
+     * Slots in leaf_idx order for the leaves the mo was built with, behind the bitmaps of the
+     * positions given a slot and of the slots in use. A leaf takes its slot when built under the
+     * mo, leaves inserted later or repeated are allocated alone.
+     */
+    struct mdd_leaf *slots;
 };
 
 struct mdd_leaf{
@@ -38,33 +69,155 @@ struct mdd_leaf{
     struct mdd_node *prev;
     struct mdd_node *next;
 
+    unsigned int flags;
+
     mdd_dvalue value;
 };
 
+#define str_leaf_val(node) (((struct mdd_leaf*) (node))->value.sso[MDD_SSO_LEN] ? \
+        (const char*) ((struct mdd_leaf*) (node))->value.strv : (const char*) ((struct mdd_leaf*) (node))->value.sso)
+
 typedef enum {
     DF_ADD, DF_DELETE, DF_MODIFY
 } mdd_diff_type;
 
-struct mdd_leaf_diff{
-    struct mdd_leaf *edit_leaf;
-    struct mdd_leaf *run_leaf;
-};
-
+/* modified leaves are bits over the schema leaf positions of the mo, see mds_leaf_at */
 struct mdd_mo_diff{
     mdd_diff_type type;
     struct mdd_mo *edit_data;
     struct mdd_mo *run_data;
 
-    mdd_diff diff_leafs;
+    unsigned int leaf_cnt;
+    unsigned int nbits;
+    uint64_t leaf_bits[];
+};
+
+/* node flags, added and deleted only last until the diff or abort of their change */
+#define MDD_F_ADDED     0x1
+#define MDD_F_DELETED   0x2
+/* the node sits in a chunk of mdd_compact_tree */
+#define MDD_F_CHUNK     0x4
+/* the mo is a track shadow with the touched bits behind it */
+#define MDD_F_SHADOW    0x8
+/* the root of a tree with tracked edits not yet taken */
+#define MDD_F_PENDING   0x10
+
+typedef enum {
+    CH_MODIFY, CH_ADD, CH_DEL
+} mdd_change_type;
+
+/*
+ * One tracked mutation, old_node is the detached run side and new_node the live edit side.
+ * For CH_MODIFY the run side is a shadow mo holding the old values of the touched leaves.
+ * For CH_DEL prev is the mo sibling old_node followed, so an abort links it back in place.
+ */
+struct mdd_change{
+    mdd_change_type type;
+    struct mdd_node *parent;
+    struct mdd_node *old_node;
+    struct mdd_node *new_node;
+    struct mdd_node *prev;
+};
+
+/*
+ * JSON bodies of mos kept by the dumps made through it, in a table of its own so that dumping
+ * only reads the tree. Bodies are keyed by mo and never nest: a mo is cached only when no
+ * ancestor is, and caching it drops the bodies of its children. A track given the cache drops
+ * the bodies at and above every mo it edits and those of the mos it frees, a tree changed any
+ * other way must be cleared. Dumps sharing the cache take its lock, edits already exclude them.
+ */
+struct mdd_frag_cache{
+    struct mdd_hmap frags;
+    size_t bytes;
+    pthread_mutex_t lock;
+};
+
+/*
+ * Change tracking for in-place edits. Every mutation records a mdd_change, so the diff
+ * is built from the changes alone and never walks the tree; the root edited is flagged
+ * pending until then. Shadow mos and removed mos are kept until the diff after the one
+ * they took part in.
+ */
+struct mdd_track{
+    struct mdd_node *root;
+    struct mdd_vector changes;
+    struct mdd_hmap shadows;
+    struct mdd_vector retired;
+    struct mdd_vector released;
+    /* fragments to drop on edit, NULL when no cache follows the tree */
+    struct mdd_frag_cache *frags;
+};
+
+/* ordered scan over the instances of an ordered list, invalidated by any edit of that list */
+struct mdd_list_cursor{
+    struct mdd_btree_iter iter;
+    long long hi;
+};
+
+/* instances of a list whose indexed leaf equals a value, in the order they entered the index */
+struct index_slot;
+
+struct mdd_index_cursor{
+    const struct index_slot *tail;
+    const struct index_slot *slot;
+    struct mds_node *leaf;
+    const char *value;
+    size_t value_len;
+    long long intv;
+    int is_int;
 };
 
 struct mdd_node* mdd_parse_json(struct mds_node *schema, const cJSON *data_json);
 struct mdd_node* mdd_parse_data(struct mds_node *schema, const char *data_json);
 void mdd_free_data(struct mdd_node *root);
 struct mdd_node* mdd_get_data(struct mdd_node *root, const char *path);
+int mdd_get_many(struct mdd_node *root, const char **paths, size_t n, struct mdd_node **out);
+struct mdd_node* mdd_find_list(struct mdd_node *parent, struct mds_node *lists, long long key);
+int mdd_list_range(struct mdd_node *parent, struct mds_node *lists, long long lo, long long hi,
+        struct mdd_list_cursor *cursor);
+struct mdd_node* mdd_list_next(struct mdd_list_cursor *cursor);
+int mdd_index_seek(struct mdd_node *parent, struct mds_node *lists, const char *leaf, const char *value,
+        struct mdd_index_cursor *cursor);
+struct mdd_node* mdd_index_next(struct mdd_index_cursor *cursor);
 int mdd_dump_data(struct mdd_node *root, char **json_str);
+int mdd_dump_subtree(struct mdd_node *node, char **json_str);
+int mdd_frag_init(struct mdd_frag_cache *cache);
+void mdd_frag_clear(struct mdd_frag_cache *cache);
+void mdd_frag_free(struct mdd_frag_cache *cache);
+void mdd_frag_relocate(struct mdd_frag_cache *cache, const struct mdd_hmap *moved);
+size_t mdd_frag_bytes(const struct mdd_frag_cache *cache);
+int mdd_dump_data_cached(struct mdd_frag_cache *cache, struct mdd_node *root, char **json_str);
+int mdd_dump_subtree_cached(struct mdd_frag_cache *cache, struct mdd_node *node, char **json_str);
+int mdd_dump_snapshot(struct mdd_node *root, char **buf, size_t *len);
+struct mdd_node* mdd_load_snapshot(struct mds_node *schema, const char *buf, size_t len);
+int mdd_is_snapshot(const char *buf, size_t len);
+struct mdd_node* mdd_new_node(struct mds_node *schema);
+struct mdd_node* mdd_new_child(struct mdd_node *parent, struct mds_node *schema);
+void mdd_fit_slots(struct mdd_node *mo);
+int mdd_link_child(struct mdd_node *parent, struct mdd_node *prev, struct mdd_node *child);
+struct mdd_node* mdd_compact_tree(struct mdd_node *root, struct mdd_hmap *moved);
+int mdd_leaf_set_str(struct mdd_leaf *leaf, const char *str, size_t len);
 void mdd_free_diff(mdd_diff *diff);
 mdd_diff* mdd_get_diff(struct mds_node *schema, struct mdd_node *root1, struct mdd_node *root2);
+mdd_diff* mdd_get_diff_parallel(struct mds_node *schema, struct mdd_node *root1, struct mdd_node *root2,
+        struct mdd_pool *pool);
 void mdd_dump_diff(mdd_diff *diff);
+mdd_diff* mdd_copy_diff(const mdd_diff *diff);
+int mdd_diff_next_leaf(const struct mdd_mo_diff *modiff, int pos);
+int mdd_diff_leaf(const struct mdd_mo_diff *modiff, int pos, struct mdd_leaf **run_leaf, struct mdd_leaf **edit_leaf);
+
+int mdd_track_init(struct mdd_track *track);
+void mdd_track_free(struct mdd_track *track);
+int mdd_set_int(struct mdd_track *track, struct mdd_node *leaf, long long val);
+int mdd_set_str(struct mdd_track *track, struct mdd_node *leaf, const char *val);
+int mdd_insert_node(struct mdd_track *track, struct mdd_node *parent, struct mdd_node *node);
+int mdd_delete_node(struct mdd_track *track, struct mdd_node *node);
+struct mdd_node* mdd_parse_child(struct mds_node *schema, const cJSON *data_json);
+mdd_diff* mdd_get_dirty_diff(struct mdd_track *track);
+void mdd_track_abort(struct mdd_track *track);
+int mdd_track_pending(const struct mdd_track *track);
+
+int mdd_diff_to_patch(const mdd_diff *diff, char **patch_str);
+int mdd_apply_patch(struct mdd_track *track, struct mdd_node *root, const char *patch_str);
 
 #endif
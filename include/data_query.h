@@ -0,0 +1,31 @@
+#ifndef __MDM_DATA_QUERY_H_
+#define __MDM_DATA_QUERY_H_
+
+#include "data_parser.h"
+
+/*
+ * Query expressions extend the mdd_get_data path syntax, for example
+ *   Data/ChildList[IntLeaf>=10][Id!=22]/SubChildList
+ * A fragment is a child name, or `*` for any child, followed by any number of
+ * [leaf op value] predicates that must all hold. op is one of = != < <= > >=;
+ * ordering ops only match int leaves. A fragment without a key matches every
+ * list instance. An `Id=N` predicate is resolved through mdd_find_list and
+ * an `=` predicate on an indexed leaf through mdd_index_seek.
+ */
+struct mdd_query;
+struct mdd_query_iter;
+
+struct mdd_query* mdd_query_compile(const char *expr);
+void mdd_query_free(struct mdd_query *query);
+
+/*
+ * Yields matches in document order, except that a step fed by a leaf index follows index order.
+ * The tree must not change while the iterator is open.
+ */
+struct mdd_query_iter* mdd_query_open(const struct mdd_query *query, struct mdd_node *root);
+/* compiles expr for a single pass, the query is freed with the iterator */
+struct mdd_query_iter* mdd_query_open_expr(const char *expr, struct mdd_node *root);
+struct mdd_node* mdd_query_next(struct mdd_query_iter *iter);
+void mdd_query_close(struct mdd_query_iter *iter);
+
+#endif
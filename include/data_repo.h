@@ -3,15 +3,77 @@
 
 #include <cjson/cJSON.h>
 #include "data_parser.h"
+#include "data_query.h"
+#include "data_agg.h"
 
 int repo_init(const char *schema_path, const char *data_path);
 void repo_free();
 
 int repo_get(const char *path, struct mdd_node **out);
+int repo_get_many(const char **paths, size_t n, struct mdd_node **out);
+struct mdd_query_iter* repo_query(const char *expr);
+int repo_list_range(const char *list_path, long long lo, long long hi, struct mdd_list_cursor *cursor);
+
+/*
+ * Value reads by path for configs that are mostly read. Without pending edits they are served
+ * from a packed copy of the committed tree, see data_pack.h, packed again by the first read after
+ * a commit changed the tree; pending edits are read from the running tree. An enum reads as its
+ * code by repo_read_int and as its name by repo_read_str, which fails unless buf holds the value
+ * and its terminator.
+ */
+int repo_read_int(const char *path, long long *val);
+int repo_read_str(const char *path, char *buf, size_t size);
+
+/*
+ * The setters, repo_insert and repo_delete edit the running tree in place, so the reads see
+ * them at once. repo_commit publishes them as the next version and repo_abort takes them back.
+ * repo_edit, repo_edit_json and repo_apply_patch fail while such edits are pending, they never
+ * commit them along; repo_compact commits them first.
+ */
 int repo_edit(const char *edit_data);
 int repo_edit_json(const cJSON *edit_data);
+int repo_set_int(const char *path, long long val);
+int repo_set_str(const char *path, const char *val);
+int repo_insert(const char *parent_path, const char *edit_data);
+int repo_delete(const char *path);
+int repo_commit();
+void repo_abort();
+/* 1 while edits wait for repo_commit or repo_abort */
+int repo_pending();
+int repo_apply_patch(const char *patch);
+
+int repo_set_diff_threads(int nthreads);
+/* lays the running tree out again for fast walks, see mdd_compact_tree; nodes got before go stale */
+int repo_compact();
+/* compacts after every n commits that changed the running tree, 0 never does */
+int repo_set_compact_interval(unsigned int commits);
+
+/*
+ * Called after each commit that changed the running tree, the diff is only valid during the call.
+ * It is NULL when the tree was replaced by an edit that could not be diffed, so the version can
+ * only be caught up with a full copy of the tree.
+ */
+typedef void (*repo_diff_cb)(const mdd_diff *diff, unsigned long long version, void *arg);
+
+int repo_register_diff_cb(repo_diff_cb cb, void *arg);
+void repo_unregister_diff_cb(repo_diff_cb cb, void *arg);
+unsigned long long repo_version();
+int repo_dump(char **json_str);
+int repo_get_json(const char *path, char **json_str);
+int repo_save_snapshot(const char *file_path);
+int repo_save_store(const char *file_path);
+
+/*
+ * Aggregates are kept current by every commit, reads cost no walk. One registered while edits
+ * are pending, or that missed a diff, is loaded by the first read after their commit or abort.
+ * Over a list declared with "snapshot": "columnar" they read a column snapshot instead, taken
+ * again on the first read without pending edits after a commit changed the list, see
+ * data_column.h. Until such a load or snapshot succeeds, reads fail.
+ */
+int repo_agg_register(const char *list_path, const char *leaf, mdd_agg_type type);
+void repo_agg_unregister(int id);
+int repo_agg_get(int id, long long *val);
 
 #define int_leaf_val(node) ((struct mdd_leaf*)node)->value.intv
-#define str_leaf_val(node) ((struct mdd_leaf*)node)->value.strv
 
 #endif
@@ -0,0 +1,26 @@
+#ifndef __MDM_DATA_STORE_H_
+#define __MDM_DATA_STORE_H_
+
+#include "data_parser.h"
+
+/*
+ * Data file engine keeping the tree as pointer-free records in a shared file mapping.
+ * A record holds one mo: its schema id and its children in order, leaves inline and
+ * child mos as file offsets. A commit appends records for the changed mos and their
+ * spine only, msyncs the written pages and then publishes the new root offset in the
+ * header page. The file is rewritten compactly once stale records outweigh live ones.
+ */
+struct mdd_store;
+
+struct mdd_store* mdd_store_create(const char *path, struct mds_node *schema, struct mdd_node *root);
+/* root gets the tree of the last published root, built in one pass over the mapping */
+struct mdd_store* mdd_store_open(const char *path, struct mds_node *schema, struct mdd_node **root);
+/* root must be the tree from open or create; a NULL diff rewrites it whole, as after a reparse */
+int mdd_store_commit(struct mdd_store *store, struct mdd_node *root, const mdd_diff *diff);
+/* rekeys the records by the copies mdd_compact_tree made of the mos, records of mos not in moved are dropped */
+int mdd_store_relocate(struct mdd_store *store, const struct mdd_hmap *moved);
+void mdd_store_close(struct mdd_store *store);
+int mdd_store_probe(const char *path);
+size_t mdd_store_size(const struct mdd_store *store);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef __MDM_DATA_SYNC_H_
+#define __MDM_DATA_SYNC_H_
+
+#include <stddef.h>
+
+/*
+ * Hot-standby replication of the repo over connected local stream sockets.
+ * The leader turns every commit into a versioned patch, keeps the last `backlog`
+ * of them and queues them for its followers; sync_poll writes the queues as far
+ * as the sockets take them, so a commit never waits on a follower. A follower
+ * applies patches in version order and acks them; when it falls behind the
+ * backlog it gets a snapshot of the leader's running tree instead. Both sides
+ * are driven by sync_poll from the thread that owns the repo.
+ */
+struct repo_sync;
+
+struct repo_sync* sync_leader_create(size_t backlog);
+int sync_leader_add(struct repo_sync *sync, int fd);
+struct repo_sync* sync_follower_create(int fd, unsigned long long version);
+int sync_poll(struct repo_sync *sync, int timeout_ms);
+unsigned long long sync_version(const struct repo_sync *sync);
+unsigned long long sync_acked(const struct repo_sync *sync);
+void sync_destroy(struct repo_sync *sync);
+
+#endif
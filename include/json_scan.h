@@ -0,0 +1,32 @@
+#ifndef __MDM_JSON_SCAN_H_
+#define __MDM_JSON_SCAN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * First pass of the bulk JSON reader: the offsets of every structural byte of a text in order,
+ * that is {}[]:, both quotes of each string and the first byte of each number or literal.
+ * Bytes inside strings never show up, so a string is always two consecutive offsets.
+ */
+typedef enum{
+    JSON_KERNEL_AUTO,
+    JSON_KERNEL_SCALAR,
+    JSON_KERNEL_SSE2,
+    JSON_KERNEL_AVX2
+} json_kernel;
+
+struct json_index{
+    uint32_t *pos;
+    size_t cnt;
+    size_t cap;
+};
+
+int json_kernel_supported(json_kernel kernel);
+/* the kernel AUTO resolves to on this cpu */
+json_kernel json_kernel_best(void);
+/* fails on an unterminated string, a text over 4 GB or an unsupported kernel */
+int json_index_build(struct json_index *index, const char *json, size_t len, json_kernel kernel);
+void json_index_free(struct json_index *index);
+
+#endif
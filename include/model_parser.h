@@ -1,12 +1,15 @@
 #ifndef _MODEL_H_
 #define _MODEL_H_
 
+#include <stdint.h>
+#include "common.h"
+
 typedef enum {
     MDS_MT_NULL, MDS_MT_CONTAINER, MDS_MT_LIST, MDS_MT_LEAF
 } mds_mtype;
 
 typedef enum {
-    MDS_DT_NULL, MDS_DT_INT, MDS_DT_STR
+    MDS_DT_NULL, MDS_DT_INT, MDS_DT_STR, MDS_DT_ENUM
 } mds_dtype;
 
 struct mds_node{
@@ -27,8 +30,19 @@ struct mds_mo{
     struct mds_node *child;
     struct mds_node *prev;
     struct mds_node *next;
+
+    unsigned int leaf_cnt;
+    struct mds_node **leafs;
+    unsigned int flags;
 };
 
+/* mo flags, MDS_F_ORDERED keeps the instances of a list in a B-tree by key */
+#define MDS_F_ORDERED       0x1
+/* set on a list when one of its leaves is indexed */
+#define MDS_F_LEAF_INDEX    0x2
+/* a list of leaves only, keyed by an int Id, that callers may snapshot as columns, see data_column.h */
+#define MDS_F_COLUMN_SNAP   0x4
+
 struct mds_leaf{
     char *name;
     mds_mtype mtype;
@@ -39,8 +53,18 @@ struct mds_leaf{
     struct mds_node *next;
 
     mds_dtype dtype;
+    unsigned int leaf_idx;
+    unsigned int flags;
+
+    /* allowed values of an enum leaf, the data holds the position of its value in intv */
+    unsigned int enum_cnt;
+    char **enums;
 };
 
+/* leaf flags, an indexed leaf of a list gets a hash index of the instances by value */
+#define MDS_F_INDEXED       0x4
+#define MDS_F_UNIQUE        0x8
+
 #define is_mo(mtype) ((mtype)==MDS_MT_CONTAINER || (mtype)==MDS_MT_LIST)
 #define is_leaf(mtype) ((mtype)==MDS_MT_LEAF)
 #define is_cont_node(schema) ((schema)->mtype==MDS_MT_CONTAINER)
@@ -48,10 +72,34 @@ struct mds_leaf{
 #define is_leaf_node(schema) ((schema)->mtype==MDS_MT_LEAF)
 #define is_int_leaf(schema) ((schema)->mtype==MDS_MT_LEAF && (schema)->dtype==MDS_DT_INT)
 #define is_str_leaf(schema) ((schema)->mtype==MDS_MT_LEAF && (schema)->dtype==MDS_DT_STR)
+#define is_enum_leaf(schema) ((schema)->mtype==MDS_MT_LEAF && (schema)->dtype==MDS_DT_ENUM)
+/* leaves whose value is held in intv */
+#define is_intv_leaf(schema) (is_int_leaf(schema) || is_enum_leaf(schema))
+#define is_ordered_list(schema) (is_list_node(schema) && (((struct mds_mo*) (schema))->flags & MDS_F_ORDERED))
+#define is_column_snap_list(schema) (is_list_node(schema) && (((struct mds_mo*) (schema))->flags & MDS_F_COLUMN_SNAP))
+#define is_indexed_list(schema) (is_list_node(schema) && \
+        (((struct mds_mo*) (schema))->flags & (MDS_F_ORDERED | MDS_F_LEAF_INDEX)))
+#define is_indexed_leaf(schema) (is_leaf_node(schema) && (((struct mds_leaf*) (schema))->flags & MDS_F_INDEXED))
 
 struct mds_node* mds_load_model(const char *model_str);
 void mds_free_model(struct mds_node *root);
 struct mds_node* mds_find_child_schema(struct mds_node *curr, const char *name);
 struct mds_node* mds_find_next_schema(struct mds_node *curr, const char *name);
+struct mds_node* mds_leaf_at(const struct mds_node *mo, unsigned int idx);
+long mds_enum_code(const struct mds_node *leaf, const char *str, size_t len);
+const char* mds_enum_name(const struct mds_node *leaf, long long code);
+
+/* schema nodes numbered in pre-order, the fingerprint covers names, types and shape */
+struct mds_table{
+    struct mds_node **nodes;
+    size_t cnt;
+    size_t cap;
+    struct mdd_hmap ids;
+    uint32_t fingerprint;
+};
+
+int mds_table_init(struct mds_table *table, struct mds_node *root);
+void mds_table_free(struct mds_table *table);
+long mds_table_id(const struct mds_table *table, const struct mds_node *schema);
 
 #endif
@@ -0,0 +1,16 @@
+#ifndef __MDM_THREAD_POOL_H_
+#define __MDM_THREAD_POOL_H_
+
+#include <stddef.h>
+
+typedef void (*pool_task_fn)(void *arg);
+
+struct mdd_pool;
+
+struct mdd_pool* pool_create(int nthreads);
+void pool_destroy(struct mdd_pool *pool);
+int pool_threads(const struct mdd_pool *pool);
+int pool_submit(struct mdd_pool *pool, pool_task_fn fn, void *arg);
+void pool_wait(struct mdd_pool *pool);
+
+#endif
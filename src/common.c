@@ -1,5 +1,11 @@
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "macro.h"
 #include "log.h"
 #include "common.h"
@@ -29,7 +35,7 @@ int vector_add(struct mdd_vector *dvec, void *ele)
 
     if (dvec->capacity == dvec->size) {
         size_t newcap = dvec->capacity * 2;
-        void *newp = realloc(dvec->vec, newcap);
+        void *newp = realloc(dvec->vec, newcap * sizeof(void*));
         CHECK_DO_RTN_VAL(!newp, LOG_WARN("No memory."), -1);
 
         dvec->vec = newp;
@@ -49,3 +55,1116 @@ void vector_free(struct mdd_vector *dvec)
     dvec->size = 0;
     dvec->capacity = 0;
 }
+
+static size_t hmap_slot(uintptr_t key, size_t capacity)
+{
+    uint64_t h = (uint64_t) key * 0x9E3779B97F4A7C15ULL;
+    return (size_t) (h >> 32) & (capacity - 1);
+}
+
+int hmap_init(struct mdd_hmap *map, size_t capacity)
+{
+    CHECK_NULL_RTN(map, -1);
+
+    size_t cap = 16;
+    while (cap < capacity * 2) {
+        cap <<= 1;
+    }
+
+    memset(map, 0, sizeof(struct mdd_hmap));
+    map->keys = calloc(cap, sizeof(uintptr_t));
+    map->vals = calloc(cap, sizeof(void*));
+    if (!map->keys || !map->vals) {
+        LOG_WARN("No memory.");
+        hmap_free(map);
+        return -1;
+    }
+    map->capacity = cap;
+    return 0;
+}
+
+static int hmap_grow(struct mdd_hmap *map)
+{
+    struct mdd_hmap bigger;
+    int rt = hmap_init(&bigger, map->capacity);
+    CHECK_RTN_VAL(rt, -1);
+
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (map->keys[i]) {
+            hmap_put(&bigger, map->keys[i], map->vals[i]);
+        }
+    }
+    hmap_free(map);
+    *map = bigger;
+    return 0;
+}
+
+int hmap_put(struct mdd_hmap *map, uintptr_t key, void *val)
+{
+    CHECK_DO_RTN_VAL(!map || !key, LOG_WARN("Invalid map key"), -1);
+
+    if ((map->size + 1) * 2 > map->capacity) {
+        CHECK_RTN_VAL(hmap_grow(map), -1);
+    }
+
+    size_t i = hmap_slot(key, map->capacity);
+    while (map->keys[i] && map->keys[i] != key) {
+        i = (i + 1) & (map->capacity - 1);
+    }
+    if (!map->keys[i]) {
+        map->keys[i] = key;
+        map->size++;
+    }
+    map->vals[i] = val;
+    return 0;
+}
+
+void* hmap_get(const struct mdd_hmap *map, uintptr_t key)
+{
+    CHECK_RTN_VAL(!map || !map->capacity || !key, NULL);
+
+    size_t i = hmap_slot(key, map->capacity);
+    while (map->keys[i]) {
+        if (map->keys[i] == key) {
+            return map->vals[i];
+        }
+        i = (i + 1) & (map->capacity - 1);
+    }
+    return NULL;
+}
+
+/* shifts the rest of the probe run back so lookups never stop at the freed slot */
+void* hmap_del(struct mdd_hmap *map, uintptr_t key)
+{
+    CHECK_RTN_VAL(!map || !map->capacity || !key, NULL);
+
+    size_t mask = map->capacity - 1;
+    size_t i = hmap_slot(key, map->capacity);
+    while (map->keys[i] && map->keys[i] != key) {
+        i = (i + 1) & mask;
+    }
+    CHECK_RTN_VAL(!map->keys[i], NULL);
+
+    void *val = map->vals[i];
+    for (size_t j = (i + 1) & mask; map->keys[j]; j = (j + 1) & mask) {
+        size_t home = hmap_slot(map->keys[j], map->capacity);
+        /* the entry at j may fill the hole only if its home is not inside (i, j] */
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            map->keys[i] = map->keys[j];
+            map->vals[i] = map->vals[j];
+            i = j;
+        }
+    }
+    map->keys[i] = 0;
+    map->vals[i] = NULL;
+    map->size--;
+    return val;
+}
+
+void hmap_clear(struct mdd_hmap *map)
+{
+    CHECK_NULL(map);
+    CHECK_RTN(!map->keys);
+
+    memset(map->keys, 0, map->capacity * sizeof(uintptr_t));
+    map->size = 0;
+}
+
+void hmap_free(struct mdd_hmap *map)
+{
+    CHECK_NULL(map);
+
+    free(map->keys);
+    free(map->vals);
+    memset(map, 0, sizeof(struct mdd_hmap));
+}
+
+#define ARENA_ALIGN 16
+
+struct arena_block{
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGN) char data[];
+};
+
+static struct arena_block* new_arena_block(size_t size)
+{
+    struct arena_block *block = nodepool_alloc(sizeof(struct arena_block) + size);
+    CHECK_DO_RTN_VAL(!block, LOG_WARN("No memory."), NULL);
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+int arena_init(struct mdd_arena *arena, size_t block_size)
+{
+    CHECK_NULL_RTN(arena, -1);
+
+    arena->head = NULL;
+    arena->block_size = block_size ? block_size : 4096;
+    return 0;
+}
+
+void* arena_alloc(struct mdd_arena *arena, size_t size)
+{
+    CHECK_NULL_RTN(arena, NULL);
+
+    size = (size + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+    struct arena_block *block = arena->head;
+    if (!block || block->size - block->used < size) {
+        if (size > arena->block_size / 4) {
+            /* big requests get their own block behind the current one */
+            block = new_arena_block(size);
+            CHECK_RTN_VAL(!block, NULL);
+            if (arena->head) {
+                block->next = arena->head->next;
+                arena->head->next = block;
+            } else {
+                arena->head = block;
+            }
+        } else {
+            block = new_arena_block(arena->block_size);
+            CHECK_RTN_VAL(!block, NULL);
+            block->next = arena->head;
+            arena->head = block;
+        }
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void arena_merge(struct mdd_arena *dst, struct mdd_arena *src)
+{
+    CHECK_NULL2(dst, src);
+    CHECK_RTN(!src->head);
+
+    struct arena_block *last = src->head;
+    while (last->next) {
+        last = last->next;
+    }
+    if (dst->head) {
+        last->next = dst->head->next;
+        dst->head->next = src->head;
+    } else {
+        dst->head = src->head;
+    }
+    src->head = NULL;
+}
+
+size_t arena_used(const struct mdd_arena *arena)
+{
+    size_t used = 0;
+    for (struct arena_block *block = arena ? arena->head : NULL; block; block = block->next) {
+        used += block->used;
+    }
+    return used;
+}
+
+void arena_free(struct mdd_arena *arena)
+{
+    CHECK_NULL(arena);
+
+    struct arena_block *block = arena->head;
+    arena->head = NULL;
+    while (block) {
+        struct arena_block *next = block->next;
+        nodepool_free(block, sizeof(struct arena_block) + block->size);
+        block = next;
+    }
+}
+
+#define BTREE_ORDER 32
+#define BTREE_MIN ((BTREE_ORDER - 1) / 2)
+
+/* separators follow the B+ rule, keys[i] <= every key under kids[i + 1] and > every key under kids[i] */
+struct btree_node{
+    unsigned int leaf;
+    unsigned int cnt;
+    long long keys[BTREE_ORDER];
+    union {
+        void *vals[BTREE_ORDER];
+        struct btree_node *kids[BTREE_ORDER + 1];
+    };
+    struct btree_node *next;
+};
+
+static struct btree_node* new_btree_node(unsigned int leaf)
+{
+    struct btree_node *node = calloc(1, sizeof(struct btree_node));
+    CHECK_DO_RTN_VAL(!node, LOG_WARN("No memory."), NULL);
+
+    node->leaf = leaf;
+    return node;
+}
+
+/* the first position whose key is >= key, or > key with upper set */
+static unsigned int btree_bound(const struct btree_node *node, long long key, int upper)
+{
+    unsigned int lo = 0;
+    unsigned int hi = node->cnt;
+    while (lo < hi) {
+        unsigned int mid = (lo + hi) / 2;
+        if (node->keys[mid] < key || (upper && node->keys[mid] == key)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static const struct btree_node* btree_leaf(const struct mdd_btree *tree, long long key)
+{
+    const struct btree_node *node = tree->root;
+    while (node && !node->leaf) {
+        node = node->kids[btree_bound(node, key, 1)];
+    }
+    return node;
+}
+
+int btree_init(struct mdd_btree *tree)
+{
+    CHECK_NULL_RTN(tree, -1);
+
+    memset(tree, 0, sizeof(struct mdd_btree));
+    return 0;
+}
+
+/* splits the full kids[i] of a parent with room for one more separator */
+static int split_child(struct btree_node *parent, unsigned int i)
+{
+    struct btree_node *node = parent->kids[i];
+    struct btree_node *right = new_btree_node(node->leaf);
+    CHECK_RTN_VAL(!right, -1);
+
+    unsigned int keep = node->cnt / 2;
+    long long up = 0;
+    if (node->leaf) {
+        right->cnt = node->cnt - keep;
+        memcpy(right->keys, node->keys + keep, right->cnt * sizeof(long long));
+        memcpy(right->vals, node->vals + keep, right->cnt * sizeof(void*));
+        right->next = node->next;
+        node->next = right;
+        up = right->keys[0];
+    } else {
+        up = node->keys[keep];
+        right->cnt = node->cnt - keep - 1;
+        memcpy(right->keys, node->keys + keep + 1, right->cnt * sizeof(long long));
+        memcpy(right->kids, node->kids + keep + 1, (right->cnt + 1) * sizeof(struct btree_node*));
+    }
+    node->cnt = keep;
+
+    memmove(parent->keys + i + 1, parent->keys + i, (parent->cnt - i) * sizeof(long long));
+    memmove(parent->kids + i + 2, parent->kids + i + 1, (parent->cnt - i) * sizeof(struct btree_node*));
+    parent->keys[i] = up;
+    parent->kids[i + 1] = right;
+    parent->cnt++;
+    return 0;
+}
+
+/* returns 1 and leaves the tree unchanged if the key is already present */
+int btree_put(struct mdd_btree *tree, long long key, void *val)
+{
+    CHECK_DO_RTN_VAL(!tree || !val, LOG_WARN("Invalid btree value"), -1);
+
+    if (!tree->root) {
+        tree->root = new_btree_node(1);
+        CHECK_RTN_VAL(!tree->root, -1);
+    }
+    if (tree->root->cnt == BTREE_ORDER) {
+        struct btree_node *root = new_btree_node(0);
+        CHECK_RTN_VAL(!root, -1);
+
+        root->kids[0] = tree->root;
+        CHECK_DO_RTN_VAL(split_child(root, 0), free(root), -1);
+        tree->root = root;
+    }
+
+    /* full nodes are split on the way down so a split never has to climb back up */
+    struct btree_node *node = tree->root;
+    while (!node->leaf) {
+        unsigned int i = btree_bound(node, key, 1);
+        if (node->kids[i]->cnt == BTREE_ORDER) {
+            CHECK_RTN_VAL(split_child(node, i), -1);
+            i = btree_bound(node, key, 1);
+        }
+        node = node->kids[i];
+    }
+
+    unsigned int pos = btree_bound(node, key, 0);
+    CHECK_RTN_VAL(pos < node->cnt && node->keys[pos] == key, 1);
+
+    memmove(node->keys + pos + 1, node->keys + pos, (node->cnt - pos) * sizeof(long long));
+    memmove(node->vals + pos + 1, node->vals + pos, (node->cnt - pos) * sizeof(void*));
+    node->keys[pos] = key;
+    node->vals[pos] = val;
+    node->cnt++;
+    tree->size++;
+    return 0;
+}
+
+void* btree_get(const struct mdd_btree *tree, long long key)
+{
+    CHECK_RTN_VAL(!tree, NULL);
+
+    const struct btree_node *node = btree_leaf(tree, key);
+    CHECK_RTN_VAL(!node, NULL);
+
+    unsigned int pos = btree_bound(node, key, 0);
+    return pos < node->cnt && node->keys[pos] == key ? node->vals[pos] : NULL;
+}
+
+static void borrow_left(struct btree_node *parent, unsigned int i)
+{
+    struct btree_node *kid = parent->kids[i];
+    struct btree_node *left = parent->kids[i - 1];
+
+    memmove(kid->keys + 1, kid->keys, kid->cnt * sizeof(long long));
+    if (kid->leaf) {
+        memmove(kid->vals + 1, kid->vals, kid->cnt * sizeof(void*));
+        kid->keys[0] = left->keys[left->cnt - 1];
+        kid->vals[0] = left->vals[left->cnt - 1];
+        parent->keys[i - 1] = kid->keys[0];
+    } else {
+        memmove(kid->kids + 1, kid->kids, (kid->cnt + 1) * sizeof(struct btree_node*));
+        kid->keys[0] = parent->keys[i - 1];
+        kid->kids[0] = left->kids[left->cnt];
+        parent->keys[i - 1] = left->keys[left->cnt - 1];
+    }
+    left->cnt--;
+    kid->cnt++;
+}
+
+static void borrow_right(struct btree_node *parent, unsigned int i)
+{
+    struct btree_node *kid = parent->kids[i];
+    struct btree_node *right = parent->kids[i + 1];
+
+    if (kid->leaf) {
+        kid->keys[kid->cnt] = right->keys[0];
+        kid->vals[kid->cnt] = right->vals[0];
+        memmove(right->vals, right->vals + 1, (right->cnt - 1) * sizeof(void*));
+        memmove(right->keys, right->keys + 1, (right->cnt - 1) * sizeof(long long));
+        parent->keys[i] = right->keys[0];
+    } else {
+        kid->keys[kid->cnt] = parent->keys[i];
+        kid->kids[kid->cnt + 1] = right->kids[0];
+        parent->keys[i] = right->keys[0];
+        memmove(right->keys, right->keys + 1, (right->cnt - 1) * sizeof(long long));
+        memmove(right->kids, right->kids + 1, right->cnt * sizeof(struct btree_node*));
+    }
+    right->cnt--;
+    kid->cnt++;
+}
+
+/* folds kids[i + 1] into kids[i] and drops their separator */
+static void merge_kids(struct btree_node *parent, unsigned int i)
+{
+    struct btree_node *left = parent->kids[i];
+    struct btree_node *right = parent->kids[i + 1];
+
+    if (left->leaf) {
+        memcpy(left->keys + left->cnt, right->keys, right->cnt * sizeof(long long));
+        memcpy(left->vals + left->cnt, right->vals, right->cnt * sizeof(void*));
+        left->cnt += right->cnt;
+        left->next = right->next;
+    } else {
+        left->keys[left->cnt] = parent->keys[i];
+        memcpy(left->keys + left->cnt + 1, right->keys, right->cnt * sizeof(long long));
+        memcpy(left->kids + left->cnt + 1, right->kids, (right->cnt + 1) * sizeof(struct btree_node*));
+        left->cnt += right->cnt + 1;
+    }
+    free(right);
+
+    memmove(parent->keys + i, parent->keys + i + 1, (parent->cnt - i - 1) * sizeof(long long));
+    memmove(parent->kids + i + 1, parent->kids + i + 2, (parent->cnt - i - 1) * sizeof(struct btree_node*));
+    parent->cnt--;
+}
+
+/* tops up kids[i] before descending into it, returns where its keys ended up */
+static unsigned int fill_child(struct btree_node *parent, unsigned int i)
+{
+    if (i > 0 && parent->kids[i - 1]->cnt > BTREE_MIN) {
+        borrow_left(parent, i);
+        return i;
+    }
+    if (i < parent->cnt && parent->kids[i + 1]->cnt > BTREE_MIN) {
+        borrow_right(parent, i);
+        return i;
+    }
+    if (i > 0) {
+        merge_kids(parent, i - 1);
+        return i - 1;
+    }
+    merge_kids(parent, i);
+    return i;
+}
+
+/* returns the removed value, or NULL if the key was absent */
+void* btree_del(struct mdd_btree *tree, long long key)
+{
+    CHECK_RTN_VAL(!tree || !tree->root, NULL);
+
+    struct btree_node *node = tree->root;
+    while (!node->leaf) {
+        unsigned int i = btree_bound(node, key, 1);
+        if (node->kids[i]->cnt <= BTREE_MIN) {
+            i = fill_child(node, i);
+        }
+        struct btree_node *kid = node->kids[i];
+        if (!node->cnt) {
+            /* only the root can be emptied by a merge */
+            tree->root = kid;
+            free(node);
+        }
+        node = kid;
+    }
+
+    unsigned int pos = btree_bound(node, key, 0);
+    CHECK_RTN_VAL(pos == node->cnt || node->keys[pos] != key, NULL);
+
+    void *val = node->vals[pos];
+    memmove(node->keys + pos, node->keys + pos + 1, (node->cnt - pos - 1) * sizeof(long long));
+    memmove(node->vals + pos, node->vals + pos + 1, (node->cnt - pos - 1) * sizeof(void*));
+    node->cnt--;
+    tree->size--;
+    if (!tree->size) {
+        free(tree->root);
+        tree->root = NULL;
+    }
+    return val;
+}
+
+/* positions iter before the first key >= key */
+void btree_seek(const struct mdd_btree *tree, long long key, struct mdd_btree_iter *iter)
+{
+    CHECK_NULL(iter);
+
+    iter->node = tree ? btree_leaf(tree, key) : NULL;
+    iter->pos = iter->node ? btree_bound(iter->node, key, 0) : 0;
+}
+
+/* yields the entry at iter and steps past it, returns 0 at the end */
+int btree_next(struct mdd_btree_iter *iter, long long *key, void **val)
+{
+    CHECK_RTN_VAL(!iter, 0);
+
+    while (iter->node && iter->pos >= iter->node->cnt) {
+        iter->node = iter->node->next;
+        iter->pos = 0;
+    }
+    CHECK_RTN_VAL(!iter->node, 0);
+
+    if (key) {
+        *key = iter->node->keys[iter->pos];
+    }
+    if (val) {
+        *val = iter->node->vals[iter->pos];
+    }
+    iter->pos++;
+    return 1;
+}
+
+/* the entry with the largest key, returns 0 on an empty tree */
+int btree_last(const struct mdd_btree *tree, long long *key, void **val)
+{
+    CHECK_RTN_VAL(!tree || !tree->root || !tree->size, 0);
+
+    const struct btree_node *node = tree->root;
+    while (!node->leaf) {
+        node = node->kids[node->cnt];
+    }
+    if (key) {
+        *key = node->keys[node->cnt - 1];
+    }
+    if (val) {
+        *val = node->vals[node->cnt - 1];
+    }
+    return 1;
+}
+
+static void free_btree_node(struct btree_node *node)
+{
+    CHECK_RTN(!node);
+
+    if (!node->leaf) {
+        for (unsigned int i = 0; i <= node->cnt; i++) {
+            free_btree_node(node->kids[i]);
+        }
+    }
+    free(node);
+}
+
+void btree_free(struct mdd_btree *tree)
+{
+    CHECK_NULL(tree);
+
+    free_btree_node(tree->root);
+    tree->root = NULL;
+    tree->size = 0;
+}
+
+struct pool_str{
+    struct pool_str *next;
+    uint64_t hash;
+    size_t len;
+    size_t ref;
+    char str[];
+};
+
+/* one process wide pool so running and editing trees share values, chained buckets under one lock */
+static struct {
+    pthread_mutex_t lock;
+    size_t capacity;
+    size_t size;
+    struct pool_str **buckets;
+} strpool = {PTHREAD_MUTEX_INITIALIZER, 0, 0, NULL};
+
+#define POOL_STR(str) ((struct pool_str*) ((char*) (str) - offsetof(struct pool_str, str)))
+
+static uint64_t strpool_hash(const char *str, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char) str[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+static int strpool_grow(void)
+{
+    size_t capacity = strpool.capacity ? strpool.capacity * 2 : 1024;
+    struct pool_str **buckets = calloc(capacity, sizeof(struct pool_str*));
+    CHECK_DO_RTN_VAL(!buckets, LOG_WARN("No memory."), -1);
+
+    for (size_t i = 0; i < strpool.capacity; i++) {
+        struct pool_str *ps = strpool.buckets[i];
+        while (ps) {
+            struct pool_str *next = ps->next;
+            ps->next = buckets[ps->hash & (capacity - 1)];
+            buckets[ps->hash & (capacity - 1)] = ps;
+            ps = next;
+        }
+    }
+    free(strpool.buckets);
+    strpool.buckets = buckets;
+    strpool.capacity = capacity;
+    return 0;
+}
+
+const char* strpool_intern(const char *str, size_t len)
+{
+    CHECK_NULL_RTN(str, NULL);
+
+    uint64_t hash = strpool_hash(str, len);
+    pthread_mutex_lock(&strpool.lock);
+    if (strpool.capacity) {
+        for (struct pool_str *ps = strpool.buckets[hash & (strpool.capacity - 1)]; ps; ps = ps->next) {
+            if (ps->hash == hash && ps->len == len && !memcmp(ps->str, str, len)) {
+                ps->ref++;
+                pthread_mutex_unlock(&strpool.lock);
+                return ps->str;
+            }
+        }
+    }
+    CHECK_DO_RTN_VAL(strpool.size >= strpool.capacity && strpool_grow(), pthread_mutex_unlock(&strpool.lock), NULL);
+
+    struct pool_str *ps = malloc(sizeof(struct pool_str) + len + 1);
+    CHECK_DO_RTN_VAL(!ps, pthread_mutex_unlock(&strpool.lock);LOG_WARN("No memory."), NULL);
+    ps->hash = hash;
+    ps->len = len;
+    ps->ref = 1;
+    memcpy(ps->str, str, len);
+    ps->str[len] = '\0';
+    ps->next = strpool.buckets[hash & (strpool.capacity - 1)];
+    strpool.buckets[hash & (strpool.capacity - 1)] = ps;
+    strpool.size++;
+    pthread_mutex_unlock(&strpool.lock);
+    return ps->str;
+}
+
+const char* strpool_ref(const char *str)
+{
+    CHECK_NULL_RTN(str, NULL);
+
+    pthread_mutex_lock(&strpool.lock);
+    POOL_STR(str)->ref++;
+    pthread_mutex_unlock(&strpool.lock);
+    return str;
+}
+
+void strpool_release(const char *str)
+{
+    CHECK_NULL(str);
+
+    struct pool_str *ps = POOL_STR(str);
+    pthread_mutex_lock(&strpool.lock);
+    if (--ps->ref) {
+        pthread_mutex_unlock(&strpool.lock);
+        return;
+    }
+    struct pool_str **link = &strpool.buckets[ps->hash & (strpool.capacity - 1)];
+    while (*link != ps) {
+        link = &(*link)->next;
+    }
+    *link = ps->next;
+    strpool.size--;
+    pthread_mutex_unlock(&strpool.lock);
+    free(ps);
+}
+
+size_t strpool_count(void)
+{
+    pthread_mutex_lock(&strpool.lock);
+    size_t size = strpool.size;
+    pthread_mutex_unlock(&strpool.lock);
+    return size;
+}
+
+#define NODEPOOL_SMALL 512
+#define NODEPOOL_MAX (16 * 1024)
+#define NODEPOOL_CLASSES (NODEPOOL_SMALL / 16 + (NODEPOOL_MAX - NODEPOOL_SMALL) / 512)
+#define NODEPOOL_BATCH 64
+
+/* a free block, the first block of a batch in the depot links the next batch */
+struct pool_block{
+    struct pool_block *next;
+    struct pool_block *batch;
+};
+
+struct pool_cache{
+    struct pool_block *blocks[NODEPOOL_CLASSES];
+    unsigned int cnt[NODEPOOL_CLASSES];
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_once_t once;
+    pthread_key_t key;
+    size_t limit;
+    size_t bytes;
+    struct pool_block *batches[NODEPOOL_CLASSES];
+    unsigned long long allocs;
+    unsigned long long releases;
+    unsigned long long mallocs;
+    unsigned long long frees;
+} nodepool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_ONCE_INIT, 0, NODEPOOL_LIMIT, 0, {NULL}, 0, 0, 0, 0};
+
+static __thread struct pool_cache pool_cache;
+static __thread int pool_cache_keyed;
+
+static int pool_class(size_t size)
+{
+    CHECK_RTN_VAL(size > NODEPOOL_MAX, -1);
+    CHECK_RTN_VAL(size > NODEPOOL_SMALL, NODEPOOL_SMALL / 16 + (int) ((size - NODEPOOL_SMALL - 1) / 512));
+    return size ? (int) ((size - 1) / 16) : 0;
+}
+
+static size_t pool_class_size(int cls)
+{
+    CHECK_RTN_VAL(cls < NODEPOOL_SMALL / 16, (size_t) (cls + 1) * 16);
+    return NODEPOOL_SMALL + (size_t) (cls - NODEPOOL_SMALL / 16 + 1) * 512;
+}
+
+static void pool_count(unsigned long long *cnt, unsigned long long n)
+{
+    __atomic_fetch_add(cnt, n, __ATOMIC_RELAXED);
+}
+
+/* hands a chain of cnt blocks to the depot, or to free once the depot is full */
+static void pool_put_batch(int cls, struct pool_block *first, unsigned int cnt)
+{
+    size_t bytes = cnt * pool_class_size(cls);
+    pthread_mutex_lock(&nodepool.lock);
+    if (nodepool.bytes + bytes <= nodepool.limit) {
+        first->batch = nodepool.batches[cls];
+        nodepool.batches[cls] = first;
+        nodepool.bytes += bytes;
+        pthread_mutex_unlock(&nodepool.lock);
+        return;
+    }
+    pthread_mutex_unlock(&nodepool.lock);
+
+    pool_count(&nodepool.frees, cnt);
+    while (first) {
+        struct pool_block *next = first->next;
+        free(first);
+        first = next;
+    }
+}
+
+/* cuts the first NODEPOOL_BATCH blocks off the chain at *head */
+static struct pool_block* pool_cut_batch(struct pool_block **head)
+{
+    struct pool_block *first = *head;
+    struct pool_block *last = first;
+    for (int i = 1; i < NODEPOOL_BATCH; i++) {
+        last = last->next;
+    }
+    *head = last->next;
+    last->next = NULL;
+    return first;
+}
+
+/* a thread going away leaves its full batches to the other threads, the depot only holds full ones */
+static void pool_flush(void *arg)
+{
+    struct pool_cache *cache = (struct pool_cache*) arg;
+    for (int cls = 0; cls < NODEPOOL_CLASSES; cls++) {
+        struct pool_block *head = cache->blocks[cls];
+        for (; cache->cnt[cls] >= NODEPOOL_BATCH; cache->cnt[cls] -= NODEPOOL_BATCH) {
+            pool_put_batch(cls, pool_cut_batch(&head), NODEPOOL_BATCH);
+        }
+        pool_count(&nodepool.frees, cache->cnt[cls]);
+        while (head) {
+            struct pool_block *next = head->next;
+            free(head);
+            head = next;
+        }
+        cache->blocks[cls] = NULL;
+        cache->cnt[cls] = 0;
+    }
+}
+
+static void pool_make_key(void)
+{
+    if (pthread_key_create(&nodepool.key, pool_flush)) {
+        LOG_WARN("Failed to create node pool key");
+    }
+}
+
+static struct pool_cache* pool_get_cache(void)
+{
+    if (!pool_cache_keyed) {
+        pthread_once(&nodepool.once, pool_make_key);
+        pthread_setspecific(nodepool.key, &pool_cache);
+        pool_cache_keyed = 1;
+    }
+    return &pool_cache;
+}
+
+/* a batch from the depot, or NULL when it has none of the class */
+static struct pool_block* pool_take_batch(int cls)
+{
+    pthread_mutex_lock(&nodepool.lock);
+    struct pool_block *first = nodepool.batches[cls];
+    if (first) {
+        nodepool.batches[cls] = first->batch;
+        nodepool.bytes -= NODEPOOL_BATCH * pool_class_size(cls);
+    }
+    pthread_mutex_unlock(&nodepool.lock);
+    return first;
+}
+
+void* nodepool_alloc(size_t size)
+{
+    pool_count(&nodepool.allocs, 1);
+    int cls = pool_class(size);
+    if (cls < 0) {
+        pool_count(&nodepool.mallocs, 1);
+        return calloc(1, size);
+    }
+    /* a full class block even with recycling off, it may be freed once recycling is back on */
+    if (!__atomic_load_n(&nodepool.limit, __ATOMIC_RELAXED)) {
+        pool_count(&nodepool.mallocs, 1);
+        return calloc(1, pool_class_size(cls));
+    }
+
+    struct pool_cache *cache = pool_get_cache();
+    if (!cache->blocks[cls]) {
+        cache->blocks[cls] = pool_take_batch(cls);
+        cache->cnt[cls] = cache->blocks[cls] ? NODEPOOL_BATCH : 0;
+    }
+    struct pool_block *block = cache->blocks[cls];
+    if (!block) {
+        pool_count(&nodepool.mallocs, 1);
+        return calloc(1, pool_class_size(cls));
+    }
+    cache->blocks[cls] = block->next;
+    cache->cnt[cls]--;
+    memset(block, 0, size);
+    return block;
+}
+
+/* size must be the size the block was allocated with */
+void nodepool_free(void *ptr, size_t size)
+{
+    CHECK_RTN(!ptr);
+
+    pool_count(&nodepool.releases, 1);
+    int cls = pool_class(size);
+    if (cls < 0 || !__atomic_load_n(&nodepool.limit, __ATOMIC_RELAXED)) {
+        pool_count(&nodepool.frees, 1);
+        free(ptr);
+        return;
+    }
+
+    struct pool_cache *cache = pool_get_cache();
+    struct pool_block *block = (struct pool_block*) ptr;
+    block->next = cache->blocks[cls];
+    cache->blocks[cls] = block;
+    if (++cache->cnt[cls] < 2 * NODEPOOL_BATCH) {
+        return;
+    }
+
+    /* the newest batch stays hot in the cache, the older one moves to the depot */
+    struct pool_block *older = cache->blocks[cls];
+    cache->blocks[cls] = pool_cut_batch(&older);
+    cache->cnt[cls] = NODEPOOL_BATCH;
+    pool_put_batch(cls, older, NODEPOOL_BATCH);
+}
+
+void nodepool_set_limit(size_t bytes)
+{
+    __atomic_store_n(&nodepool.limit, bytes, __ATOMIC_RELAXED);
+    nodepool_trim();
+}
+
+void nodepool_trim(void)
+{
+    struct pool_block *batches[NODEPOOL_CLASSES];
+    pthread_mutex_lock(&nodepool.lock);
+    memcpy(batches, nodepool.batches, sizeof(batches));
+    memset(nodepool.batches, 0, sizeof(nodepool.batches));
+    nodepool.bytes = 0;
+    pthread_mutex_unlock(&nodepool.lock);
+
+    struct pool_cache *cache = pool_get_cache();
+    for (int cls = 0; cls < NODEPOOL_CLASSES; cls++) {
+        unsigned long long cnt = 0;
+        for (struct pool_block *first = batches[cls], *batch = NULL; first; first = batch) {
+            batch = first->batch;
+            for (struct pool_block *block = first, *next = NULL; block; block = next, cnt++) {
+                next = block->next;
+                free(block);
+            }
+        }
+        for (struct pool_block *block = cache->blocks[cls], *next = NULL; block; block = next, cnt++) {
+            next = block->next;
+            free(block);
+        }
+        cache->blocks[cls] = NULL;
+        cache->cnt[cls] = 0;
+        pool_count(&nodepool.frees, cnt);
+    }
+}
+
+void nodepool_get_stats(struct nodepool_stats *stats)
+{
+    CHECK_NULL(stats);
+
+    stats->allocs = __atomic_load_n(&nodepool.allocs, __ATOMIC_RELAXED);
+    stats->releases = __atomic_load_n(&nodepool.releases, __ATOMIC_RELAXED);
+    stats->mallocs = __atomic_load_n(&nodepool.mallocs, __ATOMIC_RELAXED);
+    stats->frees = __atomic_load_n(&nodepool.frees, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&nodepool.lock);
+    stats->depot_bytes = nodepool.bytes;
+    pthread_mutex_unlock(&nodepool.lock);
+}
+
+/* the byte masks of the compares carry four bits per key, so a bit position over 4 is the key position */
+long keys_find(const int32_t *keys, size_t cnt, int32_t key)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i key32 = _mm256_set1_epi32(key);
+    for (; i + 16 <= cnt; i += 16) {
+        __m256i lo = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (keys + i)), key32);
+        __m256i hi = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (keys + i + 8)), key32);
+        uint64_t mask = (uint32_t) _mm256_movemask_epi8(lo) | (uint64_t) (uint32_t) _mm256_movemask_epi8(hi) << 32;
+        if (mask) {
+            return (long) (i + __builtin_ctzll(mask) / 4);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i key4 = _mm_set1_epi32(key);
+    for (; i + 8 <= cnt; i += 8) {
+        __m128i lo = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (keys + i)), key4);
+        __m128i hi = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (keys + i + 4)), key4);
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(lo) | (unsigned int) _mm_movemask_epi8(hi) << 16;
+        if (mask) {
+            return (long) (i + __builtin_ctz(mask) / 4);
+        }
+    }
+#endif
+    for (; i < cnt; i++) {
+        if (keys[i] == key) {
+            return (long) i;
+        }
+    }
+    return -1;
+}
+
+size_t keys_mismatch(const int32_t *a, const int32_t *b, size_t cnt)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= cnt; i += 8) {
+        __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (a + i)),
+                _mm256_loadu_si256((const __m256i*) (b + i)));
+        unsigned int mask = ~(unsigned int) _mm256_movemask_epi8(eq);
+        if (mask) {
+            return i + __builtin_ctz(mask) / 4;
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 4 <= cnt; i += 4) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (a + i)), _mm_loadu_si128((const __m128i*) (b + i)));
+        unsigned int mask = ~(unsigned int) _mm_movemask_epi8(eq) & 0xffff;
+        if (mask) {
+            return i + __builtin_ctz(mask) / 4;
+        }
+    }
+#endif
+    for (; i < cnt && a[i] == b[i]; i++) {
+    }
+    return i;
+}
+
+static int needs_escape(unsigned char c)
+{
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+/* a byte b is a control char when min(b, 0x1f) == b, compared unsigned */
+size_t json_escape_span(const char *str, size_t len)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i quote32 = _mm256_set1_epi8('"');
+    const __m256i slash32 = _mm256_set1_epi8('\\');
+    const __m256i ctrl32 = _mm256_set1_epi8(0x1f);
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (str + i));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote32), _mm256_cmpeq_epi8(v, slash32));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctrl32), v));
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(hit);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i slash = _mm_set1_epi8('\\');
+    const __m128i ctrl = _mm_set1_epi8(0x1f);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (str + i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v));
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(hit);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < len && !needs_escape((unsigned char) str[i]); i++) {
+    }
+    return i;
+}
+
+static int read_hex4(const char *str, unsigned int *val)
+{
+    *val = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = str[i];
+        unsigned int digit = c >= '0' && c <= '9' ? c - '0' :
+                             c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                             c >= 'A' && c <= 'F' ? c - 'A' + 10 : 16;
+        CHECK_RTN_VAL(digit > 15, -1);
+        *val = *val << 4 | digit;
+    }
+    return 0;
+}
+
+/* a \uXXXX escape or surrogate pair as utf-8, returns the escape length consumed or -1 */
+static int unescape_unicode(const char *src, size_t len, char *dst, size_t *out)
+{
+    unsigned int cp = 0;
+    CHECK_RTN_VAL(len < 6 || read_hex4(src + 2, &cp), -1);
+    int used = 6;
+    if (cp >= 0xd800 && cp <= 0xdbff) {
+        unsigned int low = 0;
+        CHECK_RTN_VAL(len < 12 || src[6] != '\\' || src[7] != 'u' || read_hex4(src + 8, &low), -1);
+        CHECK_RTN_VAL(low < 0xdc00 || low > 0xdfff, -1);
+        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+        used = 12;
+    }
+    /* strings are NUL terminated, so an escaped NUL or a lone low surrogate cannot be kept */
+    CHECK_RTN_VAL(!cp || (cp >= 0xdc00 && cp <= 0xdfff), -1);
+
+    char *p = dst + *out;
+    if (cp < 0x80) {
+        *p++ = (char) cp;
+    } else if (cp < 0x800) {
+        *p++ = (char) (0xc0 | cp >> 6);
+        *p++ = (char) (0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        *p++ = (char) (0xe0 | cp >> 12);
+        *p++ = (char) (0x80 | (cp >> 6 & 0x3f));
+        *p++ = (char) (0x80 | (cp & 0x3f));
+    } else {
+        *p++ = (char) (0xf0 | cp >> 18);
+        *p++ = (char) (0x80 | (cp >> 12 & 0x3f));
+        *p++ = (char) (0x80 | (cp >> 6 & 0x3f));
+        *p++ = (char) (0x80 | (cp & 0x3f));
+    }
+    *out = p - dst;
+    return used;
+}
+
+/* runs between backslashes are moved in bulk, the output never outgrows the input so dst may be src */
+long json_unescape(char *dst, const char *src, size_t len)
+{
+    CHECK_NULL_RTN2(dst, src, -1);
+
+    const char *end = src + len;
+    size_t out = 0;
+    while (src < end) {
+        const char *esc = memchr(src, '\\', end - src);
+        size_t run = (esc ? esc : end) - src;
+        memmove(dst + out, src, run);
+        out += run;
+        CHECK_RTN_VAL(!esc, (long ) out);
+
+        CHECK_RTN_VAL(end - esc < 2, -1);
+        int used = 2;
+        switch (esc[1]) {
+            case '"':
+            case '\\':
+            case '/':
+                dst[out++] = esc[1];
+            break;
+            case 'b':
+                dst[out++] = '\b';
+            break;
+            case 'f':
+                dst[out++] = '\f';
+            break;
+            case 'n':
+                dst[out++] = '\n';
+            break;
+            case 'r':
+                dst[out++] = '\r';
+            break;
+            case 't':
+                dst[out++] = '\t';
+            break;
+            case 'u':
+                used = unescape_unicode(esc, end - esc, dst, &out);
+                CHECK_RTN_VAL(used < 0, -1);
+            break;
+            default:
+                return -1;
+        }
+        src = esc + used;
+    }
+    return (long) out;
+}
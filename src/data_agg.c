@@ -0,0 +1,218 @@
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "macro.h"
+#include "log.h"
+#include "data_agg.h"
+
+/* values maps each leaf value to its multiplicity, only kept for MIN and MAX; extreme caches its first or last key */
+struct mdd_agg{
+    mdd_agg_type type;
+    struct mds_node *lists;
+    struct mds_node *leaf;
+    long long count;
+    long long sum;
+    struct mdd_btree values;
+    long long extreme;
+    int has_extreme;
+};
+
+static struct mds_node* find_list_schema(struct mds_node *schema, const char *list_path)
+{
+    size_t len = strcspn(list_path, "/");
+    CHECK_RTN_VAL(strlen(schema->name) != len || strncmp(schema->name, list_path, len), NULL);
+
+    struct mds_node *curr = schema;
+    char name[256];
+    for (const char *cursor = list_path + len; curr && *cursor == '/'; cursor += len + 1) {
+        len = strcspn(cursor + 1, "/");
+        CHECK_DO_RTN_VAL(len >= sizeof(name), LOG_WARN("Too long name in %s", list_path), NULL);
+        memcpy(name, cursor + 1, len);
+        name[len] = '\0';
+        curr = mds_find_child_schema(curr, name);
+    }
+    return curr && is_list_node(curr) ? curr : NULL;
+}
+
+struct mdd_agg* mdd_agg_create(struct mds_node *schema, const char *list_path, const char *leaf, mdd_agg_type type)
+{
+    CHECK_NULL_RTN2(schema, list_path, NULL);
+    CHECK_DO_RTN_VAL(type > MDD_AGG_MAX, LOG_WARN("Invalid aggregate type:%d", type), NULL);
+
+    struct mds_node *lists = find_list_schema(schema, list_path);
+    CHECK_DO_RTN_VAL(!lists, LOG_WARN("Failed to find list %s", list_path), NULL);
+
+    struct mds_node *leaf_schema = leaf ? mds_find_child_schema(lists, leaf) : NULL;
+    CHECK_DO_RTN_VAL(leaf && (!leaf_schema || !is_leaf_node(leaf_schema)),
+            LOG_WARN("Failed to find leaf %s of %s", leaf, list_path), NULL);
+    CHECK_DO_RTN_VAL(type != MDD_AGG_COUNT && (!leaf_schema || !is_int_leaf((struct mds_leaf* ) leaf_schema)),
+            LOG_WARN("Aggregate %d over %s needs an int leaf", type, list_path), NULL);
+
+    struct mdd_agg *agg = calloc(1, sizeof(struct mdd_agg));
+    CHECK_DO_RTN_VAL(!agg, LOG_WARN("No memory"), NULL);
+
+    agg->type = type;
+    agg->lists = lists;
+    agg->leaf = leaf_schema;
+    btree_init(&agg->values);
+    return agg;
+}
+
+void mdd_agg_free(struct mdd_agg *agg)
+{
+    CHECK_RTN(!agg);
+
+    btree_free(&agg->values);
+    free(agg);
+}
+
+static struct mdd_leaf* find_leaf(struct mdd_agg *agg, struct mdd_node *mo)
+{
+    for (struct mdd_node *child = mo ? mo->child : NULL; child; child = child->next) {
+        if (child->schema == agg->leaf) {
+            return (struct mdd_leaf*) child;
+        }
+    }
+    return NULL;
+}
+
+static int add_value(struct mdd_agg *agg, struct mdd_leaf *leaf, int delta)
+{
+    agg->count += delta;
+    CHECK_RTN_VAL(!agg->leaf, 0);
+
+    long long val = leaf->value.intv;
+    agg->sum += delta * val;
+    CHECK_RTN_VAL(agg->type != MDD_AGG_MIN && agg->type != MDD_AGG_MAX, 0);
+
+    uintptr_t cnt = (uintptr_t) btree_get(&agg->values, val) + delta;
+    if (!cnt) {
+        btree_del(&agg->values, val);
+        return 0;
+    }
+    CHECK_DO_RTN_VAL(btree_put(&agg->values, val, (void*) cnt) < 0, LOG_WARN("Failed to keep value %lld", val), -1);
+    return 0;
+}
+
+/* delta is 1 when mo enters the list and -1 when it leaves */
+static int add_mo(struct mdd_agg *agg, struct mdd_node *mo, int delta)
+{
+    struct mdd_leaf *leaf = find_leaf(agg, mo);
+    CHECK_RTN_VAL(agg->leaf && !leaf, 0);
+
+    return add_value(agg, leaf, delta);
+}
+
+static int load_mo(struct mdd_agg *agg, struct mdd_node *mo)
+{
+    for (struct mdd_node *child = mo->child; child; child = child->next) {
+        if (child->schema == agg->lists) {
+            CHECK_RTN_VAL(add_mo(agg, child, 1), -1);
+            continue;
+        }
+
+        for (struct mds_node *up = agg->lists->parent; up; up = up->parent) {
+            if (up == child->schema) {
+                CHECK_RTN_VAL(load_mo(agg, child), -1);
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+static void refresh_extreme(struct mdd_agg *agg)
+{
+    struct mdd_btree_iter iter;
+    if (agg->type == MDD_AGG_MIN) {
+        btree_seek(&agg->values, LLONG_MIN, &iter);
+        agg->has_extreme = btree_next(&iter, &agg->extreme, NULL);
+    } else if (agg->type == MDD_AGG_MAX) {
+        agg->has_extreme = btree_last(&agg->values, &agg->extreme, NULL);
+    }
+}
+
+/* recomputes the value from the tree rooted at root */
+int mdd_agg_load(struct mdd_agg *agg, struct mdd_node *root)
+{
+    CHECK_NULL_RTN2(agg, root, -1);
+
+    agg->count = 0;
+    agg->sum = 0;
+    btree_free(&agg->values);
+    btree_init(&agg->values);
+    int rt = root->schema == agg->lists ? add_mo(agg, root, 1) : load_mo(agg, root);
+    refresh_extreme(agg);
+    return rt;
+}
+
+static int apply_modify(struct mdd_agg *agg, const struct mdd_mo_diff *modiff)
+{
+    int pos = ((struct mds_leaf*) agg->leaf)->leaf_idx;
+    CHECK_RTN_VAL(mdd_diff_next_leaf(modiff, pos) != pos, 0);
+
+    struct mdd_leaf *run_leaf = NULL;
+    struct mdd_leaf *edit_leaf = NULL;
+    CHECK_RTN_VAL(mdd_diff_leaf(modiff, pos, &run_leaf, &edit_leaf), -1);
+
+    if (run_leaf) {
+        CHECK_RTN_VAL(add_value(agg, run_leaf, -1), -1);
+    }
+    return edit_leaf ? add_value(agg, edit_leaf, 1) : 0;
+}
+
+/* folds one commit diff into the value, the diff must follow the tree the value was loaded from */
+int mdd_agg_apply(struct mdd_agg *agg, const mdd_diff *diff)
+{
+    CHECK_NULL_RTN2(agg, diff, -1);
+
+    for (size_t i = 0; i < diff->size; i++) {
+        struct mdd_mo_diff *modiff = diff->vec[i];
+        struct mdd_mo *mo = modiff->edit_data ? modiff->edit_data : modiff->run_data;
+        if (mo->schema != agg->lists) {
+            continue;
+        }
+
+        int rt = 0;
+        if (modiff->type == DF_ADD) {
+            rt = add_mo(agg, (struct mdd_node*) modiff->edit_data, 1);
+        } else if (modiff->type == DF_DELETE) {
+            rt = add_mo(agg, (struct mdd_node*) modiff->run_data, -1);
+        } else if (agg->leaf) {
+            rt = apply_modify(agg, modiff);
+        }
+        CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to apply diff to aggregate of %s", agg->lists->name), -1);
+    }
+    refresh_extreme(agg);
+    return 0;
+}
+
+void mdd_agg_target(const struct mdd_agg *agg, struct mds_node **lists, struct mds_node **leaf, mdd_agg_type *type)
+{
+    CHECK_RTN(!agg);
+
+    *lists = agg->lists;
+    *leaf = agg->leaf;
+    *type = agg->type;
+}
+
+int mdd_agg_value(const struct mdd_agg *agg, long long *val)
+{
+    CHECK_NULL_RTN2(agg, val, -1);
+
+    switch (agg->type) {
+        case MDD_AGG_COUNT:
+            *val = agg->count;
+            return 0;
+        case MDD_AGG_SUM:
+            *val = agg->sum;
+            return 0;
+        case MDD_AGG_MIN:
+        case MDD_AGG_MAX:
+            *val = agg->extreme;
+            return agg->has_extreme ? 0 : -1;
+        default:
+            return -1;
+    }
+}
@@ -0,0 +1,381 @@
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "macro.h"
+#include "log.h"
+#include "data_column.h"
+
+/* one leaf of the list, ints holds int values and enum codes, strs pooled strings */
+struct mdd_column{
+    struct mds_node *leaf;
+    uint64_t *present;
+    long long *ints;
+    const char **strs;
+};
+
+/* cols is in leaf_idx order, key points at the Id column */
+struct mdd_columns{
+    struct mds_node *lists;
+    unsigned long long version;
+    size_t rows;
+    struct mdd_column *key;
+    unsigned int col_cnt;
+    struct mdd_column cols[];
+};
+
+struct column_row{
+    long long key;
+    struct mdd_node *node;
+};
+
+static int row_cmp(const void *a, const void *b)
+{
+    long long ka = ((const struct column_row*) a)->key;
+    long long kb = ((const struct column_row*) b)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+static int has_row(const struct mdd_column *col, size_t row)
+{
+    return col->present[row / 64] >> (row % 64) & 1;
+}
+
+static const struct mdd_column* get_column(const struct mdd_columns *cols, const struct mds_node *leaf)
+{
+    CHECK_RTN_VAL(!leaf || leaf->parent != cols->lists || !is_leaf_node(leaf), NULL);
+    return &cols->cols[((struct mds_leaf*) leaf)->leaf_idx];
+}
+
+static struct mdd_leaf* find_leaf(struct mdd_node *mo, struct mds_node *leaf)
+{
+    for (struct mdd_node *child = mo->child; child; child = child->next) {
+        if (child->schema == leaf) {
+            return (struct mdd_leaf*) child;
+        }
+    }
+    return NULL;
+}
+
+/* the instances of lists under parent sorted by key, NULL with *cnt 0 when there are none */
+static struct column_row* collect_rows(struct mdd_node *parent, struct mds_node *lists, struct mds_node *key,
+        size_t *cnt)
+{
+    *cnt = 0;
+    for (struct mdd_node *child = parent->child; child; child = child->next) {
+        *cnt += child->schema == lists ? 1 : 0;
+    }
+    CHECK_RTN_VAL(!*cnt, NULL);
+
+    struct column_row *rows = malloc(*cnt * sizeof(struct column_row));
+    CHECK_DO_RTN_VAL(!rows, LOG_WARN("No memory"), NULL);
+
+    size_t n = 0;
+    int sorted = 1;
+    for (struct mdd_node *child = parent->child; child; child = child->next) {
+        if (child->schema != lists) {
+            continue;
+        }
+        struct mdd_leaf *leaf = find_leaf(child, key);
+        CHECK_DO_RTN_VAL(!leaf, LOG_WARN("%s instance without key", lists->name);free(rows), NULL);
+        rows[n].key = leaf->value.intv;
+        rows[n].node = child;
+        sorted = sorted && (!n || rows[n - 1].key <= rows[n].key);
+        n++;
+    }
+    if (!sorted) {
+        qsort(rows, n, sizeof(struct column_row), row_cmp);
+    }
+    for (size_t i = 1; i < n; i++) {
+        CHECK_DO_RTN_VAL(rows[i - 1].key == rows[i].key, LOG_WARN("%s repeats key %lld", lists->name,
+                rows[i].key);free(rows), NULL);
+    }
+    return rows;
+}
+
+static int alloc_column(struct mdd_column *col, struct mds_node *leaf, size_t rows)
+{
+    size_t cap = rows ? rows : 1;
+    col->leaf = leaf;
+    col->present = calloc((cap + 63) / 64, sizeof(uint64_t));
+    if (is_str_leaf((struct mds_leaf*) leaf)) {
+        col->strs = calloc(cap, sizeof(char*));
+    } else {
+        col->ints = calloc(cap, sizeof(long long));
+    }
+    CHECK_DO_RTN_VAL(!col->present || (!col->strs && !col->ints), LOG_WARN("No memory"), -1);
+    return 0;
+}
+
+/* a pooled string leaf only takes a reference, an inline one enters the pool */
+static const char* share_str(struct mdd_leaf *leaf)
+{
+    const char *str = str_leaf_val(leaf);
+    return leaf->value.sso[MDD_SSO_LEN] ? strpool_ref(str) : strpool_intern(str, strlen(str));
+}
+
+/* a repeated leaf keeps the first value, as lookups by path do */
+static int fill_row(struct mdd_columns *cols, size_t row, struct mdd_node *mo)
+{
+    for (struct mdd_node *child = mo->child; child; child = child->next) {
+        struct mdd_column *col = &cols->cols[((struct mds_leaf*) child->schema)->leaf_idx];
+        if (has_row(col, row)) {
+            continue;
+        }
+
+        struct mdd_leaf *leaf = (struct mdd_leaf*) child;
+        if (col->strs) {
+            col->strs[row] = share_str(leaf);
+            CHECK_DO_RTN_VAL(!col->strs[row], LOG_WARN("No memory"), -1);
+        } else {
+            col->ints[row] = leaf->value.intv;
+        }
+        col->present[row / 64] |= 1ULL << (row % 64);
+    }
+    return 0;
+}
+
+/* copies the instances of lists under parent into columns stamped with version, the tree is left as it is */
+struct mdd_columns* mdd_columns_snapshot(struct mdd_node *parent, struct mds_node *lists, unsigned long long version)
+{
+    CHECK_NULL_RTN2(parent, lists, NULL);
+    CHECK_DO_RTN_VAL(!is_column_snap_list(lists) || lists->parent != parent->schema,
+            LOG_WARN("%s is not a column snapshot list of %s", lists->name, parent->schema->name), NULL);
+
+    struct mds_mo *mo = (struct mds_mo*) lists;
+    struct mds_node *key = mds_find_child_schema(lists, "Id");
+    size_t cnt = 0;
+    struct column_row *rows = collect_rows(parent, lists, key, &cnt);
+    CHECK_RTN_VAL(!rows && cnt, NULL);
+
+    struct mdd_columns *cols = calloc(1, sizeof(struct mdd_columns) + mo->leaf_cnt * sizeof(struct mdd_column));
+    CHECK_DO_RTN_VAL(!cols, LOG_WARN("No memory");free(rows), NULL);
+    cols->lists = lists;
+    cols->version = version;
+    cols->rows = cnt;
+    cols->col_cnt = mo->leaf_cnt;
+    cols->key = &cols->cols[((struct mds_leaf*) key)->leaf_idx];
+
+    for (unsigned int i = 0; i < mo->leaf_cnt; i++) {
+        CHECK_GOTO(alloc_column(&cols->cols[i], mo->leafs[i], cnt), ERR_OUT);
+    }
+    for (size_t row = 0; row < cnt; row++) {
+        CHECK_GOTO(fill_row(cols, row, rows[row].node), ERR_OUT);
+    }
+    free(rows);
+    return cols;
+
+ERR_OUT:
+    free(rows);
+    mdd_columns_free(cols);
+    return NULL;
+}
+
+void mdd_columns_free(struct mdd_columns *cols)
+{
+    CHECK_RTN(!cols);
+
+    for (unsigned int i = 0; i < cols->col_cnt; i++) {
+        struct mdd_column *col = &cols->cols[i];
+        for (size_t row = 0; col->strs && row < cols->rows; row++) {
+            if (col->strs[row]) {
+                strpool_release(col->strs[row]);
+            }
+        }
+        free(col->present);
+        free(col->ints);
+        free(col->strs);
+    }
+    free(cols);
+}
+
+unsigned long long mdd_columns_version(const struct mdd_columns *cols)
+{
+    return cols ? cols->version : 0;
+}
+
+size_t mdd_columns_rows(const struct mdd_columns *cols)
+{
+    return cols ? cols->rows : 0;
+}
+
+long long mdd_columns_key(const struct mdd_columns *cols, size_t row)
+{
+    CHECK_RTN_VAL(!cols || row >= cols->rows, -1);
+    return cols->key->ints[row];
+}
+
+/* the first row whose key is not below key */
+static size_t lower_row(const struct mdd_columns *cols, long long key)
+{
+    const long long *keys = cols->key->ints;
+    size_t lo = 0, hi = cols->rows;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (keys[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+long mdd_columns_find(const struct mdd_columns *cols, long long key)
+{
+    CHECK_RTN_VAL(!cols, -1);
+
+    size_t row = lower_row(cols, key);
+    return row < cols->rows && cols->key->ints[row] == key ? (long) row : -1;
+}
+
+int mdd_columns_range(const struct mdd_columns *cols, long long lo, long long hi, struct mdd_column_cursor *cursor)
+{
+    CHECK_NULL_RTN2(cols, cursor, -1);
+
+    cursor->cols = cols;
+    cursor->row = lower_row(cols, lo);
+    cursor->hi = hi;
+    return 0;
+}
+
+long mdd_columns_next(struct mdd_column_cursor *cursor)
+{
+    CHECK_RTN_VAL(!cursor || !cursor->cols, -1);
+
+    const struct mdd_columns *cols = cursor->cols;
+    CHECK_DO_RTN_VAL(cursor->row >= cols->rows || cols->key->ints[cursor->row] > cursor->hi, cursor->cols = NULL, -1);
+    return (long) cursor->row++;
+}
+
+int mdd_columns_int(const struct mdd_columns *cols, size_t row, const struct mds_node *leaf, long long *val)
+{
+    CHECK_NULL_RTN2(cols, val, -1);
+
+    const struct mdd_column *col = get_column(cols, leaf);
+    CHECK_RTN_VAL(!col || !col->ints || row >= cols->rows || !has_row(col, row), -1);
+    *val = col->ints[row];
+    return 0;
+}
+
+const char* mdd_columns_str(const struct mdd_columns *cols, size_t row, const struct mds_node *leaf)
+{
+    CHECK_RTN_VAL(!cols, NULL);
+
+    const struct mdd_column *col = get_column(cols, leaf);
+    CHECK_RTN_VAL(!col || row >= cols->rows || !has_row(col, row), NULL);
+    CHECK_RTN_VAL(is_enum_leaf((struct mds_leaf*) col->leaf), mds_enum_name(col->leaf, col->ints[row]));
+    return col->strs ? col->strs[row] : NULL;
+}
+
+/*
+ * Full words of the bitmap take a plain pass over 64 values the compiler can vectorize, words with
+ * gaps visit their set bits.
+ */
+static void agg_sum(const struct mdd_column *col, size_t rows, long long *sum, long long *cnt)
+{
+    long long total = 0, n = 0;
+    for (size_t base = 0; base < rows; base += 64) {
+        uint64_t bits = col->present[base / 64];
+        const long long *vals = col->ints + base;
+        if (bits == UINT64_MAX) {
+            for (int i = 0; i < 64; i++) {
+                total += vals[i];
+            }
+            n += 64;
+            continue;
+        }
+        n += __builtin_popcountll(bits);
+        for (; bits; bits &= bits - 1) {
+            total += vals[__builtin_ctzll(bits)];
+        }
+    }
+    *sum = total;
+    *cnt = n;
+}
+
+static void agg_extreme(const struct mdd_column *col, size_t rows, int is_max, long long *val, long long *cnt)
+{
+    long long lo = LLONG_MAX, hi = LLONG_MIN, n = 0;
+    for (size_t base = 0; base < rows; base += 64) {
+        uint64_t bits = col->present[base / 64];
+        const long long *vals = col->ints + base;
+        if (bits == UINT64_MAX) {
+            for (int i = 0; i < 64; i++) {
+                lo = vals[i] < lo ? vals[i] : lo;
+                hi = vals[i] > hi ? vals[i] : hi;
+            }
+            n += 64;
+            continue;
+        }
+        n += __builtin_popcountll(bits);
+        for (; bits; bits &= bits - 1) {
+            long long v = vals[__builtin_ctzll(bits)];
+            lo = v < lo ? v : lo;
+            hi = v > hi ? v : hi;
+        }
+    }
+    *val = is_max ? hi : lo;
+    *cnt = n;
+}
+
+static long long count_rows(const struct mdd_column *col, size_t rows)
+{
+    long long n = 0;
+    for (size_t i = 0; i < (rows + 63) / 64; i++) {
+        n += __builtin_popcountll(col->present[i]);
+    }
+    return n;
+}
+
+int mdd_columns_agg(const struct mdd_columns *cols, const struct mds_node *leaf, mdd_agg_type type, long long *val)
+{
+    CHECK_NULL_RTN2(cols, val, -1);
+    CHECK_DO_RTN_VAL(type > MDD_AGG_MAX, LOG_WARN("Invalid aggregate type:%d", type), -1);
+
+    const struct mdd_column *col = get_column(cols, leaf);
+    CHECK_DO_RTN_VAL(leaf && !col, LOG_WARN("%s is not a leaf of %s", leaf->name, cols->lists->name), -1);
+    if (type == MDD_AGG_COUNT) {
+        *val = col ? count_rows(col, cols->rows) : (long long) cols->rows;
+        return 0;
+    }
+    CHECK_DO_RTN_VAL(!col || !is_int_leaf((struct mds_leaf*) col->leaf), LOG_WARN("Aggregate %d over %s needs an int leaf", type,
+            cols->lists->name), -1);
+
+    long long cnt = 0;
+    if (type == MDD_AGG_SUM) {
+        agg_sum(col, cols->rows, val, &cnt);
+        return 0;
+    }
+    agg_extreme(col, cols->rows, type == MDD_AGG_MAX, val, &cnt);
+    return cnt ? 0 : -1;
+}
+
+struct mdd_node* mdd_columns_node(const struct mdd_columns *cols, size_t row)
+{
+    CHECK_RTN_VAL(!cols || row >= cols->rows, NULL);
+
+    struct mdd_node *mo = mdd_new_node(cols->lists);
+    CHECK_RTN_VAL(!mo, NULL);
+
+    struct mdd_node *prev = NULL;
+    for (unsigned int i = 0; i < cols->col_cnt; i++) {
+        const struct mdd_column *col = &cols->cols[i];
+        if (!has_row(col, row)) {
+            continue;
+        }
+
+        struct mdd_node *node = mdd_new_child(mo, col->leaf);
+        CHECK_DO_RTN_VAL(!node, mdd_free_data(mo), NULL);
+        CHECK_DO_RTN_VAL(mdd_link_child(mo, prev, node), mdd_free_data(node);mdd_free_data(mo), NULL);
+        prev = node;
+        if (col->strs) {
+            CHECK_DO_RTN_VAL(mdd_leaf_set_str((struct mdd_leaf*) node, col->strs[row], strlen(col->strs[row])),
+                    mdd_free_data(mo), NULL);
+        } else {
+            ((struct mdd_leaf*) node)->value.intv = col->ints[row];
+        }
+    }
+    mdd_fit_slots(mo);
+    return mo;
+}
@@ -0,0 +1,520 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "macro.h"
+#include "log.h"
+#include "data_pack.h"
+
+/*
+ * A mo holds its leaves itself: vals is where its block starts in the value slab, a presence
+ * bitmap and then one value per schema leaf in leaf_idx order, a string as its offset into the
+ * arena. child and next link the mos only.
+ */
+struct pack_mo{
+    uint16_t schema;
+    uint16_t leaf_cnt;
+    mdd_ref parent;
+    mdd_ref child;
+    mdd_ref next;
+    uint32_t vals;
+};
+
+struct mdd_pack{
+    struct mds_table table;
+    struct pack_mo *mos;
+    size_t mo_cnt;
+    size_t mo_cap;
+    uint64_t *vals;
+    size_t val_cnt;
+    size_t val_cap;
+    char *strs;
+    size_t str_len;
+    size_t str_cap;
+    /* low bits of a leaf ref holding the position of the leaf in its mo */
+    unsigned int pos_bits;
+    /* instances of the ordered lists by list_key, clashed is set once two keys of them collide */
+    struct mdd_hmap keys;
+    int clashed;
+};
+
+#define REF_BITS 31
+
+static mdd_ref mo_ref(size_t idx)
+{
+    return (mdd_ref) (idx + 1) << 1;
+}
+
+static mdd_ref leaf_ref(const struct mdd_pack *pack, size_t idx, unsigned int pos)
+{
+    return ((mdd_ref) (idx + 1) << pack->pos_bits | pos) << 1 | 1;
+}
+
+static size_t ref_idx(mdd_ref ref)
+{
+    return (ref >> 1) - 1;
+}
+
+static unsigned int bitmap_words(unsigned int cnt)
+{
+    return (cnt + 63) / 64;
+}
+
+static int is_present(const struct mdd_pack *pack, const struct pack_mo *mo, unsigned int pos)
+{
+    return pack->vals[mo->vals + pos / 64] >> (pos % 64) & 1;
+}
+
+static uint64_t* leaf_val(const struct mdd_pack *pack, const struct pack_mo *mo, unsigned int pos)
+{
+    return &pack->vals[mo->vals + bitmap_words(mo->leaf_cnt) + pos];
+}
+
+static struct mds_node* leaf_schema(const struct mdd_pack *pack, const struct pack_mo *mo, unsigned int pos)
+{
+    return ((struct mds_mo*) pack->table.nodes[mo->schema])->leafs[pos];
+}
+
+static const struct pack_mo* get_mo(const struct mdd_pack *pack, mdd_ref ref)
+{
+    CHECK_RTN_VAL(!pack || ref == MDD_REF_NULL || mdd_ref_is_leaf(ref) || ref_idx(ref) >= pack->mo_cnt, NULL);
+    return &pack->mos[ref_idx(ref)];
+}
+
+/* the mo holding the leaf at ref and its position there, NULL unless the leaf is present */
+static const struct pack_mo* get_leaf(const struct mdd_pack *pack, mdd_ref ref, unsigned int *pos)
+{
+    CHECK_RTN_VAL(!pack || !mdd_ref_is_leaf(ref), NULL);
+
+    size_t idx = (size_t) (ref >> 1 >> pack->pos_bits) - 1;
+    CHECK_RTN_VAL(idx >= pack->mo_cnt, NULL);
+    const struct pack_mo *mo = &pack->mos[idx];
+    *pos = (ref >> 1) & ((1u << pack->pos_bits) - 1);
+    return *pos < mo->leaf_cnt && is_present(pack, mo, *pos) ? mo : NULL;
+}
+
+/* the first leaf present at pos or after, else the first child mo */
+static mdd_ref next_in_mo(const struct mdd_pack *pack, const struct pack_mo *mo, unsigned int pos)
+{
+    for (; pos < mo->leaf_cnt; pos = (pos / 64 + 1) * 64) {
+        uint64_t bits = pack->vals[mo->vals + pos / 64] >> (pos % 64);
+        if (bits) {
+            pos += __builtin_ctzll(bits);
+            return pos < mo->leaf_cnt ? leaf_ref(pack, mo - pack->mos, pos) : mo->child;
+        }
+    }
+    return mo->child;
+}
+
+static int slab_reserve(void **slab, size_t *cap, size_t need, size_t size)
+{
+    CHECK_RTN_VAL(need <= *cap, 0);
+
+    size_t grown = *cap ? *cap * 2 : 1024;
+    grown = grown > need ? grown : need;
+    void *mem = realloc(*slab, grown * size);
+    CHECK_DO_RTN_VAL(!mem, LOG_WARN("No memory"), -1);
+    *slab = mem;
+    *cap = grown;
+    return 0;
+}
+
+static int pack_schema(struct mdd_pack *pack, struct mds_node *schema, uint16_t *id)
+{
+    long sid = mds_table_id(&pack->table, schema);
+    CHECK_DO_RTN_VAL(sid < 0 || sid > UINT16_MAX, LOG_WARN("No 16 bit id for schema %s", schema->name), -1);
+    *id = (uint16_t) sid;
+    return 0;
+}
+
+static int pack_str(struct mdd_pack *pack, const char *str, uint32_t *off)
+{
+    size_t len = strlen(str) + 1;
+    CHECK_DO_RTN_VAL(pack->str_len + len > UINT32_MAX, LOG_WARN("String arena is full"), -1);
+    CHECK_RTN_VAL(slab_reserve((void**) &pack->strs, &pack->str_cap, pack->str_len + len, 1), -1);
+
+    memcpy(pack->strs + pack->str_len, str, len);
+    *off = (uint32_t) pack->str_len;
+    pack->str_len += len;
+    return 0;
+}
+
+/* a repeated leaf keeps the first value, as lookups by path do */
+static int pack_leaf(struct mdd_pack *pack, size_t idx, struct mdd_node *node)
+{
+    struct pack_mo *mo = &pack->mos[idx];
+    unsigned int pos = ((struct mds_leaf*) node->schema)->leaf_idx;
+    CHECK_RTN_VAL(is_present(pack, mo, pos), 0);
+
+    uint64_t val = (uint64_t) ((struct mdd_leaf*) node)->value.intv;
+    if (is_str_leaf((struct mds_leaf*) node->schema)) {
+        uint32_t off = 0;
+        CHECK_RTN_VAL(pack_str(pack, str_leaf_val(node), &off), -1);
+        val = off;
+    }
+    *leaf_val(pack, mo, pos) = val;
+    pack->vals[mo->vals + pos / 64] |= 1ULL << (pos % 64);
+    return 0;
+}
+
+/* parent ref, list schema id and Id mixed into one key, a clash is told by the instance found */
+static uintptr_t list_key(mdd_ref parent, uint16_t schema, long long id)
+{
+    uint64_t key = ((uint64_t) parent << 32 | (uint32_t) id) * 0x9E3779B97F4A7C15ULL ^ schema;
+    return key ? (uintptr_t) key : 1;
+}
+
+static int get_key(const struct mdd_pack *pack, mdd_ref ref, long long *id)
+{
+    mdd_ref key = mdd_pack_find(pack, ref, mds_find_child_schema(mdd_pack_schema(pack, ref), "Id"));
+    return mdd_pack_int(pack, key, id) || *id < 0 || *id > INT_MAX ? -1 : 0;
+}
+
+/* the first instance of a key wins, as it does for lookups in the tree */
+static mdd_ref index_key(struct mdd_pack *pack, mdd_ref ref)
+{
+    long long id = 0;
+    CHECK_RTN_VAL(get_key(pack, ref, &id), ref);
+
+    const struct pack_mo *mo = &pack->mos[ref_idx(ref)];
+    uintptr_t slot = list_key(mo->parent, mo->schema, id);
+    mdd_ref held = (mdd_ref) (uintptr_t) hmap_get(&pack->keys, slot);
+    if (held != MDD_REF_NULL) {
+        long long held_id = 0;
+        const struct pack_mo *other = &pack->mos[ref_idx(held)];
+        pack->clashed |= other->parent != mo->parent || other->schema != mo->schema || get_key(pack, held, &held_id)
+                || held_id != id;
+        return ref;
+    }
+    return hmap_put(&pack->keys, slot, (void*) (uintptr_t) ref) ? MDD_REF_NULL : ref;
+}
+
+/* the slabs may move while children are added, so mos are addressed by index throughout */
+static mdd_ref pack_node(struct mdd_pack *pack, struct mdd_node *node, mdd_ref parent)
+{
+    CHECK_DO_RTN_VAL((pack->mo_cnt + 2) << pack->pos_bits >= 1UL << REF_BITS, LOG_WARN("Too many mos"), MDD_REF_NULL);
+    CHECK_RTN_VAL(slab_reserve((void**) &pack->mos, &pack->mo_cap, pack->mo_cnt + 1, sizeof(struct pack_mo)),
+            MDD_REF_NULL);
+
+    unsigned int cnt = ((struct mds_mo*) node->schema)->leaf_cnt;
+    CHECK_DO_RTN_VAL(cnt > UINT16_MAX, LOG_WARN("Too many leaves in %s", node->schema->name), MDD_REF_NULL);
+    size_t words = cnt ? bitmap_words(cnt) + cnt : 0;
+    CHECK_DO_RTN_VAL(pack->val_cnt + words > UINT32_MAX, LOG_WARN("Value slab is full"), MDD_REF_NULL);
+    CHECK_RTN_VAL(slab_reserve((void**) &pack->vals, &pack->val_cap, pack->val_cnt + words, sizeof(uint64_t)),
+            MDD_REF_NULL);
+    memset(pack->vals + pack->val_cnt, 0, words * sizeof(uint64_t));
+
+    size_t idx = pack->mo_cnt++;
+    memset(&pack->mos[idx], 0, sizeof(struct pack_mo));
+    pack->mos[idx].leaf_cnt = (uint16_t) cnt;
+    pack->mos[idx].parent = parent;
+    pack->mos[idx].vals = (uint32_t) pack->val_cnt;
+    pack->val_cnt += words;
+    CHECK_RTN_VAL(pack_schema(pack, node->schema, &pack->mos[idx].schema), MDD_REF_NULL);
+
+    mdd_ref ref = mo_ref(idx);
+    mdd_ref prev = MDD_REF_NULL;
+    for (struct mdd_node *child = node->child; child; child = child->next) {
+        if (is_leaf_node(child->schema)) {
+            CHECK_RTN_VAL(pack_leaf(pack, idx, child), MDD_REF_NULL);
+            continue;
+        }
+        mdd_ref child_ref = pack_node(pack, child, ref);
+        CHECK_RTN_VAL(child_ref == MDD_REF_NULL, MDD_REF_NULL);
+        if (prev == MDD_REF_NULL) {
+            pack->mos[idx].child = child_ref;
+        } else {
+            pack->mos[ref_idx(prev)].next = child_ref;
+        }
+        prev = child_ref;
+    }
+    return is_ordered_list(node->schema) ? index_key(pack, ref) : ref;
+}
+
+/* gives back what the doubling left over, a failed shrink keeps the larger block */
+static void slab_trim(void **slab, size_t *cap, size_t cnt, size_t size)
+{
+    void *mem = cnt ? realloc(*slab, cnt * size) : NULL;
+    if (mem) {
+        *slab = mem;
+        *cap = cnt;
+    }
+}
+
+/* enough bits for the position of any leaf of the schema */
+static unsigned int pos_bits(const struct mds_table *table)
+{
+    unsigned int most = 0;
+    for (size_t i = 0; i < table->cnt; i++) {
+        if (is_mo(table->nodes[i]->mtype) && ((struct mds_mo*) table->nodes[i])->leaf_cnt > most) {
+            most = ((struct mds_mo*) table->nodes[i])->leaf_cnt;
+        }
+    }
+    unsigned int bits = 0;
+    while (most > 1U << bits) {
+        bits++;
+    }
+    return bits;
+}
+
+struct mdd_pack* mdd_pack_build(struct mdd_node *root)
+{
+    CHECK_NULL_RTN(root, NULL);
+    CHECK_DO_RTN_VAL(is_leaf_node(root->schema), LOG_WARN("Pack needs a mo root"), NULL);
+
+    struct mdd_pack *pack = calloc(1, sizeof(struct mdd_pack));
+    CHECK_DO_RTN_VAL(!pack, LOG_WARN("No memory"), NULL);
+    CHECK_DO_RTN_VAL(mds_table_init(&pack->table, root->schema), free(pack), NULL);
+    CHECK_DO_RTN_VAL(hmap_init(&pack->keys, 0), mdd_pack_free(pack), NULL);
+    pack->pos_bits = pos_bits(&pack->table);
+    CHECK_DO_RTN_VAL(pack->pos_bits >= REF_BITS - 1, LOG_WARN("Too many leaves in a mo");mdd_pack_free(pack), NULL);
+
+    CHECK_DO_RTN_VAL(pack_node(pack, root, MDD_REF_NULL) == MDD_REF_NULL, mdd_pack_free(pack), NULL);
+    slab_trim((void**) &pack->mos, &pack->mo_cap, pack->mo_cnt, sizeof(struct pack_mo));
+    slab_trim((void**) &pack->vals, &pack->val_cap, pack->val_cnt, sizeof(uint64_t));
+    slab_trim((void**) &pack->strs, &pack->str_cap, pack->str_len, 1);
+    return pack;
+}
+
+void mdd_pack_free(struct mdd_pack *pack)
+{
+    CHECK_RTN(!pack);
+
+    mds_table_free(&pack->table);
+    hmap_free(&pack->keys);
+    free(pack->mos);
+    free(pack->vals);
+    free(pack->strs);
+    free(pack);
+}
+
+size_t mdd_pack_bytes(const struct mdd_pack *pack)
+{
+    CHECK_RTN_VAL(!pack, 0);
+    return sizeof(struct mdd_pack) + pack->mo_cap * sizeof(struct pack_mo) + pack->val_cap * sizeof(uint64_t)
+            + pack->str_cap + pack->table.cap * sizeof(struct mds_node*)
+            + pack->keys.capacity * (sizeof(uintptr_t) + sizeof(void*));
+}
+
+mdd_ref mdd_pack_root(const struct mdd_pack *pack)
+{
+    return pack && pack->mo_cnt ? mo_ref(0) : MDD_REF_NULL;
+}
+
+mdd_ref mdd_pack_parent(const struct mdd_pack *pack, mdd_ref ref)
+{
+    unsigned int pos = 0;
+    const struct pack_mo *mo = get_leaf(pack, ref, &pos);
+    CHECK_RTN_VAL(mo, mo_ref(mo - pack->mos));
+    mo = get_mo(pack, ref);
+    return mo ? mo->parent : MDD_REF_NULL;
+}
+
+mdd_ref mdd_pack_child(const struct mdd_pack *pack, mdd_ref ref)
+{
+    const struct pack_mo *mo = get_mo(pack, ref);
+    return mo ? next_in_mo(pack, mo, 0) : MDD_REF_NULL;
+}
+
+mdd_ref mdd_pack_next(const struct mdd_pack *pack, mdd_ref ref)
+{
+    unsigned int pos = 0;
+    const struct pack_mo *mo = get_leaf(pack, ref, &pos);
+    CHECK_RTN_VAL(mo, next_in_mo(pack, mo, pos + 1));
+    mo = get_mo(pack, ref);
+    return mo ? mo->next : MDD_REF_NULL;
+}
+
+struct mds_node* mdd_pack_schema(const struct mdd_pack *pack, mdd_ref ref)
+{
+    unsigned int pos = 0;
+    const struct pack_mo *mo = get_leaf(pack, ref, &pos);
+    CHECK_RTN_VAL(mo, leaf_schema(pack, mo, pos));
+    mo = get_mo(pack, ref);
+    return mo ? pack->table.nodes[mo->schema] : NULL;
+}
+
+/* a leaf is found at its position, a mo among the child mos */
+mdd_ref mdd_pack_find(const struct mdd_pack *pack, mdd_ref ref, const struct mds_node *schema)
+{
+    const struct pack_mo *mo = get_mo(pack, ref);
+    CHECK_RTN_VAL(!mo || !schema || schema->parent != pack->table.nodes[mo->schema], MDD_REF_NULL);
+    if (is_leaf_node(schema)) {
+        unsigned int pos = ((struct mds_leaf*) schema)->leaf_idx;
+        return is_present(pack, mo, pos) ? leaf_ref(pack, mo - pack->mos, pos) : MDD_REF_NULL;
+    }
+
+    for (mdd_ref child = mo->child; child != MDD_REF_NULL; child = pack->mos[ref_idx(child)].next) {
+        if (pack->table.nodes[pack->mos[ref_idx(child)].schema] == schema) {
+            return child;
+        }
+    }
+    return MDD_REF_NULL;
+}
+
+int mdd_pack_int(const struct mdd_pack *pack, mdd_ref ref, long long *val)
+{
+    unsigned int pos = 0;
+    const struct pack_mo *mo = get_leaf(pack, ref, &pos);
+    CHECK_RTN_VAL(!mo || !val, -1);
+    CHECK_RTN_VAL(!is_intv_leaf((struct mds_leaf*) leaf_schema(pack, mo, pos)), -1);
+    *val = (long long) *leaf_val(pack, mo, pos);
+    return 0;
+}
+
+const char* mdd_pack_str(const struct mdd_pack *pack, mdd_ref ref)
+{
+    unsigned int pos = 0;
+    const struct pack_mo *mo = get_leaf(pack, ref, &pos);
+    CHECK_RTN_VAL(!mo, NULL);
+
+    struct mds_node *schema = leaf_schema(pack, mo, pos);
+    uint64_t val = *leaf_val(pack, mo, pos);
+    CHECK_RTN_VAL(is_enum_leaf((struct mds_leaf*) schema), mds_enum_name(schema, (long long) val));
+    return is_str_leaf((struct mds_leaf*) schema) ? pack->strs + val : NULL;
+}
+
+int mdd_pack_view(const struct mdd_pack *pack, mdd_ref ref, struct mdd_leaf *view)
+{
+    struct mds_node *schema = mdd_pack_schema(pack, ref);
+    CHECK_RTN_VAL(!view || !schema || !is_leaf_node(schema), -1);
+
+    memset(view, 0, sizeof(struct mdd_leaf));
+    view->schema = schema;
+    if (!is_str_leaf((struct mds_leaf*) schema)) {
+        return mdd_pack_int(pack, ref, &view->value.intv);
+    }
+
+    const char *str = mdd_pack_str(pack, ref);
+    size_t len = strlen(str);
+    if (len <= MDD_SSO_LEN) {
+        memcpy(view->value.sso, str, len);
+    } else {
+        view->value.strv = str;
+        view->value.sso[MDD_SSO_LEN] = 1;
+    }
+    return 0;
+}
+
+static struct mdd_node* unpack_node(const struct mdd_pack *pack, mdd_ref ref, struct mdd_node *parent)
+{
+    struct mds_node *schema = mdd_pack_schema(pack, ref);
+    struct mdd_node *node = parent ? mdd_new_child(parent, schema) : mdd_new_node(schema);
+    CHECK_RTN_VAL(!node, NULL);
+
+    if (mdd_ref_is_leaf(ref)) {
+        if (is_str_leaf((struct mds_leaf*) schema)) {
+            const char *str = mdd_pack_str(pack, ref);
+            CHECK_DO_RTN_VAL(mdd_leaf_set_str((struct mdd_leaf*) node, str, strlen(str)), mdd_free_data(node), NULL);
+        } else {
+            mdd_pack_int(pack, ref, &((struct mdd_leaf*) node)->value.intv);
+        }
+        return node;
+    }
+
+    struct mdd_node *prev = NULL;
+    for (mdd_ref child = mdd_pack_child(pack, ref); child != MDD_REF_NULL; child = mdd_pack_next(pack, child)) {
+        struct mdd_node *child_node = unpack_node(pack, child, node);
+        CHECK_DO_RTN_VAL(!child_node, mdd_free_data(node), NULL);
+        mdd_link_child(node, prev, child_node);
+        prev = child_node;
+    }
+    return node;
+}
+
+struct mdd_node* mdd_pack_node(const struct mdd_pack *pack, mdd_ref ref)
+{
+    CHECK_RTN_VAL(!mdd_pack_schema(pack, ref), NULL);
+    return unpack_node(pack, ref, NULL);
+}
+
+/* an int value matches its decimal form, a string or enum leaf its text */
+static int match_value(const struct mdd_pack *pack, mdd_ref leaf, const char *value, size_t len)
+{
+    const char *str = mdd_pack_str(pack, leaf);
+    CHECK_RTN_VAL(str, strlen(str) == len && !strncmp(str, value, len));
+
+    long long val = 0;
+    char *end = NULL;
+    CHECK_RTN_VAL(!len || mdd_pack_int(pack, leaf, &val), 0);
+    return strtoll(value, &end, 10) == val && end == value + len;
+}
+
+static int match_name(const char *name, const char *frag, size_t len)
+{
+    return !strncmp(name, frag, len) && name[len] == '\0';
+}
+
+/* the node of ref matching one path fragment `name` or `name[key=value]` */
+static int match_frag(const struct mdd_pack *pack, mdd_ref ref, const char *frag, size_t len)
+{
+    const char *pred = memchr(frag, '[', len);
+    struct mds_node *schema = mdd_pack_schema(pack, ref);
+    CHECK_RTN_VAL(!match_name(schema->name, frag, pred ? (size_t) (pred - frag) : len), 0);
+    CHECK_RTN_VAL(!pred, 1);
+
+    const char *eq = memchr(pred, '=', frag + len - pred);
+    CHECK_RTN_VAL(!eq || frag[len - 1] != ']', 0);
+    for (mdd_ref child = mdd_pack_child(pack, ref); child != MDD_REF_NULL; child = mdd_pack_next(pack, child)) {
+        if (match_name(mdd_pack_schema(pack, child)->name, pred + 1, eq - pred - 1)) {
+            return match_value(pack, child, eq + 1, frag + len - 1 - eq - 1);
+        }
+    }
+    return 0;
+}
+
+/* an ordered list instance looked up by its Id, a miss is final unless keys clashed */
+static mdd_ref find_keyed(const struct mdd_pack *pack, mdd_ref parent, struct mds_node *schema, const char *frag,
+        size_t len, int *final)
+{
+    const char *pred = memchr(frag, '[', len);
+    CHECK_RTN_VAL(!is_ordered_list(schema) || !pred || strncmp(pred, "[Id=", 4), MDD_REF_NULL);
+
+    char *end = NULL;
+    long long id = strtoll(pred + 4, &end, 10);
+    CHECK_RTN_VAL(end != frag + len - 1 || end == pred + 4 || id < 0 || id > INT_MAX, MDD_REF_NULL);
+
+    uint16_t sid = (uint16_t) mds_table_id(&pack->table, schema);
+    mdd_ref ref = (mdd_ref) (uintptr_t) hmap_get(&pack->keys, list_key(parent, sid, id));
+    const struct pack_mo *mo = get_mo(pack, ref);
+    *final = !pack->clashed;
+    return mo && mo->parent == parent && mo->schema == sid && match_frag(pack, ref, frag, len) ? ref : MDD_REF_NULL;
+}
+
+static mdd_ref find_child(const struct mdd_pack *pack, mdd_ref parent, const char *frag, size_t len)
+{
+    const char *pred = memchr(frag, '[', len);
+    size_t name_len = pred ? (size_t) (pred - frag) : len;
+    struct mds_node *schema = mdd_pack_schema(pack, parent)->child;
+    while (schema && !match_name(schema->name, frag, name_len)) {
+        schema = schema->next;
+    }
+    CHECK_RTN_VAL(!schema, MDD_REF_NULL);
+
+    int final = 0;
+    mdd_ref ref = find_keyed(pack, parent, schema, frag, len, &final);
+    CHECK_RTN_VAL(ref != MDD_REF_NULL || final, ref);
+
+    for (ref = mdd_pack_child(pack, parent); ref != MDD_REF_NULL; ref = mdd_pack_next(pack, ref)) {
+        CHECK_RTN_VAL(match_frag(pack, ref, frag, len), ref);
+    }
+    return MDD_REF_NULL;
+}
+
+/* the node at a path of mdd_get_data, the Id of ordered list instances is looked up in one probe */
+mdd_ref mdd_pack_get(const struct mdd_pack *pack, const char *path)
+{
+    CHECK_RTN_VAL(!path, MDD_REF_NULL);
+
+    const char *slash = strchr(path, '/');
+    size_t len = slash ? (size_t) (slash - path) : strlen(path);
+    mdd_ref ref = mdd_pack_root(pack);
+    CHECK_RTN_VAL(ref == MDD_REF_NULL || !match_frag(pack, ref, path, len), MDD_REF_NULL);
+
+    while (slash && ref != MDD_REF_NULL) {
+        path = slash + 1;
+        slash = strchr(path, '/');
+        len = slash ? (size_t) (slash - path) : strlen(path);
+        ref = find_child(pack, ref, path, len);
+    }
+    return ref;
+}
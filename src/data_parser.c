@@ -1,46 +1,219 @@
+#include <limits.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "data_parser.h"
+#include "json_scan.h"
+#include "thread_pool.h"
 #include "macro.h"
 #include "cjson/cJSON.h"
 #include "log.h"
 
 static struct mdd_node* build_mdd_node(struct mds_node *schema, cJSON *data_json, struct mdd_node *parent);
-static int dump_mdd_node(struct mdd_node *node, char **buf, size_t *size, size_t *posi, struct mdd_node **next);
+static int dump_mdd_node(struct mdd_node *node, struct mdd_frag_cache *frags, char **buf, size_t *size, size_t *posi,
+        struct mdd_node **next);
 static int compare_list(struct mds_node *lists, struct mdd_node *mo_run_parent, struct mdd_node *mo_edit_parent,
         mdd_diff *diff);
 static int compare_container(struct mds_node *mos, struct mdd_node *mo_run, struct mdd_node *mo_edit, mdd_diff *diff);
+static int get_list_key(struct mdd_node *list, const char *key);
+static int check_list_key(struct mdd_node *list);
+static int is_key_out_of_range(struct mdd_node *mo, struct mdd_node *leaf, long long val);
+static uintptr_t list_key_slot(int key);
+static void free_indexes(struct mdd_mo *mo);
+static int is_leaf_equal(struct mdd_leaf *leaf_run, struct mdd_leaf *leaf_edit);
+static struct mdd_node* find_child_node(struct mdd_node *mo, struct mds_node *child_schema);
+static size_t shadow_size(struct mds_node *schema);
+
+static void free_str_val(struct mdd_leaf *leaf)
+{
+    if (leaf->value.sso[MDD_SSO_LEN]) {
+        strpool_release(leaf->value.strv);
+    }
+    memset(&leaf->value, 0, sizeof(mdd_dvalue));
+}
+
+/*
+ * The slots of a mo live in one block: the bitmap of the leaf positions given a slot, the bitmap
+ * of the slots in use, then one mdd_leaf per given position in leaf_idx order, where mo->slots
+ * points. A mo being built gives every schema leaf a slot, mdd_fit_slots then shrinks the block
+ * to the leaves it holds.
+ */
+static unsigned int slot_words(struct mds_node *schema)
+{
+    return (((struct mds_mo*) schema)->leaf_cnt + 63) / 64;
+}
+
+static size_t slots_size(struct mds_node *schema, unsigned int cnt)
+{
+    return 2 * slot_words(schema) * sizeof(uint64_t) + cnt * sizeof(struct mdd_leaf);
+}
+
+static size_t node_size(struct mdd_node *node)
+{
+    CHECK_RTN_VAL(is_leaf_node(node->schema), sizeof(struct mdd_leaf));
+    return node->flags & MDD_F_SHADOW ? shadow_size(node->schema) : sizeof(struct mdd_mo);
+}
+
+static uint64_t* slot_given(struct mdd_mo *mo)
+{
+    return (uint64_t*) mo->slots - 2 * slot_words(mo->schema);
+}
+
+static uint64_t* slot_bits(struct mdd_mo *mo)
+{
+    return (uint64_t*) mo->slots - slot_words(mo->schema);
+}
+
+static unsigned int count_bits(const uint64_t *bits, unsigned int words)
+{
+    unsigned int cnt = 0;
+    for (unsigned int i = 0; i < words; i++) {
+        cnt += __builtin_popcountll(bits[i]);
+    }
+    return cnt;
+}
+
+/* the slot of position pos among the given ones */
+static struct mdd_leaf* slot_at(struct mdd_mo *mo, unsigned int pos)
+{
+    const uint64_t *given = slot_given(mo);
+    unsigned int rank = count_bits(given, pos / 64) + __builtin_popcountll(given[pos / 64] & ((1ULL << (pos % 64)) - 1));
+    return &mo->slots[rank];
+}
+
+static size_t slots_block_size(struct mdd_mo *mo)
+{
+    return slots_size(mo->schema, count_bits(slot_given(mo), slot_words(mo->schema)));
+}
+
+/* places the slots of mo in block, giving the positions set in given, every one without it */
+static void set_slots(struct mdd_mo *mo, void *block, const uint64_t *given)
+{
+    unsigned int words = slot_words(mo->schema);
+    mo->slots = (struct mdd_leaf*) ((uint64_t*) block + 2 * words);
+    if (given) {
+        memcpy(block, given, words * sizeof(uint64_t));
+        return;
+    }
+    unsigned int cnt = ((struct mds_mo*) mo->schema)->leaf_cnt;
+    memset(block, 0xff, cnt / 64 * sizeof(uint64_t));
+    if (cnt % 64) {
+        ((uint64_t*) block)[cnt / 64] = (1ULL << (cnt % 64)) - 1;
+    }
+}
+
+static void free_slots(struct mdd_mo *mo)
+{
+    CHECK_RTN(!mo->slots);
+    nodepool_free(slot_given(mo), slots_block_size(mo));
+    mo->slots = NULL;
+}
+
+static struct mdd_leaf* get_slot(struct mdd_node *mo, struct mds_node *leaf)
+{
+    CHECK_RTN_VAL(!is_mo(mo->schema->mtype) || !((struct mdd_mo*) mo)->slots, NULL);
+
+    unsigned int pos = ((struct mds_leaf*) leaf)->leaf_idx;
+    CHECK_RTN_VAL(!(slot_bits((struct mdd_mo*) mo)[pos / 64] >> (pos % 64) & 1), NULL);
+    return slot_at((struct mdd_mo*) mo, pos);
+}
+
+static int in_slot(struct mdd_leaf *leaf)
+{
+    struct mdd_mo *mo = (struct mdd_mo*) leaf->parent;
+    CHECK_RTN_VAL(!mo || !is_mo(mo->schema->mtype) || !mo->slots, 0);
+    return leaf >= mo->slots && leaf < mo->slots + count_bits(slot_given(mo), slot_words(mo->schema));
+}
+
+static void put_slot(struct mdd_leaf *leaf)
+{
+    struct mdd_mo *mo = (struct mdd_mo*) leaf->parent;
+    unsigned int pos = ((struct mds_leaf*) leaf->schema)->leaf_idx;
+    slot_bits(mo)[pos / 64] &= ~(1ULL << (pos % 64));
+    memset(leaf, 0, sizeof(struct mdd_leaf));
+}
+
+/* the slot of a leaf of mo, NULL when it has none or another leaf holds it */
+static struct mdd_leaf* take_slot(struct mdd_mo *mo, struct mds_node *schema)
+{
+    unsigned int pos = ((struct mds_leaf*) schema)->leaf_idx;
+    uint64_t *bits = slot_bits(mo);
+    CHECK_RTN_VAL(!(slot_given(mo)[pos / 64] >> (pos % 64) & 1) || (bits[pos / 64] >> (pos % 64) & 1), NULL);
 
-static void mdd_free_self_node(struct mdd_node *node)
+    bits[pos / 64] |= 1ULL << (pos % 64);
+    struct mdd_leaf *leaf = slot_at(mo, pos);
+    leaf->schema = schema;
+    leaf->parent = (struct mdd_node*) mo;
+    return leaf;
+}
+
+/* nodes laid out by mdd_compact_tree live in aligned chunks, a chunk goes with its last node */
+#define MDD_CHUNK_SIZE (64 * 1024)
+
+struct mdd_chunk{
+    size_t live;
+    size_t used;
+};
+
+static struct mdd_chunk* chunk_of(const void *ptr)
+{
+    return (struct mdd_chunk*) ((uintptr_t) ptr & ~(uintptr_t) (MDD_CHUNK_SIZE - 1));
+}
+
+static void put_chunk(struct mdd_chunk *chunk)
+{
+    if (chunk && !--chunk->live) {
+        free(chunk);
+    }
+}
+
+/* with the parent freed along, a leaf in its slots has nothing to give back */
+static void mdd_free_self_node(struct mdd_node *node, int parent_freed)
 {
     CHECK_RTN(!node);
 
     if (is_leaf(node->schema->mtype)) {
         struct mdd_leaf *leaf = (struct mdd_leaf*) node;
         if (((struct mds_leaf*) leaf->schema)->dtype == MDS_DT_STR) {
-            free(leaf->value.strv);
+            free_str_val(leaf);
+        }
+        if (in_slot(leaf)) {
+            if (!parent_freed) {
+                put_slot(leaf);
+            }
+            return;
+        }
+    } else {
+        struct mdd_mo *mo = (struct mdd_mo*) node;
+        free_indexes(mo);
+        /* slots laid out right behind their mo go with it */
+        if (!(node->flags & MDD_F_CHUNK) || chunk_of(mo->slots) != chunk_of(mo)) {
+            free_slots(mo);
         }
     }
-    free(node);
+    if (node->flags & MDD_F_CHUNK) {
+        put_chunk(chunk_of(node));
+        return;
+    }
+    nodepool_free(node, node_size(node));
 }
 
-void mdd_free_data(struct mdd_node *root)
+static void free_siblings(struct mdd_node *first, int parent_freed)
 {
-    CHECK_RTN(!root);
-
-    struct mdd_node *child = root->child;
-    struct mdd_node *next = root->next;
-
-    if (child) {
-        mdd_free_data(child);
-    }
-
-    if (next) {
-        mdd_free_data(next);
+    struct mdd_node *next = NULL;
+    for (struct mdd_node *node = first; node; node = next) {
+        next = node->next;
+        if (node->child) {
+            free_siblings(node->child, 1);
+        }
+        mdd_free_self_node(node, parent_freed);
     }
+}
 
-    mdd_free_self_node(root);
+void mdd_free_data(struct mdd_node *root)
+{
+    free_siblings(root, 0);
 }
 
 static struct mdd_node* get_last_child(struct mdd_node *node)
@@ -52,12 +225,272 @@ static struct mdd_node* get_last_child(struct mdd_node *node)
     return n;
 }
 
+/* instances whose indexed leaf hashes alike, a circular chain entered at its newest slot */
+struct index_slot{
+    struct mdd_node *entry;
+    struct index_slot *next;
+};
+
+/* the instances of a list by the value of one leaf */
+struct leaf_index{
+    struct mds_node *schema;
+    struct mdd_hmap map;
+};
+
+/* the indexes over the instances of one list under one parent mo */
+struct mdd_index{
+    struct mds_node *schema;
+    struct mdd_btree tree;
+    unsigned int nleaf;
+    struct leaf_index *leafs;
+    struct mdd_index *next;
+};
+
+static void free_index(struct mdd_index *index)
+{
+    for (unsigned int i = 0; i < index->nleaf; i++) {
+        struct mdd_hmap *map = &index->leafs[i].map;
+        for (size_t j = 0; j < map->capacity; j++) {
+            struct index_slot *tail = map->keys[j] ? map->vals[j] : NULL;
+            struct index_slot *slot = tail ? tail->next : NULL;
+            while (slot) {
+                struct index_slot *next = slot == tail ? NULL : slot->next;
+                free(slot);
+                slot = next;
+            }
+        }
+        hmap_free(map);
+    }
+    free(index->leafs);
+    btree_free(&index->tree);
+    free(index);
+}
+
+static struct mdd_index* new_index(struct mds_node *lists)
+{
+    struct mds_mo *mo = (struct mds_mo*) lists;
+    struct mdd_index *index = calloc(1, sizeof(struct mdd_index));
+    CHECK_DO_RTN_VAL(!index, LOG_WARN("No memory"), NULL);
+
+    index->schema = lists;
+    btree_init(&index->tree);
+    for (unsigned int i = 0; i < mo->leaf_cnt; i++) {
+        index->nleaf += is_indexed_leaf(mo->leafs[i]) ? 1 : 0;
+    }
+    CHECK_RTN_VAL(!index->nleaf, index);
+
+    index->leafs = calloc(index->nleaf, sizeof(struct leaf_index));
+    CHECK_DO_RTN_VAL(!index->leafs, LOG_WARN("No memory");free(index), NULL);
+
+    struct leaf_index *leaf = index->leafs;
+    for (unsigned int i = 0; i < mo->leaf_cnt; i++) {
+        if (is_indexed_leaf(mo->leafs[i])) {
+            leaf->schema = mo->leafs[i];
+            CHECK_DO_RTN_VAL(hmap_init(&leaf->map, 0), free_index(index), NULL);
+            leaf++;
+        }
+    }
+    return index;
+}
+
+static struct mdd_index* get_index(struct mdd_node *parent, struct mds_node *lists, int create)
+{
+    CHECK_RTN_VAL(!parent || !is_indexed_list(lists), NULL);
+
+    struct mdd_mo *mo = (struct mdd_mo*) parent;
+    for (struct mdd_index *index = mo->index; index; index = index->next) {
+        if (index->schema == lists) {
+            return index;
+        }
+    }
+    CHECK_RTN_VAL(!create, NULL);
+
+    struct mdd_index *index = new_index(lists);
+    CHECK_RTN_VAL(!index, NULL);
+
+    index->next = mo->index;
+    mo->index = index;
+    return index;
+}
+
+static void free_indexes(struct mdd_mo *mo)
+{
+    struct mdd_index *next = NULL;
+    for (struct mdd_index *index = mo->index; index; index = next) {
+        next = index->next;
+        free_index(index);
+    }
+    mo->index = NULL;
+}
+
+static struct leaf_index* get_leaf_index(struct mdd_index *index, struct mds_node *leaf)
+{
+    for (unsigned int i = 0; index && i < index->nleaf; i++) {
+        if (index->leafs[i].schema == leaf) {
+            return &index->leafs[i];
+        }
+    }
+    return NULL;
+}
+
+/* FNV-1a over the string bytes, ints are spread by a multiply; 0 is not a valid map key */
+static uintptr_t hash_str(const char *str, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char) str[i]) * 1099511628211ULL;
+    }
+    return (uintptr_t) (h ? h : 1);
+}
+
+static uintptr_t hash_int(long long val)
+{
+    uint64_t h = (uint64_t) val * 0xC2B2AE3D27D4EB4FULL;
+    h ^= h >> 29;
+    return (uintptr_t) (h ? h : 1);
+}
+
+static uintptr_t hash_leaf(struct mdd_leaf *leaf)
+{
+    if (is_str_leaf((struct mds_leaf* )(leaf->schema))) {
+        return hash_str(str_leaf_val(leaf), strlen(str_leaf_val(leaf)));
+    }
+    return hash_int(leaf->value.intv);
+}
+
+/* the first indexed instance whose leaf holds the same value as leaf */
+static struct mdd_node* find_leaf_equal(struct leaf_index *index, struct mdd_leaf *leaf)
+{
+    const struct index_slot *tail = hmap_get(&index->map, hash_leaf(leaf));
+    for (const struct index_slot *slot = tail ? tail->next : NULL; slot; slot = slot == tail ? NULL : slot->next) {
+        if (is_leaf_equal((struct mdd_leaf*) find_child_node(slot->entry, index->schema), leaf)) {
+            return slot->entry;
+        }
+    }
+    return NULL;
+}
+
+/* returns 1 without indexing on a value already taken in a unique index */
+static int leaf_index_put(struct leaf_index *index, struct mdd_node *entry)
+{
+    struct mdd_leaf *leaf = (struct mdd_leaf*) find_child_node(entry, index->schema);
+    CHECK_RTN_VAL(!leaf, 0);
+    CHECK_RTN_VAL((((struct mds_leaf*) index->schema)->flags & MDS_F_UNIQUE) && find_leaf_equal(index, leaf), 1);
+
+    struct index_slot *slot = malloc(sizeof(struct index_slot));
+    CHECK_DO_RTN_VAL(!slot, LOG_WARN("No memory"), -1);
+
+    uintptr_t hash = hash_leaf(leaf);
+    struct index_slot *tail = hmap_get(&index->map, hash);
+    slot->entry = entry;
+    slot->next = tail ? tail->next : slot;
+    CHECK_DO_RTN_VAL(hmap_put(&index->map, hash, slot), free(slot), -1);
+    if (tail) {
+        tail->next = slot;
+    }
+    return 0;
+}
+
+static void leaf_index_del(struct leaf_index *index, struct mdd_node *entry)
+{
+    struct mdd_leaf *leaf = (struct mdd_leaf*) find_child_node(entry, index->schema);
+    CHECK_RTN(!leaf);
+
+    uintptr_t hash = hash_leaf(leaf);
+    struct index_slot *tail = hmap_get(&index->map, hash);
+    CHECK_RTN(!tail);
+
+    struct index_slot *prev = tail;
+    do {
+        struct index_slot *slot = prev->next;
+        if (slot->entry == entry) {
+            if (slot == prev) {
+                hmap_del(&index->map, hash);
+            } else {
+                prev->next = slot->next;
+                if (slot == tail) {
+                    hmap_put(&index->map, hash, prev);
+                }
+            }
+            free(slot);
+            return;
+        }
+        prev = slot;
+    } while (prev != tail);
+}
+
+static void unindex_entry(struct mdd_node *parent, struct mdd_node *entry)
+{
+    struct mdd_index *index = get_index(parent, entry->schema, 0);
+    CHECK_RTN(!index);
+
+    int key = get_list_key(entry, "Id");
+    if (is_ordered_list(entry->schema) && key >= 0 && btree_get(&index->tree, key) == entry) {
+        btree_del(&index->tree, key);
+    }
+    for (unsigned int i = 0; i < index->nleaf; i++) {
+        leaf_index_del(&index->leafs[i], entry);
+    }
+}
+
+/*
+ * Instances without the indexed leaf stay out of that index. Returns 1, leaving entry out of
+ * every index, on a value already taken in the key or a unique index; edits check for it up front.
+ */
+static int index_entry(struct mdd_node *parent, struct mdd_node *entry)
+{
+    CHECK_RTN_VAL(!parent || !is_indexed_list(entry->schema), 0);
+
+    struct mdd_index *index = get_index(parent, entry->schema, 1);
+    CHECK_RTN_VAL(!index, -1);
+
+    int key = get_list_key(entry, "Id");
+    int rt = is_ordered_list(entry->schema) && key >= 0 ? btree_put(&index->tree, key, entry) : 0;
+    CHECK_DO_RTN_VAL(rt > 0, LOG_WARN("Duplicate key %s[%d]", entry->schema->name, key), 1);
+
+    for (unsigned int i = 0; i < index->nleaf && !rt; i++) {
+        rt = leaf_index_put(&index->leafs[i], entry);
+        if (rt > 0) {
+            LOG_WARN("Duplicate %s of %s[%d]", index->leafs[i].schema->name, entry->schema->name, key);
+        }
+    }
+    CHECK_DO_RTN_VAL(rt, unindex_entry(parent, entry), rt);
+    return 0;
+}
+
+/* 1 if another instance of entry's list under parent holds value in its key or in a unique leaf */
+static int value_conflict(struct mdd_node *parent, struct mdd_node *entry, struct mdd_leaf *value)
+{
+    struct mdd_index *index = get_index(parent, entry->schema, 0);
+    CHECK_RTN_VAL(!index, 0);
+
+    struct mdd_node *exist = NULL;
+    struct leaf_index *leaf = get_leaf_index(index, value->schema);
+    if (leaf && (((struct mds_leaf*) leaf->schema)->flags & MDS_F_UNIQUE)) {
+        exist = find_leaf_equal(leaf, value);
+    } else if (is_ordered_list(entry->schema) && !strcmp(value->schema->name, "Id")) {
+        exist = btree_get(&index->tree, value->value.intv);
+    }
+    CHECK_DO_RTN_VAL(exist && exist != entry,
+            LOG_WARN("%s of %s is already taken", value->schema->name, entry->schema->name), 1);
+    return 0;
+}
+
+/* entry if leaf is its key or an indexed leaf, entry being a list instance */
+static struct mdd_node* indexed_entry(struct mdd_node *entry, struct mdd_node *leaf)
+{
+    CHECK_RTN_VAL(!entry || !is_indexed_list(entry->schema), NULL);
+    CHECK_RTN_VAL(is_indexed_leaf((struct mds_leaf* ) leaf->schema), entry);
+    return is_ordered_list(entry->schema) && !strcmp(leaf->schema->name, "Id") ? entry : NULL;
+}
+
 static struct mdd_node* build_container_node(struct mds_node *schema, cJSON *data_json, struct mdd_node *parent)
 {
     CHECK_DO_RTN_VAL(!cJSON_IsObject(data_json), LOG_WARN("invalid container data"), NULL);
 
     LOG_INFO("mdd--try build container or list: %s", schema->name);
-    struct mdd_mo *node = (struct mdd_mo*) calloc(1, sizeof(struct mdd_mo));
+    struct mdd_mo *node = (struct mdd_mo*) nodepool_alloc(sizeof(struct mdd_mo));
+    CHECK_DO_RTN_VAL(!node, LOG_WARN("no memory!"), NULL);
     node->schema = schema;
     node->parent = parent;
 
@@ -71,6 +504,12 @@ static struct mdd_node* build_container_node(struct mds_node *schema, cJSON *dat
                 ERR_OUT);
 
         node_child = build_mdd_node(schema_child, data_child, parent);
+        /* an empty list builds nothing, anything else without a node is invalid data */
+        if (!node_child && is_list_node(schema_child) && cJSON_IsArray(data_child) && !data_child->child) {
+            data_child = data_child->next;
+            continue;
+        }
+        CHECK_DO_GOTO(!node_child, LOG_WARN("invalid data %s under %s", data_child->string, schema->name), ERR_OUT);
         if (!prev) {
             parent->child = node_child;
         } else {
@@ -81,6 +520,7 @@ static struct mdd_node* build_container_node(struct mds_node *schema, cJSON *dat
 
         data_child = data_child->next;
     }
+    mdd_fit_slots((struct mdd_node*) node);
     return node;
 
 ERR_OUT:
@@ -100,6 +540,9 @@ static struct mdd_node* build_list_node(struct mds_node *schema, cJSON *data_jso
     cJSON *element = data_json->child;
     while (element) {
         node = build_container_node(schema, element, parent);
+        CHECK_DO_RTN_VAL(!node, mdd_free_data(first), NULL);
+        CHECK_DO_RTN_VAL(check_list_key(node) || index_entry(parent, node), LOG_WARN("Failed to index %s", schema->name);
+                mdd_free_data(node);mdd_free_data(first), NULL);
         if (!first) {
             first = node;
         }
@@ -115,25 +558,39 @@ static struct mdd_node* build_list_node(struct mds_node *schema, cJSON *data_jso
     return first;
 }
 
+/* numbers with a fraction or an exponent are truncated, out of range ones saturate */
+static long long double_to_intv(double val)
+{
+    CHECK_RTN_VAL(val >= 9223372036854775807.0, LLONG_MAX);
+    CHECK_RTN_VAL(val <= -9223372036854775808.0, LLONG_MIN);
+    return (long long) val;
+}
+
 static struct mdd_node* build_leaf_node(struct mds_node *schema, cJSON *data_json, struct mdd_node *parent)
 {
     LOG_INFO("mdd--try build leaf: %s-%s", schema->name, data_json->string);
     struct mds_leaf *leaf_schema = (struct mds_leaf*) schema;
-    struct mdd_leaf *leaf = (struct mdd_leaf*) calloc(1, sizeof(struct mdd_leaf));
-    CHECK_DO_RTN_VAL(!leaf, LOG_WARN("no memory!"), NULL);
+    struct mdd_node *node = parent ? mdd_new_child(parent, schema) : mdd_new_node(schema);
+    CHECK_RTN_VAL(!node, NULL);
 
-    leaf->schema = schema;
+    struct mdd_leaf *leaf = (struct mdd_leaf*) node;
     leaf->parent = parent;
     if (leaf_schema->dtype == MDS_DT_STR) {
         LOG_DEBUG("mdd--try build str leaf: %s-%s", schema->name, data_json->valuestring);
-        CHECK_DO_RTN_VAL(!cJSON_IsString(data_json), LOG_WARN("mdd--data is not string");free(leaf), NULL);
-        leaf->value.strv = strdup(data_json->valuestring);
+        CHECK_DO_RTN_VAL(!cJSON_IsString(data_json), LOG_WARN("mdd--data is not string");mdd_free_data(node), NULL);
+        CHECK_DO_RTN_VAL(mdd_leaf_set_str(leaf, data_json->valuestring, strlen(data_json->valuestring)),
+                mdd_free_data(node), NULL);
+    } else if (leaf_schema->dtype == MDS_DT_ENUM) {
+        CHECK_DO_RTN_VAL(!cJSON_IsString(data_json), LOG_WARN("mdd--data is not string");mdd_free_data(node), NULL);
+        leaf->value.intv = mds_enum_code(schema, data_json->valuestring, strlen(data_json->valuestring));
+        CHECK_DO_RTN_VAL(leaf->value.intv < 0, LOG_WARN("mdd--invalid %s value %s", schema->name,
+                data_json->valuestring);mdd_free_data(node), NULL);
     } else {
         LOG_DEBUG("mdd--try build int leaf: %s-%d", schema->name, data_json->valueint);
-        CHECK_DO_RTN_VAL(!cJSON_IsNumber(data_json), LOG_WARN("mdd--data is not number");free(leaf), NULL);
-        leaf->value.intv = data_json->valueint;
+        CHECK_DO_RTN_VAL(!cJSON_IsNumber(data_json), LOG_WARN("mdd--data is not number");mdd_free_data(node), NULL);
+        leaf->value.intv = double_to_intv(data_json->valuedouble);
     }
-    return leaf;
+    return node;
 }
 
 static struct mdd_node* build_mdd_node(struct mds_node *schema, cJSON *data_json, struct mdd_node *parent)
@@ -158,70 +615,287 @@ struct mdd_node* mdd_parse_json(struct mds_node *schema, const cJSON *data_root)
     return build_container_node(schema, data_root->child, NULL);
 }
 
-struct mdd_node* mdd_parse_data(struct mds_node *schema, const char *data_json)
+/* second pass of the bulk reader, the structural offsets are walked as tokens along the schema */
+struct scan_ctx{
+    const char *json;
+    size_t len;
+    const uint32_t *pos;
+    size_t cnt;
+    size_t i;
+};
+
+static int scan_child(struct scan_ctx *ctx, struct mds_node *schema, struct mdd_node *mo, struct mdd_node **prev);
+
+static char scan_peek(const struct scan_ctx *ctx)
+{
+    return ctx->i < ctx->cnt ? ctx->json[ctx->pos[ctx->i]] : '\0';
+}
+
+static int scan_expect(struct scan_ctx *ctx, char c)
 {
-    const char *end = NULL;
-    struct mdd_node *data_root = NULL;
-    cJSON *json_root = cJSON_ParseWithOpts(data_json, &end, cJSON_True);
-    CHECK_DO_RTN_VAL(!json_root, LOG_WARN("Failed to parse json %s, error occured at %s", data_json, end), NULL);
+    CHECK_RTN_VAL(scan_peek(ctx) != c, -1);
+    ctx->i++;
+    return 0;
+}
 
-    data_root = mdd_parse_json(schema, json_root);
+/* a string is its two quotes in the index, body is the raw text between them */
+static int scan_string(struct scan_ctx *ctx, const char **body, size_t *len)
+{
+    CHECK_RTN_VAL(scan_peek(ctx) != '"' || ctx->i + 1 >= ctx->cnt, -1);
+    *body = ctx->json + ctx->pos[ctx->i] + 1;
+    *len = ctx->pos[ctx->i + 1] - ctx->pos[ctx->i] - 1;
+    ctx->i += 2;
+    return 0;
+}
 
-    cJSON_Delete(json_root);
-    return data_root;
+static char* scan_strdup(const char *body, size_t len)
+{
+    CHECK_RTN_VAL(!memchr(body, '\\', len), strndup(body, len));
+
+    char *str = malloc(len + 1);
+    CHECK_DO_RTN_VAL(!str, LOG_WARN("no memory!"), NULL);
+    long out = json_unescape(str, body, len);
+    CHECK_DO_RTN_VAL(out < 0, LOG_WARN("Invalid escape in %.*s", (int ) len, body);free(str), NULL);
+    str[out] = '\0';
+    return str;
 }
 
-static void split_mo_key_value(char *fragment, char **mo, char **key, char **value)
+static struct mds_node* scan_child_schema(struct mds_node *schema, const char *key, size_t len)
 {
-    *mo = fragment;
-    *key = NULL;
-    *value = NULL;
+    char *name = NULL;
+    if (memchr(key, '\\', len)) {
+        name = scan_strdup(key, len);
+        CHECK_RTN_VAL(!name, NULL);
+        key = name;
+        len = strlen(name);
+    }
 
-    char *tmp = fragment;
-    int len = strlen(fragment);
-    for (int i = 0; i < len; i++) {
-        if (*tmp == '[') {
-            *tmp = '\0';
-            *key = tmp + 1;
-        } else if (*tmp == '=') {
-            *tmp = '\0';
-            *value = tmp + 1;
-        } else if (*tmp == ']') {
-            *tmp = '\0';
-        }
-        tmp++;
+    struct mds_node *child = schema->child;
+    while (child && (strncmp(child->name, key, len) || child->name[len] != '\0')) {
+        child = child->next;
     }
+    free(name);
+    return child;
 }
 
-static char* next_word(char **path_head)
+/* json number grammar, integers are read exactly and the rest through strtod */
+static int scan_number(const char *num, size_t len, long long *val)
 {
-    int len = strlen(*path_head);
-    char *word = *path_head;
-    char *tail = *path_head;
-    for (int i = 0; i < len; i++) {
-        if (*tail == '/') {
-            *tail = '\0';
-            *path_head = tail + 1;
-            return word;
+    size_t i = num[0] == '-';
+    CHECK_RTN_VAL(i >= len || num[i] < '0' || num[i] > '9', -1);
+    CHECK_RTN_VAL(num[i] == '0' && i + 1 < len && num[i + 1] >= '0' && num[i + 1] <= '9', -1);
+
+    /* integers beyond the long long range saturate, as double_to_intv does */
+    int neg = num[0] == '-';
+    unsigned long long limit = neg ? (unsigned long long) LLONG_MAX + 1 : (unsigned long long) LLONG_MAX;
+    unsigned long long mag = 0;
+    int overflow = 0;
+    for (; i < len && num[i] >= '0' && num[i] <= '9'; i++) {
+        overflow |= __builtin_mul_overflow(mag, 10, &mag) || __builtin_add_overflow(mag, num[i] - '0', &mag);
+    }
+    if (i == len) {
+        mag = overflow || mag > limit ? limit : mag;
+        *val = !neg ? (long long) mag : mag == limit ? LLONG_MIN : -(long long) mag;
+        return 0;
+    }
+
+    if (i < len && num[i] == '.') {
+        CHECK_RTN_VAL(++i >= len || num[i] < '0' || num[i] > '9', -1);
+        for (; i < len && num[i] >= '0' && num[i] <= '9'; i++) {
         }
-        tail++;
     }
-    *path_head = tail;
-    return word;
+    if (i < len && (num[i] == 'e' || num[i] == 'E')) {
+        i++;
+        i += i < len && (num[i] == '+' || num[i] == '-');
+        CHECK_RTN_VAL(i >= len || num[i] < '0' || num[i] > '9', -1);
+        for (; i < len && num[i] >= '0' && num[i] <= '9'; i++) {
+        }
+    }
+    CHECK_RTN_VAL(i != len, -1);
+
+    /* the byte after a number is a delimiter, so strtod stops where the grammar did */
+    *val = double_to_intv(strtod(num, NULL));
+    return 0;
 }
 
-static int next_fragment(char **path_head, char **mo, char **key, char **value)
+static int scan_enum(struct scan_ctx *ctx, struct mdd_leaf *leaf)
 {
-    char *fragment = next_word(path_head);
-    if (!fragment || strlen(fragment) == 0) {
-        return 0;
+    const char *body = NULL;
+    size_t len = 0;
+    CHECK_DO_RTN_VAL(scan_string(ctx, &body, &len), LOG_WARN("mdd--data is not string"), -1);
+    if (!memchr(body, '\\', len)) {
+        leaf->value.intv = mds_enum_code(leaf->schema, body, len);
+    } else {
+        char *str = scan_strdup(body, len);
+        CHECK_RTN_VAL(!str, -1);
+        leaf->value.intv = mds_enum_code(leaf->schema, str, strlen(str));
+        free(str);
+    }
+    CHECK_DO_RTN_VAL(leaf->value.intv < 0, LOG_WARN("Invalid %s value %.*s", leaf->schema->name, (int ) len, body),
+            -1);
+    return 0;
+}
+
+static int scan_leaf(struct scan_ctx *ctx, struct mdd_leaf *leaf)
+{
+    if (is_str_leaf((struct mds_leaf* )(leaf->schema))) {
+        const char *body = NULL;
+        size_t len = 0;
+        CHECK_DO_RTN_VAL(scan_string(ctx, &body, &len), LOG_WARN("mdd--data is not string"), -1);
+        CHECK_RTN_VAL(!memchr(body, '\\', len), mdd_leaf_set_str(leaf, body, len));
+
+        char *str = scan_strdup(body, len);
+        CHECK_RTN_VAL(!str, -1);
+        int rt = mdd_leaf_set_str(leaf, str, strlen(str));
+        free(str);
+        return rt;
+    }
+    if (is_enum_leaf((struct mds_leaf* )(leaf->schema))) {
+        return scan_enum(ctx, leaf);
+    }
+
+    char c = scan_peek(ctx);
+    CHECK_DO_RTN_VAL(c != '-' && (c < '0' || c > '9'), LOG_WARN("mdd--data is not number"), -1);
+    const char *num = ctx->json + ctx->pos[ctx->i++];
+    size_t len = 0;
+    while (num + len < ctx->json + ctx->len && !strchr(" \t\n\r,:[]{}\"", num[len])) {
+        len++;
+    }
+    CHECK_DO_RTN_VAL(scan_number(num, len, &leaf->value.intv), LOG_WARN("Invalid number %.*s", (int ) len, num), -1);
+    return 0;
+}
+
+/* the members of an object as the children of mo, in document order */
+static int scan_mo_body(struct scan_ctx *ctx, struct mdd_node *mo)
+{
+    CHECK_DO_RTN_VAL(scan_expect(ctx, '{'), LOG_WARN("invalid container data"), -1);
+    CHECK_RTN_VAL(!scan_expect(ctx, '}'), 0);
+
+    struct mdd_node *prev = NULL;
+    do {
+        const char *key = NULL;
+        size_t len = 0;
+        CHECK_RTN_VAL(scan_string(ctx, &key, &len) || scan_expect(ctx, ':'), -1);
+
+        struct mds_node *schema = scan_child_schema(mo->schema, key, len);
+        CHECK_DO_RTN_VAL(!schema, LOG_WARN("invalid child data name %.*s under %s", (int ) len, key, mo->schema->name),
+                -1);
+        CHECK_RTN_VAL(scan_child(ctx, schema, mo, &prev), -1);
+    } while (!scan_expect(ctx, ','));
+    mdd_fit_slots(mo);
+    return scan_expect(ctx, '}');
+}
+
+/* list instances are linked once complete, so they enter the indexes with their keys */
+static int scan_list(struct scan_ctx *ctx, struct mds_node *schema, struct mdd_node *mo, struct mdd_node **prev)
+{
+    CHECK_DO_RTN_VAL(scan_expect(ctx, '['), LOG_WARN("invalid list data: %s", schema->name), -1);
+    CHECK_RTN_VAL(!scan_expect(ctx, ']'), 0);
+
+    do {
+        struct mdd_node *entry = mdd_new_node(schema);
+        CHECK_RTN_VAL(!entry, -1);
+        CHECK_DO_RTN_VAL(scan_mo_body(ctx, entry) || mdd_link_child(mo, *prev, entry), mdd_free_data(entry), -1);
+        *prev = entry;
+    } while (!scan_expect(ctx, ','));
+    return scan_expect(ctx, ']');
+}
+
+static int scan_child(struct scan_ctx *ctx, struct mds_node *schema, struct mdd_node *mo, struct mdd_node **prev)
+{
+    CHECK_RTN_VAL(is_list_node(schema), scan_list(ctx, schema, mo, prev));
+
+    struct mdd_node *node = mdd_new_child(mo, schema);
+    CHECK_RTN_VAL(!node, -1);
+    mdd_link_child(mo, *prev, node);
+    *prev = node;
+    return is_leaf_node(schema) ? scan_leaf(ctx, (struct mdd_leaf*) node) : scan_mo_body(ctx, node);
+}
+
+/* the object holds one member, the root container, whose name is not checked against the schema */
+struct mdd_node* mdd_parse_data(struct mds_node *schema, const char *data_json)
+{
+    CHECK_NULL_RTN2(schema, data_json, NULL);
+
+    struct json_index index;
+    size_t len = strlen(data_json);
+    CHECK_DO_RTN_VAL(json_index_build(&index, data_json, len, JSON_KERNEL_AUTO), LOG_WARN("Failed to index json"),
+            NULL);
+
+    struct scan_ctx ctx = {data_json, len, index.pos, index.cnt, 0};
+    struct mdd_node *root = mdd_new_node(schema);
+    const char *key = NULL;
+    size_t key_len = 0;
+    int rt = !root || scan_expect(&ctx, '{') || scan_string(&ctx, &key, &key_len) || scan_expect(&ctx, ':');
+    rt = rt || scan_mo_body(&ctx, root) || scan_expect(&ctx, '}') || ctx.i != ctx.cnt;
+    if (rt) {
+        size_t at = ctx.i < ctx.cnt ? ctx.pos[ctx.i] : len;
+        LOG_WARN("Failed to parse json, error occured at %zu: %.32s", at, data_json + at);
+        mdd_free_data(root);
+        root = NULL;
+    }
+    json_index_free(&index);
+    return root;
+}
+
+/* one path fragment `name` or `name[key=value]` viewed in place, the value is parsed once */
+struct path_frag{
+    const char *name;
+    size_t name_len;
+    const char *key;
+    size_t key_len;
+    const char *value;
+    size_t value_len;
+    long long intv;
+    int is_int;
+};
+
+static int parse_frag_pred(const char *pred, size_t len, struct path_frag *frag)
+{
+    const char *eq = memchr(pred, '=', len);
+    CHECK_DO_RTN_VAL(!eq || pred[len - 1] != ']', LOG_WARN("Invalid predicate %.*s", (int ) len, pred), -1);
+
+    frag->key = pred;
+    frag->key_len = eq - pred;
+    frag->value = eq + 1;
+    frag->value_len = pred + len - 1 - frag->value;
+
+    /* strtoll stops at the closing ']' at the latest */
+    char *end = NULL;
+    frag->intv = strtoll(frag->value, &end, 10);
+    frag->is_int = frag->value_len && end == frag->value + frag->value_len;
+    return 0;
+}
+
+/* returns 1 with the next fragment, 0 at the end of the path and -1 on a malformed fragment */
+static int next_frag(const char **cursor, struct path_frag *frag)
+{
+    const char *head = *cursor;
+    while (*head == '/') {
+        head++;
     }
+    CHECK_RTN_VAL(!*head, 0);
+
+    size_t len = strcspn(head, "/");
+    *cursor = head + len;
 
-    split_mo_key_value(fragment, mo, key, value);
+    memset(frag, 0, sizeof(struct path_frag));
+    frag->name = head;
+    const char *pred = memchr(head, '[', len);
+    frag->name_len = pred ? (size_t) (pred - head) : len;
+    if (pred) {
+        CHECK_RTN_VAL(parse_frag_pred(pred + 1, len - frag->name_len - 1, frag), -1);
+    }
     return 1;
 }
 
-static int match_node_value(struct mdd_node *node, char *value)
+/* strncmp stops at the end of a shorter name, so it never reads past it */
+static int match_name(const char *name, const char *frag, size_t len)
+{
+    return !strncmp(name, frag, len) && name[len] == '\0';
+}
+
+static int match_node_value(struct mdd_node *node, const struct path_frag *frag)
 {
     CHECK_RTN_VAL(node->schema->mtype != MDS_MT_LEAF, 0);
 
@@ -229,22 +903,22 @@ static int match_node_value(struct mdd_node *node, char *value)
     struct mdd_leaf *leaf = (struct mdd_leaf*) node;
 
     if (schema->dtype == MDS_DT_STR) {
-        return strcmp(leaf->value.strv, value) == 0 ? 1 : 0;
+        return match_name(str_leaf_val(leaf), frag->value, frag->value_len);
     } else if (schema->dtype == MDS_DT_INT) {
-        char *end;
-        return strtoll(value, &end, 10) == leaf->value.intv ? 1 : 0;
+        return frag->is_int && frag->intv == leaf->value.intv;
+    } else if (schema->dtype == MDS_DT_ENUM) {
+        return match_name(mds_enum_name(node->schema, leaf->value.intv), frag->value, frag->value_len);
     }
     return 0;
 }
 
-static int match_node(struct mdd_node *node, char *name, char *key, char *value)
+static int match_node(struct mdd_node *node, const struct path_frag *frag)
 {
-    int rlt = strcmp(node->schema->name, name);
-    CHECK_RTN_VAL(rlt, 0);
+    CHECK_RTN_VAL(!match_name(node->schema->name, frag->name, frag->name_len), 0);
 
-    if (key && value) {
+    if (frag->key) {
         for (struct mdd_node *iter = node->child; iter; iter = iter->next) {
-            if (!strcmp(iter->schema->name, key) && match_node_value(iter, value)) {
+            if (match_name(iter->schema->name, frag->key, frag->key_len) && match_node_value(iter, frag)) {
                 return 1;
             }
         }
@@ -253,56 +927,311 @@ static int match_node(struct mdd_node *node, char *name, char *key, char *value)
     return 1;
 }
 
-static struct mdd_node* find_child(struct mdd_node *cur, char *name, char *key, char *value)
+/* the slots sharing the hash of a fragment value, NULL if no instance can match */
+static const struct index_slot* leaf_chain(struct leaf_index *index, const struct path_frag *frag)
 {
-    for (struct mdd_node *iter = cur->child; iter; iter = iter->next) {
-        if (match_node(iter, name, key, value)) {
-            return iter;
-        }
+    if (is_str_leaf((struct mds_leaf* ) index->schema)) {
+        return hmap_get(&index->map, hash_str(frag->value, frag->value_len));
+    } else if (is_enum_leaf((struct mds_leaf* ) index->schema)) {
+        long code = mds_enum_code(index->schema, frag->value, frag->value_len);
+        return code >= 0 ? hmap_get(&index->map, hash_int(code)) : NULL;
     }
-    return NULL;
+    return frag->is_int ? hmap_get(&index->map, hash_int(frag->intv)) : NULL;
 }
 
-struct mdd_node* mdd_get_data(struct mdd_node *root, const char *path)
+static struct mdd_node* find_leaf_value(struct leaf_index *index, const struct path_frag *frag)
 {
-    int rlt = 0, has_next = 0;
-    struct mdd_node *out = NULL;
-    char *dup_path = strdup(path);
-    CHECK_DO_RTN_VAL(!dup_path, LOG_WARN("Failed to dup string"), NULL);
-
-    struct mdd_node *target = NULL;
-    char *name = NULL;
-    char *key = NULL;
-    char *value = NULL;
-    char *tmp = dup_path;
-    has_next = next_fragment(&tmp, &name, &key, &value);
-    CHECK_DO_GOTO(!has_next, LOG_WARN("Failed to parse first fragment:%s", dup_path); rlt = -1, CLEAN);
-
-    target = root;
-    CHECK_DO_GOTO(!match_node(target, name, key, value),
-            LOG_WARN("Failed to match root mo:%s-%s", name, target->schema->name); rlt = -1, CLEAN);
-    do {
-        has_next = next_fragment(&tmp, &name, &key, &value);
-        if (!has_next) {
-            out = target;
-            goto CLEAN;
+    const struct index_slot *tail = leaf_chain(index, frag);
+    for (const struct index_slot *slot = tail ? tail->next : NULL; slot; slot = slot == tail ? NULL : slot->next) {
+        struct mdd_node *leaf = find_child_node(slot->entry, index->schema);
+        if (leaf && match_node_value(leaf, frag)) {
+            return slot->entry;
         }
-        target = find_child(target, name, key, value);
-    } while (target);
-    rlt = -1;
-
-CLEAN:
-    if (dup_path) {
-        free(dup_path);
     }
-    return out;
+    return NULL;
 }
 
-static int dump_write_str(char **buf, size_t *size, size_t *posi, const char *str)
+/* returns 1 if a predicate on a key or indexed leaf was answered by an index */
+static int find_indexed_child(struct mdd_node *cur, const struct path_frag *frag, struct mdd_node **out)
 {
-    size_t write_len = strlen(str);
-    size_t need_len = *posi + write_len + 1;
-    if (need_len > *size) {
+    CHECK_RTN_VAL(!frag->key || !is_mo(cur->schema->mtype), 0);
+
+    for (struct mdd_index *index = ((struct mdd_mo*) cur)->index; index; index = index->next) {
+        if (!match_name(index->schema->name, frag->name, frag->name_len)) {
+            continue;
+        }
+        if (is_ordered_list(index->schema) && match_name("Id", frag->key, frag->key_len)) {
+            *out = frag->is_int ? btree_get(&index->tree, frag->intv) : NULL;
+            return 1;
+        }
+        for (unsigned int i = 0; i < index->nleaf; i++) {
+            if (match_name(index->leafs[i].schema->name, frag->key, frag->key_len)) {
+                *out = find_leaf_value(&index->leafs[i], frag);
+                return 1;
+            }
+        }
+        return 0;
+    }
+    return 0;
+}
+
+static struct mdd_node* find_child(struct mdd_node *cur, const struct path_frag *frag)
+{
+    struct mdd_node *found = NULL;
+    CHECK_RTN_VAL(find_indexed_child(cur, frag, &found), found);
+
+    for (struct mdd_node *iter = cur->child; iter; iter = iter->next) {
+        if (match_node(iter, frag)) {
+            return iter;
+        }
+    }
+    return NULL;
+}
+
+/* instances of lists under parent whose indexed leaf equals value, -1 if the leaf has no index */
+int mdd_index_seek(struct mdd_node *parent, struct mds_node *lists, const char *leaf, const char *value,
+        struct mdd_index_cursor *cursor)
+{
+    CHECK_DO_RTN_VAL(!parent || !lists || !leaf || !value || !cursor, LOG_WARN("NULL Para"), -1);
+    CHECK_RTN_VAL(lists->parent != parent->schema, -1);
+
+    struct mds_node *schema = mds_find_child_schema(lists, leaf);
+    CHECK_RTN_VAL(!schema || !is_indexed_leaf((struct mds_leaf* ) schema), -1);
+
+    struct path_frag frag;
+    memset(&frag, 0, sizeof(struct path_frag));
+    frag.value = value;
+    frag.value_len = strlen(value);
+    char *end = NULL;
+    frag.intv = strtoll(value, &end, 10);
+    frag.is_int = frag.value_len && !*end;
+
+    struct leaf_index *index = get_leaf_index(get_index(parent, lists, 0), schema);
+    cursor->tail = index ? leaf_chain(index, &frag) : NULL;
+    cursor->slot = cursor->tail ? cursor->tail->next : NULL;
+    cursor->leaf = schema;
+    cursor->value = value;
+    cursor->value_len = frag.value_len;
+    cursor->intv = frag.intv;
+    cursor->is_int = frag.is_int;
+    return 0;
+}
+
+struct mdd_node* mdd_index_next(struct mdd_index_cursor *cursor)
+{
+    CHECK_RTN_VAL(!cursor, NULL);
+
+    struct path_frag frag;
+    memset(&frag, 0, sizeof(struct path_frag));
+    frag.value = cursor->value;
+    frag.value_len = cursor->value_len;
+    frag.intv = cursor->intv;
+    frag.is_int = cursor->is_int;
+
+    while (cursor->slot) {
+        const struct index_slot *slot = cursor->slot;
+        cursor->slot = slot == cursor->tail ? NULL : slot->next;
+
+        struct mdd_node *leaf = find_child_node(slot->entry, cursor->leaf);
+        if (leaf && match_node_value(leaf, &frag)) {
+            return slot->entry;
+        }
+    }
+    return NULL;
+}
+
+/* evaluates the path in place, nothing is allocated */
+struct mdd_node* mdd_get_data(struct mdd_node *root, const char *path)
+{
+    CHECK_NULL_RTN2(root, path, NULL);
+
+    struct path_frag frag;
+    const char *cursor = path;
+    int has_next = next_frag(&cursor, &frag);
+    CHECK_DO_RTN_VAL(has_next <= 0, LOG_WARN("Failed to parse first fragment:%s", path), NULL);
+    CHECK_DO_RTN_VAL(!match_node(root, &frag),
+            LOG_WARN("Failed to match root mo:%.*s-%s", (int ) frag.name_len, frag.name, root->schema->name), NULL);
+
+    struct mdd_node *target = root;
+    while (target && (has_next = next_frag(&cursor, &frag)) > 0) {
+        target = find_child(target, &frag);
+    }
+    return has_next < 0 ? NULL : target;
+}
+
+#define TRIE_BLOCK 4096
+#define TRIE_INDEX_MIN 8
+#define TRIE_NO_PATH ((size_t) -1)
+
+/* requested paths merged by fragment, each trie node is resolved against the data tree once */
+struct path_trie{
+    struct path_frag frag;
+    size_t frag_len;
+    struct path_trie *child;
+    struct path_trie *next;
+    struct path_trie *same_key;
+    size_t nchild;
+    size_t first_path;
+    int resolved;
+};
+
+struct trie_ctx{
+    struct mdd_arena arena;
+    size_t *next_path;
+    struct mdd_node **out;
+    size_t found;
+};
+
+static struct path_trie* new_trie_node(struct trie_ctx *ctx, const struct path_frag *frag, size_t frag_len)
+{
+    struct path_trie *node = arena_alloc(&ctx->arena, sizeof(struct path_trie));
+    CHECK_DO_RTN_VAL(!node, LOG_WARN("No memory"), NULL);
+
+    memset(node, 0, sizeof(struct path_trie));
+    if (frag) {
+        node->frag = *frag;
+    }
+    node->frag_len = frag_len;
+    node->first_path = TRIE_NO_PATH;
+    return node;
+}
+
+static struct path_trie* trie_child(struct trie_ctx *ctx, struct path_trie *parent, const struct path_frag *frag,
+        size_t frag_len)
+{
+    for (struct path_trie *iter = parent->child; iter; iter = iter->next) {
+        if (iter->frag_len == frag_len && !memcmp(iter->frag.name, frag->name, frag_len)) {
+            return iter;
+        }
+    }
+
+    struct path_trie *node = new_trie_node(ctx, frag, frag_len);
+    CHECK_RTN_VAL(!node, NULL);
+
+    node->next = parent->child;
+    parent->child = node;
+    parent->nchild++;
+    return node;
+}
+
+static int trie_add_path(struct trie_ctx *ctx, struct path_trie *root, const char *path, size_t idx)
+{
+    struct path_frag frag;
+    const char *cursor = path;
+    struct path_trie *node = root;
+    int has_next = 0;
+    while ((has_next = next_frag(&cursor, &frag)) > 0) {
+        node = trie_child(ctx, node, &frag, cursor - frag.name);
+        CHECK_RTN_VAL(!node, -1);
+    }
+    CHECK_DO_RTN_VAL(has_next < 0 || node == root, LOG_WARN("Invalid path:%s", path), -1);
+
+    ctx->next_path[idx] = node->first_path;
+    node->first_path = idx;
+    return 0;
+}
+
+static void resolve_trie(struct trie_ctx *ctx, struct path_trie *trie, struct mdd_node *data);
+
+static void resolve_trie_child(struct trie_ctx *ctx, struct path_trie *child, struct mdd_node *data)
+{
+    struct mdd_node *target = find_child(data, &child->frag);
+    if (target) {
+        resolve_trie(ctx, child, target);
+    }
+}
+
+static int is_key_indexable(const struct path_frag *frag)
+{
+    return frag->key && frag->is_int && frag->intv >= 0 && frag->intv <= INT_MAX && match_name("Id", frag->key,
+            frag->key_len);
+}
+
+/* many siblings under one mo, resolve the list key predicates in one pass over its children */
+static void resolve_trie_indexed(struct trie_ctx *ctx, struct path_trie *trie, struct mdd_node *data)
+{
+    struct mdd_hmap index;
+    int no_index = hmap_init(&index, trie->nchild);
+    for (struct path_trie *child = trie->child; child; child = child->next) {
+        if (no_index || !is_key_indexable(&child->frag)) {
+            resolve_trie_child(ctx, child, data);
+            continue;
+        }
+        uintptr_t slot = list_key_slot((int) child->frag.intv);
+        child->same_key = hmap_get(&index, slot);
+        if (hmap_put(&index, slot, child)) {
+            resolve_trie_child(ctx, child, data);
+        }
+    }
+
+    for (struct mdd_node *iter = data->child; iter && !no_index; iter = iter->next) {
+        int key = is_list_node(iter->schema) ? get_list_key(iter, "Id") : -1;
+        struct path_trie *child = key < 0 ? NULL : hmap_get(&index, list_key_slot(key));
+        for (; child; child = child->same_key) {
+            if (!child->resolved && match_node(iter, &child->frag)) {
+                resolve_trie(ctx, child, iter);
+            }
+        }
+    }
+    hmap_free(&index);
+}
+
+static void resolve_trie(struct trie_ctx *ctx, struct path_trie *trie, struct mdd_node *data)
+{
+    trie->resolved = 1;
+    for (size_t idx = trie->first_path; idx != TRIE_NO_PATH; idx = ctx->next_path[idx]) {
+        ctx->out[idx] = data;
+        ctx->found++;
+    }
+
+    if (trie->nchild >= TRIE_INDEX_MIN) {
+        resolve_trie_indexed(ctx, trie, data);
+        return;
+    }
+    for (struct path_trie *child = trie->child; child; child = child->next) {
+        resolve_trie_child(ctx, child, data);
+    }
+}
+
+/*
+ * Resolves n paths in one walk, shared prefixes are visited once. Unresolved paths get NULL.
+ * Returns the number of resolved paths or -1 on a malformed path.
+ */
+int mdd_get_many(struct mdd_node *root, const char **paths, size_t n, struct mdd_node **out)
+{
+    CHECK_DO_RTN_VAL(!root || !paths || !out, LOG_WARN("Null arg"), -1);
+    CHECK_RTN_VAL(!n, 0);
+
+    struct trie_ctx ctx;
+    memset(&ctx, 0, sizeof(struct trie_ctx));
+    arena_init(&ctx.arena, TRIE_BLOCK);
+    ctx.out = out;
+    ctx.next_path = arena_alloc(&ctx.arena, n * sizeof(size_t));
+    struct path_trie *trie = new_trie_node(&ctx, NULL, 0);
+    CHECK_DO_GOTO(!ctx.next_path || !trie, LOG_WARN("No memory"), EXCEPTION);
+
+    for (size_t i = 0; i < n; i++) {
+        out[i] = NULL;
+        CHECK_GOTO(!paths[i] || trie_add_path(&ctx, trie, paths[i], i), EXCEPTION);
+    }
+
+    for (struct path_trie *child = trie->child; child; child = child->next) {
+        if (match_node(root, &child->frag)) {
+            resolve_trie(&ctx, child, root);
+        }
+    }
+    arena_free(&ctx.arena);
+    return ctx.found;
+
+EXCEPTION:
+    arena_free(&ctx.arena);
+    return -1;
+}
+
+static int dump_write_mem(char **buf, size_t *size, size_t *posi, const char *str, size_t write_len)
+{
+    size_t need_len = *posi + write_len + 1;
+    if (need_len > *size) {
         size_t new_size = (*size) * 2;
         new_size = new_size > need_len ? new_size : need_len;
         char *new_buf = realloc(*buf, new_size);
@@ -312,11 +1241,192 @@ static int dump_write_str(char **buf, size_t *size, size_t *posi, const char *st
         *size = new_size;
     }
 
-    strcat(*buf + *posi, str);
+    memcpy(*buf + *posi, str, write_len);
     *posi = *posi + write_len;
+    (*buf)[*posi] = '\0';
+    return 0;
+}
+
+static int dump_write_str(char **buf, size_t *size, size_t *posi, const char *str)
+{
+    return dump_write_mem(buf, size, posi, str, strlen(str));
+}
+
+/* writes str quoted, clean runs go out in bulk between the bytes that need an escape */
+static int dump_write_json_str(char **buf, size_t *size, size_t *posi, const char *str)
+{
+    static const char HEX[] = "0123456789abcdef";
+    CHECK_RTN_VAL(dump_write_mem(buf, size, posi, "\"", 1), -1);
+
+    size_t len = strlen(str);
+    while (len) {
+        size_t span = json_escape_span(str, len);
+        CHECK_RTN_VAL(dump_write_mem(buf, size, posi, str, span), -1);
+        CHECK_RTN_VAL(span == len, dump_write_mem(buf, size, posi, "\"", 1));
+
+        char esc[6] = {'\\', 0, '0', '0', 0, 0};
+        size_t esc_len = 2;
+        unsigned char c = (unsigned char) str[span];
+        switch (c) {
+            case '"':
+            case '\\':
+                esc[1] = (char) c;
+            break;
+            case '\b':
+                esc[1] = 'b';
+            break;
+            case '\f':
+                esc[1] = 'f';
+            break;
+            case '\n':
+                esc[1] = 'n';
+            break;
+            case '\r':
+                esc[1] = 'r';
+            break;
+            case '\t':
+                esc[1] = 't';
+            break;
+            default:
+                esc[1] = 'u';
+                esc[4] = HEX[c >> 4];
+                esc[5] = HEX[c & 0xf];
+                esc_len = 6;
+            break;
+        }
+        CHECK_RTN_VAL(dump_write_mem(buf, size, posi, esc, esc_len), -1);
+        str += span + 1;
+        len -= span + 1;
+    }
+    return dump_write_mem(buf, size, posi, "\"", 1);
+}
+
+/* bodies above FRAG_MAX stay uncached and are rebuilt from the fragments of their children */
+#define FRAG_MAX 4096
+
+struct mdd_frag{
+    size_t len;
+    char data[];
+};
+
+int mdd_frag_init(struct mdd_frag_cache *cache)
+{
+    CHECK_NULL_RTN(cache, -1);
+
+    memset(cache, 0, sizeof(struct mdd_frag_cache));
+    CHECK_RTN_VAL(hmap_init(&cache->frags, 0), -1);
+    CHECK_DO_RTN_VAL(pthread_mutex_init(&cache->lock, NULL), hmap_free(&cache->frags), -1);
+    return 0;
+}
+
+static void drop_frag(struct mdd_frag_cache *cache, struct mdd_node *node)
+{
+    struct mdd_frag *frag = hmap_del(&cache->frags, (uintptr_t) node);
+    if (frag) {
+        cache->bytes -= sizeof(struct mdd_frag) + frag->len;
+        free(frag);
+    }
+}
+
+void mdd_frag_clear(struct mdd_frag_cache *cache)
+{
+    CHECK_RTN(!cache || !cache->frags.size);
+
+    for (size_t i = 0; i < cache->frags.capacity; i++) {
+        if (cache->frags.keys[i]) {
+            free(cache->frags.vals[i]);
+        }
+    }
+    hmap_clear(&cache->frags);
+    cache->bytes = 0;
+}
+
+void mdd_frag_free(struct mdd_frag_cache *cache)
+{
+    CHECK_NULL(cache);
+
+    mdd_frag_clear(cache);
+    hmap_free(&cache->frags);
+    pthread_mutex_destroy(&cache->lock);
+}
+
+/* moves the fragments to the copies made by mdd_compact_tree, dropping those of mos not copied */
+void mdd_frag_relocate(struct mdd_frag_cache *cache, const struct mdd_hmap *moved)
+{
+    CHECK_RTN(!cache || !cache->frags.size);
+
+    struct mdd_hmap frags;
+    if (hmap_init(&frags, cache->frags.size)) {
+        mdd_frag_clear(cache);
+        return;
+    }
+    for (size_t i = 0; i < cache->frags.capacity; i++) {
+        struct mdd_frag *frag = cache->frags.keys[i] ? cache->frags.vals[i] : NULL;
+        void *copy = frag ? hmap_get(moved, cache->frags.keys[i]) : NULL;
+        if (frag && (!copy || hmap_put(&frags, (uintptr_t) copy, frag))) {
+            cache->bytes -= sizeof(struct mdd_frag) + frag->len;
+            free(frag);
+        }
+    }
+    hmap_free(&cache->frags);
+    cache->frags = frags;
+}
+
+/* bytes held by the fragments in the cache */
+size_t mdd_frag_bytes(const struct mdd_frag_cache *cache)
+{
+    return cache ? cache->bytes : 0;
+}
+
+static int has_cached_ancestor(struct mdd_frag_cache *cache, struct mdd_node *node)
+{
+    for (node = node->parent; node; node = node->parent) {
+        CHECK_RTN_VAL(hmap_get(&cache->frags, (uintptr_t) node), 1);
+    }
     return 0;
 }
 
+static void cache_frag(struct mdd_frag_cache *cache, struct mdd_node *mo, const char *data, size_t len)
+{
+    CHECK_RTN(len > FRAG_MAX || has_cached_ancestor(cache, mo));
+
+    struct mdd_frag *frag = malloc(sizeof(struct mdd_frag) + len);
+    CHECK_RTN(!frag);
+
+    frag->len = len;
+    memcpy(frag->data, data, len);
+    drop_frag(cache, mo);
+    CHECK_DO_RTN(hmap_put(&cache->frags, (uintptr_t) mo, frag), free(frag));
+    cache->bytes += sizeof(struct mdd_frag) + len;
+
+    for (struct mdd_node *child = mo->child; child && cache->frags.size > 1; child = child->next) {
+        if (is_mo(child->schema->mtype)) {
+            drop_frag(cache, child);
+        }
+    }
+}
+
+/* an edit below node changes the bodies of node and of every mo above it */
+static void drop_frags(struct mdd_frag_cache *cache, struct mdd_node *node)
+{
+    CHECK_RTN(!cache || !cache->frags.size);
+
+    for (; node; node = node->parent) {
+        drop_frag(cache, node);
+    }
+}
+
+/* node and every mo below it are about to be freed, their addresses must not find a body again */
+static void drop_subtree_frags(struct mdd_frag_cache *cache, struct mdd_node *node)
+{
+    CHECK_RTN(!cache || !cache->frags.size || !is_mo(node->schema->mtype));
+
+    drop_frag(cache, node);
+    for (struct mdd_node *child = node->child; child; child = child->next) {
+        drop_subtree_frags(cache, child);
+    }
+}
+
 static int dump_node_name(const char *name, char **buf, size_t *size, size_t *posi)
 {
     int rlt = dump_write_str(buf, size, posi, "\"");
@@ -331,8 +1441,13 @@ static int dump_node_name(const char *name, char **buf, size_t *size, size_t *po
     return 0;
 }
 
-static int dump_container_body(struct mdd_node *node, char **buf, size_t *size, size_t *posi)
+static int dump_container_body(struct mdd_node *node, struct mdd_frag_cache *frags, char **buf, size_t *size,
+        size_t *posi)
 {
+    struct mdd_frag *frag = frags ? hmap_get(&frags->frags, (uintptr_t) node) : NULL;
+    CHECK_RTN_VAL(frag, dump_write_mem(buf, size, posi, frag->data, frag->len));
+
+    size_t begin = *posi;
     int rlt = dump_write_str(buf, size, posi, "{");
     CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump '{'"), -1);
 
@@ -344,7 +1459,7 @@ static int dump_container_body(struct mdd_node *node, char **buf, size_t *size,
             CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump ','"), -1);
         }
 
-        rlt = dump_mdd_node(n, buf, size, posi, &next);
+        rlt = dump_mdd_node(n, frags, buf, size, posi, &next);
         CHECK_RTN_VAL(rlt, -1);
 
         n = next;
@@ -353,10 +1468,14 @@ static int dump_container_body(struct mdd_node *node, char **buf, size_t *size,
     rlt = dump_write_str(buf, size, posi, "}");
     CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump '}'"), -1);
 
+    if (frags) {
+        cache_frag(frags, node, *buf + begin, *posi - begin);
+    }
     return rlt;
 }
 
-static int dump_container_node(struct mdd_node *node, char **buf, size_t *size, size_t *posi, struct mdd_node **next)
+static int dump_container_node(struct mdd_node *node, struct mdd_frag_cache *frags, char **buf, size_t *size,
+        size_t *posi, struct mdd_node **next)
 {
     int rlt = dump_node_name(node->schema->name, buf, size, posi);
     CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump node name!"), -1);
@@ -364,7 +1483,7 @@ static int dump_container_node(struct mdd_node *node, char **buf, size_t *size,
     rlt = dump_write_str(buf, size, posi, ":");
     CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump ':'"), -1);
 
-    rlt = dump_container_body(node, buf, size, posi);
+    rlt = dump_container_body(node, frags, buf, size, posi);
     CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump container body"), -1);
 
     *next = node->next;
@@ -372,7 +1491,8 @@ static int dump_container_node(struct mdd_node *node, char **buf, size_t *size,
     return 0;
 }
 
-static int dump_list_node(struct mdd_node *node, char **buf, size_t *size, size_t *posi, struct mdd_node **next)
+static int dump_list_node(struct mdd_node *node, struct mdd_frag_cache *frags, char **buf, size_t *size, size_t *posi,
+        struct mdd_node **next)
 {
     int rlt = dump_node_name(node->schema->name, buf, size, posi);
     CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump list name!"), -1);
@@ -387,7 +1507,7 @@ static int dump_list_node(struct mdd_node *node, char **buf, size_t *size, size_
             CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump ','"), -1);
         }
 
-        rlt = dump_container_body(n, buf, size, posi);
+        rlt = dump_container_body(n, frags, buf, size, posi);
         CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump list body"), -1);
 
         n = n->next;
@@ -400,23 +1520,17 @@ static int dump_list_node(struct mdd_node *node, char **buf, size_t *size, size_
     return rlt;
 }
 
-static int dump_leaf_node(struct mdd_leaf *leaf, char **buf, size_t *size, size_t *posi, struct mdd_node **next)
+static int dump_leaf_value(struct mdd_leaf *leaf, char **buf, size_t *size, size_t *posi)
 {
-    int rlt = dump_node_name(leaf->schema->name, buf, size, posi);
-    CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump leaf name!"), -1);
-
-    rlt = dump_write_str(buf, size, posi, ":");
-    CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump ':'"), -1);
-
+    int rlt = 0;
     if (is_str_leaf((struct mds_leaf* )(leaf->schema))) {
-        rlt = dump_write_str(buf, size, posi, "\"");
-        CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump '\"'"), -1);
-
-        rlt = dump_write_str(buf, size, posi, leaf->value.strv);
+        rlt = dump_write_json_str(buf, size, posi, str_leaf_val(leaf));
         CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump str value"), -1);
-
-        rlt = dump_write_str(buf, size, posi, "\"");
-        CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump '\"'"), -1);
+    } else if (is_enum_leaf((struct mds_leaf* )(leaf->schema))) {
+        const char *name = mds_enum_name(leaf->schema, leaf->value.intv);
+        CHECK_DO_RTN_VAL(!name, LOG_WARN("Invalid enum value %lld", leaf->value.intv), -1);
+        rlt = dump_write_json_str(buf, size, posi, name);
+        CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump enum value"), -1);
     } else if (is_int_leaf((struct mds_leaf* )(leaf->schema))) {
         char tmp[40];
         memset(tmp, 0, sizeof(tmp));
@@ -427,17 +1541,31 @@ static int dump_leaf_node(struct mdd_leaf *leaf, char **buf, size_t *size, size_
         LOG_WARN("Invalid leaf type");
         return -1;
     }
+    return 0;
+}
+
+static int dump_leaf_node(struct mdd_leaf *leaf, char **buf, size_t *size, size_t *posi, struct mdd_node **next)
+{
+    int rlt = dump_node_name(leaf->schema->name, buf, size, posi);
+    CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump leaf name!"), -1);
+
+    rlt = dump_write_str(buf, size, posi, ":");
+    CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump ':'"), -1);
+
+    rlt = dump_leaf_value(leaf, buf, size, posi);
+    CHECK_RTN_VAL(rlt, -1);
 
     *next = leaf->next;
     return 0;
 }
 
-static int dump_mdd_node(struct mdd_node *node, char **buf, size_t *size, size_t *posi, struct mdd_node **next)
+static int dump_mdd_node(struct mdd_node *node, struct mdd_frag_cache *frags, char **buf, size_t *size, size_t *posi,
+        struct mdd_node **next)
 {
     int rlt = 0;
     switch (node->schema->mtype) {
         case MDS_MT_CONTAINER:
-            rlt = dump_container_node(node, buf, size, posi, next);
+            rlt = dump_container_node(node, frags, buf, size, posi, next);
         break;
 
         case MDS_MT_LEAF:
@@ -445,7 +1573,7 @@ static int dump_mdd_node(struct mdd_node *node, char **buf, size_t *size, size_t
         break;
 
         case MDS_MT_LIST:
-            rlt = dump_list_node(node, buf, size, posi, next);
+            rlt = dump_list_node(node, frags, buf, size, posi, next);
         break;
 
         default:
@@ -456,7 +1584,7 @@ static int dump_mdd_node(struct mdd_node *node, char **buf, size_t *size, size_t
     return rlt;
 }
 
-int mdd_dump_data(struct mdd_node *root, char **json_str)
+static int dump_data(struct mdd_node *root, struct mdd_frag_cache *frags, char **json_str)
 {
     CHECK_DO_RTN_VAL(!root || !json_str, LOG_WARN("Null arg"), -1);
 
@@ -470,7 +1598,7 @@ int mdd_dump_data(struct mdd_node *root, char **json_str)
     int rlt = dump_write_str(&buf, &size, &posi, "{");
     CHECK_DO_GOTO(rlt, LOG_WARN("Failed to dump '{'"), CLEAN);
 
-    rlt = dump_mdd_node(cur, &buf, &size, &posi, &next);
+    rlt = dump_mdd_node(cur, frags, &buf, &size, &posi, &next);
     CHECK_DO_GOTO(rlt, LOG_WARN("Failed to dump data tree"), CLEAN);
 
     dump_write_str(&buf, &size, &posi, "}");
@@ -484,169 +1612,233 @@ CLEAN:
     return -1;
 }
 
-void mdd_free_diff(mdd_diff *diff)
+/* a mo dumps as its body object and a leaf as its value */
+static int dump_subtree(struct mdd_node *node, struct mdd_frag_cache *frags, char **json_str)
 {
-    CHECK_NULL(diff);
+    CHECK_DO_RTN_VAL(!node || !json_str, LOG_WARN("Null arg"), -1);
 
-    for (size_t i = 0; i < diff->size; i++) {
-        struct mdd_mo_diff *modiff = (struct mdd_mo_diff*) (diff->vec[i]);
-        vector_free(&modiff->diff_leafs);
-    }
+    size_t size = 1024;
+    size_t posi = 0;
+    char *buf = calloc(1, size);
+    CHECK_DO_RTN_VAL(!buf, LOG_WARN("No memory"), -1);
 
-    vector_free(diff);
-    free(diff);
+    int rlt = is_leaf_node(node->schema) ? dump_leaf_value((struct mdd_leaf*) node, &buf, &size, &posi) :
+            dump_container_body(node, frags, &buf, &size, &posi);
+    CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump %s", node->schema->name);free(buf), -1);
+
+    *json_str = buf;
+    return 0;
 }
 
-static int is_leaf_equal(struct mdd_leaf *leaf_run, struct mdd_leaf *leaf_edit)
+/* the plain dumps only read the tree */
+int mdd_dump_data(struct mdd_node *root, char **json_str)
 {
-    CHECK_NULL_RTN2(leaf_run, leaf_edit, 0);
+    return dump_data(root, NULL, json_str);
+}
 
-    if (is_int_leaf((struct mds_leaf* )(leaf_run->schema))) {
-        return leaf_run->value.intv == leaf_edit->value.intv;
-    } else if (is_str_leaf((struct mds_leaf* )(leaf_run->schema))) {
-        return !strcmp(leaf_run->value.strv, leaf_edit->value.strv);
-    } else {
-        LOG_WARN("leaf type no support yes");
-    }
-    return 0;
+int mdd_dump_subtree(struct mdd_node *node, char **json_str)
+{
+    return dump_subtree(node, NULL, json_str);
 }
 
-//TODO: maybe slow, sort mdd tree by schema will be better
-static struct mdd_node* find_child_node(struct mdd_node *mo, struct mds_node *child_schema)
+/* unchanged mos are copied from their fragments in the cache, the others are cached as they are dumped */
+int mdd_dump_data_cached(struct mdd_frag_cache *cache, struct mdd_node *root, char **json_str)
 {
-    struct mdd_node *child = mo->child;
-    while (child) {
-        if (child->schema == child_schema) {
-            return child;
-        }
+    CHECK_RTN_VAL(!cache, dump_data(root, NULL, json_str));
 
-        child = child->next;
-    }
-    return NULL;
+    pthread_mutex_lock(&cache->lock);
+    int rt = dump_data(root, cache, json_str);
+    pthread_mutex_unlock(&cache->lock);
+    return rt;
 }
 
-struct mdd_leaf_diff* build_leaf_diff(struct mdd_leaf *leaf_run, struct mdd_leaf *leaf_edit)
+int mdd_dump_subtree_cached(struct mdd_frag_cache *cache, struct mdd_node *node, char **json_str)
 {
-    struct mdd_leaf_diff *leafdiff = calloc(1, sizeof(struct mdd_leaf_diff));
-    CHECK_DO_RTN_VAL(!leafdiff, LOG_WARN("No memory"), NULL);
+    CHECK_RTN_VAL(!cache, dump_subtree(node, NULL, json_str));
 
-    leafdiff->edit_leaf = leaf_edit;
-    leafdiff->run_leaf = leaf_run;
-    return leafdiff;
+    pthread_mutex_lock(&cache->lock);
+    int rt = dump_subtree(node, cache, json_str);
+    pthread_mutex_unlock(&cache->lock);
+    return rt;
 }
 
-static struct mdd_mo_diff* init_mo_diff_modify(struct mdd_node *mo_run, struct mdd_node *mo_edit,
-        struct mdd_leaf_diff *leafdiff)
+#define DIFF_BLOCK 4096
+#define DIFF_INIT_CAP 16
+
+static mdd_diff* new_diff()
 {
-    struct mdd_mo_diff *modiff = calloc(1, sizeof(struct mdd_mo_diff));
-    CHECK_DO_RTN_VAL(!modiff, LOG_WARN("No memory"), NULL);
+    struct mdd_arena arena;
+    arena_init(&arena, DIFF_BLOCK);
+    mdd_diff *diff = (mdd_diff*) arena_alloc(&arena, sizeof(mdd_diff));
+    CHECK_DO_RTN_VAL(!diff, LOG_WARN("No memory"), NULL);
 
-    modiff->type = DF_MODIFY;
-    modiff->run_data = mo_run;
-    modiff->edit_data = mo_edit;
-    int rt = vector_init(&modiff->diff_leafs, (void*) leafdiff);
-    if (rt) {
-        LOG_WARN("Init diff leaf vec failed");
-        free(modiff);
-        return NULL;
-    }
-    return modiff;
+    memset(diff, 0, sizeof(mdd_diff));
+    diff->arena = arena;
+    return diff;
 }
 
-static int compare_leaf(struct mds_leaf *leaf, struct mdd_node *mo_run, struct mdd_node *mo_edit,
-        struct mdd_mo_diff **modiff)
+void mdd_free_diff(mdd_diff *diff)
 {
-    int rt = -1;
-    struct mdd_leaf *leaf_run = (struct mdd_leaf*) find_child_node(mo_run, leaf);
-    struct mdd_leaf *leaf_edit = (struct mdd_leaf*) find_child_node(mo_edit, leaf);
-    CHECK_DO_RTN_VAL(!leaf_run && !leaf_edit, LOG_INFO("leaf %s not exit for both", leaf->name), 0);
+    CHECK_NULL(diff);
 
-    if (!is_leaf_equal(leaf_run, leaf_edit)) {
-        struct mdd_leaf_diff *leafdiff = build_leaf_diff(leaf_run, leaf_edit);
-        CHECK_DO_RTN_VAL(!leafdiff, LOG_WARN("No memory"), -1);
+    struct mdd_arena arena = diff->arena;
+    arena_free(&arena);
+}
 
-        if (*modiff == NULL) {
-            *modiff = init_mo_diff_modify(mo_run, mo_edit, leafdiff);
-            CHECK_DO_RTN_VAL(!modiff, LOG_WARN("Failed to init diff mo");free(leafdiff), -1);
-        } else {
-            rt = vector_add(&(*modiff)->diff_leafs, (void*) leafdiff);
-            CHECK_DO_RTN_VAL(!rt, LOG_WARN("Failed to add diff leaf");free(leafdiff), -1);
+static int add_mo_diff(mdd_diff *diff, struct mdd_mo_diff *modiff)
+{
+    if (diff->size == diff->capacity) {
+        size_t newcap = diff->capacity ? diff->capacity * 2 : DIFF_INIT_CAP;
+        struct mdd_mo_diff **vec = arena_alloc(&diff->arena, newcap * sizeof(struct mdd_mo_diff*));
+        CHECK_DO_RTN_VAL(!vec, LOG_WARN("No memory"), -1);
+
+        if (diff->size) {
+            memcpy(vec, diff->vec, diff->size * sizeof(struct mdd_mo_diff*));
         }
+        diff->vec = vec;
+        diff->capacity = newcap;
     }
+
+    diff->vec[diff->size] = modiff;
+    diff->size++;
     return 0;
 }
 
-static struct mdd_mo_diff* build_mo_diff_modify(struct mds_node *mos, struct mdd_node *mo_run, struct mdd_node *mo_edit)
+static size_t mo_diff_size(unsigned int nbits)
 {
-    struct mdd_mo_diff *modiff = NULL;
-    struct mds_node *child = mos->child;
-    while (child) {
-        if (is_leaf_node(child)) {
-            int rt = compare_leaf((struct mds_leaf*) child, mo_run, mo_edit, &modiff);
-            if (rt) {
-                if (modiff) {
-                    vector_free(&(modiff->diff_leafs));
-                    free(modiff);
-                }
-                return rt;
-            }
-        }
-        child = child->next;
-    }
-    return modiff;
+    return sizeof(struct mdd_mo_diff) + (nbits + 63) / 64 * sizeof(uint64_t);
 }
 
-static struct mdd_mo_diff* build_mo_diff_add(struct mdd_node *mo_edit)
+static struct mdd_mo_diff* new_mo_diff(mdd_diff *diff, mdd_diff_type type, struct mdd_node *mo_run,
+        struct mdd_node *mo_edit, unsigned int nbits)
 {
-    struct mdd_mo_diff *modiff = calloc(1, sizeof(struct mdd_mo_diff));
+    size_t size = mo_diff_size(nbits);
+    struct mdd_mo_diff *modiff = arena_alloc(&diff->arena, size);
     CHECK_DO_RTN_VAL(!modiff, LOG_WARN("No memory"), NULL);
 
-    modiff->type = DF_ADD;
-    modiff->run_data = NULL;
-    modiff->edit_data = mo_edit;
+    memset(modiff, 0, size);
+    modiff->type = type;
+    modiff->run_data = (struct mdd_mo*) mo_run;
+    modiff->edit_data = (struct mdd_mo*) mo_edit;
+    modiff->nbits = nbits;
+    CHECK_RTN_VAL(add_mo_diff(diff, modiff), NULL);
     return modiff;
 }
 
-static struct mdd_mo_diff* build_mo_diff_del(struct mdd_node *mo_run)
+static void set_leaf_bit(struct mdd_mo_diff *modiff, unsigned int pos)
 {
-    struct mdd_mo_diff *modiff = calloc(1, sizeof(struct mdd_mo_diff));
-    CHECK_DO_RTN_VAL(!modiff, LOG_WARN("No memory"), NULL);
-
-    modiff->type = DF_DELETE;
-    modiff->run_data = mo_run;
-    modiff->edit_data = NULL;
-    return modiff;
+    uint64_t mask = 1ULL << (pos % 64);
+    if (!(modiff->leaf_bits[pos / 64] & mask)) {
+        modiff->leaf_bits[pos / 64] |= mask;
+        modiff->leaf_cnt++;
+    }
 }
 
-static int compare_self(struct mds_node *mos, struct mdd_node *mo_run, struct mdd_node *mo_edit, mdd_diff *diff)
+int mdd_diff_next_leaf(const struct mdd_mo_diff *modiff, int pos)
 {
-    int rt = -1;
-    struct mdd_mo_diff *modiff = NULL;
-    if (!mo_run && !mo_edit) {
-        return 0;
-    } else if (!mo_run) {
-        modiff = build_mo_diff_add(mo_edit);
-        CHECK_DO_RTN_VAL(!modiff, LOG_WARN("Failed to build add diff for: %s", mos->name), -1);
-    } else if (!mo_edit) {
-        modiff = build_mo_diff_del(mo_run);
-        CHECK_DO_RTN_VAL(!modiff, LOG_WARN("Failed to build del diff for: %s", mos->name), -1);
-    } else {
-        modiff = build_mo_diff_modify(mos, mo_run, mo_edit);
-    }
+    CHECK_RTN_VAL(!modiff || pos < 0, -1);
 
-    if (modiff) {
-        rt = vector_add(diff, (void*) modiff);
-        CHECK_DO_RTN_VAL(!rt, LOG_WARN("Failed to add modiff"), -1);
+    for (unsigned int i = pos; i < modiff->nbits; i = (i / 64 + 1) * 64) {
+        uint64_t word = modiff->leaf_bits[i / 64] >> (i % 64);
+        if (word) {
+            return i + __builtin_ctzll(word);
+        }
     }
-    return 0;
+    return -1;
 }
 
-static int get_list_key(struct mdd_node *list, const char *key)
+static int is_leaf_equal(struct mdd_leaf *leaf_run, struct mdd_leaf *leaf_edit)
 {
-    struct mdd_node *child = list->child;
-    while (child) {
-        if (!strcmp(child->schema->name, key)) {
-            CHECK_DO_RTN_VAL(!is_leaf(child->schema->mtype) || !is_int_leaf((struct mds_leaf*)(child->schema)),
+    CHECK_RTN_VAL(!leaf_run || !leaf_edit, leaf_run == leaf_edit);
+
+    if (is_intv_leaf((struct mds_leaf* )(leaf_run->schema))) {
+        return leaf_run->value.intv == leaf_edit->value.intv;
+    } else if (is_str_leaf((struct mds_leaf* )(leaf_run->schema))) {
+        /* long values are interned, so equal ones share the pointer; inline ones are zero padded */
+        int heap = leaf_run->value.sso[MDD_SSO_LEN];
+        CHECK_RTN_VAL(heap != leaf_edit->value.sso[MDD_SSO_LEN], 0);
+        return heap ? leaf_run->value.strv == leaf_edit->value.strv
+                : !memcmp(leaf_run->value.sso, leaf_edit->value.sso, sizeof(leaf_run->value.sso));
+    } else {
+        LOG_WARN("leaf type no support yes");
+    }
+    return 0;
+}
+
+//TODO: maybe slow, sort mdd tree by schema will be better
+static struct mdd_node* find_child_node(struct mdd_node *mo, struct mds_node *child_schema)
+{
+    CHECK_RTN_VAL(!mo, NULL);
+
+    struct mdd_leaf *slot = is_leaf_node(child_schema) ? get_slot(mo, child_schema) : NULL;
+    CHECK_RTN_VAL(slot, (struct mdd_node*) slot);
+
+    struct mdd_node *child = mo->child;
+    while (child) {
+        if (child->schema == child_schema) {
+            return child;
+        }
+
+        child = child->next;
+    }
+    return NULL;
+}
+
+int mdd_diff_leaf(const struct mdd_mo_diff *modiff, int pos, struct mdd_leaf **run_leaf, struct mdd_leaf **edit_leaf)
+{
+    CHECK_DO_RTN_VAL(!modiff || !run_leaf || !edit_leaf, LOG_WARN("Null arg"), -1);
+
+    struct mdd_mo *mo = modiff->edit_data ? modiff->edit_data : modiff->run_data;
+    struct mds_node *schema = mds_leaf_at(mo->schema, pos);
+    CHECK_DO_RTN_VAL(!schema, LOG_WARN("Invalid leaf position %d of %s", pos, mo->schema->name), -1);
+
+    *run_leaf = (struct mdd_leaf*) find_child_node((struct mdd_node*) modiff->run_data, schema);
+    *edit_leaf = (struct mdd_leaf*) find_child_node((struct mdd_node*) modiff->edit_data, schema);
+    return 0;
+}
+
+static int compare_leafs(struct mds_node *mos, struct mdd_node *mo_run, struct mdd_node *mo_edit, mdd_diff *diff)
+{
+    struct mds_mo *schema = (struct mds_mo*) mos;
+    struct mdd_mo_diff *modiff = NULL;
+    for (unsigned int i = 0; i < schema->leaf_cnt; i++) {
+        struct mdd_leaf *leaf_run = (struct mdd_leaf*) find_child_node(mo_run, schema->leafs[i]);
+        struct mdd_leaf *leaf_edit = (struct mdd_leaf*) find_child_node(mo_edit, schema->leafs[i]);
+        if (is_leaf_equal(leaf_run, leaf_edit)) {
+            continue;
+        }
+
+        if (!modiff) {
+            modiff = new_mo_diff(diff, DF_MODIFY, mo_run, mo_edit, schema->leaf_cnt);
+            CHECK_DO_RTN_VAL(!modiff, LOG_WARN("Failed to init diff mo"), -1);
+        }
+        set_leaf_bit(modiff, i);
+    }
+    return 0;
+}
+
+static int compare_self(struct mds_node *mos, struct mdd_node *mo_run, struct mdd_node *mo_edit, mdd_diff *diff)
+{
+    if (!mo_run && !mo_edit) {
+        return 0;
+    } else if (!mo_run) {
+        CHECK_DO_RTN_VAL(!new_mo_diff(diff, DF_ADD, NULL, mo_edit, 0),
+                LOG_WARN("Failed to build add diff for: %s", mos->name), -1);
+    } else if (!mo_edit) {
+        CHECK_DO_RTN_VAL(!new_mo_diff(diff, DF_DELETE, mo_run, NULL, 0),
+                LOG_WARN("Failed to build del diff for: %s", mos->name), -1);
+    } else {
+        return compare_leafs(mos, mo_run, mo_edit, diff);
+    }
+    return 0;
+}
+
+static int get_list_key(struct mdd_node *list, const char *key)
+{
+    struct mdd_node *child = list->child;
+    while (child) {
+        if (!strcmp(child->schema->name, key)) {
+            CHECK_DO_RTN_VAL(!is_leaf(child->schema->mtype) || !is_int_leaf((struct mds_leaf*)(child->schema)),
                     LOG_WARN("Invalid key:%s", key), -1);
             return ((struct mdd_leaf*) child)->value.intv;
         }
@@ -655,8 +1847,32 @@ static int get_list_key(struct mdd_node *list, const char *key)
     return -1;
 }
 
+/* keys are looked up as int and -1 stands for none, so the key leaf of a list instance mo holds 0 to INT_MAX */
+static int is_key_out_of_range(struct mdd_node *mo, struct mdd_node *leaf, long long val)
+{
+    CHECK_RTN_VAL(!mo || !is_list_node(mo->schema) || strcmp(leaf->schema->name, "Id"), 0);
+    CHECK_RTN_VAL(!is_int_leaf((struct mds_leaf* )(leaf->schema)), 0);
+    CHECK_DO_RTN_VAL(val < 0 || val > INT_MAX, LOG_WARN("Key %lld of %s out of range", val, mo->schema->name), 1);
+    return 0;
+}
+
+static int check_list_key(struct mdd_node *list)
+{
+    for (struct mdd_node *child = list->child; child; child = child->next) {
+        if (is_leaf_node(child->schema) && is_key_out_of_range(list, child, ((struct mdd_leaf*) child)->value.intv)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
 static struct mdd_node* find_child_list(struct mdd_node *parent, struct mds_node *lists, int targetKey)
 {
+    if (is_ordered_list(lists)) {
+        struct mdd_index *index = get_index(parent, lists, 0);
+        return index ? btree_get(&index->tree, targetKey) : NULL;
+    }
+
     struct mdd_node *list_child = find_child_node(parent, lists);
     while (list_child && list_child->schema == lists) {
         int key = get_list_key(list_child, "Id");
@@ -668,48 +1884,248 @@ static struct mdd_node* find_child_list(struct mdd_node *parent, struct mds_node
     return NULL;
 }
 
-static int compare_list(struct mds_node *lists, struct mdd_node *mo_run_parent, struct mdd_node *mo_edit_parent,
-        mdd_diff *diff)
+/* the lookup point for list instances by key, a B-tree probe for ordered lists */
+struct mdd_node* mdd_find_list(struct mdd_node *parent, struct mds_node *lists, long long key)
+{
+    CHECK_NULL_RTN2(parent, lists, NULL);
+    CHECK_RTN_VAL(key < 0 || key > INT_MAX, NULL);
+
+    return find_child_list(parent, lists, (int) key);
+}
+
+/* instances with lo <= key <= hi in key order, only lists declared with an ordered index can be scanned */
+int mdd_list_range(struct mdd_node *parent, struct mds_node *lists, long long lo, long long hi,
+        struct mdd_list_cursor *cursor)
+{
+    CHECK_DO_RTN_VAL(!parent || !lists || !cursor, LOG_WARN("NULL Para"), -1);
+    CHECK_DO_RTN_VAL(!is_ordered_list(lists) || lists->parent != parent->schema,
+            LOG_WARN("%s is not an ordered list of %s", lists->name, parent->schema->name), -1);
+
+    struct mdd_index *index = get_index(parent, lists, 0);
+    btree_seek(index ? &index->tree : NULL, lo, &cursor->iter);
+    cursor->hi = hi;
+    return 0;
+}
+
+struct mdd_node* mdd_list_next(struct mdd_list_cursor *cursor)
+{
+    CHECK_RTN_VAL(!cursor, NULL);
+
+    long long key = 0;
+    void *entry = NULL;
+    CHECK_RTN_VAL(!btree_next(&cursor->iter, &key, &entry), NULL);
+    if (key > cursor->hi) {
+        cursor->iter.node = NULL;
+        return NULL;
+    }
+    return entry;
+}
+
+static uintptr_t list_key_slot(int key)
+{
+    return (uintptr_t) (unsigned int) key + 1;
+}
+
+#define LIST_KEYS_INLINE 32
+
+/*
+ * The keys of the instances of an unordered list in sibling order, so matching scans an int array
+ * with keys_find instead of walking the instances. Searches start after the last match, which keeps
+ * lists edited in place linear; keys are unique within a list, a repeated one matches one of them.
+ */
+struct list_keys{
+    size_t cnt;
+    size_t hint;
+    int32_t *keys;
+    struct mdd_node **nodes;
+    int32_t keys_buf[LIST_KEYS_INLINE];
+    struct mdd_node *nodes_buf[LIST_KEYS_INLINE];
+};
+
+static void free_list_keys(struct list_keys *lk)
+{
+    if (lk->keys != lk->keys_buf) {
+        free(lk->keys);
+        free(lk->nodes);
+    }
+}
+
+static int load_list_keys(struct list_keys *lk, struct mdd_node *parent, struct mds_node *lists)
+{
+    struct mdd_node *first = find_child_node(parent, lists);
+    lk->cnt = 0;
+    lk->hint = 0;
+    lk->keys = lk->keys_buf;
+    lk->nodes = lk->nodes_buf;
+    for (struct mdd_node *iter = first; iter && iter->schema == lists; iter = iter->next) {
+        lk->cnt++;
+    }
+    if (lk->cnt > LIST_KEYS_INLINE) {
+        lk->keys = malloc(lk->cnt * sizeof(int32_t));
+        lk->nodes = malloc(lk->cnt * sizeof(struct mdd_node*));
+        CHECK_DO_RTN_VAL(!lk->keys || !lk->nodes, LOG_WARN("No memory");free_list_keys(lk), -1);
+    }
+
+    struct mdd_node *iter = first;
+    for (size_t i = 0; i < lk->cnt; i++, iter = iter->next) {
+        lk->keys[i] = get_list_key(iter, "Id");
+        lk->nodes[i] = iter;
+        CHECK_DO_RTN_VAL(-1 == lk->keys[i], LOG_WARN("Failed to get list key");free_list_keys(lk), -1);
+    }
+    return 0;
+}
+
+static struct mdd_node* seek_list_keys(struct list_keys *lk, int key)
+{
+    long pos = keys_find(lk->keys + lk->hint, lk->cnt - lk->hint, key);
+    pos = pos < 0 ? keys_find(lk->keys, lk->hint, key) : pos + (long) lk->hint;
+    CHECK_RTN_VAL(pos < 0, NULL);
+
+    lk->hint = (size_t) pos + 1;
+    return lk->nodes[pos];
+}
+
+static struct mdd_node* lookup_list(struct mdd_node *parent, struct mds_node *lists, int key,
+        const struct mdd_hmap *index, struct list_keys *keys)
+{
+    if (index) {
+        return (struct mdd_node*) hmap_get(index, list_key_slot(key));
+    } else if (keys) {
+        return seek_list_keys(keys, key);
+    }
+    return find_child_list(parent, lists, key);
+}
+
+/* the instances of the other side to match against when no hash index was built for them */
+static struct list_keys* other_list_keys(struct list_keys *lk, struct mdd_node *other_parent,
+        struct mds_node *lists, const struct mdd_hmap *index, int *rt)
+{
+    *rt = 0;
+    CHECK_RTN_VAL(index || is_ordered_list(lists) || !other_parent, NULL);
+    *rt = load_list_keys(lk, other_parent, lists);
+    return *rt ? NULL : lk;
+}
+
+/* compares up to count run instances starting at first against the edit parent */
+static int compare_list_run(struct mds_node *lists, struct mdd_node *first, size_t count,
+        struct mdd_node *mo_edit_parent, const struct mdd_hmap *edit_index, mdd_diff *diff)
 {
     int rt = -1;
     int key = -1;
-    struct mdd_mo_diff *modiff = NULL;
-    struct mdd_node *list_run = find_child_node(mo_run_parent, lists);
-    while (list_run != NULL && list_run->schema == lists) {
-        modiff = NULL;
+    struct list_keys lk;
+    struct list_keys *edit_keys = other_list_keys(&lk, mo_edit_parent, lists, edit_index, &rt);
+    CHECK_RTN_VAL(rt, -1);
+
+    struct mdd_node *list_run = first;
+    for (size_t i = 0; i < count && list_run != NULL && list_run->schema == lists; i++) {
         key = get_list_key(list_run, "Id");
-        CHECK_DO_RTN_VAL(-1 == key, LOG_WARN("Failed to get list key"), -1);
+        CHECK_DO_GOTO(-1 == key, LOG_WARN("Failed to get list key");rt = -1, OUT);
 
-        struct mdd_node *find_edit = find_child_list(mo_edit_parent, lists, key);
+        struct mdd_node *find_edit = lookup_list(mo_edit_parent, lists, key, edit_index, edit_keys);
         rt = compare_container(lists, list_run, find_edit, diff);
-        CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to add modiff"), -1);
+        CHECK_DO_GOTO(rt, LOG_WARN("Failed to add modiff");rt = -1, OUT);
 
         list_run = list_run->next;
     }
 
-    struct mdd_node *list_edit = find_child_node(mo_edit_parent, lists);
-    while (list_edit != NULL && list_edit->schema == lists) {
+OUT:
+    if (edit_keys) {
+        free_list_keys(edit_keys);
+    }
+    return rt;
+}
+
+/* reports the edit instances among count starting at first that the run parent lacks */
+static int compare_list_add(struct mds_node *lists, struct mdd_node *first, size_t count,
+        struct mdd_node *mo_run_parent, const struct mdd_hmap *run_index, mdd_diff *diff)
+{
+    int rt = -1;
+    int key = -1;
+    struct list_keys lk;
+    struct list_keys *run_keys = other_list_keys(&lk, mo_run_parent, lists, run_index, &rt);
+    CHECK_RTN_VAL(rt, -1);
+
+    struct mdd_node *list_edit = first;
+    for (size_t i = 0; i < count && list_edit != NULL && list_edit->schema == lists; i++) {
         key = get_list_key(list_edit, "Id");
-        CHECK_DO_RTN_VAL(-1 == key, LOG_WARN("Failed to get list key"), -1);
-        LOG_INFO("Find list inst:%s[%d]", list_edit->schema->name, key);
+        CHECK_DO_GOTO(-1 == key, LOG_WARN("Failed to get list key");rt = -1, OUT);
+        LOG_DEBUG("Find list inst:%s[%d]", list_edit->schema->name, key);
 
-        struct mdd_node *find_run = find_child_list(mo_run_parent, lists, key);
+        struct mdd_node *find_run = lookup_list(mo_run_parent, lists, key, run_index, run_keys);
         if (!find_run) {
-            LOG_INFO("Find add list inst:%s[%d]", list_edit->schema->name, key);
+            LOG_DEBUG("Find add list inst:%s[%d]", list_edit->schema->name, key);
             rt = compare_container(lists, find_run, list_edit, diff);
-            CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to add modiff"), -1);
+            CHECK_DO_GOTO(rt, LOG_WARN("Failed to add modiff");rt = -1, OUT);
         }
 
         list_edit = list_edit->next;
-        if (list_edit) {
-            LOG_INFO("Find next list inst:%s[%d]", list_edit->schema->name, key);
-        } else {
-            LOG_INFO("All list inst over");
+    }
+
+OUT:
+    if (run_keys) {
+        free_list_keys(run_keys);
+    }
+    return rt;
+}
+
+/* called for each pair of instances matched, run or edit is NULL for an instance the other side lacks */
+typedef int (*list_pair_fn)(struct mds_node *lists, struct mdd_node *run, struct mdd_node *edit, void *arg);
+
+/*
+ * Both sides of an unordered list as key arrays. The leading instances whose keys agree position by
+ * position pair without a search, the rest are looked up in the other array. Every run instance is
+ * passed first, then the edit instances without a match, which is the order of their diff records.
+ */
+static int match_list_keys(struct mds_node *lists, struct mdd_node *mo_run_parent, struct mdd_node *mo_edit_parent,
+        list_pair_fn fn, void *arg)
+{
+    struct list_keys run, edit;
+    CHECK_RTN_VAL(load_list_keys(&run, mo_run_parent, lists), -1);
+    CHECK_DO_RTN_VAL(load_list_keys(&edit, mo_edit_parent, lists), free_list_keys(&run), -1);
+
+    int rt = 0;
+    size_t same = keys_mismatch(run.keys, edit.keys, run.cnt < edit.cnt ? run.cnt : edit.cnt);
+    run.hint = same;
+    edit.hint = same;
+    for (size_t i = 0; i < run.cnt && !rt; i++) {
+        struct mdd_node *find_edit = i < same ? edit.nodes[i] : seek_list_keys(&edit, run.keys[i]);
+        rt = fn(lists, run.nodes[i], find_edit, arg);
+    }
+    for (size_t i = same; i < edit.cnt && !rt; i++) {
+        if (!seek_list_keys(&run, edit.keys[i])) {
+            rt = fn(lists, NULL, edit.nodes[i], arg);
         }
     }
+    free_list_keys(&run);
+    free_list_keys(&edit);
+    return rt;
+}
+
+static int compare_pair(struct mds_node *lists, struct mdd_node *run, struct mdd_node *edit, void *arg)
+{
+    return compare_container(lists, run, edit, (mdd_diff*) arg);
+}
+
+static int compare_list_keys(struct mds_node *lists, struct mdd_node *mo_run_parent, struct mdd_node *mo_edit_parent,
+        mdd_diff *diff)
+{
+    int rt = match_list_keys(lists, mo_run_parent, mo_edit_parent, compare_pair, diff);
+    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to add modiff"), -1);
     return 0;
 }
 
+static int compare_list(struct mds_node *lists, struct mdd_node *mo_run_parent, struct mdd_node *mo_edit_parent,
+        mdd_diff *diff)
+{
+    if (!is_ordered_list(lists)) {
+        return compare_list_keys(lists, mo_run_parent, mo_edit_parent, diff);
+    }
+    int rt = compare_list_run(lists, find_child_node(mo_run_parent, lists), SIZE_MAX, mo_edit_parent, NULL, diff);
+    CHECK_RTN_VAL(rt, -1);
+
+    return compare_list_add(lists, find_child_node(mo_edit_parent, lists), SIZE_MAX, mo_run_parent, NULL, diff);
+}
+
 static int compare_container(struct mds_node *mos, struct mdd_node *mo_run, struct mdd_node *mo_edit, mdd_diff *diff)
 {
     int rt = compare_self(mos, mo_run, mo_edit, diff);
@@ -737,9 +2153,9 @@ mdd_diff* mdd_get_diff(struct mds_node *schema, struct mdd_node *root_run, struc
 {
     CHECK_NULL_RTN3(schema, root_run, root_edit, NULL);
 
-    mdd_diff *diff = (mdd_diff*) malloc(sizeof(mdd_diff));
-    int rt = vector_init(diff, NULL);
-    CHECK_DO_GOTO(rt, LOG_WARN("Failed to init vector"), EXCEPTION);
+    int rt = 0;
+    mdd_diff *diff = new_diff();
+    CHECK_RTN_VAL(!diff, NULL);
 
     struct mds_node *mos = schema;
     if (is_cont_node(mos)) {
@@ -754,6 +2170,268 @@ EXCEPTION:
     return NULL;
 }
 
+#define DIFF_CHUNK 256
+
+/* a task compares a container, count instances of an ordered list from first, or count pairs */
+struct diff_task{
+    struct mds_node *schema;
+    struct mdd_node *run;
+    struct mdd_node *edit;
+    struct mdd_node *first;
+    size_t count;
+    int is_add;
+    const struct mdd_hmap *index;
+    struct mdd_node **pairs;
+    mdd_diff *diff;
+    int rt;
+};
+
+/* the instances of an unordered list as matched by match_list_keys, run and edit side by side */
+struct list_pairs{
+    size_t cnt;
+    size_t capacity;
+    struct mdd_node **nodes;
+};
+
+struct diff_plan{
+    struct mdd_vector tasks;
+    struct mdd_vector indexes;
+    struct mdd_vector pairs;
+};
+
+static void run_diff_task(void *arg)
+{
+    struct diff_task *task = (struct diff_task*) arg;
+    if (task->pairs) {
+        task->rt = 0;
+        for (size_t i = 0; i < task->count && !task->rt; i++) {
+            task->rt = compare_container(task->schema, task->pairs[2 * i], task->pairs[2 * i + 1], task->diff);
+        }
+    } else if (!task->first) {
+        task->rt = compare_container(task->schema, task->run, task->edit, task->diff);
+    } else if (!task->is_add) {
+        task->rt = compare_list_run(task->schema, task->first, task->count, task->edit, task->index, task->diff);
+    } else {
+        task->rt = compare_list_add(task->schema, task->first, task->count, task->run, task->index, task->diff);
+    }
+}
+
+static struct diff_task* add_diff_task(struct diff_plan *plan, struct mds_node *schema, struct mdd_node *run,
+        struct mdd_node *edit)
+{
+    struct diff_task *task = calloc(1, sizeof(struct diff_task));
+    CHECK_DO_RTN_VAL(!task, LOG_WARN("No memory"), NULL);
+
+    task->schema = schema;
+    task->run = run;
+    task->edit = edit;
+    task->diff = new_diff();
+    if (!task->diff || vector_add(&plan->tasks, task)) {
+        mdd_free_diff(task->diff);
+        free(task);
+        return NULL;
+    }
+    return task;
+}
+
+static size_t count_list(struct mdd_node *first, struct mds_node *lists)
+{
+    size_t count = 0;
+    for (struct mdd_node *iter = first; iter && iter->schema == lists; iter = iter->next) {
+        count++;
+    }
+    return count;
+}
+
+static struct mdd_hmap* build_list_index(struct diff_plan *plan, struct mdd_node *first, size_t count)
+{
+    struct mdd_hmap *index = calloc(1, sizeof(struct mdd_hmap));
+    CHECK_DO_RTN_VAL(!index, LOG_WARN("No memory"), NULL);
+    CHECK_DO_RTN_VAL(hmap_init(index, count), free(index), NULL);
+    CHECK_DO_RTN_VAL(vector_add(&plan->indexes, index), hmap_free(index);free(index), NULL);
+
+    struct mdd_node *iter = first;
+    for (size_t i = 0; i < count; i++, iter = iter->next) {
+        int key = get_list_key(iter, "Id");
+        if (key != -1 && !hmap_get(index, list_key_slot(key))) {
+            CHECK_RTN_VAL(hmap_put(index, list_key_slot(key), iter), NULL);
+        }
+    }
+    return index;
+}
+
+static int plan_list_chunks(struct diff_plan *plan, struct mds_node *lists, struct mdd_node *parent,
+        struct mdd_node *other_parent, int is_add)
+{
+    struct mdd_node *first = find_child_node(parent, lists);
+    size_t count = count_list(first, lists);
+    CHECK_RTN_VAL(!count, 0);
+
+    struct mdd_node *other = find_child_node(other_parent, lists);
+    const struct mdd_hmap *index = NULL;
+    if (count > DIFF_CHUNK) {
+        index = build_list_index(plan, other, count_list(other, lists));
+        CHECK_RTN_VAL(!index, -1);
+    }
+
+    while (count) {
+        struct diff_task *task = is_add ? add_diff_task(plan, lists, other_parent, parent) :
+                add_diff_task(plan, lists, parent, other_parent);
+        CHECK_RTN_VAL(!task, -1);
+
+        task->first = first;
+        task->count = count > DIFF_CHUNK ? DIFF_CHUNK : count;
+        task->is_add = is_add;
+        task->index = index;
+        for (size_t i = 0; i < task->count; i++) {
+            first = first->next;
+        }
+        count -= task->count;
+    }
+    return 0;
+}
+
+static int add_pair(struct mds_node *lists, struct mdd_node *run, struct mdd_node *edit, void *arg)
+{
+    (void) lists;
+    struct list_pairs *pairs = (struct list_pairs*) arg;
+    if (pairs->cnt == pairs->capacity) {
+        size_t capacity = pairs->capacity ? pairs->capacity * 2 : DIFF_CHUNK;
+        struct mdd_node **nodes = realloc(pairs->nodes, capacity * 2 * sizeof(struct mdd_node*));
+        CHECK_DO_RTN_VAL(!nodes, LOG_WARN("No memory"), -1);
+        pairs->nodes = nodes;
+        pairs->capacity = capacity;
+    }
+    pairs->nodes[2 * pairs->cnt] = run;
+    pairs->nodes[2 * pairs->cnt + 1] = edit;
+    pairs->cnt++;
+    return 0;
+}
+
+/* an unordered list is matched up front as mdd_get_diff matches it, only the pairs are compared in tasks */
+static int plan_list_pairs(struct diff_plan *plan, struct mds_node *lists, struct mdd_node *root_run,
+        struct mdd_node *root_edit)
+{
+    struct list_pairs *pairs = calloc(1, sizeof(struct list_pairs));
+    CHECK_DO_RTN_VAL(!pairs, LOG_WARN("No memory"), -1);
+    CHECK_DO_RTN_VAL(vector_add(&plan->pairs, pairs), free(pairs), -1);
+    CHECK_DO_RTN_VAL(match_list_keys(lists, root_run, root_edit, add_pair, pairs),
+            LOG_WARN("Failed to match %s", lists->name), -1);
+
+    for (size_t done = 0; done < pairs->cnt;) {
+        struct diff_task *task = add_diff_task(plan, lists, root_run, root_edit);
+        CHECK_RTN_VAL(!task, -1);
+
+        task->pairs = pairs->nodes + 2 * done;
+        task->count = pairs->cnt - done > DIFF_CHUNK ? DIFF_CHUNK : pairs->cnt - done;
+        done += task->count;
+    }
+    return 0;
+}
+
+/* splits the children of the root into tasks in the order compare_container visits them */
+static int plan_diff(struct diff_plan *plan, struct mds_node *mos, struct mdd_node *root_run,
+        struct mdd_node *root_edit)
+{
+    for (struct mds_node *childs = mos->child; childs; childs = childs->next) {
+        if (is_cont_node(childs)) {
+            struct diff_task *task = add_diff_task(plan, childs, find_child_node(root_run, childs),
+                    find_child_node(root_edit, childs));
+            CHECK_RTN_VAL(!task, -1);
+        } else if (is_list_node(childs) && !is_ordered_list(childs)) {
+            CHECK_RTN_VAL(plan_list_pairs(plan, childs, root_run, root_edit), -1);
+        } else if (is_list_node(childs)) {
+            CHECK_RTN_VAL(plan_list_chunks(plan, childs, root_run, root_edit, 0), -1);
+            CHECK_RTN_VAL(plan_list_chunks(plan, childs, root_edit, root_run, 1), -1);
+        }
+    }
+    return 0;
+}
+
+static void free_diff_plan(struct diff_plan *plan)
+{
+    for (size_t i = 0; i < plan->tasks.size; i++) {
+        struct diff_task *task = (struct diff_task*) plan->tasks.vec[i];
+        mdd_free_diff(task->diff);
+        free(task);
+    }
+    for (size_t i = 0; i < plan->indexes.size; i++) {
+        hmap_free((struct mdd_hmap*) plan->indexes.vec[i]);
+        free(plan->indexes.vec[i]);
+    }
+    for (size_t i = 0; i < plan->pairs.size; i++) {
+        free(((struct list_pairs*) plan->pairs.vec[i])->nodes);
+        free(plan->pairs.vec[i]);
+    }
+    vector_free(&plan->tasks);
+    vector_free(&plan->indexes);
+    vector_free(&plan->pairs);
+}
+
+static int merge_task_diff(struct diff_task *task, mdd_diff *diff)
+{
+    CHECK_RTN_VAL(task->rt, -1);
+
+    for (size_t i = 0; i < task->diff->size; i++) {
+        CHECK_RTN_VAL(add_mo_diff(diff, task->diff->vec[i]), -1);
+    }
+
+    /* the records move with their arena, the task diff header is released along with them */
+    struct mdd_arena arena = task->diff->arena;
+    task->diff = NULL;
+    arena_merge(&diff->arena, &arena);
+    return 0;
+}
+
+/*
+ * Same result as mdd_get_diff, with the root's child containers and chunks of its lists
+ * compared as independent tasks on the pool. Instances of unordered lists are matched before
+ * the tasks start, by the same rule. Task buffers are merged in schema order.
+ */
+mdd_diff* mdd_get_diff_parallel(struct mds_node *schema, struct mdd_node *root_run, struct mdd_node *root_edit,
+        struct mdd_pool *pool)
+{
+    CHECK_NULL_RTN3(schema, root_run, root_edit, NULL);
+    CHECK_RTN_VAL(!pool || !is_cont_node(schema), mdd_get_diff(schema, root_run, root_edit));
+
+    struct diff_plan plan;
+    memset(&plan, 0, sizeof(struct diff_plan));
+    mdd_diff *diff = new_diff();
+    CHECK_RTN_VAL(!diff, NULL);
+
+    int rt = vector_init(&plan.tasks, NULL);
+    rt |= vector_init(&plan.indexes, NULL);
+    rt |= vector_init(&plan.pairs, NULL);
+    CHECK_DO_GOTO(rt, LOG_WARN("Failed to init vector"), EXCEPTION);
+
+    rt = compare_self(schema, root_run, root_edit, diff);
+    CHECK_DO_GOTO(rt, LOG_WARN("Failed to compare mo:%s", schema->name), EXCEPTION);
+
+    rt = plan_diff(&plan, schema, root_run, root_edit);
+    CHECK_DO_GOTO(rt, LOG_WARN("Failed to plan diff tasks"), EXCEPTION);
+
+    for (size_t i = 0; i < plan.tasks.size; i++) {
+        rt = pool_submit(pool, run_diff_task, plan.tasks.vec[i]);
+        if (rt) {
+            run_diff_task(plan.tasks.vec[i]);
+        }
+    }
+    pool_wait(pool);
+
+    for (size_t i = 0; i < plan.tasks.size; i++) {
+        rt = merge_task_diff((struct diff_task*) plan.tasks.vec[i], diff);
+        CHECK_DO_GOTO(rt, LOG_WARN("Failed to merge diff task %zu", i), EXCEPTION);
+    }
+
+    free_diff_plan(&plan);
+    return diff;
+
+EXCEPTION:
+    free_diff_plan(&plan);
+    mdd_free_diff(diff);
+    return NULL;
+}
+
 static const char* get_diff_mo_name(struct mdd_mo_diff *modiff)
 {
     struct mdd_mo *mo = modiff->edit_data ? modiff->edit_data : modiff->run_data;
@@ -777,7 +2455,1320 @@ static const char* get_diff_type(struct mdd_mo_diff *modiff)
 void mdd_dump_diff(mdd_diff *diff)
 {
     for (size_t i = 0; i < diff->size; i++) {
-        struct mdd_mo_diff *modiff = (struct mdd_mo_diff*) diff->vec[i];
-        LOG_INFO("modiff:%s - %s", get_diff_type(modiff), get_diff_mo_name(modiff));
+        struct mdd_mo_diff *modiff = diff->vec[i];
+        LOG_INFO("modiff:%s - %s, leafs:%u", get_diff_type(modiff), get_diff_mo_name(modiff), modiff->leaf_cnt);
+    }
+}
+
+/* the copy shares the tree nodes and keeps all records in one block */
+mdd_diff* mdd_copy_diff(const mdd_diff *diff)
+{
+    CHECK_NULL_RTN(diff, NULL);
+
+    size_t total = sizeof(mdd_diff) + diff->size * sizeof(struct mdd_mo_diff*) + 64;
+    for (size_t i = 0; i < diff->size; i++) {
+        total += mo_diff_size(diff->vec[i]->nbits) + 16;
+    }
+
+    struct mdd_arena arena;
+    arena_init(&arena, total);
+    mdd_diff *copy = (mdd_diff*) arena_alloc(&arena, sizeof(mdd_diff));
+    CHECK_DO_RTN_VAL(!copy, LOG_WARN("No memory"), NULL);
+
+    memset(copy, 0, sizeof(mdd_diff));
+    copy->arena = arena;
+    copy->vec = arena_alloc(&copy->arena, (diff->size ? diff->size : 1) * sizeof(struct mdd_mo_diff*));
+    CHECK_DO_GOTO(!copy->vec, LOG_WARN("No memory"), EXCEPTION);
+    copy->capacity = diff->size;
+
+    for (size_t i = 0; i < diff->size; i++) {
+        size_t size = mo_diff_size(diff->vec[i]->nbits);
+        struct mdd_mo_diff *modiff = arena_alloc(&copy->arena, size);
+        CHECK_DO_GOTO(!modiff, LOG_WARN("No memory"), EXCEPTION);
+
+        memcpy(modiff, diff->vec[i], size);
+        copy->vec[copy->size++] = modiff;
+    }
+    return copy;
+
+EXCEPTION:
+    mdd_free_diff(copy);
+    return NULL;
+}
+
+/* old values of the leaves touched in one mo since the last diff, used as the diff run side */
+struct track_shadow{
+    struct mdd_mo mo;
+    unsigned int nbits;
+    uint64_t touched[];
+};
+
+static size_t shadow_size(struct mds_node *schema)
+{
+    return sizeof(struct track_shadow) + (((struct mds_mo*) schema)->leaf_cnt + 63) / 64 * sizeof(uint64_t);
+}
+
+int mdd_track_init(struct mdd_track *track)
+{
+    CHECK_NULL_RTN(track, -1);
+
+    memset(track, 0, sizeof(struct mdd_track));
+    int rt = vector_init(&track->changes, NULL);
+    rt |= hmap_init(&track->shadows, 0);
+    rt |= vector_init(&track->retired, NULL);
+    rt |= vector_init(&track->released, NULL);
+    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to init track");mdd_track_free(track), -1);
+    return 0;
+}
+
+static void free_nodes(struct mdd_vector *nodes)
+{
+    for (size_t i = 0; i < nodes->size; i++) {
+        mdd_free_data((struct mdd_node*) nodes->vec[i]);
     }
+    nodes->size = 0;
+}
+
+static void clear_changes(struct mdd_track *track)
+{
+    for (size_t i = 0; i < track->changes.size; i++) {
+        nodepool_free(track->changes.vec[i], sizeof(struct mdd_change));
+    }
+    track->changes.size = 0;
+    hmap_clear(&track->shadows);
+}
+
+void mdd_track_free(struct mdd_track *track)
+{
+    CHECK_NULL(track);
+
+    clear_changes(track);
+    free_nodes(&track->retired);
+    free_nodes(&track->released);
+    vector_free(&track->changes);
+    hmap_free(&track->shadows);
+    vector_free(&track->retired);
+    vector_free(&track->released);
+}
+
+/* only the first edit since the last diff climbs to the root */
+static void mark_pending(struct mdd_track *track, struct mdd_node *node)
+{
+    CHECK_RTN(track->root);
+
+    while (node->parent) {
+        node = node->parent;
+    }
+    node->flags |= MDD_F_PENDING;
+    track->root = node;
+}
+
+static struct mdd_change* add_change(struct mdd_track *track, mdd_change_type type, struct mdd_node *parent,
+        struct mdd_node *old_node, struct mdd_node *new_node)
+{
+    struct mdd_change *change = nodepool_alloc(sizeof(struct mdd_change));
+    CHECK_DO_RTN_VAL(!change, LOG_WARN("No memory"), NULL);
+
+    change->type = type;
+    change->parent = parent;
+    change->old_node = old_node;
+    change->new_node = new_node;
+    int rt = vector_add(&track->changes, change);
+    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to add change");nodepool_free(change, sizeof(struct mdd_change)), NULL);
+    return change;
+}
+
+static struct track_shadow* get_shadow(struct mdd_track *track, struct mdd_node *mo)
+{
+    struct track_shadow *shadow = hmap_get(&track->shadows, (uintptr_t) mo);
+    CHECK_RTN_VAL(shadow, shadow);
+
+    unsigned int nbits = ((struct mds_mo*) mo->schema)->leaf_cnt;
+    shadow = nodepool_alloc(shadow_size(mo->schema));
+    CHECK_DO_RTN_VAL(!shadow, LOG_WARN("No memory"), NULL);
+
+    shadow->mo.schema = mo->schema;
+    shadow->mo.flags = MDD_F_SHADOW;
+    shadow->nbits = nbits;
+    int rt = vector_add(&track->retired, shadow);
+    CHECK_DO_RTN_VAL(rt, nodepool_free(shadow, shadow_size(mo->schema)), NULL);
+
+    struct mdd_change *change = add_change(track, CH_MODIFY, mo, (struct mdd_node*) shadow, mo);
+    CHECK_DO_RTN_VAL(!change, track->retired.size--;nodepool_free(shadow, shadow_size(mo->schema)), NULL);
+
+    rt = hmap_put(&track->shadows, (uintptr_t) mo, shadow);
+    CHECK_RTN_VAL(rt, NULL);
+    return shadow;
+}
+
+static void push_child(struct mdd_node *parent, struct mdd_node *node)
+{
+    node->parent = parent;
+    node->prev = NULL;
+    node->next = parent->child;
+    if (parent->child) {
+        parent->child->prev = node;
+    }
+    parent->child = node;
+}
+
+/* returns 1 if the leaf position was already touched since the last diff */
+static int touch_leaf(struct track_shadow *shadow, struct mds_node *schema)
+{
+    unsigned int pos = ((struct mds_leaf*) schema)->leaf_idx;
+    uint64_t mask = 1ULL << (pos % 64);
+    CHECK_RTN_VAL(shadow->touched[pos / 64] & mask, 1);
+
+    shadow->touched[pos / 64] |= mask;
+    return 0;
+}
+
+static int is_leaf_touched(struct track_shadow *shadow, unsigned int pos)
+{
+    return (shadow->touched[pos / 64] >> (pos % 64)) & 1;
+}
+
+static struct mdd_node* clone_leaf(struct mdd_leaf *leaf)
+{
+    struct mdd_leaf *clone = (struct mdd_leaf*) nodepool_alloc(sizeof(struct mdd_leaf));
+    CHECK_DO_RTN_VAL(!clone, LOG_WARN("no memory!"), NULL);
+
+    clone->schema = leaf->schema;
+    clone->value = leaf->value;
+    if (is_str_leaf((struct mds_leaf* )(leaf->schema)) && leaf->value.sso[MDD_SSO_LEN]) {
+        strpool_ref(leaf->value.strv);
+    }
+    return (struct mdd_node*) clone;
+}
+
+static int track_leaf(struct mdd_track *track, struct mdd_node *leaf)
+{
+    struct track_shadow *shadow = get_shadow(track, leaf->parent);
+    CHECK_RTN_VAL(!shadow, -1);
+    drop_frags(track->frags, leaf->parent);
+    CHECK_RTN_VAL(is_leaf_touched(shadow, ((struct mds_leaf*) leaf->schema)->leaf_idx), 0);
+
+    struct mdd_node *old = clone_leaf((struct mdd_leaf*) leaf);
+    CHECK_RTN_VAL(!old, -1);
+
+    touch_leaf(shadow, leaf->schema);
+    push_child((struct mdd_node*) shadow, old);
+    mark_pending(track, leaf);
+    return 0;
+}
+
+static int set_intv(struct mdd_track *track, struct mdd_node *leaf, long long val)
+{
+    CHECK_RTN_VAL(is_key_out_of_range(leaf->parent, leaf, val), -1);
+
+    struct mdd_leaf value = *(struct mdd_leaf*) leaf;
+    value.value.intv = val;
+    struct mdd_node *entry = indexed_entry(leaf->parent, leaf);
+    CHECK_RTN_VAL(entry && value_conflict(entry->parent, entry, &value), -1);
+
+    int rt = track_leaf(track, leaf);
+    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to track leaf %s", leaf->schema->name), -1);
+
+    /* a new value moves the instance within its indexes */
+    if (entry) {
+        unindex_entry(entry->parent, entry);
+    }
+    ((struct mdd_leaf*) leaf)->value.intv = val;
+    CHECK_DO_RTN_VAL(entry && index_entry(entry->parent, entry), LOG_WARN("Failed to index %s", entry->schema->name),
+            -1);
+    return 0;
+}
+
+int mdd_set_int(struct mdd_track *track, struct mdd_node *leaf, long long val)
+{
+    CHECK_DO_RTN_VAL(!track || !leaf || !is_int_leaf((struct mds_leaf* )(leaf->schema)), LOG_WARN("Invalid int leaf"),
+            -1);
+    return set_intv(track, leaf, val);
+}
+
+/* enum leaves take their value by name */
+int mdd_set_str(struct mdd_track *track, struct mdd_node *leaf, const char *val)
+{
+    CHECK_DO_RTN_VAL(!track || !leaf || !val, LOG_WARN("Invalid str leaf"), -1);
+    if (is_enum_leaf((struct mds_leaf* )(leaf->schema))) {
+        long code = mds_enum_code(leaf->schema, val, strlen(val));
+        CHECK_DO_RTN_VAL(code < 0, LOG_WARN("Invalid %s value %s", leaf->schema->name, val), -1);
+        return set_intv(track, leaf, code);
+    }
+    CHECK_DO_RTN_VAL(!is_str_leaf((struct mds_leaf* )(leaf->schema)), LOG_WARN("Invalid str leaf"), -1);
+
+    /* the new value is stored aside first, so running out of memory leaves the leaf untouched */
+    struct mdd_leaf value = *(struct mdd_leaf*) leaf;
+    memset(&value.value, 0, sizeof(mdd_dvalue));
+    CHECK_RTN_VAL(mdd_leaf_set_str(&value, val, strlen(val)), -1);
+    struct mdd_node *entry = indexed_entry(leaf->parent, leaf);
+    CHECK_DO_RTN_VAL(entry && value_conflict(entry->parent, entry, &value), free_str_val(&value), -1);
+
+    int rt = track_leaf(track, leaf);
+    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to track leaf %s", leaf->schema->name);free_str_val(&value), -1);
+
+    if (entry) {
+        unindex_entry(entry->parent, entry);
+    }
+    struct mdd_leaf *target = (struct mdd_leaf*) leaf;
+    free_str_val(target);
+    target->value = value.value;
+    CHECK_DO_RTN_VAL(entry && index_entry(entry->parent, entry), LOG_WARN("Failed to index %s", entry->schema->name),
+            -1);
+    return 0;
+}
+
+static struct mdd_node* find_last_sibling(struct mdd_node *parent, struct mds_node *schema)
+{
+    struct mdd_node *last = NULL;
+    for (struct mdd_node *iter = parent->child; iter; iter = iter->next) {
+        if (iter->schema == schema) {
+            last = iter;
+        } else if (last) {
+            break;
+        }
+    }
+    return last;
+}
+
+static void link_node(struct mdd_node *parent, struct mdd_node *node)
+{
+    struct mdd_node *prev = find_last_sibling(parent, node->schema);
+    if (!prev && parent->child) {
+        prev = get_last_child(parent->child);
+    }
+
+    node->parent = parent;
+    node->prev = prev;
+    if (prev) {
+        node->next = prev->next;
+        if (prev->next) {
+            prev->next->prev = node;
+        }
+        prev->next = node;
+    } else {
+        node->next = NULL;
+        parent->child = node;
+    }
+}
+
+static void unlink_node(struct mdd_node *node)
+{
+    unindex_entry(node->parent, node);
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else if (node->parent) {
+        node->parent->child = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    }
+    node->prev = NULL;
+    node->next = NULL;
+}
+
+static int check_insert(struct mdd_node *parent, struct mdd_node *node)
+{
+    CHECK_DO_RTN_VAL(node->schema->parent != parent->schema,
+            LOG_WARN("%s is not a child of %s", node->schema->name, parent->schema->name), -1);
+    CHECK_RTN_VAL(is_list_node(node->schema) && check_list_key(node), -1);
+    CHECK_RTN_VAL(is_leaf_node(node->schema) && is_key_out_of_range(parent, node, ((struct mdd_leaf*) node)->value.intv),
+            -1);
+
+    struct mdd_node *exist = find_child_node(parent, node->schema);
+    CHECK_RTN_VAL(!exist, 0);
+    CHECK_DO_RTN_VAL(!is_list_node(node->schema), LOG_WARN("%s already exist", node->schema->name), -1);
+
+    int key = get_list_key(node, "Id");
+    CHECK_DO_RTN_VAL(find_child_list(parent, node->schema, key),
+            LOG_WARN("%s[%d] already exist", node->schema->name, key), -1);
+
+    for (struct mdd_node *leaf = node->child; leaf; leaf = leaf->next) {
+        CHECK_RTN_VAL(is_indexed_leaf((struct mds_leaf* ) leaf->schema)
+                && value_conflict(parent, node, (struct mdd_leaf*) leaf), -1);
+    }
+    return 0;
+}
+
+int mdd_insert_node(struct mdd_track *track, struct mdd_node *parent, struct mdd_node *node)
+{
+    CHECK_DO_RTN_VAL(!track || !parent || !node || node->next, LOG_WARN("Invalid insert node"), -1);
+    CHECK_RTN_VAL(check_insert(parent, node), -1);
+
+    struct mdd_node *entry = is_leaf_node(node->schema) ? indexed_entry(parent, node) : NULL;
+    CHECK_RTN_VAL(entry && value_conflict(entry->parent, entry, (struct mdd_leaf*) node), -1);
+    CHECK_DO_RTN_VAL(index_entry(parent, node), LOG_WARN("Failed to index %s", node->schema->name), -1);
+
+    if (is_leaf_node(node->schema)) {
+        struct track_shadow *shadow = get_shadow(track, parent);
+        CHECK_RTN_VAL(!shadow, -1);
+        touch_leaf(shadow, node->schema);
+    } else {
+        CHECK_DO_RTN_VAL(!add_change(track, CH_ADD, parent, NULL, node), unindex_entry(parent, node), -1);
+        node->flags |= MDD_F_ADDED;
+    }
+
+    /* a key or indexed leaf added to a list instance makes it reachable by that value */
+    if (entry) {
+        unindex_entry(entry->parent, entry);
+    }
+    link_node(parent, node);
+    drop_frags(track->frags, parent);
+    mark_pending(track, node);
+    if (entry && index_entry(entry->parent, entry)) {
+        LOG_WARN("Failed to index %s", entry->schema->name);
+    }
+    return 0;
+}
+
+/* the first removal of a leaf since the last diff keeps it as the old value, later ones drop it */
+static int track_delete_leaf(struct mdd_track *track, struct mdd_node *leaf)
+{
+    struct track_shadow *shadow = get_shadow(track, leaf->parent);
+    CHECK_RTN_VAL(!shadow, -1);
+
+    /* a leaf in a slot stays with its mo, so the shadow keeps a copy */
+    struct mdd_node *parent = leaf->parent;
+    int touched = is_leaf_touched(shadow, ((struct mds_leaf*) leaf->schema)->leaf_idx);
+    struct mdd_node *old = leaf;
+    if (!touched && get_slot(parent, leaf->schema) == (struct mdd_leaf*) leaf) {
+        old = clone_leaf((struct mdd_leaf*) leaf);
+        CHECK_RTN_VAL(!old, -1);
+    }
+
+    struct mdd_node *entry = indexed_entry(leaf->parent, leaf);
+    if (entry) {
+        unindex_entry(entry->parent, entry);
+    }
+    unlink_node(leaf);
+    drop_frags(track->frags, parent);
+    /* the instance stays reachable through its other leaves */
+    if (entry && index_entry(entry->parent, entry)) {
+        LOG_WARN("Failed to index %s", entry->schema->name);
+    }
+    touch_leaf(shadow, leaf->schema);
+    if (touched || old != leaf) {
+        mdd_free_data(leaf);
+    }
+    if (!touched) {
+        push_child((struct mdd_node*) shadow, old);
+    }
+    mark_pending(track, parent);
+    return 0;
+}
+
+/* the mo sibling before node, leaves skipped */
+static struct mdd_node* prev_mo(struct mdd_node *node)
+{
+    struct mdd_node *prev = node->prev;
+    while (prev && is_leaf_node(prev->schema)) {
+        prev = prev->prev;
+    }
+    return prev;
+}
+
+int mdd_delete_node(struct mdd_track *track, struct mdd_node *node)
+{
+    CHECK_DO_RTN_VAL(!track || !node || !node->parent, LOG_WARN("Invalid delete node"), -1);
+    CHECK_RTN_VAL(is_leaf_node(node->schema), track_delete_leaf(track, node));
+
+    int rt = vector_add(&track->retired, node);
+    CHECK_RTN_VAL(rt, -1);
+
+    struct mdd_change *change = add_change(track, CH_DEL, node->parent, node, NULL);
+    CHECK_DO_RTN_VAL(!change, track->retired.size--, -1);
+    change->prev = prev_mo(node);
+
+    drop_frags(track->frags, node->parent);
+    drop_subtree_frags(track->frags, node);
+    unlink_node(node);
+    node->flags |= MDD_F_DELETED;
+    mark_pending(track, node->parent);
+    return 0;
+}
+
+/* a list schema takes either an array of instances or a single instance object */
+struct mdd_node* mdd_parse_child(struct mds_node *schema, const cJSON *data_json)
+{
+    CHECK_NULL_RTN2(schema, data_json, NULL);
+
+    if (is_list_node(schema) && cJSON_IsObject(data_json)) {
+        struct mdd_node *node = build_container_node(schema, (cJSON*) data_json, NULL);
+        CHECK_DO_RTN_VAL(node && check_list_key(node), mdd_free_data(node), NULL);
+        return node;
+    }
+    return build_mdd_node(schema, (cJSON*) data_json, NULL);
+}
+
+/* a change below a node added or deleted since the last diff is covered by that node */
+static int is_change_visible(struct mdd_node *node)
+{
+    for (; node; node = node->parent) {
+        if (node->flags & (MDD_F_ADDED | MDD_F_DELETED)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int add_subtree_diff(struct mdd_node *mo, mdd_diff_type type, mdd_diff *diff)
+{
+    struct mdd_mo_diff *modiff = type == DF_ADD ? new_mo_diff(diff, type, NULL, mo, 0) :
+            new_mo_diff(diff, type, mo, NULL, 0);
+    CHECK_DO_RTN_VAL(!modiff, LOG_WARN("Failed to build diff for: %s", mo->schema->name), -1);
+
+    for (struct mdd_node *child = mo->child; child; child = child->next) {
+        if (is_mo(child->schema->mtype)) {
+            CHECK_RTN_VAL(add_subtree_diff(child, type, diff), -1);
+        }
+    }
+    return 0;
+}
+
+static int add_modify_diff(struct mdd_change *change, mdd_diff *diff)
+{
+    struct track_shadow *shadow = (struct track_shadow*) change->old_node;
+    struct mds_mo *schema = (struct mds_mo*) shadow->mo.schema;
+    struct mdd_mo_diff *modiff = NULL;
+    for (unsigned int i = 0; i < shadow->nbits; i++) {
+        if (!is_leaf_touched(shadow, i)) {
+            continue;
+        }
+
+        struct mdd_leaf *leaf_run = (struct mdd_leaf*) find_child_node(change->old_node, schema->leafs[i]);
+        struct mdd_leaf *leaf_edit = (struct mdd_leaf*) find_child_node(change->new_node, schema->leafs[i]);
+        if (is_leaf_equal(leaf_run, leaf_edit)) {
+            continue;
+        }
+
+        if (!modiff) {
+            modiff = new_mo_diff(diff, DF_MODIFY, change->old_node, change->new_node, shadow->nbits);
+            CHECK_DO_RTN_VAL(!modiff, LOG_WARN("Failed to init diff mo"), -1);
+        }
+        set_leaf_bit(modiff, i);
+    }
+    return 0;
+}
+
+static int add_change_diff(struct mdd_change *change, mdd_diff *diff)
+{
+    CHECK_RTN_VAL(!is_change_visible(change->parent), 0);
+
+    switch (change->type) {
+        case CH_MODIFY:
+            return add_modify_diff(change, diff);
+        case CH_ADD:
+            CHECK_RTN_VAL(change->new_node->flags & MDD_F_DELETED, 0);
+            return add_subtree_diff(change->new_node, DF_ADD, diff);
+        case CH_DEL:
+            CHECK_RTN_VAL(change->old_node->flags & MDD_F_ADDED, 0);
+            return add_subtree_diff(change->old_node, DF_DELETE, diff);
+        default:
+            LOG_WARN("Invalid change type:%d", change->type);
+            return -1;
+    }
+}
+
+/* only the nodes of mo changes carry added or deleted */
+static void clear_marks(struct mdd_track *track)
+{
+    for (size_t i = 0; i < track->changes.size; i++) {
+        struct mdd_change *change = (struct mdd_change*) track->changes.vec[i];
+        if (change->type != CH_MODIFY) {
+            struct mdd_node *node = change->new_node ? change->new_node : change->old_node;
+            node->flags &= ~(MDD_F_ADDED | MDD_F_DELETED);
+        }
+    }
+    if (track->root) {
+        track->root->flags &= ~MDD_F_PENDING;
+        track->root = NULL;
+    }
+}
+
+/*
+ * Builds the diff of everything edited through the track since the last call. Cost is
+ * proportional to the number of changes and their depth, not to the tree size. The diff
+ * stays valid until the next call or mdd_track_free.
+ */
+mdd_diff* mdd_get_dirty_diff(struct mdd_track *track)
+{
+    CHECK_NULL_RTN(track, NULL);
+
+    mdd_diff *diff = new_diff();
+    CHECK_RTN_VAL(!diff, NULL);
+
+    for (size_t i = 0; i < track->changes.size; i++) {
+        int rt = add_change_diff((struct mdd_change*) track->changes.vec[i], diff);
+        CHECK_DO_GOTO(rt, LOG_WARN("Failed to build change diff"), EXCEPTION);
+    }
+
+    clear_marks(track);
+    clear_changes(track);
+    free_nodes(&track->released);
+
+    struct mdd_vector tmp = track->released;
+    track->released = track->retired;
+    track->retired = tmp;
+    return diff;
+
+EXCEPTION:
+    mdd_free_diff(diff);
+    return NULL;
+}
+
+/* links node after prev, or first under parent without prev */
+static void link_after(struct mdd_node *parent, struct mdd_node *prev, struct mdd_node *node)
+{
+    struct mdd_node *next = prev ? prev->next : parent->child;
+    node->parent = parent;
+    node->prev = prev;
+    node->next = next;
+    if (next) {
+        next->prev = node;
+    }
+    if (prev) {
+        prev->next = node;
+    } else {
+        parent->child = node;
+    }
+}
+
+/* the last of the leaves heading the children of mo whose schema position is below pos */
+static struct mdd_node* leaf_before(struct mdd_node *mo, unsigned int pos)
+{
+    struct mdd_node *prev = NULL;
+    for (struct mdd_node *iter = mo->child; iter && is_leaf_node(iter->schema); iter = iter->next) {
+        if (((struct mds_leaf*) iter->schema)->leaf_idx >= pos) {
+            break;
+        }
+        prev = iter;
+    }
+    return prev;
+}
+
+/* puts the old values of the touched leaves back, a removed leaf returns among the leaves in schema order */
+static void restore_leaves(struct mdd_track *track, struct track_shadow *shadow, struct mdd_node *mo)
+{
+    struct mds_mo *schema = (struct mds_mo*) mo->schema;
+    for (unsigned int i = 0; i < shadow->nbits; i++) {
+        if (!is_leaf_touched(shadow, i)) {
+            continue;
+        }
+
+        struct mdd_leaf *cur = (struct mdd_leaf*) find_child_node(mo, schema->leafs[i]);
+        struct mdd_leaf *old = (struct mdd_leaf*) find_child_node((struct mdd_node*) shadow, schema->leafs[i]);
+        if (cur && old) {
+            if (is_str_leaf((struct mds_leaf* )(cur->schema))) {
+                free_str_val(cur);
+            }
+            cur->value = old->value;
+            memset(&old->value, 0, sizeof(mdd_dvalue));
+        } else if (cur) {
+            unlink_node((struct mdd_node*) cur);
+            mdd_free_data((struct mdd_node*) cur);
+        } else if (old) {
+            unlink_node((struct mdd_node*) old);
+            link_after(mo, leaf_before(mo, i), (struct mdd_node*) old);
+        }
+    }
+    drop_frags(track->frags, mo);
+}
+
+/* undoes the mo inserts and removals, newest first, so every node goes back next to the sibling it had */
+static void undo_mo_changes(struct mdd_track *track)
+{
+    for (size_t i = track->changes.size; i > 0; i--) {
+        struct mdd_change *change = (struct mdd_change*) track->changes.vec[i - 1];
+        if (change->type == CH_ADD) {
+            drop_subtree_frags(track->frags, change->new_node);
+            unlink_node(change->new_node);
+        } else if (change->type == CH_DEL) {
+            struct mdd_node *prev = change->prev ? change->prev : leaf_before(change->parent, UINT_MAX);
+            link_after(change->parent, prev, change->old_node);
+            change->old_node->flags &= ~MDD_F_DELETED;
+        }
+        drop_frags(track->frags, change->parent);
+    }
+}
+
+/* list instances that kept or got back their place are indexed again with their old values */
+static void reindex_changes(struct mdd_track *track)
+{
+    for (size_t i = 0; i < track->changes.size; i++) {
+        struct mdd_change *change = (struct mdd_change*) track->changes.vec[i];
+        struct mdd_node *entry = change->type == CH_MODIFY ? change->new_node :
+                change->type == CH_DEL ? change->old_node : NULL;
+        if (!entry || !is_list_node(entry->schema) || !is_change_visible(entry)) {
+            continue;
+        }
+        unindex_entry(entry->parent, entry);
+        if (index_entry(entry->parent, entry)) {
+            LOG_WARN("Failed to index %s", entry->schema->name);
+        }
+    }
+}
+
+/*
+ * Takes back every edit made through the track since the last mdd_get_dirty_diff: leaves get
+ * their old values from the shadows, removed mos are linked back and inserted ones freed.
+ * Nodes got while editing may go stale.
+ */
+void mdd_track_abort(struct mdd_track *track)
+{
+    CHECK_NULL(track);
+
+    /* edited instances leave their indexes first, their values pass through each other's */
+    for (size_t i = 0; i < track->changes.size; i++) {
+        struct mdd_change *change = (struct mdd_change*) track->changes.vec[i];
+        if (change->type == CH_MODIFY && is_list_node(change->new_node->schema)) {
+            unindex_entry(change->new_node->parent, change->new_node);
+        }
+    }
+    for (size_t i = 0; i < track->changes.size; i++) {
+        struct mdd_change *change = (struct mdd_change*) track->changes.vec[i];
+        if (change->type == CH_MODIFY) {
+            restore_leaves(track, (struct track_shadow*) change->old_node, change->new_node);
+        }
+    }
+    undo_mo_changes(track);
+    reindex_changes(track);
+    clear_marks(track);
+
+    for (size_t i = 0; i < track->changes.size; i++) {
+        struct mdd_change *change = (struct mdd_change*) track->changes.vec[i];
+        if (change->type == CH_ADD) {
+            mdd_free_data(change->new_node);
+        }
+    }
+    for (size_t i = 0; i < track->retired.size; i++) {
+        struct mdd_node *node = (struct mdd_node*) track->retired.vec[i];
+        if (node->flags & MDD_F_SHADOW) {
+            mdd_free_data(node);
+        }
+    }
+    track->retired.size = 0;
+    clear_changes(track);
+}
+
+/* 1 while edits made through the track wait for mdd_get_dirty_diff or mdd_track_abort */
+int mdd_track_pending(const struct mdd_track *track)
+{
+    return track && track->changes.size;
+}
+
+static int dump_node_path(struct mdd_node *node, char **buf, size_t *size, size_t *posi)
+{
+    if (node->parent) {
+        CHECK_RTN_VAL(dump_node_path(node->parent, buf, size, posi), -1);
+        CHECK_RTN_VAL(dump_write_str(buf, size, posi, "/"), -1);
+    }
+    CHECK_RTN_VAL(dump_write_str(buf, size, posi, node->schema->name), -1);
+
+    if (is_list_node(node->schema)) {
+        char tmp[40];
+        snprintf(tmp, sizeof(tmp), "[Id=%d]", get_list_key(node, "Id"));
+        CHECK_RTN_VAL(dump_write_str(buf, size, posi, tmp), -1);
+    }
+    return 0;
+}
+
+static int dump_patch_op(const char *op, struct mdd_node *mo, struct mdd_node *leaf, struct mdd_node *value,
+        char **buf, size_t *size, size_t *posi)
+{
+    CHECK_RTN_VAL(dump_write_str(buf, size, posi, *posi > 1 ? ",{\"op\":\"" : "{\"op\":\""), -1);
+    CHECK_RTN_VAL(dump_write_str(buf, size, posi, op), -1);
+    CHECK_RTN_VAL(dump_write_str(buf, size, posi, "\",\"path\":\""), -1);
+    CHECK_RTN_VAL(dump_node_path(mo, buf, size, posi), -1);
+    if (leaf) {
+        CHECK_RTN_VAL(dump_write_str(buf, size, posi, "/"), -1);
+        CHECK_RTN_VAL(dump_write_str(buf, size, posi, leaf->schema->name), -1);
+    }
+    CHECK_RTN_VAL(dump_write_str(buf, size, posi, "\""), -1);
+
+    if (value) {
+        CHECK_RTN_VAL(dump_write_str(buf, size, posi, ",\"value\":"), -1);
+        int rlt = is_leaf_node(value->schema) ? dump_leaf_value((struct mdd_leaf*) value, buf, size, posi) :
+                dump_container_body(value, NULL, buf, size, posi);
+        CHECK_DO_RTN_VAL(rlt, LOG_WARN("Failed to dump patch value of %s", value->schema->name), -1);
+    }
+    return dump_write_str(buf, size, posi, "}");
+}
+
+static int dump_patch_leafs(struct mdd_mo_diff *modiff, char **buf, size_t *size, size_t *posi)
+{
+    for (int pos = mdd_diff_next_leaf(modiff, 0); pos >= 0; pos = mdd_diff_next_leaf(modiff, pos + 1)) {
+        struct mdd_leaf *leaf_run = NULL, *leaf_edit = NULL;
+        CHECK_RTN_VAL(mdd_diff_leaf(modiff, pos, &leaf_run, &leaf_edit), -1);
+
+        int rlt = 0;
+        struct mdd_node *mo = (struct mdd_node*) modiff->edit_data;
+        if (!leaf_edit) {
+            rlt = dump_patch_op("remove", mo, (struct mdd_node*) leaf_run, NULL, buf, size, posi);
+        } else {
+            rlt = dump_patch_op(leaf_run ? "replace" : "add", mo, (struct mdd_node*) leaf_edit,
+                    (struct mdd_node*) leaf_edit, buf, size, posi);
+        }
+        CHECK_RTN_VAL(rlt, -1);
+    }
+    return 0;
+}
+
+/* an added or removed mo carries its whole subtree, the records below it are skipped */
+static int dump_patch_record(struct mdd_mo_diff *modiff, struct mdd_hmap *covered, char **buf, size_t *size,
+        size_t *posi)
+{
+    if (modiff->type == DF_MODIFY) {
+        return dump_patch_leafs(modiff, buf, size, posi);
+    }
+
+    struct mdd_node *mo = (struct mdd_node*) (modiff->type == DF_ADD ? modiff->edit_data : modiff->run_data);
+    CHECK_RTN_VAL(hmap_put(covered, (uintptr_t) mo, mo), -1);
+    CHECK_RTN_VAL(mo->parent && hmap_get(covered, (uintptr_t) mo->parent), 0);
+
+    if (modiff->type == DF_ADD) {
+        return dump_patch_op("add", mo, NULL, mo, buf, size, posi);
+    }
+    return dump_patch_op("remove", mo, NULL, NULL, buf, size, posi);
+}
+
+/*
+ * Serializes the diff as a JSON Patch style array of add/remove/replace ops. Paths use the
+ * mdd_get_data syntax with list keys, so the patch stays valid on any replica of the tree.
+ */
+int mdd_diff_to_patch(const mdd_diff *diff, char **patch_str)
+{
+    CHECK_DO_RTN_VAL(!diff || !patch_str, LOG_WARN("Null arg"), -1);
+
+    struct mdd_hmap covered;
+    CHECK_RTN_VAL(hmap_init(&covered, 0), -1);
+
+    size_t size = 1024;
+    size_t posi = 0;
+    char *buf = calloc(1, size);
+    CHECK_DO_GOTO(!buf, LOG_WARN("No memory"), CLEAN);
+
+    int rlt = dump_write_str(&buf, &size, &posi, "[");
+    for (size_t i = 0; i < diff->size && !rlt; i++) {
+        rlt = dump_patch_record(diff->vec[i], &covered, &buf, &size, &posi);
+    }
+    rlt |= dump_write_str(&buf, &size, &posi, "]");
+    CHECK_DO_GOTO(rlt, LOG_WARN("Failed to dump patch"), CLEAN);
+
+    hmap_free(&covered);
+    *patch_str = buf;
+    return 0;
+
+CLEAN:
+    hmap_free(&covered);
+    free(buf);
+    return -1;
+}
+
+static int apply_patch_replace(struct mdd_track *track, struct mdd_node *node, const cJSON *value)
+{
+    CHECK_DO_RTN_VAL(!is_leaf_node(node->schema), LOG_WARN("Can not replace mo %s", node->schema->name), -1);
+
+    if (is_str_leaf((struct mds_leaf* )(node->schema)) || is_enum_leaf((struct mds_leaf* )(node->schema))) {
+        CHECK_DO_RTN_VAL(!cJSON_IsString(value), LOG_WARN("%s needs a string", node->schema->name), -1);
+        return mdd_set_str(track, node, value->valuestring);
+    }
+    CHECK_DO_RTN_VAL(!cJSON_IsNumber(value), LOG_WARN("%s needs a number", node->schema->name), -1);
+    return mdd_set_int(track, node, double_to_intv(value->valuedouble));
+}
+
+static int apply_patch_add(struct mdd_track *track, struct mdd_node *root, const char *path, const cJSON *value)
+{
+    char *parent_path = strdup(path);
+    CHECK_DO_RTN_VAL(!parent_path, LOG_WARN("Failed to dup string"), -1);
+
+    int rt = -1;
+    struct mdd_node *node = NULL;
+    char *name = strrchr(parent_path, '/');
+    CHECK_DO_GOTO(!name, LOG_WARN("Can not add root %s", path), CLEAN);
+
+    *name++ = '\0';
+    name[strcspn(name, "[")] = '\0';
+    struct mdd_node *parent = mdd_get_data(root, parent_path);
+    CHECK_DO_GOTO(!parent || !is_mo(parent->schema->mtype), LOG_WARN("Failed to find mo %s", parent_path), CLEAN);
+
+    struct mds_node *schema = mds_find_child_schema(parent->schema, name);
+    CHECK_DO_GOTO(!schema, LOG_WARN("invalid child %s under %s", name, parent_path), CLEAN);
+
+    node = value ? mdd_parse_child(schema, value) : NULL;
+    CHECK_DO_GOTO(!node || node->next, LOG_WARN("invalid data for %s", path), CLEAN);
+
+    rt = mdd_insert_node(track, parent, node);
+    if (!rt) {
+        node = NULL;
+    }
+
+CLEAN:
+    mdd_free_data(node);
+    free(parent_path);
+    return rt;
+}
+
+static int apply_patch_op(struct mdd_track *track, struct mdd_node *root, const cJSON *op)
+{
+    const cJSON *type = cJSON_GetObjectItemCaseSensitive(op, "op");
+    const cJSON *path = cJSON_GetObjectItemCaseSensitive(op, "path");
+    const cJSON *value = cJSON_GetObjectItemCaseSensitive(op, "value");
+    CHECK_DO_RTN_VAL(!cJSON_IsString(type) || !cJSON_IsString(path), LOG_WARN("Invalid patch op"), -1);
+
+    if (!strcmp(type->valuestring, "add")) {
+        return apply_patch_add(track, root, path->valuestring, value);
+    }
+
+    struct mdd_node *node = mdd_get_data(root, path->valuestring);
+    CHECK_DO_RTN_VAL(!node, LOG_WARN("Failed to find %s", path->valuestring), -1);
+
+    if (!strcmp(type->valuestring, "remove")) {
+        return mdd_delete_node(track, node);
+    } else if (!strcmp(type->valuestring, "replace")) {
+        return apply_patch_replace(track, node, value);
+    }
+    LOG_WARN("Invalid patch op:%s", type->valuestring);
+    return -1;
+}
+
+/*
+ * Replays a patch from mdd_diff_to_patch through the track, so the cost follows the patch
+ * size and the applied ops show up in the next dirty diff. Stops at the first failing op.
+ */
+int mdd_apply_patch(struct mdd_track *track, struct mdd_node *root, const char *patch_str)
+{
+    CHECK_DO_RTN_VAL(!track || !root || !patch_str, LOG_WARN("Null arg"), -1);
+
+    cJSON *patch = cJSON_Parse(patch_str);
+    CHECK_DO_RTN_VAL(!cJSON_IsArray(patch), LOG_WARN("Invalid patch %s", patch_str);cJSON_Delete(patch), -1);
+
+    int rt = 0;
+    for (cJSON *op = patch->child; op && !rt; op = op->next) {
+        rt = apply_patch_op(track, root, op);
+    }
+    cJSON_Delete(patch);
+    return rt;
+}
+
+struct mdd_node* mdd_new_node(struct mds_node *schema)
+{
+    CHECK_NULL_RTN(schema, NULL);
+
+    struct mdd_node *node = nodepool_alloc(is_leaf_node(schema) ? sizeof(struct mdd_leaf) : sizeof(struct mdd_mo));
+    CHECK_DO_RTN_VAL(!node, LOG_WARN("no memory!"), NULL);
+    node->schema = schema;
+    return node;
+}
+
+/* a node to be linked under parent, a leaf takes its slot in parent when that is free */
+struct mdd_node* mdd_new_child(struct mdd_node *parent, struct mds_node *schema)
+{
+    CHECK_NULL_RTN2(parent, schema, NULL);
+    CHECK_RTN_VAL(!is_leaf_node(schema) || schema->parent != parent->schema, mdd_new_node(schema));
+
+    struct mdd_mo *mo = (struct mdd_mo*) parent;
+    if (!mo->slots) {
+        void *block = nodepool_alloc(slots_size(mo->schema, ((struct mds_mo*) mo->schema)->leaf_cnt));
+        CHECK_DO_RTN_VAL(!block, LOG_WARN("no memory!"), NULL);
+        set_slots(mo, block, NULL);
+    }
+
+    struct mdd_leaf *leaf = take_slot(mo, schema);
+    return leaf ? (struct mdd_node*) leaf : mdd_new_node(schema);
+}
+
+/*
+ * Shrinks the slots of mo to the leaves it holds, moving them to a block of their own. Loaders
+ * call it once mo is built and before it is linked, while nothing else points at its leaves;
+ * without memory the block is kept as it is.
+ */
+void mdd_fit_slots(struct mdd_node *node)
+{
+    CHECK_RTN(!node || !is_mo(node->schema->mtype) || !((struct mdd_mo*) node)->slots);
+
+    struct mdd_mo *mo = (struct mdd_mo*) node;
+    unsigned int words = slot_words(mo->schema);
+    uint64_t *used = slot_bits(mo);
+    CHECK_RTN(!memcmp(slot_given(mo), used, words * sizeof(uint64_t)));
+
+    unsigned int cnt = count_bits(used, words);
+    CHECK_DO_RTN(!cnt, free_slots(mo));
+    void *block = nodepool_alloc(slots_size(mo->schema, cnt));
+    CHECK_RTN(!block);
+
+    struct mdd_mo old = *mo;
+    set_slots(mo, block, used);
+    struct mdd_leaf *leaf = mo->slots;
+    for (unsigned int i = 0; i < words; i++) {
+        for (uint64_t bits = used[i]; bits; bits &= bits - 1) {
+            *leaf = *slot_at(&old, i * 64 + __builtin_ctzll(bits));
+            if (leaf->prev) {
+                leaf->prev->next = (struct mdd_node*) leaf;
+            } else {
+                mo->child = (struct mdd_node*) leaf;
+            }
+            if (leaf->next) {
+                leaf->next->prev = (struct mdd_node*) leaf;
+            }
+            leaf++;
+        }
+    }
+    free_slots(&old);
+}
+
+/* stores str inline when it fits, interned in the string pool otherwise, and releases the value held before */
+int mdd_leaf_set_str(struct mdd_leaf *leaf, const char *str, size_t len)
+{
+    CHECK_NULL_RTN2(leaf, str, -1);
+
+    mdd_dvalue value;
+    memset(&value, 0, sizeof(mdd_dvalue));
+    if (len <= MDD_SSO_LEN) {
+        memcpy(value.sso, str, len);
+    } else {
+        value.strv = strpool_intern(str, len);
+        CHECK_DO_RTN_VAL(!value.strv, LOG_WARN("no memory!"), -1);
+        value.sso[MDD_SSO_LEN] = 1;
+    }
+    free_str_val(leaf);
+    leaf->value = value;
+    return 0;
+}
+
+/*
+ * Links child after prev, or first under parent without prev, for loaders that build a tree
+ * in document order. A list instance must be complete so it can enter the indexes of parent;
+ * one whose key or unique leaf is already taken is left unlinked and -1 returned.
+ */
+int mdd_link_child(struct mdd_node *parent, struct mdd_node *prev, struct mdd_node *child)
+{
+    CHECK_NULL_RTN2(parent, child, -1);
+
+    int rt = is_list_node(child->schema) ? check_list_key(child) || index_entry(parent, child) : 0;
+    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to index %s", child->schema->name), -1);
+    child->parent = parent;
+    child->prev = prev;
+    if (prev) {
+        prev->next = child;
+    } else {
+        parent->child = child;
+    }
+    return 0;
+}
+
+/* the chunk being filled, moved maps each old mo to its copy when given */
+struct compact_ctx{
+    struct mdd_chunk *chunk;
+    struct mdd_hmap *moved;
+};
+
+#define COMPACT_ROOM (MDD_CHUNK_SIZE - sizeof(struct mdd_chunk))
+
+/* zeroed room for size bytes behind the last node laid out, in a fresh chunk once this one is full */
+static void* compact_take(struct compact_ctx *cpt, size_t size)
+{
+    size = (size + 7) & ~(size_t) 7;
+    if (!cpt->chunk || cpt->chunk->used + size > MDD_CHUNK_SIZE) {
+        void *mem = NULL;
+        CHECK_DO_RTN_VAL(posix_memalign(&mem, MDD_CHUNK_SIZE, MDD_CHUNK_SIZE), LOG_WARN("no memory!"), NULL);
+        /* the chunk being filled holds one count of its own, dropped once it is left */
+        put_chunk(cpt->chunk);
+        cpt->chunk = (struct mdd_chunk*) mem;
+        cpt->chunk->live = 1;
+        cpt->chunk->used = sizeof(struct mdd_chunk);
+    }
+    void *node = (char*) cpt->chunk + cpt->chunk->used;
+    cpt->chunk->used += size;
+    cpt->chunk->live++;
+    memset(node, 0, size);
+    return node;
+}
+
+static struct mdd_node* compact_leaf(struct compact_ctx *cpt, struct mdd_leaf *old, struct mdd_node *parent)
+{
+    struct mdd_leaf *leaf = NULL;
+    if (old->schema->parent == parent->schema && ((struct mdd_mo*) parent)->slots) {
+        leaf = take_slot((struct mdd_mo*) parent, old->schema);
+    }
+    if (!leaf) {
+        leaf = compact_take(cpt, sizeof(struct mdd_leaf));
+        CHECK_RTN_VAL(!leaf, NULL);
+        leaf->schema = old->schema;
+        leaf->flags = MDD_F_CHUNK;
+    }
+    leaf->value = old->value;
+    if (is_str_leaf((struct mds_leaf* )(old->schema)) && old->value.sso[MDD_SSO_LEN]) {
+        strpool_ref(old->value.strv);
+    }
+    return (struct mdd_node*) leaf;
+}
+
+/* the leaf positions of mo held by one of its children, the first holder takes the slot */
+static uint64_t* held_leafs(struct mdd_mo *mo, unsigned int *cnt)
+{
+    uint64_t *held = calloc(slot_words(mo->schema), sizeof(uint64_t));
+    CHECK_DO_RTN_VAL(!held, LOG_WARN("no memory!"), NULL);
+
+    *cnt = 0;
+    for (struct mdd_node *child = mo->child; child; child = child->next) {
+        if (is_leaf_node(child->schema) && child->schema->parent == mo->schema) {
+            unsigned int pos = ((struct mds_leaf*) child->schema)->leaf_idx;
+            *cnt += !(held[pos / 64] >> (pos % 64) & 1);
+            held[pos / 64] |= 1ULL << (pos % 64);
+        }
+    }
+    return held;
+}
+
+/* the mo, then slots for the leaves it holds, then its child mos in turn */
+static struct mdd_node* compact_mo(struct compact_ctx *cpt, struct mdd_mo *old, struct mdd_node *parent)
+{
+    unsigned int cnt = 0;
+    uint64_t *held = held_leafs(old, &cnt);
+    CHECK_RTN_VAL(!held, NULL);
+    size_t slots = cnt ? slots_size(old->schema, cnt) : 0;
+
+    struct mdd_mo *mo = NULL;
+    void *block = NULL;
+    if (sizeof(struct mdd_mo) + slots <= COMPACT_ROOM) {
+        mo = compact_take(cpt, sizeof(struct mdd_mo) + slots);
+        CHECK_DO_RTN_VAL(!mo, free(held), NULL);
+        mo->schema = old->schema;
+        mo->flags = MDD_F_CHUNK;
+        block = mo + 1;
+    } else {
+        mo = (struct mdd_mo*) mdd_new_node(old->schema);
+        block = mo ? nodepool_alloc(slots) : NULL;
+        CHECK_DO_RTN_VAL(!block, LOG_WARN("no memory!");nodepool_free(mo, sizeof(struct mdd_mo));free(held), NULL);
+    }
+    if (cnt) {
+        set_slots(mo, block, held);
+    }
+    free(held);
+    struct mdd_node *node = (struct mdd_node*) mo;
+    mo->parent = parent;
+    CHECK_DO_RTN_VAL(cpt->moved && hmap_put(cpt->moved, (uintptr_t) old, mo), mdd_free_data(node), NULL);
+
+    struct mdd_node *prev = NULL;
+    for (struct mdd_node *child = old->child; child; child = child->next) {
+        struct mdd_node *copy = is_leaf_node(child->schema) ? compact_leaf(cpt, (struct mdd_leaf*) child, node) :
+                compact_mo(cpt, (struct mdd_mo*) child, node);
+        CHECK_DO_RTN_VAL(!copy, mdd_free_data(node), NULL);
+
+        CHECK_DO_RTN_VAL(mdd_link_child(node, prev, copy), mdd_free_data(copy);mdd_free_data(node), NULL);
+        prev = copy;
+    }
+    return node;
+}
+
+/*
+ * Lays the tree out again in pre-order, each mo followed by the slots of its leaves, in aligned
+ * chunks of MDD_CHUNK_SIZE, and frees the old nodes, so a walk reads memory front to back instead
+ * of hopping between allocations made edit by edit. Edits must have been taken by
+ * mdd_get_dirty_diff. Pointers into the old tree go stale, moved gets each old mo mapped to its
+ * copy when given. On failure the old tree is kept and NULL returned.
+ */
+struct mdd_node* mdd_compact_tree(struct mdd_node *root, struct mdd_hmap *moved)
+{
+    CHECK_DO_RTN_VAL(!root || root->parent || root->next || !is_mo(root->schema->mtype), LOG_WARN("Invalid root"),
+            NULL);
+    CHECK_DO_RTN_VAL(root->flags & MDD_F_PENDING, LOG_WARN("Tree has edits not taken"), NULL);
+
+    struct compact_ctx cpt = {NULL, moved};
+    struct mdd_node *copy = compact_mo(&cpt, (struct mdd_mo*) root, NULL);
+    put_chunk(cpt.chunk);
+    CHECK_RTN_VAL(!copy, NULL);
+
+    mdd_free_data(root);
+    return copy;
+}
+
+#define SNAP_MAGIC "MDDS"
+#define SNAP_VERSION 1
+#define SNAP_HEAD_LEN 9
+
+static int snap_write_varint(char **buf, size_t *size, size_t *posi, unsigned long long val)
+{
+    char tmp[10];
+    size_t len = 0;
+    do {
+        tmp[len++] = (char) ((val & 0x7f) | (val > 0x7f ? 0x80 : 0));
+        val >>= 7;
+    } while (val);
+    return dump_write_mem(buf, size, posi, tmp, len);
+}
+
+static int snap_write_node(struct mds_table *table, struct mdd_node *node, char **buf, size_t *size, size_t *posi)
+{
+    long id = mds_table_id(table, node->schema);
+    CHECK_DO_RTN_VAL(id < 0, LOG_WARN("Unknown schema %s", node->schema->name), -1);
+    CHECK_RTN_VAL(snap_write_varint(buf, size, posi, id), -1);
+
+    if (is_leaf_node(node->schema)) {
+        struct mdd_leaf *leaf = (struct mdd_leaf*) node;
+        if (is_intv_leaf((struct mds_leaf* ) leaf->schema)) {
+            unsigned long long val = (unsigned long long) leaf->value.intv;
+            return snap_write_varint(buf, size, posi, (val << 1) ^ (0 - (val >> 63)));
+        }
+        const char *str = str_leaf_val(leaf);
+        size_t len = strlen(str);
+        CHECK_RTN_VAL(snap_write_varint(buf, size, posi, len), -1);
+        return dump_write_mem(buf, size, posi, str, len);
+    }
+
+    size_t nchild = 0;
+    for (struct mdd_node *child = node->child; child; child = child->next) {
+        nchild++;
+    }
+    CHECK_RTN_VAL(snap_write_varint(buf, size, posi, nchild), -1);
+    for (struct mdd_node *child = node->child; child; child = child->next) {
+        CHECK_RTN_VAL(snap_write_node(table, child, buf, size, posi), -1);
+    }
+    return 0;
+}
+
+/*
+ * Binary snapshot of the tree: a header of magic, version and schema fingerprint, then the
+ * nodes in pre-order. Each node is its pre-order schema id, then a mo has its child count,
+ * an int leaf its zigzag value and a string leaf its length and bytes, all as varints.
+ */
+int mdd_dump_snapshot(struct mdd_node *root, char **buf, size_t *len)
+{
+    CHECK_DO_RTN_VAL(!root || !buf || !len, LOG_WARN("Null arg"), -1);
+
+    struct mds_node *schema = root->schema;
+    while (schema->parent) {
+        schema = schema->parent;
+    }
+    struct mds_table table;
+    CHECK_RTN_VAL(mds_table_init(&table, schema), -1);
+
+    size_t size = 64 * 1024;
+    size_t posi = 0;
+    char *data = malloc(size);
+    CHECK_DO_GOTO(!data, LOG_WARN("No memory"), CLEAN);
+
+    unsigned char head[SNAP_HEAD_LEN] = {'M', 'D', 'D', 'S', SNAP_VERSION};
+    for (int i = 0; i < 4; i++) {
+        head[5 + i] = (unsigned char) (table.fingerprint >> (i * 8));
+    }
+    CHECK_DO_GOTO(dump_write_mem(&data, &size, &posi, (char*) head, SNAP_HEAD_LEN), LOG_WARN("No memory"), CLEAN);
+    CHECK_DO_GOTO(snap_write_node(&table, root, &data, &size, &posi), LOG_WARN("Failed to dump snapshot"), CLEAN);
+
+    mds_table_free(&table);
+    *buf = data;
+    *len = posi;
+    return 0;
+
+CLEAN:
+    free(data);
+    mds_table_free(&table);
+    return -1;
+}
+
+struct snap_reader{
+    const unsigned char *pos;
+    const unsigned char *end;
+    struct mds_table *table;
+};
+
+static int snap_read_varint(struct snap_reader *reader, unsigned long long *val)
+{
+    *val = 0;
+    for (int shift = 0; reader->pos < reader->end && shift < 64; shift += 7) {
+        unsigned char byte = *reader->pos++;
+        *val |= (unsigned long long) (byte & 0x7f) << shift;
+        CHECK_RTN_VAL(!(byte & 0x80), 0);
+    }
+    LOG_WARN("Truncated varint in snapshot");
+    return -1;
+}
+
+static struct mdd_node* snap_read_leaf(struct snap_reader *reader, struct mds_node *schema, struct mdd_node *parent)
+{
+    unsigned long long val = 0;
+    CHECK_RTN_VAL(snap_read_varint(reader, &val), NULL);
+
+    struct mdd_leaf *leaf = (struct mdd_leaf*) (parent ? mdd_new_child(parent, schema) : mdd_new_node(schema));
+    CHECK_RTN_VAL(!leaf, NULL);
+    leaf->parent = parent;
+    if (is_intv_leaf((struct mds_leaf* ) schema)) {
+        leaf->value.intv = (long long) ((val >> 1) ^ (0 - (val & 1)));
+        CHECK_DO_RTN_VAL(is_enum_leaf((struct mds_leaf* ) schema) && !mds_enum_name(schema, leaf->value.intv),
+                LOG_WARN("Invalid enum value in snapshot");mdd_free_data((struct mdd_node*) leaf), NULL);
+        return (struct mdd_node*) leaf;
+    }
+
+    CHECK_DO_RTN_VAL(val > (unsigned long long) (reader->end - reader->pos),
+            LOG_WARN("Truncated string in snapshot");mdd_free_data((struct mdd_node*) leaf), NULL);
+    CHECK_DO_RTN_VAL(mdd_leaf_set_str(leaf, (const char*) reader->pos, val), mdd_free_data((struct mdd_node*) leaf),
+            NULL);
+    reader->pos += val;
+    return (struct mdd_node*) leaf;
+}
+
+static struct mdd_node* snap_read_node(struct snap_reader *reader, struct mds_node *expect, struct mdd_node *parent)
+{
+    unsigned long long id = 0;
+    CHECK_RTN_VAL(snap_read_varint(reader, &id), NULL);
+    CHECK_DO_RTN_VAL(id >= reader->table->cnt, LOG_WARN("Invalid schema id %llu in snapshot", id), NULL);
+
+    struct mds_node *schema = reader->table->nodes[id];
+    CHECK_DO_RTN_VAL(expect ? schema->parent != expect : schema->parent != NULL,
+            LOG_WARN("Misplaced %s in snapshot", schema->name), NULL);
+    CHECK_RTN_VAL(is_leaf_node(schema), snap_read_leaf(reader, schema, parent));
+
+    unsigned long long nchild = 0;
+    CHECK_RTN_VAL(snap_read_varint(reader, &nchild), NULL);
+    struct mdd_mo *mo = (struct mdd_mo*) nodepool_alloc(sizeof(struct mdd_mo));
+    CHECK_DO_RTN_VAL(!mo, LOG_WARN("no memory!"), NULL);
+    mo->schema = schema;
+    mo->parent = parent;
+
+    struct mdd_node *node = (struct mdd_node*) mo;
+    struct mdd_node *prev = NULL;
+    for (unsigned long long i = 0; i < nchild; i++) {
+        struct mdd_node *child = snap_read_node(reader, schema, node);
+        CHECK_DO_RTN_VAL(!child, mdd_free_data(node), NULL);
+
+        CHECK_DO_RTN_VAL(mdd_link_child(node, prev, child), mdd_free_data(child);mdd_free_data(node), NULL);
+        prev = child;
+    }
+    mdd_fit_slots(node);
+    return node;
+}
+
+/* rebuilds a tree from mdd_dump_snapshot in one pass, the snapshot must come from the same schema */
+struct mdd_node* mdd_load_snapshot(struct mds_node *schema, const char *buf, size_t len)
+{
+    CHECK_DO_RTN_VAL(!schema || !buf, LOG_WARN("Null arg"), NULL);
+    CHECK_DO_RTN_VAL(len < SNAP_HEAD_LEN || memcmp(buf, SNAP_MAGIC, 4) || buf[4] != SNAP_VERSION,
+            LOG_WARN("Not a snapshot"), NULL);
+
+    struct mds_table table;
+    CHECK_RTN_VAL(mds_table_init(&table, schema), NULL);
+
+    uint32_t fingerprint = 0;
+    for (int i = 0; i < 4; i++) {
+        fingerprint |= (uint32_t) (unsigned char) buf[5 + i] << (i * 8);
+    }
+    struct mdd_node *root = NULL;
+    CHECK_DO_GOTO(fingerprint != table.fingerprint, LOG_WARN("Snapshot was taken with another schema"), CLEAN);
+
+    struct snap_reader reader = {(const unsigned char*) buf + SNAP_HEAD_LEN, (const unsigned char*) buf + len, &table};
+    root = snap_read_node(&reader, NULL, NULL);
+    if (root && reader.pos != reader.end) {
+        LOG_WARN("Trailing bytes in snapshot");
+        mdd_free_data(root);
+        root = NULL;
+    }
+
+CLEAN:
+    mds_table_free(&table);
+    return root;
+}
+
+int mdd_is_snapshot(const char *buf, size_t len)
+{
+    return buf && len >= SNAP_HEAD_LEN && !memcmp(buf, SNAP_MAGIC, 4);
 }
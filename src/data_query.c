@@ -0,0 +1,326 @@
+#include <stdlib.h>
+#include <string.h>
+#include "macro.h"
+#include "log.h"
+#include "data_query.h"
+
+typedef enum {
+    QOP_EQ, QOP_NE, QOP_LT, QOP_LE, QOP_GT, QOP_GE
+} query_op;
+
+struct query_pred{
+    const char *leaf;
+    query_op op;
+    const char *strv;
+    long long intv;
+    int is_int;
+};
+
+struct query_step{
+    const char *name;
+    struct query_pred *preds;
+    size_t npred;
+    const struct query_pred *key;
+};
+
+/* names and values point into buf, the owned copy of the expression */
+struct mdd_query{
+    char *buf;
+    size_t nstep;
+    struct query_step *steps;
+};
+
+/* the last node matched at one step, and the index cursor feeding that step if any */
+struct query_level{
+    struct mdd_node *node;
+    int indexed;
+    struct mdd_index_cursor cursor;
+};
+
+struct mdd_query_iter{
+    const struct mdd_query *query;
+    struct mdd_query *owned;
+    struct mdd_node *root;
+    int started;
+    int done;
+    struct query_level levels[];
+};
+
+static const char *OP_STRS[] = {"!=", "<=", ">=", "=", "<", ">"};
+static const query_op OP_VALS[] = {QOP_NE, QOP_LE, QOP_GE, QOP_EQ, QOP_LT, QOP_GT};
+
+/* splits `leaf op value` in place */
+static int parse_pred(char *text, struct query_pred *pred)
+{
+    size_t len = strcspn(text, "!<>=");
+    CHECK_DO_RTN_VAL(!len || !text[len], LOG_WARN("Invalid predicate:%s", text), -1);
+
+    char *op = text + len;
+    size_t i = 0;
+    for (; i < sizeof(OP_STRS) / sizeof(OP_STRS[0]); i++) {
+        if (!strncmp(op, OP_STRS[i], strlen(OP_STRS[i]))) {
+            break;
+        }
+    }
+    CHECK_DO_RTN_VAL(i == sizeof(OP_STRS) / sizeof(OP_STRS[0]), LOG_WARN("Invalid operator:%s", op), -1);
+
+    pred->leaf = text;
+    pred->op = OP_VALS[i];
+    pred->strv = op + strlen(OP_STRS[i]);
+    *op = '\0';
+
+    char *end = NULL;
+    pred->intv = strtoll(pred->strv, &end, 10);
+    pred->is_int = *pred->strv && !*end;
+    CHECK_DO_RTN_VAL(pred->op != QOP_EQ && pred->op != QOP_NE && !pred->is_int,
+            LOG_WARN("%s needs an int operand", text), -1);
+    return 0;
+}
+
+static int parse_step(char *text, struct query_step *step)
+{
+    char *pred = strchr(text, '[');
+    step->name = text;
+    CHECK_RTN_VAL(!pred, 0);
+
+    for (char *iter = pred; *iter; iter++) {
+        step->npred += *iter == '[';
+    }
+    step->preds = calloc(step->npred, sizeof(struct query_pred));
+    CHECK_DO_RTN_VAL(!step->preds, LOG_WARN("No memory"), -1);
+
+    for (size_t i = 0; i < step->npred; i++) {
+        CHECK_DO_RTN_VAL(*pred != '[', LOG_WARN("Invalid predicates in %s", text), -1);
+        *pred++ = '\0';
+
+        char *close = strchr(pred, ']');
+        CHECK_DO_RTN_VAL(!close, LOG_WARN("Unclosed predicate in %s", text), -1);
+        *close = '\0';
+
+        struct query_pred *p = &step->preds[i];
+        CHECK_RTN_VAL(parse_pred(pred, p), -1);
+        if (!step->key && strcmp(step->name, "*") && p->op == QOP_EQ && p->is_int && !strcmp(p->leaf, "Id")) {
+            step->key = p;
+        }
+        pred = close + 1;
+    }
+    CHECK_DO_RTN_VAL(*pred, LOG_WARN("Trailing characters in %s", text), -1);
+    return 0;
+}
+
+struct mdd_query* mdd_query_compile(const char *expr)
+{
+    CHECK_NULL_RTN(expr, NULL);
+
+    struct mdd_query *query = calloc(1, sizeof(struct mdd_query));
+    CHECK_DO_RTN_VAL(!query, LOG_WARN("No memory"), NULL);
+
+    query->buf = strdup(expr);
+    CHECK_DO_GOTO(!query->buf, LOG_WARN("No memory"), EXCEPTION);
+
+    size_t cap = 1;
+    for (const char *iter = expr; *iter; iter++) {
+        cap += *iter == '/';
+    }
+    query->steps = calloc(cap, sizeof(struct query_step));
+    CHECK_DO_GOTO(!query->steps, LOG_WARN("No memory"), EXCEPTION);
+
+    for (char *save = NULL, *text = strtok_r(query->buf, "/", &save); text; text = strtok_r(NULL, "/", &save)) {
+        CHECK_GOTO(parse_step(text, &query->steps[query->nstep++]), EXCEPTION);
+    }
+    CHECK_DO_GOTO(!query->nstep, LOG_WARN("Empty query"), EXCEPTION);
+    return query;
+
+EXCEPTION:
+    LOG_WARN("Failed to compile query:%s", expr);
+    mdd_query_free(query);
+    return NULL;
+}
+
+void mdd_query_free(struct mdd_query *query)
+{
+    CHECK_RTN(!query);
+
+    for (size_t i = 0; i < query->nstep; i++) {
+        free(query->steps[i].preds);
+    }
+    free(query->steps);
+    free(query->buf);
+    free(query);
+}
+
+static struct mdd_leaf* find_leaf(struct mdd_node *node, const char *name)
+{
+    for (struct mdd_node *iter = node->child; iter; iter = iter->next) {
+        if (is_leaf(iter->schema->mtype) && !strcmp(iter->schema->name, name)) {
+            return (struct mdd_leaf*) iter;
+        }
+    }
+    return NULL;
+}
+
+static int cmp_op(query_op op, int cmp)
+{
+    switch (op) {
+        case QOP_EQ:
+            return cmp == 0;
+        case QOP_NE:
+            return cmp != 0;
+        case QOP_LT:
+            return cmp < 0;
+        case QOP_LE:
+            return cmp <= 0;
+        case QOP_GT:
+            return cmp > 0;
+        case QOP_GE:
+            return cmp >= 0;
+        default:
+            return 0;
+    }
+}
+
+static int match_pred(struct mdd_node *node, const struct query_pred *pred)
+{
+    struct mdd_leaf *leaf = find_leaf(node, pred->leaf);
+    CHECK_RTN_VAL(!leaf, 0);
+
+    struct mds_leaf *schema = (struct mds_leaf*) leaf->schema;
+    if (schema->dtype == MDS_DT_INT) {
+        CHECK_RTN_VAL(!pred->is_int, pred->op == QOP_NE);
+        return cmp_op(pred->op, (leaf->value.intv > pred->intv) - (leaf->value.intv < pred->intv));
+    } else if (schema->dtype == MDS_DT_STR) {
+        CHECK_RTN_VAL(pred->op != QOP_EQ && pred->op != QOP_NE, 0);
+        return cmp_op(pred->op, strcmp(str_leaf_val(leaf), pred->strv));
+    } else if (schema->dtype == MDS_DT_ENUM) {
+        CHECK_RTN_VAL(pred->op != QOP_EQ && pred->op != QOP_NE, 0);
+        return cmp_op(pred->op, strcmp(mds_enum_name(leaf->schema, leaf->value.intv), pred->strv));
+    }
+    return 0;
+}
+
+static int match_step(struct mdd_node *node, const struct query_step *step)
+{
+    CHECK_RTN_VAL(strcmp(step->name, "*") && strcmp(step->name, node->schema->name), 0);
+
+    for (size_t i = 0; i < step->npred; i++) {
+        if (!match_pred(node, &step->preds[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* an = predicate on an indexed leaf feeds the step from the index instead of the siblings */
+static int seek_indexed(struct mdd_node *parent, struct mds_node *lists, const struct query_step *step,
+        struct query_level *level)
+{
+    for (size_t i = 0; i < step->npred; i++) {
+        const struct query_pred *pred = &step->preds[i];
+        if (pred->op == QOP_EQ && !mdd_index_seek(parent, lists, pred->leaf, pred->strv, &level->cursor)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* the next child of parent after the level's last match, keys are unique so a key hit ends the scan */
+static struct mdd_node* seek_step(struct mdd_node *parent, struct query_level *level, const struct query_step *step)
+{
+    struct mdd_node *prev = level->node;
+    struct mds_node *lists = NULL;
+    if (!prev && strcmp(step->name, "*")) {
+        lists = mds_find_child_schema(parent->schema, step->name);
+        CHECK_RTN_VAL(!lists, NULL);
+        level->indexed = is_list_node(lists) && !step->key && seek_indexed(parent, lists, step, level);
+    }
+
+    if (step->key) {
+        CHECK_RTN_VAL(prev || !is_list_node(lists), NULL);
+
+        struct mdd_node *node = mdd_find_list(parent, lists, step->key->intv);
+        return node && match_step(node, step) ? node : NULL;
+    }
+
+    if (level->indexed) {
+        for (struct mdd_node *node = mdd_index_next(&level->cursor); node; node = mdd_index_next(&level->cursor)) {
+            if (match_step(node, step)) {
+                return node;
+            }
+        }
+        return NULL;
+    }
+
+    for (struct mdd_node *iter = prev ? prev->next : parent->child; iter; iter = iter->next) {
+        if (match_step(iter, step)) {
+            return iter;
+        }
+    }
+    return NULL;
+}
+
+struct mdd_query_iter* mdd_query_open(const struct mdd_query *query, struct mdd_node *root)
+{
+    CHECK_NULL_RTN2(query, root, NULL);
+
+    struct mdd_query_iter *iter = calloc(1, sizeof(struct mdd_query_iter) + query->nstep * sizeof(struct query_level));
+    CHECK_DO_RTN_VAL(!iter, LOG_WARN("No memory"), NULL);
+
+    iter->query = query;
+    iter->root = root;
+    return iter;
+}
+
+struct mdd_query_iter* mdd_query_open_expr(const char *expr, struct mdd_node *root)
+{
+    CHECK_NULL_RTN2(expr, root, NULL);
+
+    struct mdd_query *query = mdd_query_compile(expr);
+    CHECK_RTN_VAL(!query, NULL);
+
+    struct mdd_query_iter *iter = mdd_query_open(query, root);
+    CHECK_DO_RTN_VAL(!iter, mdd_query_free(query), NULL);
+    iter->owned = query;
+    return iter;
+}
+
+/* depth first over the steps, each level resumes after the last node it matched */
+struct mdd_node* mdd_query_next(struct mdd_query_iter *iter)
+{
+    CHECK_RTN_VAL(!iter || iter->done, NULL);
+
+    const struct mdd_query *query = iter->query;
+    size_t level = query->nstep - 1;
+    if (!iter->started) {
+        iter->started = 1;
+        iter->done = query->nstep == 1;
+        CHECK_DO_RTN_VAL(!match_step(iter->root, &query->steps[0]), iter->done = 1, NULL);
+
+        iter->levels[0].node = iter->root;
+        CHECK_RTN_VAL(iter->done, iter->root);
+        level = 1;
+    }
+
+    while (level > 0) {
+        struct query_level *cur = &iter->levels[level];
+        cur->node = seek_step(iter->levels[level - 1].node, cur, &query->steps[level]);
+        if (!cur->node) {
+            level--;
+            continue;
+        }
+        if (level == query->nstep - 1) {
+            return cur->node;
+        }
+        level++;
+        iter->levels[level].node = NULL;
+    }
+    iter->done = 1;
+    return NULL;
+}
+
+void mdd_query_close(struct mdd_query_iter *iter)
+{
+    CHECK_RTN(!iter);
+
+    mdd_query_free(iter->owned);
+    free(iter);
+}
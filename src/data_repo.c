@@ -1,12 +1,50 @@
+#include <fcntl.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "macro.h"
 #include "log.h"
 #include "data_repo.h"
 #include "data_parser.h"
 #include "model_parser.h"
+#include "data_store.h"
+#include "data_column.h"
+#include "data_pack.h"
+#include "thread_pool.h"
+
+#define REPO_MAX_DIFF_CB 8
+#define REPO_MAX_AGG 32
+
+struct repo_diff_hook
+{
+    repo_diff_cb cb;
+    void *arg;
+};
+
+/*
+ * A stale aggregate missed a diff, or was registered while edits were pending, and is reloaded on
+ * the next read once none are: the running tree holds pending edits, which the next commit applies
+ * to the aggregate as a diff, so loading them too would count them twice. One over a column snapshot
+ * list is never loaded: it reads a snapshot of the list, taken again on the next read without
+ * pending edits once the list changed in a version after the snapshot's.
+ */
+struct repo_agg
+{
+    struct mdd_agg *agg;
+    int stale;
+    int snapshot;
+    struct mdd_columns *cols;
+    unsigned long long changed;
+};
+
+/* how the data file is kept, chosen by its format at repo_init */
+typedef enum {
+    REPO_ENGINE_JSON, REPO_ENGINE_SNAPSHOT, REPO_ENGINE_STORE
+} repo_engine;
 
 struct repo_ctx
 {
@@ -15,6 +53,20 @@ struct repo_ctx
     struct mds_node *schema;
     struct mdd_node *running;
     struct mdd_node *editing;
+    struct mdd_track track;
+    /* bodies of the running mos cached by repo_dump and repo_get_json, the track drops them on edit */
+    struct mdd_frag_cache frags;
+    /* packed copy of the committed tree at pack_version for repo_read_int and repo_read_str */
+    struct mdd_pack *pack;
+    unsigned long long pack_version;
+    struct mdd_pool *pool;
+    unsigned long long version;
+    repo_engine engine;
+    struct mdd_store *store;
+    unsigned int compact_interval;
+    unsigned int commits;
+    struct repo_diff_hook hooks[REPO_MAX_DIFF_CB];
+    struct repo_agg aggs[REPO_MAX_AGG];
 };
 
 static struct repo_ctx ctx;
@@ -47,11 +99,42 @@ static char* load_file(const char *file_path)
     return buffer;
 }
 
+/* maps the data file and loads it in one pass when it is a binary snapshot, is_snapshot tells JSON files apart */
+static struct mdd_node* load_snapshot(const char *file_path, int *is_snapshot)
+{
+    *is_snapshot = 0;
+    int fd = open(file_path, O_RDONLY);
+    CHECK_RTN_VAL(fd < 0, NULL);
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (!fstat(fd, &st) && st.st_size > 0) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    CHECK_RTN_VAL(map == MAP_FAILED, NULL);
+
+    struct mdd_node *root = NULL;
+    if (mdd_is_snapshot(map, st.st_size)) {
+        *is_snapshot = 1;
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+        root = mdd_load_snapshot(ctx.schema, map, st.st_size);
+        if (!root) {
+            LOG_WARN("failed to load snapshot: %s", file_path);
+        }
+    }
+    munmap(map, st.st_size);
+    return root;
+}
+
 int repo_init(const char *schema_path, const char *data_path)
 {
     memset(&ctx, 0, sizeof(struct repo_ctx));
     ctx.schema_file = strdup(schema_path);
     ctx.data_file = strdup(data_path);
+    CHECK_DO_RTN_VAL(mdd_track_init(&ctx.track), LOG_WARN("failed to init change track"), -1);
+    CHECK_DO_RTN_VAL(mdd_frag_init(&ctx.frags), LOG_WARN("failed to init fragment cache"), -1);
+    ctx.track.frags = &ctx.frags;
 
     char *schema_buff = load_file(schema_path);
     CHECK_DO_RTN_VAL(!schema_buff, LOG_WARN("failed to load schema"), -1);
@@ -59,6 +142,19 @@ int repo_init(const char *schema_path, const char *data_path)
     free(schema_buff);
     schema_buff = NULL;
 
+    if (mdd_store_probe(data_path)) {
+        ctx.engine = REPO_ENGINE_STORE;
+        ctx.store = mdd_store_open(data_path, ctx.schema, &ctx.running);
+        return ctx.store ? 0 : -1;
+    }
+
+    int is_snapshot = 0;
+    ctx.running = load_snapshot(data_path, &is_snapshot);
+    if (is_snapshot) {
+        ctx.engine = REPO_ENGINE_SNAPSHOT;
+        return ctx.running ? 0 : -1;
+    }
+
     char *data_buff = load_file(data_path);
     CHECK_DO_RTN_VAL(!data_buff, LOG_WARN("failed to load data"), -1);
     ctx.running = mdd_parse_data(ctx.schema, data_buff);
@@ -74,6 +170,15 @@ void repo_free()
     free(ctx.schema_file);
     mdd_free_data(ctx.running);
     mdd_free_data(ctx.editing);
+    mdd_track_free(&ctx.track);
+    mdd_frag_free(&ctx.frags);
+    mdd_pack_free(ctx.pack);
+    pool_destroy(ctx.pool);
+    mdd_store_close(ctx.store);
+    for (int i = 0; i < REPO_MAX_AGG; i++) {
+        mdd_agg_free(ctx.aggs[i].agg);
+        mdd_columns_free(ctx.aggs[i].cols);
+    }
     mds_free_model(ctx.schema);
     memset(&ctx, 0, sizeof(struct repo_ctx));
 }
@@ -86,10 +191,97 @@ int repo_get(const char *path, struct mdd_node **out)
     return (*out) ? 0 : -1;
 }
 
+/* fills out[i] for paths[i], NULL where a path does not resolve, and fails unless all resolve */
+int repo_get_many(const char **paths, size_t n, struct mdd_node **out)
+{
+    CHECK_DO_RTN_VAL(!paths || !out, LOG_WARN("NULL Para"), -1);
+
+    int found = mdd_get_many(ctx.running, paths, n, out);
+    return found >= 0 && (size_t) found == n ? 0 : -1;
+}
+
+/* the pack of the committed tree, packed again after a commit changed it, NULL while edits are pending */
+static struct mdd_pack* committed_pack()
+{
+    CHECK_RTN_VAL(!ctx.running || repo_pending(), NULL);
+    CHECK_RTN_VAL(ctx.pack && ctx.pack_version == ctx.version, ctx.pack);
+
+    mdd_pack_free(ctx.pack);
+    ctx.pack = mdd_pack_build(ctx.running);
+    ctx.pack_version = ctx.version;
+    if (!ctx.pack) {
+        LOG_WARN("Failed to pack version %llu, reads go to the running tree", ctx.version);
+    }
+    return ctx.pack;
+}
+
+int repo_read_int(const char *path, long long *val)
+{
+    CHECK_DO_RTN_VAL(!path || !val, LOG_WARN("NULL Para"), -1);
+
+    struct mdd_pack *pack = committed_pack();
+    CHECK_RTN_VAL(pack, mdd_pack_int(pack, mdd_pack_get(pack, path), val));
+
+    struct mdd_node *leaf = mdd_get_data(ctx.running, path);
+    CHECK_RTN_VAL(!leaf || !is_intv_leaf((struct mds_leaf*) leaf->schema), -1);
+    *val = ((struct mdd_leaf*) leaf)->value.intv;
+    return 0;
+}
+
+int repo_read_str(const char *path, char *buf, size_t size)
+{
+    CHECK_DO_RTN_VAL(!path || !buf, LOG_WARN("NULL Para"), -1);
+
+    const char *str = NULL;
+    struct mdd_pack *pack = committed_pack();
+    if (pack) {
+        str = mdd_pack_str(pack, mdd_pack_get(pack, path));
+    } else {
+        struct mdd_node *leaf = mdd_get_data(ctx.running, path);
+        struct mds_node *schema = leaf ? leaf->schema : NULL;
+        str = !schema ? NULL : is_str_leaf((struct mds_leaf*) schema) ? str_leaf_val(leaf) :
+                is_enum_leaf((struct mds_leaf*) schema) ? mds_enum_name(schema, int_leaf_val(leaf)) : NULL;
+    }
+    CHECK_RTN_VAL(!str, -1);
+
+    size_t len = strlen(str);
+    CHECK_DO_RTN_VAL(len >= size, LOG_WARN("Value of %s takes %zu bytes", path, len + 1), -1);
+    memcpy(buf, str, len + 1);
+    return 0;
+}
+
+/* iterates the running tree, close with mdd_query_close before the next commit */
+struct mdd_query_iter* repo_query(const char *expr)
+{
+    CHECK_DO_RTN_VAL(!expr || !ctx.running, LOG_WARN("NULL Para"), NULL);
+
+    return mdd_query_open_expr(expr, ctx.running);
+}
+
+/* list_path names the list below its parent mo, e.g. Data/ChildList; the full key range is an ordered cursor */
+int repo_list_range(const char *list_path, long long lo, long long hi, struct mdd_list_cursor *cursor)
+{
+    CHECK_DO_RTN_VAL(!list_path || !cursor, LOG_WARN("NULL Para"), -1);
+
+    const char *name = strrchr(list_path, '/');
+    CHECK_DO_RTN_VAL(!name, LOG_WARN("Invalid list path %s", list_path), -1);
+
+    char *parent_path = strndup(list_path, name - list_path);
+    CHECK_DO_RTN_VAL(!parent_path, LOG_WARN("No memory"), -1);
+
+    struct mdd_node *parent = mdd_get_data(ctx.running, parent_path);
+    free(parent_path);
+    CHECK_DO_RTN_VAL(!parent || !is_mo(parent->schema->mtype), LOG_WARN("Failed to find parent of %s", list_path), -1);
+
+    struct mds_node *lists = mds_find_child_schema(parent->schema, name + 1);
+    CHECK_DO_RTN_VAL(!lists, LOG_WARN("Failed to find list %s", list_path), -1);
+
+    return mdd_list_range(parent, lists, lo, hi, cursor);
+}
+
 //TODO: consider file broken 
-static int write_file(const char *file_path, char *buffer)
+static int write_file(const char *file_path, const char *buffer, size_t len)
 {
-    size_t len = strlen(buffer);
     size_t cnt = 0;
     FILE *fp = fopen(file_path, "w");
     CHECK_DO_RTN_VAL(!fp, LOG_WARN("failed to load file: %s", file_path), -1);
@@ -104,31 +296,133 @@ static int write_file(const char *file_path, char *buffer)
     return 0;
 }
 
-static int deal_edit()
+/* the data file keeps the format it was loaded in, the store only writes what diff touched */
+static int persist_running(const mdd_diff *diff)
 {
-    mdd_diff *diff = mdd_get_diff(ctx.schema, ctx.running, ctx.editing);
-    if (diff) {//TODO: register diff callback
+    if (ctx.engine == REPO_ENGINE_STORE) {
+        int rt = mdd_store_commit(ctx.store, ctx.running, diff);
+        CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to persist new data"), -1);
+        return 0;
+    }
+
+    char *buf = NULL;
+    size_t len = 0;
+    int snapshot = ctx.engine == REPO_ENGINE_SNAPSHOT;
+    int rt = snapshot ? mdd_dump_snapshot(ctx.running, &buf, &len) : mdd_dump_data_cached(&ctx.frags, ctx.running, &buf);
+    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to dump new data"), -1);
+
+    rt = write_file(ctx.data_file, buf, snapshot ? len : strlen(buf));
+    free(buf);
+    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to persist new data"), -1);
+
+    return rt;
+}
+
+static struct mds_node* agg_lists(const struct mdd_agg *agg)
+{
+    struct mds_node *lists = NULL;
+    struct mds_node *leaf = NULL;
+    mdd_agg_type type;
+    mdd_agg_target(agg, &lists, &leaf, &type);
+    return lists;
+}
+
+static int diff_touches(const mdd_diff *diff, const struct mdd_agg *agg)
+{
+    struct mds_node *lists = agg_lists(agg);
+    for (size_t i = 0; i < diff->size; i++) {
+        struct mdd_mo *mo = diff->vec[i]->edit_data ? diff->vec[i]->edit_data : diff->vec[i]->run_data;
+        CHECK_RTN_VAL(mo->schema == lists, 1);
+    }
+    return 0;
+}
+
+/*
+ * Every commit that changes the running tree gets the next version. A NULL diff stands for a tree
+ * replaced without one: it still takes a version, every aggregate goes stale and the hooks get NULL.
+ */
+static void notify_diff(mdd_diff *diff)
+{
+    CHECK_RTN(diff && !diff->size);
+
+    if (diff) {
         mdd_dump_diff(diff);
-        mdd_free_diff(diff);
     }
+    ctx.version++;
+    for (int i = 0; i < REPO_MAX_AGG; i++) {
+        if (ctx.aggs[i].snapshot) {
+            ctx.aggs[i].changed = !diff || diff_touches(diff, ctx.aggs[i].agg) ? ctx.version : ctx.aggs[i].changed;
+        } else if (ctx.aggs[i].agg && !ctx.aggs[i].stale && (!diff || mdd_agg_apply(ctx.aggs[i].agg, diff))) {
+            ctx.aggs[i].stale = 1;
+        }
+    }
+    for (int i = 0; i < REPO_MAX_DIFF_CB; i++) {
+        if (ctx.hooks[i].cb) {
+            ctx.hooks[i].cb(diff, ctx.version, ctx.hooks[i].arg);
+        }
+    }
+}
 
+static int deal_edit()
+{
+    mdd_diff *diff = mdd_get_diff_parallel(ctx.schema, ctx.running, ctx.editing, ctx.pool);
+    if (!diff) {
+        LOG_WARN("Failed to diff the edit, it is published without one");
+    }
+    notify_diff(diff);
+    mdd_free_diff(diff);
+
+    mdd_frag_clear(&ctx.frags);
     mdd_free_data(ctx.running);
     ctx.running = ctx.editing;
     ctx.editing = NULL;
+    ctx.commits = 0;
 
-    char *buf = NULL;
-    int rt = mdd_dump_data(ctx.running, &buf);
-    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to dump new data"), -1);
+    return persist_running(NULL);
+}
 
-    rt = write_file(ctx.data_file, buf);
-    free(buf);
-    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to persist new data"), -1);
+/* the store records and the cached fragments are keyed by mo, they follow the mos to their copies */
+static int compact_running()
+{
+    struct mdd_hmap moved;
+    CHECK_RTN_VAL(hmap_init(&moved, 0), -1);
+
+    int follow = ctx.store || mdd_frag_bytes(&ctx.frags);
+    struct mdd_node *root = mdd_compact_tree(ctx.running, follow ? &moved : NULL);
+    CHECK_DO_RTN_VAL(!root, hmap_free(&moved), -1);
+    ctx.running = root;
+    ctx.commits = 0;
+    mdd_frag_relocate(&ctx.frags, &moved);
+
+    int rt = 0;
+    if (ctx.store && mdd_store_relocate(ctx.store, &moved)) {
+        rt = mdd_store_commit(ctx.store, ctx.running, NULL);
+    }
+    hmap_free(&moved);
+    return rt;
+}
+
+static int commit_track()
+{
+    mdd_diff *diff = mdd_get_dirty_diff(&ctx.track);
+    CHECK_DO_RTN_VAL(!diff, LOG_WARN("Failed to get dirty diff"), -1);
 
+    notify_diff(diff);
+    size_t changed = diff->size;
+    int rt = changed ? persist_running(diff) : 0;
+    mdd_free_diff(diff);
+
+    /* edits in place scatter new nodes over the heap, a failed compaction keeps the tree as it was */
+    if (!rt && changed && ctx.compact_interval && ++ctx.commits >= ctx.compact_interval && compact_running()) {
+        LOG_WARN("Failed to compact running data");
+    }
     return rt;
 }
 
 int repo_edit_json(const cJSON *edit_data)
 {
+    CHECK_DO_RTN_VAL(repo_pending(), LOG_WARN("Edits pending, commit or abort them first"), -1);
+
     ctx.editing = mdd_parse_json(ctx.schema, edit_data);
     CHECK_DO_RTN_VAL(!ctx.editing, LOG_WARN("Failed to parse edit data"), -1);
 
@@ -137,8 +431,310 @@ int repo_edit_json(const cJSON *edit_data)
 
 int repo_edit(const char *edit_data)
 {
+    CHECK_DO_RTN_VAL(repo_pending(), LOG_WARN("Edits pending, commit or abort them first"), -1);
+
     ctx.editing = mdd_parse_data(ctx.schema, edit_data);
     CHECK_DO_RTN_VAL(!ctx.editing, LOG_WARN("Failed to parse edit data"), -1);
 
     return deal_edit();
 }
+
+int repo_set_int(const char *path, long long val)
+{
+    CHECK_DO_RTN_VAL(!path, LOG_WARN("NULL Para"), -1);
+
+    struct mdd_node *leaf = mdd_get_data(ctx.running, path);
+    CHECK_DO_RTN_VAL(!leaf, LOG_WARN("Failed to find %s", path), -1);
+
+    return mdd_set_int(&ctx.track, leaf, val);
+}
+
+int repo_set_str(const char *path, const char *val)
+{
+    CHECK_DO_RTN_VAL(!path || !val, LOG_WARN("NULL Para"), -1);
+
+    struct mdd_node *leaf = mdd_get_data(ctx.running, path);
+    CHECK_DO_RTN_VAL(!leaf, LOG_WARN("Failed to find %s", path), -1);
+
+    return mdd_set_str(&ctx.track, leaf, val);
+}
+
+int repo_insert(const char *parent_path, const char *edit_data)
+{
+    CHECK_DO_RTN_VAL(!parent_path || !edit_data, LOG_WARN("NULL Para"), -1);
+
+    struct mdd_node *parent = mdd_get_data(ctx.running, parent_path);
+    CHECK_DO_RTN_VAL(!parent || !is_mo(parent->schema->mtype), LOG_WARN("Failed to find mo %s", parent_path), -1);
+
+    cJSON *json = cJSON_Parse(edit_data);
+    CHECK_DO_RTN_VAL(!cJSON_IsObject(json), LOG_WARN("Invalid insert data %s", edit_data);cJSON_Delete(json), -1);
+
+    int rt = 0;
+    for (cJSON *item = json->child; item && !rt; item = item->next) {
+        struct mds_node *schema = mds_find_child_schema(parent->schema, item->string);
+        CHECK_DO_GOTO(!schema, LOG_WARN("invalid child %s under %s", item->string, parent_path); rt = -1, CLEAN);
+
+        struct mdd_node *node = mdd_parse_child(schema, item);
+        CHECK_DO_GOTO(!node, LOG_WARN("invalid data for %s", item->string); rt = -1, CLEAN);
+
+        while (node && !rt) {
+            struct mdd_node *next = node->next;
+            node->next = NULL;
+            if (next) {
+                next->prev = NULL;
+            }
+            rt = mdd_insert_node(&ctx.track, parent, node);
+            if (rt) {
+                mdd_free_data(node);
+                mdd_free_data(next);
+            }
+            node = next;
+        }
+    }
+
+CLEAN:
+    cJSON_Delete(json);
+    return rt;
+}
+
+int repo_delete(const char *path)
+{
+    CHECK_DO_RTN_VAL(!path, LOG_WARN("NULL Para"), -1);
+
+    struct mdd_node *node = mdd_get_data(ctx.running, path);
+    CHECK_DO_RTN_VAL(!node, LOG_WARN("Failed to find %s", path), -1);
+
+    return mdd_delete_node(&ctx.track, node);
+}
+
+int repo_commit()
+{
+    return commit_track();
+}
+
+void repo_abort()
+{
+    mdd_track_abort(&ctx.track);
+}
+
+int repo_pending()
+{
+    return mdd_track_pending(&ctx.track);
+}
+
+int repo_apply_patch(const char *patch)
+{
+    CHECK_DO_RTN_VAL(!patch, LOG_WARN("NULL Para"), -1);
+    CHECK_DO_RTN_VAL(repo_pending(), LOG_WARN("Edits pending, commit or abort them first"), -1);
+
+    /* a patch applies whole or not at all */
+    int rt = mdd_apply_patch(&ctx.track, ctx.running, patch);
+    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to apply patch");mdd_track_abort(&ctx.track), -1);
+
+    return commit_track();
+}
+
+int repo_set_diff_threads(int nthreads)
+{
+    CHECK_DO_RTN_VAL(nthreads < 0, LOG_WARN("Invalid thread count:%d", nthreads), -1);
+
+    pool_destroy(ctx.pool);
+    ctx.pool = NULL;
+    CHECK_RTN_VAL(nthreads <= 1, 0);
+
+    ctx.pool = pool_create(nthreads);
+    return ctx.pool ? 0 : -1;
+}
+
+int repo_compact()
+{
+    CHECK_DO_RTN_VAL(!ctx.running, LOG_WARN("No running data"), -1);
+    CHECK_DO_RTN_VAL(commit_track(), LOG_WARN("Failed to commit pending changes"), -1);
+
+    return compact_running();
+}
+
+int repo_set_compact_interval(unsigned int commits)
+{
+    ctx.compact_interval = commits;
+    ctx.commits = 0;
+    return 0;
+}
+
+int repo_register_diff_cb(repo_diff_cb cb, void *arg)
+{
+    CHECK_DO_RTN_VAL(!cb, LOG_WARN("NULL Para"), -1);
+
+    for (int i = 0; i < REPO_MAX_DIFF_CB; i++) {
+        if (!ctx.hooks[i].cb) {
+            ctx.hooks[i].cb = cb;
+            ctx.hooks[i].arg = arg;
+            return 0;
+        }
+    }
+    LOG_WARN("Too many diff callbacks");
+    return -1;
+}
+
+void repo_unregister_diff_cb(repo_diff_cb cb, void *arg)
+{
+    for (int i = 0; i < REPO_MAX_DIFF_CB; i++) {
+        if (ctx.hooks[i].cb == cb && ctx.hooks[i].arg == arg) {
+            memset(&ctx.hooks[i], 0, sizeof(struct repo_diff_hook));
+        }
+    }
+}
+
+unsigned long long repo_version()
+{
+    return ctx.version;
+}
+
+int repo_dump(char **json_str)
+{
+    CHECK_DO_RTN_VAL(!json_str || !ctx.running, LOG_WARN("NULL Para"), -1);
+
+    return mdd_dump_data_cached(&ctx.frags, ctx.running, json_str);
+}
+
+/* writes the running tree as a binary snapshot, repo_init takes it in place of the JSON data file */
+int repo_save_snapshot(const char *file_path)
+{
+    CHECK_DO_RTN_VAL(!file_path || !ctx.running, LOG_WARN("NULL Para"), -1);
+
+    char *buf = NULL;
+    size_t len = 0;
+    CHECK_DO_RTN_VAL(mdd_dump_snapshot(ctx.running, &buf, &len), LOG_WARN("Failed to dump snapshot"), -1);
+
+    int rt = write_file(file_path, buf, len);
+    free(buf);
+    return rt;
+}
+
+/* writes the running tree as a mapped data store, repo_init then keeps it as the live data file */
+int repo_save_store(const char *file_path)
+{
+    CHECK_DO_RTN_VAL(!file_path || !ctx.running, LOG_WARN("NULL Para"), -1);
+
+    struct mdd_store *store = mdd_store_create(file_path, ctx.schema, ctx.running);
+    CHECK_DO_RTN_VAL(!store, LOG_WARN("Failed to create store %s", file_path), -1);
+    mdd_store_close(store);
+    return 0;
+}
+
+/* the JSON of one node of the running tree, see mdd_dump_subtree */
+int repo_get_json(const char *path, char **json_str)
+{
+    CHECK_DO_RTN_VAL(!path || !json_str, LOG_WARN("NULL Para"), -1);
+
+    struct mdd_node *node = mdd_get_data(ctx.running, path);
+    CHECK_DO_RTN_VAL(!node, LOG_WARN("Failed to find %s", path), -1);
+
+    return mdd_dump_subtree_cached(&ctx.frags, node, json_str);
+}
+
+/* a list under one parent at most, the column snapshot is taken under that parent */
+static int is_snapshot_list(struct mds_node *lists)
+{
+    CHECK_RTN_VAL(!is_column_snap_list(lists), 0);
+    for (struct mds_node *up = lists->parent; up; up = up->parent) {
+        CHECK_RTN_VAL(is_list_node(up), 0);
+    }
+    return 1;
+}
+
+static struct mdd_node* find_instance(struct mdd_node *root, struct mds_node *schema)
+{
+    CHECK_RTN_VAL(root->schema == schema || !schema->parent, root->schema == schema ? root : NULL);
+
+    struct mdd_node *parent = find_instance(root, schema->parent);
+    for (struct mdd_node *child = parent ? parent->child : NULL; child; child = child->next) {
+        CHECK_RTN_VAL(child->schema == schema, child);
+    }
+    return NULL;
+}
+
+/*
+ * Takes the snapshot again when it is older than the last change of the list, none without a parent.
+ * The running tree holds the pending edits, so a snapshot is only taken while there are none.
+ */
+static int refresh_snapshot(struct repo_agg *entry)
+{
+    CHECK_RTN_VAL(entry->cols && !entry->stale && mdd_columns_version(entry->cols) >= entry->changed, 0);
+    CHECK_DO_RTN_VAL(repo_pending(), LOG_WARN("Snapshot is taken once the pending edits are committed or aborted"), -1);
+
+    struct mds_node *lists = agg_lists(entry->agg);
+    mdd_columns_free(entry->cols);
+    struct mdd_node *parent = find_instance(ctx.running, lists->parent);
+    entry->cols = parent ? mdd_columns_snapshot(parent, lists, ctx.version) : NULL;
+    CHECK_DO_RTN_VAL(parent && !entry->cols, LOG_WARN("Failed to snapshot %s", lists->name), -1);
+
+    entry->stale = 0;
+    return 0;
+}
+
+static int snapshot_value(struct repo_agg *entry, long long *val)
+{
+    CHECK_RTN_VAL(refresh_snapshot(entry), -1);
+
+    struct mds_node *lists = NULL;
+    struct mds_node *leaf = NULL;
+    mdd_agg_type type;
+    mdd_agg_target(entry->agg, &lists, &leaf, &type);
+    if (!entry->cols) {
+        *val = 0;
+        return type == MDD_AGG_MIN || type == MDD_AGG_MAX ? -1 : 0;
+    }
+    return mdd_columns_agg(entry->cols, leaf, type, val);
+}
+
+static int load_agg(struct repo_agg *entry)
+{
+    CHECK_DO_RTN_VAL(repo_pending(), LOG_WARN("Aggregate loads once the pending edits are committed or aborted"), -1);
+    CHECK_RTN_VAL(mdd_agg_load(entry->agg, ctx.running), -1);
+    entry->stale = 0;
+    return 0;
+}
+
+/* returns the id of the new aggregate, see mdd_agg_create */
+int repo_agg_register(const char *list_path, const char *leaf, mdd_agg_type type)
+{
+    CHECK_DO_RTN_VAL(!list_path || !ctx.running, LOG_WARN("NULL Para"), -1);
+
+    int id = 0;
+    while (id < REPO_MAX_AGG && ctx.aggs[id].agg) {
+        id++;
+    }
+    CHECK_DO_RTN_VAL(id == REPO_MAX_AGG, LOG_WARN("Too many aggregates"), -1);
+
+    struct mdd_agg *agg = mdd_agg_create(ctx.schema, list_path, leaf, type);
+    CHECK_RTN_VAL(!agg, -1);
+
+    struct repo_agg *entry = &ctx.aggs[id];
+    entry->agg = agg;
+    entry->snapshot = is_snapshot_list(agg_lists(agg));
+    entry->stale = repo_pending();
+    int rt = entry->stale ? 0 : entry->snapshot ? refresh_snapshot(entry) : load_agg(entry);
+    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to load aggregate of %s", list_path);repo_agg_unregister(id), -1);
+    return id;
+}
+
+void repo_agg_unregister(int id)
+{
+    CHECK_RTN(id < 0 || id >= REPO_MAX_AGG);
+
+    mdd_agg_free(ctx.aggs[id].agg);
+    mdd_columns_free(ctx.aggs[id].cols);
+    memset(&ctx.aggs[id], 0, sizeof(struct repo_agg));
+}
+
+/* the value as of the last commit, edits not yet committed are not seen */
+int repo_agg_get(int id, long long *val)
+{
+    CHECK_DO_RTN_VAL(id < 0 || id >= REPO_MAX_AGG || !ctx.aggs[id].agg || !val, LOG_WARN("Invalid aggregate:%d", id), -1);
+
+    struct repo_agg *entry = &ctx.aggs[id];
+    CHECK_RTN_VAL(entry->snapshot, snapshot_value(entry, val));
+    CHECK_RTN_VAL(entry->stale && load_agg(entry), -1);
+    return mdd_agg_value(entry->agg, val);
+}
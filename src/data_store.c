@@ -0,0 +1,439 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "macro.h"
+#include "log.h"
+#include "data_store.h"
+
+#define STORE_MAGIC "MDDM"
+#define STORE_VERSION 1
+#define STORE_PAGE 4096
+#define STORE_DATA STORE_PAGE
+#define STORE_INIT_SIZE (64 * 1024)
+#define STORE_COMPACT_MIN (1024 * 1024)
+
+/* the header page, root is only moved once the records it reaches are synced */
+struct store_head{
+    char magic[4];
+    uint32_t version;
+    uint32_t fingerprint;
+    uint32_t reserved;
+    uint64_t root;
+    uint64_t used;
+    uint64_t live;
+    uint64_t gen;
+};
+
+/* a child in document order, len is the byte count of a string leaf */
+struct store_entry{
+    uint32_t sid;
+    uint32_t len;
+    union {
+        int64_t intv;
+        uint64_t off;
+    };
+};
+
+/* string bytes follow the entries, size covers them and the padding to 8 */
+struct store_record{
+    uint32_t sid;
+    uint32_t nchild;
+    uint64_t size;
+    struct store_entry entries[];
+};
+
+/* offsets maps each mo of the tree to its current record */
+struct mdd_store{
+    char *path;
+    int fd;
+    char *map;
+    size_t map_size;
+    struct mds_node *schema;
+    struct mds_table table;
+    struct mdd_hmap offsets;
+};
+
+static struct store_head* store_head(struct mdd_store *store)
+{
+    return (struct store_head*) store->map;
+}
+
+static struct store_record* store_record(struct mdd_store *store, uint64_t off)
+{
+    return (struct store_record*) (store->map + off);
+}
+
+static int store_grow(struct mdd_store *store, size_t need)
+{
+    CHECK_RTN_VAL(need <= store->map_size, 0);
+
+    size_t size = store->map_size * 2 > need ? store->map_size * 2 : need;
+    size = (size + STORE_PAGE - 1) / STORE_PAGE * STORE_PAGE;
+    CHECK_DO_RTN_VAL(ftruncate(store->fd, size), LOG_WARN("Failed to grow %s", store->path), -1);
+
+    void *map = mremap(store->map, store->map_size, size, MREMAP_MAYMOVE);
+    CHECK_DO_RTN_VAL(map == MAP_FAILED, LOG_WARN("Failed to remap %s", store->path), -1);
+
+    store->map = map;
+    store->map_size = size;
+    return 0;
+}
+
+static int store_sync(struct mdd_store *store, uint64_t begin, uint64_t end)
+{
+    begin = begin / STORE_PAGE * STORE_PAGE;
+    CHECK_RTN_VAL(end <= begin, 0);
+    CHECK_DO_RTN_VAL(msync(store->map + begin, end - begin, MS_SYNC), LOG_WARN("Failed to sync %s", store->path), -1);
+    return 0;
+}
+
+/* children are written after their parent, so the file holds each new spine in pre-order */
+static int write_mo(struct mdd_store *store, struct mdd_node *mo, uint64_t *off)
+{
+    void *exist = hmap_get(&store->offsets, (uintptr_t) mo);
+    if (exist) {
+        *off = (uintptr_t) exist;
+        return 0;
+    }
+
+    uint32_t nchild = 0;
+    size_t size = sizeof(struct store_record);
+    for (struct mdd_node *child = mo->child; child; child = child->next) {
+        nchild++;
+        size += sizeof(struct store_entry);
+        if (is_str_leaf((struct mds_leaf* ) child->schema)) {
+            size += strlen(str_leaf_val((struct mdd_leaf*) child));
+        }
+    }
+    size = (size + 7) & ~(size_t) 7;
+
+    uint64_t at = store_head(store)->used;
+    CHECK_RTN_VAL(store_grow(store, at + size), -1);
+    struct store_record *rec = store_record(store, at);
+    rec->sid = mds_table_id(&store->table, mo->schema);
+    rec->nchild = nchild;
+    rec->size = size;
+    store_head(store)->used = at + size;
+    store_head(store)->live += size;
+
+    uint64_t strs = at + sizeof(struct store_record) + nchild * sizeof(struct store_entry);
+    uint32_t i = 0;
+    for (struct mdd_node *child = mo->child; child; child = child->next, i++) {
+        struct store_entry entry = {(uint32_t) mds_table_id(&store->table, child->schema), 0, {0}};
+        if (is_mo(child->schema->mtype)) {
+            CHECK_RTN_VAL(write_mo(store, child, &entry.off), -1);
+        } else if (is_intv_leaf((struct mds_leaf* ) child->schema)) {
+            entry.intv = ((struct mdd_leaf*) child)->value.intv;
+        } else {
+            const char *str = str_leaf_val((struct mdd_leaf*) child);
+            entry.len = strlen(str);
+            entry.off = strs;
+            memcpy(store->map + strs, str, entry.len);
+            strs += entry.len;
+        }
+        store_record(store, at)->entries[i] = entry;
+    }
+
+    CHECK_RTN_VAL(hmap_put(&store->offsets, (uintptr_t) mo, (void*) (uintptr_t) at), -1);
+    *off = at;
+    return 0;
+}
+
+/* publishes the tree under root once every record it reaches is on disk */
+static int write_root(struct mdd_store *store, struct mdd_node *root)
+{
+    uint64_t begin = store_head(store)->used;
+    uint64_t off = 0;
+    CHECK_DO_RTN_VAL(write_mo(store, root, &off), LOG_WARN("Failed to write %s", store->path), -1);
+    CHECK_RTN_VAL(store_sync(store, begin, store_head(store)->used), -1);
+
+    store_head(store)->root = off;
+    store_head(store)->gen++;
+    return store_sync(store, 0, sizeof(struct store_head));
+}
+
+static struct mdd_store* store_new(const char *path, struct mds_node *schema)
+{
+    struct mdd_store *store = calloc(1, sizeof(struct mdd_store));
+    CHECK_DO_RTN_VAL(!store, LOG_WARN("No memory"), NULL);
+
+    store->fd = -1;
+    store->map = MAP_FAILED;
+    store->schema = schema;
+    store->path = strdup(path);
+    CHECK_DO_RTN_VAL(!store->path || hmap_init(&store->offsets, 0), free(store->path);free(store), NULL);
+    CHECK_DO_RTN_VAL(mds_table_init(&store->table, schema), mdd_store_close(store), NULL);
+    return store;
+}
+
+struct mdd_store* mdd_store_create(const char *path, struct mds_node *schema, struct mdd_node *root)
+{
+    CHECK_NULL_RTN3(path, schema, root, NULL);
+
+    struct mdd_store *store = store_new(path, schema);
+    CHECK_RTN_VAL(!store, NULL);
+
+    store->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK_DO_GOTO(store->fd < 0 || ftruncate(store->fd, STORE_INIT_SIZE), LOG_WARN("Failed to create %s", path),
+            ERR_OUT);
+    store->map = mmap(NULL, STORE_INIT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+    CHECK_DO_GOTO(store->map == MAP_FAILED, LOG_WARN("Failed to map %s", path), ERR_OUT);
+    store->map_size = STORE_INIT_SIZE;
+
+    struct store_head *head = store_head(store);
+    memcpy(head->magic, STORE_MAGIC, 4);
+    head->version = STORE_VERSION;
+    head->fingerprint = store->table.fingerprint;
+    head->used = STORE_DATA;
+    CHECK_GOTO(write_root(store, root), ERR_OUT);
+    return store;
+
+ERR_OUT:
+    mdd_store_close(store);
+    return NULL;
+}
+
+/* builds the mo at off below parent, checking every offset and id against the file */
+static struct mdd_node* read_mo(struct mdd_store *store, uint64_t off, struct mds_node *expect,
+        struct mdd_node *parent)
+{
+    uint64_t used = store_head(store)->used;
+    CHECK_DO_RTN_VAL(off < STORE_DATA || off % 8 || off + sizeof(struct store_record) > used,
+            LOG_WARN("Invalid record offset %llu", (unsigned long long) off), NULL);
+
+    struct store_record *rec = store_record(store, off);
+    CHECK_DO_RTN_VAL(rec->size > used - off || rec->size < sizeof(struct store_record) || rec->sid >= store->table.cnt ||
+            (rec->size - sizeof(struct store_record)) / sizeof(struct store_entry) < rec->nchild,
+            LOG_WARN("Invalid record at %llu", (unsigned long long) off), NULL);
+
+    struct mds_node *schema = store->table.nodes[rec->sid];
+    CHECK_DO_RTN_VAL(!is_mo(schema->mtype) || schema->parent != expect, LOG_WARN("Misplaced %s", schema->name),
+            NULL);
+
+    struct mdd_node *mo = mdd_new_node(schema);
+    CHECK_RTN_VAL(!mo, NULL);
+    mo->parent = parent;
+    CHECK_DO_RTN_VAL(hmap_put(&store->offsets, (uintptr_t) mo, (void*) (uintptr_t) off), mdd_free_data(mo), NULL);
+
+    struct mdd_node *prev = NULL;
+    for (uint32_t i = 0; i < rec->nchild; i++) {
+        struct store_entry *entry = &rec->entries[i];
+        struct mds_node *child_schema = entry->sid < store->table.cnt ? store->table.nodes[entry->sid] : NULL;
+        CHECK_DO_GOTO(!child_schema || child_schema->parent != schema,
+                LOG_WARN("Invalid child %u of %s", entry->sid, schema->name), ERR_OUT);
+
+        struct mdd_node *child = NULL;
+        if (is_mo(child_schema->mtype)) {
+            child = read_mo(store, entry->off, schema, mo);
+        } else if ((child = mdd_new_child(mo, child_schema)) && is_str_leaf((struct mds_leaf* ) child_schema)) {
+            struct mdd_leaf *leaf = (struct mdd_leaf*) child;
+            int rt = entry->off > used || entry->len > used - entry->off ||
+                    mdd_leaf_set_str(leaf, store->map + entry->off, entry->len);
+            CHECK_DO_GOTO(rt, LOG_WARN("Invalid string of %s", child_schema->name);mdd_free_data(child), ERR_OUT);
+        } else if (child) {
+            ((struct mdd_leaf*) child)->value.intv = entry->intv;
+            CHECK_DO_GOTO(is_enum_leaf((struct mds_leaf* ) child_schema) && !mds_enum_name(child_schema, entry->intv),
+                    LOG_WARN("Invalid enum of %s", child_schema->name);mdd_free_data(child), ERR_OUT);
+        }
+        CHECK_GOTO(!child, ERR_OUT);
+
+        CHECK_DO_GOTO(mdd_link_child(mo, prev, child), mdd_free_data(child), ERR_OUT);
+        prev = child;
+    }
+    mdd_fit_slots(mo);
+    return mo;
+
+ERR_OUT:
+    mdd_free_data(mo);
+    return NULL;
+}
+
+struct mdd_store* mdd_store_open(const char *path, struct mds_node *schema, struct mdd_node **root)
+{
+    CHECK_NULL_RTN3(path, schema, root, NULL);
+
+    struct mdd_store *store = store_new(path, schema);
+    CHECK_RTN_VAL(!store, NULL);
+
+    struct stat st;
+    store->fd = open(path, O_RDWR);
+    CHECK_DO_GOTO(store->fd < 0 || fstat(store->fd, &st) || st.st_size < STORE_DATA, LOG_WARN("Failed to open %s", path),
+            ERR_OUT);
+    store->map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+    CHECK_DO_GOTO(store->map == MAP_FAILED, LOG_WARN("Failed to map %s", path), ERR_OUT);
+    store->map_size = st.st_size;
+
+    struct store_head *head = store_head(store);
+    CHECK_DO_GOTO(memcmp(head->magic, STORE_MAGIC, 4) || head->version != STORE_VERSION,
+            LOG_WARN("%s is not a data store", path), ERR_OUT);
+    CHECK_DO_GOTO(head->fingerprint != store->table.fingerprint, LOG_WARN("%s was written with another schema", path),
+            ERR_OUT);
+    CHECK_DO_GOTO(head->used > store->map_size, LOG_WARN("%s is truncated", path), ERR_OUT);
+    /* records are appended at used, 8 aligned behind the header page */
+    CHECK_DO_GOTO(head->used < STORE_DATA || head->used % 8 || head->live > head->used - STORE_DATA,
+            LOG_WARN("%s has an invalid used size %llu", path, (unsigned long long) head->used), ERR_OUT);
+
+    madvise(store->map, store->map_size, MADV_SEQUENTIAL);
+    *root = read_mo(store, head->root, NULL, NULL);
+    CHECK_DO_GOTO(!*root, LOG_WARN("Failed to load %s", path), ERR_OUT);
+    return store;
+
+ERR_OUT:
+    mdd_store_close(store);
+    return NULL;
+}
+
+static uint64_t record_size(struct mdd_store *store, void *off)
+{
+    return store_record(store, (uintptr_t) off)->size;
+}
+
+/* drops the records of node and its ancestors, they are rewritten by the next write_root */
+static void stale_spine(struct mdd_store *store, struct mdd_node *node)
+{
+    for (; node; node = node->parent) {
+        void *off = hmap_del(&store->offsets, (uintptr_t) node);
+        if (off) {
+            store_head(store)->live -= record_size(store, off);
+        }
+    }
+}
+
+static void stale_diff(struct mdd_store *store, const mdd_diff *diff)
+{
+    for (size_t i = 0; i < diff->size; i++) {
+        struct mdd_mo_diff *modiff = diff->vec[i];
+        if (modiff->type == DF_DELETE) {
+            struct mdd_node *mo = (struct mdd_node*) modiff->run_data;
+            void *off = hmap_del(&store->offsets, (uintptr_t) mo);
+            if (off) {
+                store_head(store)->live -= record_size(store, off);
+            }
+            stale_spine(store, mo->parent);
+        } else {
+            stale_spine(store, (struct mdd_node*) modiff->edit_data);
+        }
+    }
+}
+
+/* a rename is only durable once the directory holding path is synced */
+static int sync_dir(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    char *dir = slash ? strndup(path, slash == path ? 1 : (size_t) (slash - path)) : strdup(".");
+    CHECK_DO_RTN_VAL(!dir, LOG_WARN("No memory"), -1);
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    int rt = fd < 0 || fsync(fd);
+    if (fd >= 0) {
+        close(fd);
+    }
+    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to sync directory %s", dir);free(dir), -1);
+    free(dir);
+    return 0;
+}
+
+/* rewrites the live tree into a fresh file and takes it over */
+static int store_compact(struct mdd_store *store, struct mdd_node *root)
+{
+    size_t len = strlen(store->path);
+    char *tmp = malloc(len + 5);
+    CHECK_DO_RTN_VAL(!tmp, LOG_WARN("No memory"), -1);
+    snprintf(tmp, len + 5, "%s.tmp", store->path);
+
+    /* the fresh file and its size must be on disk before it replaces the old one */
+    struct mdd_store *fresh = mdd_store_create(tmp, store->schema, root);
+    CHECK_DO_RTN_VAL(!fresh, free(tmp), -1);
+    int rt = fsync(fresh->fd) || rename(tmp, store->path);
+    CHECK_DO_RTN_VAL(rt, LOG_WARN("Failed to replace %s", store->path);unlink(tmp);free(tmp);mdd_store_close(fresh),
+            -1);
+    free(tmp);
+
+    /* store keeps its path and takes the fresh mapping, fresh goes away with the old one */
+    struct mdd_store old = *store;
+    *store = *fresh;
+    free(store->path);
+    store->path = old.path;
+    *fresh = old;
+    fresh->path = NULL;
+    mdd_store_close(fresh);
+    return sync_dir(store->path);
+}
+
+int mdd_store_commit(struct mdd_store *store, struct mdd_node *root, const mdd_diff *diff)
+{
+    CHECK_NULL_RTN2(store, root, -1);
+
+    if (diff) {
+        stale_diff(store, diff);
+    } else {
+        hmap_clear(&store->offsets);
+        store_head(store)->live = 0;
+    }
+    CHECK_RTN_VAL(write_root(store, root), -1);
+
+    struct store_head *head = store_head(store);
+    CHECK_RTN_VAL(head->used - STORE_DATA <= 2 * head->live + STORE_COMPACT_MIN, 0);
+    return store_compact(store, root);
+}
+
+int mdd_store_relocate(struct mdd_store *store, const struct mdd_hmap *moved)
+{
+    CHECK_NULL_RTN2(store, moved, -1);
+
+    struct mdd_hmap offsets;
+    CHECK_RTN_VAL(hmap_init(&offsets, store->offsets.size), -1);
+    for (size_t i = 0; i < store->offsets.capacity; i++) {
+        if (!store->offsets.keys[i]) {
+            continue;
+        }
+        void *mo = hmap_get(moved, store->offsets.keys[i]);
+        if (!mo) {
+            store_head(store)->live -= record_size(store, store->offsets.vals[i]);
+            continue;
+        }
+        CHECK_DO_RTN_VAL(hmap_put(&offsets, (uintptr_t) mo, store->offsets.vals[i]), hmap_free(&offsets), -1);
+    }
+    hmap_free(&store->offsets);
+    store->offsets = offsets;
+    return 0;
+}
+
+void mdd_store_close(struct mdd_store *store)
+{
+    CHECK_RTN(!store);
+
+    if (store->map != MAP_FAILED) {
+        munmap(store->map, store->map_size);
+    }
+    if (store->fd >= 0) {
+        close(store->fd);
+    }
+    mds_table_free(&store->table);
+    hmap_free(&store->offsets);
+    free(store->path);
+    free(store);
+}
+
+int mdd_store_probe(const char *path)
+{
+    char magic[4];
+    FILE *fp = path ? fopen(path, "r") : NULL;
+    CHECK_RTN_VAL(!fp, 0);
+
+    size_t cnt = fread(magic, 1, sizeof(magic), fp);
+    fclose(fp);
+    return cnt == sizeof(magic) && !memcmp(magic, STORE_MAGIC, 4);
+}
+
+/* bytes in use in the file, live and stale records together */
+size_t mdd_store_size(const struct mdd_store *store)
+{
+    return store ? ((const struct store_head*) store->map)->used : 0;
+}
@@ -0,0 +1,512 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "macro.h"
+#include "log.h"
+#include "data_repo.h"
+#include "data_sync.h"
+
+#define SYNC_MAX_PEERS 8
+#define SYNC_MAX_MSG (64 * 1024 * 1024)
+/* a follower with more unsent bytes than this is dropped */
+#define SYNC_MAX_QUEUE (4ULL * SYNC_MAX_MSG)
+
+typedef enum {
+    SYNC_HELLO = 1, SYNC_RESYNC, SYNC_PATCH, SYNC_SNAPSHOT, SYNC_ACK
+} sync_msg_type;
+
+/* frames are exchanged between processes on the same host, so native byte order */
+struct sync_hdr{
+    uint32_t type;
+    uint32_t len;
+    uint64_t version;
+};
+
+struct sync_change{
+    unsigned long long version;
+    char *patch;
+};
+
+/* frames for a follower wait in out until sync_poll finds its socket writable */
+struct sync_peer{
+    int fd;
+    unsigned long long acked;
+    int snapshot_due;
+    char *out;
+    size_t out_len;
+    size_t out_pos;
+    size_t out_cap;
+};
+
+struct repo_sync{
+    int is_leader;
+    unsigned long long version;
+
+    /* leader: ring of the latest change sets and the connected followers */
+    struct sync_change *backlog;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    struct sync_peer peers[SYNC_MAX_PEERS];
+    size_t peer_cnt;
+
+    /* follower */
+    int fd;
+    int catching_up;
+};
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == ENOTSOCK) {
+            n = write(fd, p, len);
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        CHECK_DO_RTN_VAL(n <= 0, LOG_WARN("Failed to write sync fd %d", fd), -1);
+
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* queues one frame for the follower, nothing is written here */
+static int queue_msg(struct sync_peer *peer, sync_msg_type type, unsigned long long version, const char *body)
+{
+    struct sync_hdr hdr;
+    hdr.type = type;
+    hdr.len = body ? strlen(body) : 0;
+    hdr.version = version;
+
+    /* the sent part goes first */
+    if (peer->out_pos) {
+        memmove(peer->out, peer->out + peer->out_pos, peer->out_len - peer->out_pos);
+        peer->out_len -= peer->out_pos;
+        peer->out_pos = 0;
+    }
+
+    size_t need = peer->out_len + sizeof(hdr) + hdr.len;
+    CHECK_DO_RTN_VAL(need > SYNC_MAX_QUEUE, LOG_WARN("Sync follower fd %d is too slow", peer->fd), -1);
+    if (need > peer->out_cap) {
+        size_t cap = peer->out_cap ? peer->out_cap : 4096;
+        while (cap < need) {
+            cap *= 2;
+        }
+        char *out = realloc(peer->out, cap);
+        CHECK_DO_RTN_VAL(!out, LOG_WARN("No memory"), -1);
+        peer->out = out;
+        peer->out_cap = cap;
+    }
+    memcpy(peer->out + peer->out_len, &hdr, sizeof(hdr));
+    if (hdr.len) {
+        memcpy(peer->out + peer->out_len + sizeof(hdr), body, hdr.len);
+    }
+    peer->out_len = need;
+    return 0;
+}
+
+/* writes what the socket takes without blocking, the rest waits for the next poll */
+static int flush_peer(struct sync_peer *peer)
+{
+    while (peer->out_pos < peer->out_len) {
+        ssize_t n = send(peer->fd, peer->out + peer->out_pos, peer->out_len - peer->out_pos,
+                MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == ENOTSOCK) {
+            n = write(peer->fd, peer->out + peer->out_pos, peer->out_len - peer->out_pos);
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        CHECK_RTN_VAL(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK), 0);
+        CHECK_DO_RTN_VAL(n <= 0, LOG_WARN("Failed to write sync fd %d", peer->fd), -1);
+
+        peer->out_pos += n;
+    }
+    peer->out_pos = 0;
+    peer->out_len = 0;
+    return 0;
+}
+
+static int read_full(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+    while (len) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        CHECK_RTN_VAL(n <= 0, -1);
+
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* the follower's frames are bare headers, written in place */
+static int send_msg(int fd, sync_msg_type type, unsigned long long version, const char *body)
+{
+    struct sync_hdr hdr;
+    hdr.type = type;
+    hdr.len = body ? strlen(body) : 0;
+    hdr.version = version;
+    CHECK_RTN_VAL(write_full(fd, &hdr, sizeof(hdr)), -1);
+    return hdr.len ? write_full(fd, body, hdr.len) : 0;
+}
+
+/* the body is NUL terminated and owned by the caller */
+static int recv_msg(int fd, struct sync_hdr *hdr, char **body)
+{
+    *body = NULL;
+    CHECK_RTN_VAL(read_full(fd, hdr, sizeof(struct sync_hdr)), -1);
+    CHECK_DO_RTN_VAL(hdr->len > SYNC_MAX_MSG, LOG_WARN("Sync message too big:%u", hdr->len), -1);
+
+    *body = malloc(hdr->len + 1);
+    CHECK_DO_RTN_VAL(!*body, LOG_WARN("No memory"), -1);
+
+    (*body)[hdr->len] = '\0';
+    CHECK_DO_RTN_VAL(read_full(fd, *body, hdr->len), free(*body);*body = NULL, -1);
+    return 0;
+}
+
+static void drop_peer(struct repo_sync *sync, size_t idx)
+{
+    LOG_WARN("Drop sync follower fd %d", sync->peers[idx].fd);
+    close(sync->peers[idx].fd);
+    free(sync->peers[idx].out);
+    sync->peers[idx] = sync->peers[sync->peer_cnt - 1];
+    sync->peer_cnt--;
+}
+
+static struct sync_change* backlog_at(struct repo_sync *sync, size_t i)
+{
+    return &sync->backlog[(sync->head + i) % sync->capacity];
+}
+
+static void push_change(struct repo_sync *sync, unsigned long long version, char *patch)
+{
+    if (sync->count == sync->capacity) {
+        free(backlog_at(sync, 0)->patch);
+        sync->head = (sync->head + 1) % sync->capacity;
+        sync->count--;
+    }
+    struct sync_change *change = backlog_at(sync, sync->count);
+    change->version = version;
+    change->patch = patch;
+    sync->count++;
+}
+
+static void clear_backlog(struct repo_sync *sync)
+{
+    for (size_t i = 0; i < sync->count; i++) {
+        free(backlog_at(sync, i)->patch);
+    }
+    sync->head = 0;
+    sync->count = 0;
+}
+
+/*
+ * Runs inside the commit, so the patch is only queued. Without a patch the version has a gap
+ * no follower can replay: the backlog restarts after it and every follower gets a snapshot.
+ */
+static void on_leader_diff(const mdd_diff *diff, unsigned long long version, void *arg)
+{
+    struct repo_sync *sync = (struct repo_sync*) arg;
+    sync->version = version;
+
+    char *patch = NULL;
+    if (!diff || mdd_diff_to_patch(diff, &patch)) {
+        LOG_ERROR("No patch for version %llu, followers resync", version);
+        clear_backlog(sync);
+        for (size_t i = 0; i < sync->peer_cnt; i++) {
+            sync->peers[i].snapshot_due = 1;
+        }
+        return;
+    }
+
+    push_change(sync, version, patch);
+    for (size_t i = sync->peer_cnt; i > 0; i--) {
+        if (queue_msg(&sync->peers[i - 1], SYNC_PATCH, version, patch)) {
+            drop_peer(sync, i - 1);
+        }
+    }
+}
+
+/* edits not yet committed are in the running tree, the snapshot waits for their commit or abort */
+static int send_snapshot(struct repo_sync *sync, struct sync_peer *peer)
+{
+    peer->snapshot_due = 1;
+    CHECK_RTN_VAL(repo_pending(), 0);
+
+    char *data = NULL;
+    CHECK_DO_RTN_VAL(repo_dump(&data), LOG_WARN("Failed to dump snapshot"), -1);
+
+    peer->snapshot_due = 0;
+    int rt = queue_msg(peer, SYNC_SNAPSHOT, sync->version, data);
+    free(data);
+    return rt;
+}
+
+static void flush_snapshots(struct repo_sync *sync)
+{
+    for (size_t i = sync->peer_cnt; i > 0; i--) {
+        if (sync->peers[i - 1].snapshot_due && send_snapshot(sync, &sync->peers[i - 1])) {
+            drop_peer(sync, i - 1);
+        }
+    }
+}
+
+/* 1 if the backlog holds every change set after version up to the current one, without gaps */
+static int backlog_covers(struct repo_sync *sync, unsigned long long version)
+{
+    CHECK_RTN_VAL(version > sync->version || !sync->count || backlog_at(sync, 0)->version > version + 1, 0);
+
+    unsigned long long expect = backlog_at(sync, 0)->version;
+    for (size_t i = 0; i < sync->count; i++, expect++) {
+        CHECK_RTN_VAL(backlog_at(sync, i)->version != expect, 0);
+    }
+    return expect - 1 == sync->version;
+}
+
+/* replays the missing change sets if the backlog still covers them, otherwise sends a snapshot */
+static int catch_up(struct repo_sync *sync, struct sync_peer *peer, unsigned long long version)
+{
+    CHECK_RTN_VAL(version == sync->version, 0);
+    CHECK_RTN_VAL(!backlog_covers(sync, version), send_snapshot(sync, peer));
+
+    for (size_t i = 0; i < sync->count; i++) {
+        struct sync_change *change = backlog_at(sync, i);
+        if (change->version > version) {
+            CHECK_RTN_VAL(queue_msg(peer, SYNC_PATCH, change->version, change->patch), -1);
+        }
+    }
+    return 0;
+}
+
+static int deal_leader_msg(struct repo_sync *sync, struct sync_peer *peer, struct sync_hdr *hdr)
+{
+    switch (hdr->type) {
+        case SYNC_HELLO:
+            return catch_up(sync, peer, hdr->version);
+        case SYNC_RESYNC:
+            return send_snapshot(sync, peer);
+        case SYNC_ACK:
+            peer->acked = hdr->version;
+            return 0;
+        default:
+            LOG_WARN("Invalid sync message %u from follower", hdr->type);
+            return -1;
+    }
+}
+
+static void flush_peers(struct repo_sync *sync)
+{
+    for (size_t i = sync->peer_cnt; i > 0; i--) {
+        if (flush_peer(&sync->peers[i - 1])) {
+            drop_peer(sync, i - 1);
+        }
+    }
+}
+
+static int poll_leader(struct repo_sync *sync, int timeout_ms)
+{
+    flush_snapshots(sync);
+    flush_peers(sync);
+
+    struct pollfd fds[SYNC_MAX_PEERS];
+    for (size_t i = 0; i < sync->peer_cnt; i++) {
+        fds[i].fd = sync->peers[i].fd;
+        fds[i].events = POLLIN | (sync->peers[i].out_len ? POLLOUT : 0);
+        fds[i].revents = 0;
+    }
+
+    int ready = poll(fds, sync->peer_cnt, timeout_ms);
+    CHECK_RTN_VAL(ready < 0 && errno == EINTR, 0);
+    CHECK_DO_RTN_VAL(ready < 0, LOG_WARN("Failed to poll followers"), -1);
+
+    int handled = 0;
+    for (size_t i = sync->peer_cnt; i > 0; i--) {
+        if (!(fds[i - 1].revents & ~POLLOUT)) {
+            continue;
+        }
+
+        struct sync_hdr hdr;
+        char *body = NULL;
+        int rt = recv_msg(fds[i - 1].fd, &hdr, &body);
+        if (!rt) {
+            rt = deal_leader_msg(sync, &sync->peers[i - 1], &hdr);
+            handled++;
+        }
+        free(body);
+        if (rt) {
+            drop_peer(sync, i - 1);
+        }
+    }
+    flush_peers(sync);
+    return handled;
+}
+
+static int apply_patch(struct repo_sync *sync, struct sync_hdr *hdr, const char *patch)
+{
+    CHECK_RTN_VAL(hdr->version <= sync->version, 0);
+
+    if (hdr->version != sync->version + 1) {
+        CHECK_RTN_VAL(sync->catching_up, 0);
+
+        sync->catching_up = 1;
+        return send_msg(sync->fd, SYNC_HELLO, sync->version, NULL);
+    }
+
+    if (repo_apply_patch(patch)) {
+        LOG_WARN("Failed to apply version %llu, ask for a snapshot", (unsigned long long) hdr->version);
+        sync->catching_up = 1;
+        return send_msg(sync->fd, SYNC_RESYNC, sync->version, NULL);
+    }
+
+    sync->version = hdr->version;
+    sync->catching_up = 0;
+    return send_msg(sync->fd, SYNC_ACK, sync->version, NULL);
+}
+
+static int load_snapshot(struct repo_sync *sync, struct sync_hdr *hdr, const char *data)
+{
+    CHECK_RTN_VAL(hdr->version <= sync->version, 0);
+    CHECK_DO_RTN_VAL(repo_edit(data), LOG_WARN("Failed to load snapshot %llu", (unsigned long long) hdr->version), -1);
+
+    sync->version = hdr->version;
+    sync->catching_up = 0;
+    return send_msg(sync->fd, SYNC_ACK, sync->version, NULL);
+}
+
+static int poll_follower(struct repo_sync *sync, int timeout_ms)
+{
+    struct pollfd pfd;
+    pfd.fd = sync->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int ready = poll(&pfd, 1, timeout_ms);
+    CHECK_RTN_VAL(ready < 0 && errno == EINTR, 0);
+    CHECK_DO_RTN_VAL(ready < 0, LOG_WARN("Failed to poll leader"), -1);
+    CHECK_RTN_VAL(!ready, 0);
+
+    struct sync_hdr hdr;
+    char *body = NULL;
+    int rt = recv_msg(sync->fd, &hdr, &body);
+    CHECK_DO_RTN_VAL(rt, LOG_WARN("Lost sync leader"), -1);
+
+    if (hdr.type == SYNC_PATCH) {
+        rt = apply_patch(sync, &hdr, body);
+    } else if (hdr.type == SYNC_SNAPSHOT) {
+        rt = load_snapshot(sync, &hdr, body);
+    } else {
+        LOG_WARN("Invalid sync message %u from leader", hdr.type);
+        rt = -1;
+    }
+    free(body);
+    return rt ? -1 : 1;
+}
+
+struct repo_sync* sync_leader_create(size_t backlog)
+{
+    CHECK_DO_RTN_VAL(!backlog, LOG_WARN("Invalid sync backlog"), NULL);
+
+    struct repo_sync *sync = calloc(1, sizeof(struct repo_sync));
+    CHECK_DO_RTN_VAL(!sync, LOG_WARN("No memory"), NULL);
+
+    sync->is_leader = 1;
+    sync->fd = -1;
+    sync->version = repo_version();
+    sync->capacity = backlog;
+    sync->backlog = calloc(backlog, sizeof(struct sync_change));
+    CHECK_DO_RTN_VAL(!sync->backlog, LOG_WARN("No memory");free(sync), NULL);
+
+    CHECK_DO_RTN_VAL(repo_register_diff_cb(on_leader_diff, sync), sync_destroy(sync), NULL);
+    return sync;
+}
+
+/* the sync takes over the fd */
+int sync_leader_add(struct repo_sync *sync, int fd)
+{
+    CHECK_DO_RTN_VAL(!sync || !sync->is_leader || fd < 0, LOG_WARN("Invalid sync leader or fd"), -1);
+    CHECK_DO_RTN_VAL(sync->peer_cnt == SYNC_MAX_PEERS, LOG_WARN("Too many followers"), -1);
+
+    sync->peers[sync->peer_cnt].fd = fd;
+    sync->peers[sync->peer_cnt].acked = 0;
+    sync->peers[sync->peer_cnt].snapshot_due = 0;
+    sync->peers[sync->peer_cnt].out = NULL;
+    sync->peers[sync->peer_cnt].out_len = 0;
+    sync->peers[sync->peer_cnt].out_pos = 0;
+    sync->peers[sync->peer_cnt].out_cap = 0;
+    sync->peer_cnt++;
+    return 0;
+}
+
+/* version is what the local repo already holds, 0 for the leader's initial data */
+struct repo_sync* sync_follower_create(int fd, unsigned long long version)
+{
+    CHECK_DO_RTN_VAL(fd < 0, LOG_WARN("Invalid sync fd"), NULL);
+
+    struct repo_sync *sync = calloc(1, sizeof(struct repo_sync));
+    CHECK_DO_RTN_VAL(!sync, LOG_WARN("No memory"), NULL);
+
+    sync->fd = fd;
+    sync->version = version;
+    sync->catching_up = 1;
+    CHECK_DO_RTN_VAL(send_msg(fd, SYNC_HELLO, version, NULL), free(sync), NULL);
+    return sync;
+}
+
+/* returns the number of messages handled, -1 once a follower lost its leader */
+int sync_poll(struct repo_sync *sync, int timeout_ms)
+{
+    CHECK_NULL_RTN(sync, -1);
+
+    return sync->is_leader ? poll_leader(sync, timeout_ms) : poll_follower(sync, timeout_ms);
+}
+
+unsigned long long sync_version(const struct repo_sync *sync)
+{
+    return sync ? sync->version : 0;
+}
+
+/* leader: the lowest version acked by all followers, follower: the applied version */
+unsigned long long sync_acked(const struct repo_sync *sync)
+{
+    CHECK_RTN_VAL(!sync, 0);
+    CHECK_RTN_VAL(!sync->is_leader, sync->version);
+
+    unsigned long long acked = sync->version;
+    for (size_t i = 0; i < sync->peer_cnt; i++) {
+        if (sync->peers[i].acked < acked) {
+            acked = sync->peers[i].acked;
+        }
+    }
+    return acked;
+}
+
+void sync_destroy(struct repo_sync *sync)
+{
+    CHECK_RTN(!sync);
+
+    if (sync->is_leader) {
+        repo_unregister_diff_cb(on_leader_diff, sync);
+        clear_backlog(sync);
+        for (size_t i = 0; i < sync->peer_cnt; i++) {
+            close(sync->peers[i].fd);
+            free(sync->peers[i].out);
+        }
+        free(sync->backlog);
+    } else {
+        close(sync->fd);
+    }
+    free(sync);
+}
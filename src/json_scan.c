@@ -0,0 +1,245 @@
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+#include "json_scan.h"
+#include "macro.h"
+#include "log.h"
+
+#define SCAN_BLOCK 64
+
+#define CLS_BS 1
+#define CLS_QUOTE 2
+#define CLS_OP 4
+#define CLS_WS 8
+
+/* one bit per byte of a 64 byte block for each class the structure depends on */
+struct scan_masks{
+    uint64_t bs;
+    uint64_t quote;
+    uint64_t op;
+    uint64_t ws;
+};
+
+/* what carries over from one block into the next */
+struct scan_state{
+    uint64_t escaped;
+    uint64_t in_str;
+    uint64_t scalar;
+};
+
+typedef void (*scan_classify)(const char *block, struct scan_masks *masks);
+
+static const unsigned char CLASS[256] = {
+    ['\\'] = CLS_BS, ['"'] = CLS_QUOTE,
+    ['{'] = CLS_OP, ['}'] = CLS_OP, ['['] = CLS_OP, [']'] = CLS_OP, [':'] = CLS_OP, [','] = CLS_OP,
+    [' '] = CLS_WS, ['\t'] = CLS_WS, ['\n'] = CLS_WS, ['\r'] = CLS_WS
+};
+
+static void classify_scalar(const char *block, struct scan_masks *masks)
+{
+    memset(masks, 0, sizeof(struct scan_masks));
+    for (int i = 0; i < SCAN_BLOCK; i++) {
+        unsigned char cls = CLASS[(unsigned char) block[i]];
+        uint64_t bit = 1ULL << i;
+        masks->bs |= cls & CLS_BS ? bit : 0;
+        masks->quote |= cls & CLS_QUOTE ? bit : 0;
+        masks->op |= cls & CLS_OP ? bit : 0;
+        masks->ws |= cls & CLS_WS ? bit : 0;
+    }
+}
+
+#ifdef SCAN_X86
+/* '[' and ']' are '{' and '}' with bit 0x20 cleared, so one compare on byte | 0x20 takes both */
+__attribute__((target("sse2")))
+static void classify_sse2(const char *block, struct scan_masks *masks)
+{
+    memset(masks, 0, sizeof(struct scan_masks));
+    for (int i = 0; i < SCAN_BLOCK; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (block + i));
+        __m128i low = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i op = _mm_or_si128(_mm_cmpeq_epi8(low, _mm_set1_epi8('{')), _mm_cmpeq_epi8(low, _mm_set1_epi8('}')));
+        op = _mm_or_si128(op, _mm_cmpeq_epi8(v, _mm_set1_epi8(':')));
+        op = _mm_or_si128(op, _mm_cmpeq_epi8(v, _mm_set1_epi8(',')));
+        __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+        ws = _mm_or_si128(ws, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        ws = _mm_or_si128(ws, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+
+        masks->bs |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << i;
+        masks->quote |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << i;
+        masks->op |= (uint64_t) (uint16_t) _mm_movemask_epi8(op) << i;
+        masks->ws |= (uint64_t) (uint16_t) _mm_movemask_epi8(ws) << i;
+    }
+}
+
+__attribute__((target("avx2")))
+static void classify_avx2(const char *block, struct scan_masks *masks)
+{
+    memset(masks, 0, sizeof(struct scan_masks));
+    for (int i = 0; i < SCAN_BLOCK; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (block + i));
+        __m256i low = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i op = _mm256_or_si256(_mm256_cmpeq_epi8(low, _mm256_set1_epi8('{')),
+                _mm256_cmpeq_epi8(low, _mm256_set1_epi8('}')));
+        op = _mm256_or_si256(op, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')));
+        op = _mm256_or_si256(op, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+        __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+        ws = _mm256_or_si256(ws, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+        ws = _mm256_or_si256(ws, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+
+        masks->bs |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << i;
+        masks->quote |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << i;
+        masks->op |= (uint64_t) (uint32_t) _mm256_movemask_epi8(op) << i;
+        masks->ws |= (uint64_t) (uint32_t) _mm256_movemask_epi8(ws) << i;
+    }
+}
+#endif
+
+int json_kernel_supported(json_kernel kernel)
+{
+    switch (kernel) {
+        case JSON_KERNEL_AUTO:
+        case JSON_KERNEL_SCALAR:
+            return 1;
+#ifdef SCAN_X86
+        case JSON_KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case JSON_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return 0;
+    }
+}
+
+json_kernel json_kernel_best(void)
+{
+    CHECK_RTN_VAL(json_kernel_supported(JSON_KERNEL_AVX2), JSON_KERNEL_AVX2);
+    CHECK_RTN_VAL(json_kernel_supported(JSON_KERNEL_SSE2), JSON_KERNEL_SSE2);
+    return JSON_KERNEL_SCALAR;
+}
+
+static scan_classify get_classify(json_kernel kernel)
+{
+    if (kernel == JSON_KERNEL_AUTO) {
+        kernel = json_kernel_best();
+    }
+    CHECK_RTN_VAL(!json_kernel_supported(kernel), NULL);
+#ifdef SCAN_X86
+    CHECK_RTN_VAL(kernel == JSON_KERNEL_AVX2, classify_avx2);
+    CHECK_RTN_VAL(kernel == JSON_KERNEL_SSE2, classify_sse2);
+#endif
+    return classify_scalar;
+}
+
+/*
+ * Bytes escaped by a backslash run of odd length. A run starting on an even bit has its odd length
+ * end on an odd bit and the other way round; the add carries each run start to the byte after it.
+ */
+static uint64_t escaped_bytes(uint64_t bs, uint64_t *carry)
+{
+    const uint64_t even = 0x5555555555555555ULL;
+    bs &= ~*carry;
+    uint64_t follows = bs << 1 | *carry;
+    uint64_t odd_starts = bs & ~even & ~follows;
+    uint64_t even_ends = 0;
+    *carry = __builtin_add_overflow(odd_starts, bs, &even_ends);
+    return (even ^ (even_ends << 1)) & follows;
+}
+
+/* bit i is the parity of the bits up to i, so it is set between an opening and a closing quote */
+static uint64_t prefix_xor(uint64_t bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+static uint64_t structural_bits(const struct scan_masks *masks, struct scan_state *state)
+{
+    uint64_t quote = masks->quote & ~escaped_bytes(masks->bs, &state->escaped);
+    uint64_t in_str = prefix_xor(quote) ^ state->in_str;
+    state->in_str = (uint64_t) ((int64_t) in_str >> 63);
+
+    uint64_t scalar = ~(masks->op | masks->ws | quote | in_str);
+    uint64_t starts = scalar & ~(scalar << 1 | state->scalar);
+    state->scalar = scalar >> 63;
+    return (masks->op & ~in_str) | quote | starts;
+}
+
+/* four offsets per step without a branch on each bit, the stores past the last bit are overwritten later */
+static void flatten_bits(struct json_index *index, uint32_t base, uint64_t bits)
+{
+    uint32_t *out = index->pos + index->cnt;
+    size_t cnt = __builtin_popcountll(bits);
+    for (size_t i = 0; i < cnt; i += 4) {
+        out[i] = base + __builtin_ctzll(bits);
+        bits &= bits - 1;
+        out[i + 1] = base + __builtin_ctzll(bits | 1ULL << 63);
+        bits &= bits - 1;
+        out[i + 2] = base + __builtin_ctzll(bits | 1ULL << 63);
+        bits &= bits - 1;
+        out[i + 3] = base + __builtin_ctzll(bits | 1ULL << 63);
+        bits &= bits - 1;
+    }
+    index->cnt += cnt;
+}
+
+static int index_reserve(struct json_index *index, size_t need)
+{
+    CHECK_RTN_VAL(need <= index->cap, 0);
+
+    size_t cap = index->cap ? index->cap * 2 : 1024;
+    cap = cap > need ? cap : need;
+    uint32_t *pos = realloc(index->pos, cap * sizeof(uint32_t));
+    CHECK_DO_RTN_VAL(!pos, LOG_WARN("No memory"), -1);
+
+    index->pos = pos;
+    index->cap = cap;
+    return 0;
+}
+
+int json_index_build(struct json_index *index, const char *json, size_t len, json_kernel kernel)
+{
+    CHECK_NULL_RTN2(index, json, -1);
+    memset(index, 0, sizeof(struct json_index));
+    CHECK_DO_RTN_VAL(len > UINT32_MAX, LOG_WARN("Json text of %zu bytes is too long", len), -1);
+
+    scan_classify classify = get_classify(kernel);
+    CHECK_DO_RTN_VAL(!classify, LOG_WARN("Json kernel %d is not supported", kernel), -1);
+
+    struct scan_state state = {0, 0, 0};
+    struct scan_masks masks;
+    char tail[SCAN_BLOCK];
+    for (size_t base = 0; base < len; base += SCAN_BLOCK) {
+        const char *block = json + base;
+        if (len - base < SCAN_BLOCK) {
+            /* the spaces padding the last block are whitespace, so they add nothing */
+            memset(tail, ' ', SCAN_BLOCK);
+            memcpy(tail, block, len - base);
+            block = tail;
+        }
+        classify(block, &masks);
+        uint64_t bits = structural_bits(&masks, &state);
+
+        CHECK_DO_RTN_VAL(index_reserve(index, index->cnt + SCAN_BLOCK), json_index_free(index), -1);
+        flatten_bits(index, (uint32_t) base, bits);
+    }
+    CHECK_DO_RTN_VAL(state.in_str, LOG_WARN("Unterminated string in json");json_index_free(index), -1);
+    return 0;
+}
+
+void json_index_free(struct json_index *index)
+{
+    CHECK_RTN(!index);
+
+    free(index->pos);
+    memset(index, 0, sizeof(struct json_index));
+}
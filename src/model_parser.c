@@ -48,6 +48,8 @@ static mds_dtype parse_dtype(const char *str)
         return MDS_DT_INT;
     } else if (strcmp("string", str) == 0) {
         return MDS_DT_STR;
+    } else if (strcmp("enum", str) == 0) {
+        return MDS_DT_ENUM;
     }
     return MDS_DT_NULL;
 }
@@ -62,6 +64,61 @@ static mds_dtype get_dtype(cJSON *node)
     return MDS_DT_NULL;
 }
 
+static unsigned int get_mo_flags(cJSON *node)
+{
+    cJSON *attr = locate_child(node, "@attr");
+    cJSON *index = locate_child(attr, "index");
+    cJSON *snapshot = locate_child(attr, "snapshot");
+    unsigned int flags = 0;
+    if (cJSON_IsString(index) && strcmp("ordered", index->valuestring) == 0) {
+        flags |= MDS_F_ORDERED;
+    }
+    if (cJSON_IsString(snapshot) && strcmp("columnar", snapshot->valuestring) == 0) {
+        flags |= MDS_F_COLUMN_SNAP;
+    }
+    return flags;
+}
+
+static unsigned int get_leaf_flags(cJSON *node)
+{
+    cJSON *attr = locate_child(node, "@attr");
+    cJSON *index = locate_child(attr, "index");
+    CHECK_RTN_VAL(!cJSON_IsString(index), 0);
+
+    if (strcmp("unique", index->valuestring) == 0) {
+        return MDS_F_INDEXED | MDS_F_UNIQUE;
+    } else if (strcmp("multi", index->valuestring) == 0) {
+        return MDS_F_INDEXED;
+    }
+    LOG_WARN("mds--unknown index %s of %s", index->valuestring, node->string);
+    return 0;
+}
+
+/* the enum values come from a non empty array of distinct strings */
+static int get_enums(cJSON *node, struct mds_leaf *leaf)
+{
+    cJSON *attr = locate_child(node, "@attr");
+    cJSON *values = locate_child(attr, "enum");
+    int cnt = cJSON_GetArraySize(values);
+    CHECK_DO_RTN_VAL(!cJSON_IsArray(values) || !cnt, LOG_WARN("mds--enum %s needs values", node->string), -1);
+
+    leaf->enums = calloc(cnt, sizeof(char*));
+    CHECK_DO_RTN_VAL(!leaf->enums, LOG_WARN("mds--no memory"), -1);
+
+    for (cJSON *value = values->child; value; value = value->next) {
+        CHECK_DO_RTN_VAL(!cJSON_IsString(value), LOG_WARN("mds--enum %s has a non string value", node->string), -1);
+        CHECK_DO_RTN_VAL(mds_enum_code((struct mds_node*) leaf, value->valuestring, strlen(value->valuestring)) >= 0,
+                LOG_WARN("mds--enum %s repeats %s", node->string, value->valuestring), -1);
+
+        leaf->enums[leaf->enum_cnt] = strdup(value->valuestring);
+        CHECK_DO_RTN_VAL(!leaf->enums[leaf->enum_cnt], LOG_WARN("mds--no memory"), -1);
+        leaf->enum_cnt++;
+    }
+    return 0;
+}
+
+static void mds_free_self_node(struct mds_node *node);
+
 static struct mds_node* build_self_node(cJSON *json_node)
 {
     struct mds_node *node = NULL;
@@ -76,12 +133,20 @@ static struct mds_node* build_self_node(cJSON *json_node)
         node = (struct mds_node*) calloc(1, sizeof(struct mds_mo));
         node->name = strdup(json_node->string);
         node->mtype = mtype;
+        if (mtype == MDS_MT_LIST) {
+            ((struct mds_mo*) node)->flags = get_mo_flags(json_node);
+        }
         LOG_DEBUG("mds--build self mo-> name:%s, mtype:%d", node->name, node->mtype);
     } else {
         struct mds_leaf *leaf = (struct mds_leaf*) calloc(1, sizeof(struct mds_leaf));
         leaf->name = strdup(json_node->string);
         leaf->mtype = mtype;
         leaf->dtype = get_dtype(json_node);
+        leaf->flags = get_leaf_flags(json_node);
+        if (leaf->dtype == MDS_DT_ENUM && get_enums(json_node, leaf)) {
+            mds_free_self_node((struct mds_node*) leaf);
+            return NULL;
+        }
         LOG_DEBUG("mds--build self leaf-> name:%s, mtype:%d, dtype=%d", leaf->name, leaf->mtype, leaf->dtype);
         node = (struct mds_node*) leaf;
     }
@@ -95,7 +160,9 @@ static struct mds_node* build_child_node(struct mds_node *parent, cJSON *json_no
     CHECK_RTN_VAL(!node, NULL);
 
     parent->child = node;
-    node->parent = parent;
+    for (struct mds_node *sib = node; sib; sib = sib->next) {
+        sib->parent = parent;
+    }
     return node;
 }
 
@@ -140,6 +207,44 @@ static cJSON* find_next_schema(cJSON *node)
     return NULL;
 }
 
+/* numbers the leaves of a mo in schema order so data code can address them by position, and notes indexed ones */
+static int index_leafs(struct mds_mo *mo)
+{
+    unsigned int cnt = 0;
+    for (struct mds_node *child = mo->child; child; child = child->next) {
+        cnt += is_leaf_node(child) ? 1 : 0;
+    }
+    CHECK_RTN_VAL(!cnt, 0);
+
+    mo->leafs = calloc(cnt, sizeof(struct mds_node*));
+    CHECK_DO_RTN_VAL(!mo->leafs, LOG_WARN("mds--no memory"), -1);
+
+    for (struct mds_node *child = mo->child; child; child = child->next) {
+        if (is_leaf_node(child)) {
+            ((struct mds_leaf*) child)->leaf_idx = mo->leaf_cnt;
+            mo->leafs[mo->leaf_cnt++] = child;
+            mo->flags |= mo->mtype == MDS_MT_LIST && is_indexed_leaf(child) ? MDS_F_LEAF_INDEX : 0;
+        }
+    }
+    return 0;
+}
+
+/* a list snapshot as columns holds nothing but leaves and has an int Id to order its rows by */
+static int check_column_snap(struct mds_mo *mo)
+{
+    CHECK_RTN_VAL(!(mo->flags & MDS_F_COLUMN_SNAP), 0);
+
+    struct mds_node *key = NULL;
+    for (struct mds_node *child = mo->child; child; child = child->next) {
+        CHECK_DO_RTN_VAL(!is_leaf_node(child), LOG_WARN("mds--column snapshot %s holds mo %s", mo->name,
+                child->name), -1);
+        key = strcmp(child->name, "Id") ? key : child;
+    }
+    CHECK_DO_RTN_VAL(!key || !is_int_leaf((struct mds_leaf*) key), LOG_WARN("mds--column snapshot %s needs an int Id",
+            mo->name), -1);
+    return 0;
+}
+
 static struct mds_node* build_mds_node(cJSON *json_node)
 {
     struct mds_node *node = build_self_node(json_node);
@@ -157,6 +262,10 @@ static struct mds_node* build_mds_node(cJSON *json_node)
         child = build_child_node(node, json_child);
         CHECK_GOTO(!child, ERR_OUT);
     }
+    if (is_mo(node->mtype)) {
+        CHECK_GOTO(index_leafs((struct mds_mo*) node), ERR_OUT);
+        CHECK_GOTO(check_column_snap((struct mds_mo*) node), ERR_OUT);
+    }
 
     json_next = find_next_schema(json_node);
     if (json_next) {
@@ -189,6 +298,15 @@ struct mds_node* mds_load_model(const char *model_str)
 static void mds_free_self_node(struct mds_node *node)
 {
     if (node) {
+        if (is_mo(node->mtype)) {
+            free(((struct mds_mo*) node)->leafs);
+        } else {
+            struct mds_leaf *leaf = (struct mds_leaf*) node;
+            for (unsigned int i = 0; i < leaf->enum_cnt; i++) {
+                free(leaf->enums[i]);
+            }
+            free(leaf->enums);
+        }
         free(node->name);
         free(node);
     }
@@ -196,6 +314,8 @@ static void mds_free_self_node(struct mds_node *node)
 
 void mds_free_model(struct mds_node *root)
 {
+    CHECK_RTN(!root);
+
     struct mds_node *child = root->child;
     struct mds_node *next = root->next;
 
@@ -245,3 +365,94 @@ struct mds_node* mds_find_next_schema(struct mds_node *curr, const char *name)
     }
     return NULL;
 }
+
+struct mds_node* mds_leaf_at(const struct mds_node *mo, unsigned int idx)
+{
+    CHECK_RTN_VAL(!mo || !is_mo(mo->mtype), NULL);
+
+    const struct mds_mo *schema = (const struct mds_mo*) mo;
+    return idx < schema->leaf_cnt ? schema->leafs[idx] : NULL;
+}
+
+/* enums are a handful of values, a scan beats hashing them */
+long mds_enum_code(const struct mds_node *leaf, const char *str, size_t len)
+{
+    CHECK_RTN_VAL(!leaf || !str || !is_enum_leaf((const struct mds_leaf*) leaf), -1);
+
+    const struct mds_leaf *schema = (const struct mds_leaf*) leaf;
+    for (unsigned int i = 0; i < schema->enum_cnt; i++) {
+        if (strlen(schema->enums[i]) == len && !memcmp(schema->enums[i], str, len)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char* mds_enum_name(const struct mds_node *leaf, long long code)
+{
+    CHECK_RTN_VAL(!leaf || !is_enum_leaf((const struct mds_leaf*) leaf), NULL);
+
+    const struct mds_leaf *schema = (const struct mds_leaf*) leaf;
+    return code >= 0 && code < schema->enum_cnt ? schema->enums[code] : NULL;
+}
+
+static uint32_t table_hash(uint32_t hash, const void *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ ((const unsigned char*) data)[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int table_add(struct mds_table *table, struct mds_node *schema)
+{
+    if (table->cnt == table->cap) {
+        size_t cap = table->cap ? table->cap * 2 : 32;
+        struct mds_node **nodes = realloc(table->nodes, cap * sizeof(struct mds_node*));
+        CHECK_DO_RTN_VAL(!nodes, LOG_WARN("No memory"), -1);
+        table->nodes = nodes;
+        table->cap = cap;
+    }
+    CHECK_RTN_VAL(hmap_put(&table->ids, (uintptr_t) schema, (void*) (table->cnt + 1)), -1);
+    table->nodes[table->cnt++] = schema;
+
+    int type[2] = {schema->mtype, is_leaf_node(schema) ? (int) ((struct mds_leaf*) schema)->dtype : 0};
+    table->fingerprint = table_hash(table->fingerprint, schema->name, strlen(schema->name) + 1);
+    table->fingerprint = table_hash(table->fingerprint, type, sizeof(type));
+    if (is_enum_leaf((struct mds_leaf*) schema)) {
+        for (unsigned int i = 0; i < ((struct mds_leaf*) schema)->enum_cnt; i++) {
+            const char *name = ((struct mds_leaf*) schema)->enums[i];
+            table->fingerprint = table_hash(table->fingerprint, name, strlen(name) + 1);
+        }
+    }
+    for (struct mds_node *child = schema->child; child; child = child->next) {
+        CHECK_RTN_VAL(table_add(table, child), -1);
+    }
+    table->fingerprint = table_hash(table->fingerprint, ")", 1);
+    return 0;
+}
+
+int mds_table_init(struct mds_table *table, struct mds_node *root)
+{
+    CHECK_NULL_RTN2(table, root, -1);
+
+    memset(table, 0, sizeof(struct mds_table));
+    table->fingerprint = 2166136261u;
+    CHECK_RTN_VAL(hmap_init(&table->ids, 0), -1);
+    CHECK_DO_RTN_VAL(table_add(table, root), mds_table_free(table), -1);
+    return 0;
+}
+
+void mds_table_free(struct mds_table *table)
+{
+    CHECK_RTN(!table);
+
+    free(table->nodes);
+    hmap_free(&table->ids);
+    memset(table, 0, sizeof(struct mds_table));
+}
+
+long mds_table_id(const struct mds_table *table, const struct mds_node *schema)
+{
+    return (long) (uintptr_t) hmap_get(&table->ids, (uintptr_t) schema) - 1;
+}
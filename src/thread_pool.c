@@ -0,0 +1,236 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "macro.h"
+#include "log.h"
+#include "thread_pool.h"
+
+#define DEQUE_CAP 64
+
+struct pool_task{
+    pool_task_fn fn;
+    void *arg;
+};
+
+/* owner pops from the tail, thieves take from the head */
+struct pool_deque{
+    pthread_mutex_t lock;
+    size_t capacity;
+    size_t head;
+    size_t tail;
+    struct pool_task *tasks;
+};
+
+struct pool_worker{
+    struct mdd_pool *pool;
+    int id;
+    pthread_t thread;
+};
+
+struct mdd_pool{
+    int nthreads;
+    int ndeques;
+    int next_deque;
+    int stop;
+    size_t pending;
+    size_t queued;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    struct pool_deque *deques;
+    struct pool_worker *workers;
+};
+
+static int deque_push(struct pool_deque *dq, struct pool_task *task)
+{
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail - dq->head == dq->capacity) {
+        size_t newcap = dq->capacity * 2;
+        struct pool_task *tasks = calloc(newcap, sizeof(struct pool_task));
+        CHECK_DO_RTN_VAL(!tasks, pthread_mutex_unlock(&dq->lock);LOG_WARN("No memory."), -1);
+
+        for (size_t i = dq->head; i < dq->tail; i++) {
+            tasks[i - dq->head] = dq->tasks[i % dq->capacity];
+        }
+        free(dq->tasks);
+        dq->tasks = tasks;
+        dq->tail -= dq->head;
+        dq->head = 0;
+        dq->capacity = newcap;
+    }
+    dq->tasks[dq->tail % dq->capacity] = *task;
+    dq->tail++;
+    pthread_mutex_unlock(&dq->lock);
+    return 0;
+}
+
+static int deque_pop(struct pool_deque *dq, struct pool_task *task, int steal)
+{
+    int found = 0;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail != dq->head) {
+        if (steal) {
+            *task = dq->tasks[dq->head % dq->capacity];
+            dq->head++;
+        } else {
+            dq->tail--;
+            *task = dq->tasks[dq->tail % dq->capacity];
+        }
+        found = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return found;
+}
+
+static int take_task(struct mdd_pool *pool, int id, struct pool_task *task)
+{
+    CHECK_RTN_VAL(deque_pop(&pool->deques[id], task, 0), 1);
+
+    for (int i = 1; i < pool->nthreads; i++) {
+        int victim = (id + i) % pool->nthreads;
+        CHECK_RTN_VAL(deque_pop(&pool->deques[victim], task, 1), 1);
+    }
+    return 0;
+}
+
+static void* worker_main(void *arg)
+{
+    struct pool_worker *worker = (struct pool_worker*) arg;
+    struct mdd_pool *pool = worker->pool;
+    struct pool_task task;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->stop && !pool->queued) {
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        }
+        if (pool->stop && !pool->queued) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        if (!take_task(pool, worker->id, &task)) {
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->queued--;
+        pthread_mutex_unlock(&pool->lock);
+
+        task.fn(task.arg);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->pending--;
+        if (!pool->pending) {
+            pthread_cond_broadcast(&pool->done_cond);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+struct mdd_pool* pool_create(int nthreads)
+{
+    CHECK_DO_RTN_VAL(nthreads <= 0, LOG_WARN("Invalid thread count:%d", nthreads), NULL);
+
+    struct mdd_pool *pool = calloc(1, sizeof(struct mdd_pool));
+    CHECK_DO_RTN_VAL(!pool, LOG_WARN("No memory."), NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    pool->deques = calloc(nthreads, sizeof(struct pool_deque));
+    pool->workers = calloc(nthreads, sizeof(struct pool_worker));
+    CHECK_DO_GOTO(!pool->deques || !pool->workers, LOG_WARN("No memory."), ERR_OUT);
+
+    for (int i = 0; i < nthreads; i++) {
+        pool->deques[i].capacity = DEQUE_CAP;
+        pool->deques[i].tasks = calloc(DEQUE_CAP, sizeof(struct pool_task));
+        CHECK_DO_GOTO(!pool->deques[i].tasks, LOG_WARN("No memory."), ERR_OUT);
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->ndeques++;
+    }
+
+    for (int i = 0; i < nthreads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        CHECK_DO_GOTO(pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]),
+                LOG_WARN("Failed to create worker %d", i), ERR_OUT);
+        pool->nthreads++;
+    }
+    return pool;
+
+ERR_OUT:
+    pool_destroy(pool);
+    return NULL;
+}
+
+void pool_destroy(struct mdd_pool *pool)
+{
+    CHECK_RTN(!pool);
+
+    if (pool->workers) {
+        pthread_mutex_lock(&pool->lock);
+        pool->stop = 1;
+        pthread_cond_broadcast(&pool->work_cond);
+        pthread_mutex_unlock(&pool->lock);
+        for (int i = 0; i < pool->nthreads; i++) {
+            pthread_join(pool->workers[i].thread, NULL);
+        }
+    }
+
+    /* only the first ndeques were set up when pool_create failed part way */
+    for (int i = 0; i < pool->ndeques; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+}
+
+int pool_threads(const struct mdd_pool *pool)
+{
+    return pool ? pool->nthreads : 0;
+}
+
+int pool_submit(struct mdd_pool *pool, pool_task_fn fn, void *arg)
+{
+    CHECK_DO_RTN_VAL(!pool || !fn, LOG_WARN("Invalid task"), -1);
+
+    struct pool_task task = {fn, arg};
+    pthread_mutex_lock(&pool->lock);
+    int id = pool->next_deque;
+    pool->next_deque = (pool->next_deque + 1) % pool->nthreads;
+    pool->pending++;
+    pool->queued++;
+    pthread_mutex_unlock(&pool->lock);
+
+    int rt = deque_push(&pool->deques[id], &task);
+
+    pthread_mutex_lock(&pool->lock);
+    if (rt) {
+        pool->pending--;
+        pool->queued--;
+        pthread_mutex_unlock(&pool->lock);
+        return -1;
+    }
+    pthread_cond_signal(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void pool_wait(struct mdd_pool *pool)
+{
+    CHECK_RTN(!pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending) {
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -56,7 +56,7 @@ public:
         ASSERT_STREQ(name, node->schema->name);
 
         struct mdd_leaf *leaf = (struct mdd_leaf*) node;
-        ASSERT_STREQ(value, leaf->value.strv);
+        ASSERT_STREQ(value, str_leaf_val(leaf));
     }
 
     void assert_data_int_leaf(const char *name, long long value, struct mdd_node *node)
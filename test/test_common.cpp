@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include <string>
+#include <vector>
+#include <string.h>
 
 extern "C" {
 #include "common.h"
@@ -62,3 +64,259 @@ TEST_F(CommonTest, should_add_element_to_vec_and_do_loop_and_free)
 
     vector_free(&dvec);
 }
+
+TEST_F(CommonTest, should_alloc_aligned_from_arena_and_merge)
+{
+    struct mdd_arena a1, a2;
+    ASSERT_EQ(0, arena_init(&a1, 256));
+    ASSERT_EQ(0, arena_init(&a2, 256));
+
+    char *p1 = (char*) arena_alloc(&a1, 3);
+    char *p2 = (char*) arena_alloc(&a1, 5);
+    ASSERT_EQ(0, (uintptr_t) p1 % 16);
+    ASSERT_EQ(0, (uintptr_t) p2 % 16);
+    ASSERT_EQ(16, p2 - p1);
+
+    char *big = (char*) arena_alloc(&a1, 1000);
+    ASSERT_TRUE(NULL != big);
+    memset(big, 1, 1000);
+    ASSERT_EQ(p1 + 32, (char*) arena_alloc(&a1, 8));
+
+    ASSERT_TRUE(NULL != arena_alloc(&a2, 100));
+    size_t used = arena_used(&a1) + arena_used(&a2);
+    arena_merge(&a1, &a2);
+    ASSERT_TRUE(NULL == a2.head);
+    ASSERT_EQ(used, arena_used(&a1));
+    arena_free(&a1);
+    ASSERT_TRUE(NULL == a1.head);
+}
+
+TEST_F(CommonTest, should_keep_btree_ordered_through_puts_and_dels)
+{
+    struct mdd_btree tree;
+    ASSERT_EQ(0, btree_init(&tree));
+
+    static struct TestData vals[2000];
+    for (int i = 0; i < 2000; i++) {
+        int key = (i * 7919) % 2000;
+        vals[key].d = key;
+        ASSERT_EQ(0, btree_put(&tree, key, &vals[key]));
+    }
+    ASSERT_EQ(1, btree_put(&tree, 5, &vals[6]));
+    ASSERT_EQ(2000, tree.size);
+    ASSERT_EQ(&vals[5], btree_get(&tree, 5));
+    ASSERT_TRUE(NULL == btree_get(&tree, 2000));
+
+    for (int i = 0; i < 2000; i += 2) {
+        ASSERT_EQ(&vals[i], btree_del(&tree, i));
+    }
+    ASSERT_TRUE(NULL == btree_del(&tree, 0));
+    ASSERT_EQ(1000, tree.size);
+
+    struct mdd_btree_iter iter;
+    long long key = 0;
+    void *val = NULL;
+    btree_seek(&tree, 1000, &iter);
+    for (int expect = 1001; expect < 2000; expect += 2) {
+        ASSERT_EQ(1, btree_next(&iter, &key, &val));
+        ASSERT_EQ(expect, key);
+        ASSERT_EQ(expect, ((struct TestData*) val)->d);
+    }
+    ASSERT_EQ(0, btree_next(&iter, &key, &val));
+    ASSERT_EQ(1, btree_last(&tree, &key, &val));
+    ASSERT_EQ(1999, key);
+
+    for (int i = 1; i < 2000; i += 2) {
+        ASSERT_EQ(&vals[i], btree_del(&tree, i));
+    }
+    ASSERT_EQ(0, tree.size);
+    ASSERT_TRUE(NULL == tree.root);
+    ASSERT_EQ(0, btree_last(&tree, &key, &val));
+    btree_free(&tree);
+}
+
+TEST_F(CommonTest, should_find_remaining_keys_after_hmap_del)
+{
+    struct mdd_hmap map;
+    ASSERT_EQ(0, hmap_init(&map, 0));
+
+    static struct TestData vals[1000];
+    for (int i = 1; i < 1000; i++) {
+        vals[i].d = i;
+        ASSERT_EQ(0, hmap_put(&map, i * 16, &vals[i]));
+    }
+    for (int i = 1; i < 1000; i += 3) {
+        ASSERT_EQ(&vals[i], hmap_del(&map, i * 16));
+    }
+    ASSERT_TRUE(NULL == hmap_del(&map, 16));
+    ASSERT_EQ(666, map.size);
+
+    for (int i = 1; i < 1000; i++) {
+        ASSERT_EQ(i % 3 == 1 ? NULL : &vals[i], hmap_get(&map, i * 16)) << i;
+    }
+    hmap_free(&map);
+}
+
+TEST_F(CommonTest, should_share_interned_strings_until_last_release)
+{
+    size_t base = strpool_count();
+    string text = "interface-GigabitEthernet0/0/1 and more";
+    const char *a = strpool_intern(text.c_str(), 30);
+    const char *b = strpool_intern("interface-GigabitEthernet0/0/1", 30);
+    const char *c = strpool_intern(text.c_str(), text.size());
+    ASSERT_TRUE(a == b);
+    ASSERT_TRUE(a != c);
+    ASSERT_STREQ("interface-GigabitEthernet0/0/1", a);
+    ASSERT_EQ(base + 2, strpool_count());
+
+    ASSERT_TRUE(a == strpool_ref(a));
+    strpool_release(a);
+    strpool_release(b);
+    ASSERT_EQ(base + 2, strpool_count());
+    strpool_release(a);
+    strpool_release(c);
+    ASSERT_EQ(base, strpool_count());
+
+    /* enough distinct strings to grow the buckets, every one still found afterwards */
+    vector<const char*> strs;
+    for (int i = 0; i < 5000; i++) {
+        string s = "value-" + to_string(i);
+        strs.push_back(strpool_intern(s.c_str(), s.size()));
+    }
+    for (int i = 0; i < 5000; i++) {
+        string s = "value-" + to_string(i);
+        ASSERT_TRUE(strs[i] == strpool_intern(s.c_str(), s.size()));
+        strpool_release(strs[i]);
+        strpool_release(strs[i]);
+    }
+    ASSERT_EQ(base, strpool_count());
+}
+
+TEST_F(CommonTest, should_find_keys_and_first_mismatch_at_every_position)
+{
+    for (size_t cnt = 0; cnt < 70; cnt++) {
+        vector<int32_t> keys(cnt), other(cnt);
+        for (size_t i = 0; i < cnt; i++) {
+            keys[i] = other[i] = (int32_t) (i * 7 + 1);
+        }
+        ASSERT_EQ(-1, keys_find(keys.data(), cnt, 0));
+        ASSERT_EQ(cnt, keys_mismatch(keys.data(), other.data(), cnt));
+        for (size_t pos = 0; pos < cnt; pos++) {
+            ASSERT_EQ((long) pos, keys_find(keys.data(), cnt, keys[pos])) << cnt << ":" << pos;
+            other[pos] = -1;
+            ASSERT_EQ(pos, keys_mismatch(keys.data(), other.data(), cnt)) << cnt << ":" << pos;
+            other[pos] = keys[pos];
+        }
+    }
+
+    /* a repeated key is found at its first position */
+    vector<int32_t> repeated(40, 5);
+    repeated[33] = 9;
+    repeated[38] = 9;
+    ASSERT_EQ(33, keys_find(repeated.data(), repeated.size(), 9));
+    ASSERT_EQ(0, keys_find(repeated.data(), repeated.size(), 5));
+}
+
+TEST_F(CommonTest, should_recycle_pool_blocks_through_depot)
+{
+    nodepool_trim();
+    struct nodepool_stats base, stats;
+    nodepool_get_stats(&base);
+    ASSERT_EQ(0u, base.depot_bytes);
+
+    /* a freed block comes back zeroed to the next request of its class */
+    char *a = (char*) nodepool_alloc(72);
+    memset(a, 0x5a, 72);
+    nodepool_free(a, 72);
+    char *b = (char*) nodepool_alloc(80);
+    ASSERT_TRUE(a == b);
+    for (int i = 0; i < 80; i++) {
+        ASSERT_EQ(0, b[i]);
+    }
+    nodepool_free(b, 80);
+
+    /* blocks past two batches wait in the depot and serve the next round without malloc */
+    vector<void*> blocks(1000);
+    for (auto &block : blocks) {
+        block = nodepool_alloc(64);
+    }
+    for (auto block : blocks) {
+        nodepool_free(block, 64);
+    }
+    nodepool_get_stats(&stats);
+    ASSERT_GT(stats.depot_bytes, 0u);
+    unsigned long long mallocs = stats.mallocs;
+    ASSERT_EQ(base.mallocs + 1 + blocks.size(), mallocs);
+    for (auto &block : blocks) {
+        block = nodepool_alloc(64);
+    }
+    nodepool_get_stats(&stats);
+    ASSERT_EQ(mallocs, stats.mallocs);
+    ASSERT_EQ(base.allocs + 2 + 2 * blocks.size(), stats.allocs);
+    for (auto block : blocks) {
+        nodepool_free(block, 64);
+    }
+
+    /* large blocks and a pool turned off go to malloc and free every time */
+    nodepool_set_limit(0);
+    nodepool_get_stats(&stats);
+    ASSERT_EQ(0u, stats.depot_bytes);
+    nodepool_free(nodepool_alloc(64), 64);
+    nodepool_set_limit(NODEPOOL_LIMIT);
+    nodepool_free(nodepool_alloc(32 * 1024), 32 * 1024);
+    struct nodepool_stats last;
+    nodepool_get_stats(&last);
+    ASSERT_EQ(stats.mallocs + 2, last.mallocs);
+    ASSERT_EQ(stats.frees + 2, last.frees);
+}
+
+TEST_F(CommonTest, should_recycle_block_allocated_with_pool_off)
+{
+    /* a block taken with recycling off is filed under its class, so it must hold the class size */
+    nodepool_set_limit(0);
+    char *a = (char*) nodepool_alloc(40);
+    nodepool_set_limit(NODEPOOL_LIMIT);
+    nodepool_free(a, 40);
+    char *b = (char*) nodepool_alloc(48);
+    ASSERT_TRUE(a == b);
+    memset(b, 0x5a, 48);
+    nodepool_free(b, 48);
+    nodepool_trim();
+}
+
+TEST_F(CommonTest, should_find_first_byte_to_escape)
+{
+    string clean(100, 'a');
+    ASSERT_EQ(100u, json_escape_span(clean.c_str(), clean.size()));
+    ASSERT_EQ(0u, json_escape_span("", 0));
+
+    const char *special = "\"\\\x1f\x01";
+    for (size_t pos : {0u, 15u, 16u, 31u, 32u, 47u, 99u}) {
+        for (const char *c = special; *c; c++) {
+            string str = clean;
+            str[pos] = *c;
+            ASSERT_EQ(pos, json_escape_span(str.c_str(), str.size())) << pos << ":" << (int) *c;
+        }
+    }
+
+    /* bytes above 0x7f are utf-8 and stay as they are */
+    string utf8 = clean + "\xe4\xb8\xad\x7f";
+    ASSERT_EQ(utf8.size(), json_escape_span(utf8.c_str(), utf8.size()));
+}
+
+TEST_F(CommonTest, should_unescape_json_string_bodies)
+{
+    char buf[128];
+    const char *src = R"(a\"b\\c\/d\b\f\n\r\t\u0041\u00e9\u4e2d\ud83d\ude00 end)";
+    long len = json_unescape(buf, src, strlen(src));
+    ASSERT_EQ(string("a\"b\\c/d\b\f\n\r\tA\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80 end"), string(buf, len));
+
+    /* in place, as the output never outgrows the input */
+    strcpy(buf, R"(x\ty)");
+    len = json_unescape(buf, buf, strlen(buf));
+    ASSERT_EQ(string("x\ty"), string(buf, len));
+
+    for (const char *bad : {"\\", "\\x", "\\u12", "\\u12g4", "\\u0000", "\\ud83d", "\\ud83d\\u0041", "\\ude00"}) {
+        ASSERT_EQ(-1, json_unescape(buf, bad, strlen(bad))) << bad;
+    }
+}
@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+#include <fstream>
+
+extern "C" {
+#include "model_test_util.h"
+#include "data_repo.h"
+#include "data_agg.h"
+}
+
+using namespace std;
+using namespace testing;
+
+class DataAggTest: public ModelTestUtil, public Test
+{
+public:
+    void SetUp()
+    {
+        std::ifstream src("../test/testdata/testdata.json", std::ios::binary);
+        std::ofstream dst("testdata_agg.json", std::ios::binary);
+        dst << src.rdbuf();
+        dst.close();
+
+        int rlt = repo_init("../test/testdata/testmodel.json", "testdata_agg.json");
+        ASSERT_EQ(0, rlt);
+    }
+
+    void TearDown()
+    {
+        repo_free();
+        remove("testdata_agg.json");
+    }
+
+    long long value(int id)
+    {
+        long long val = 0;
+        EXPECT_EQ(0, repo_agg_get(id, &val)) << id;
+        return val;
+    }
+};
+
+TEST_F(DataAggTest, should_load_aggregates_from_running)
+{
+    ASSERT_EQ(5, value(repo_agg_register("Data/ChildList", NULL, MDD_AGG_COUNT)));
+    ASSERT_EQ(39, value(repo_agg_register("Data/ChildList", "IntLeaf", MDD_AGG_SUM)));
+    ASSERT_EQ(1, value(repo_agg_register("Data/ChildList", "IntLeaf", MDD_AGG_MIN)));
+    ASSERT_EQ(22, value(repo_agg_register("Data/ChildList", "IntLeaf", MDD_AGG_MAX)));
+    ASSERT_EQ(2, value(repo_agg_register("Data/ChildList/SubChildList", "StrLeaf", MDD_AGG_COUNT)));
+}
+
+TEST_F(DataAggTest, should_reject_invalid_aggregates)
+{
+    ASSERT_EQ(-1, repo_agg_register("Data/Other", NULL, MDD_AGG_COUNT));
+    ASSERT_EQ(-1, repo_agg_register("Data/ChildData", NULL, MDD_AGG_COUNT));
+    ASSERT_EQ(-1, repo_agg_register("Data/ChildList", "Other", MDD_AGG_COUNT));
+    ASSERT_EQ(-1, repo_agg_register("Data/ChildList", NULL, MDD_AGG_SUM));
+    ASSERT_EQ(-1, repo_agg_register("Data/ChildList/SubChildList", "StrLeaf", MDD_AGG_MAX));
+
+    long long val = 0;
+    ASSERT_EQ(-1, repo_agg_get(0, &val));
+    ASSERT_EQ(-1, repo_agg_get(-1, &val));
+}
+
+TEST_F(DataAggTest, should_follow_tracked_commits)
+{
+    int count = repo_agg_register("Data/ChildList", NULL, MDD_AGG_COUNT);
+    int sum = repo_agg_register("Data/ChildList", "IntLeaf", MDD_AGG_SUM);
+    int min = repo_agg_register("Data/ChildList", "IntLeaf", MDD_AGG_MIN);
+    int max = repo_agg_register("Data/ChildList", "IntLeaf", MDD_AGG_MAX);
+    int subs = repo_agg_register("Data/ChildList/SubChildList", NULL, MDD_AGG_COUNT);
+
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=1]/IntLeaf", 100));
+    ASSERT_EQ(0, repo_delete("Data/ChildList[Id=22]"));
+    ASSERT_EQ(0, repo_insert("Data", R"({"ChildList": [{"Id": 5, "IntLeaf": -5}, {"Id": 6}]})"));
+    ASSERT_EQ(39, value(sum));
+    ASSERT_EQ(0, repo_commit());
+
+    ASSERT_EQ(6, value(count));
+    ASSERT_EQ(111, value(sum));
+    ASSERT_EQ(-5, value(min));
+    ASSERT_EQ(100, value(max));
+    ASSERT_EQ(0, value(subs));
+
+    /* removing the extremes falls back to the next values held */
+    ASSERT_EQ(0, repo_delete("Data/ChildList[Id=5]"));
+    ASSERT_EQ(0, repo_delete("Data/ChildList[Id=1]/IntLeaf"));
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(2, value(min));
+    ASSERT_EQ(11, value(max));
+    ASSERT_EQ(16, value(sum));
+
+    repo_agg_unregister(min);
+    long long val = 0;
+    ASSERT_EQ(-1, repo_agg_get(min, &val));
+    ASSERT_EQ(min, repo_agg_register("Data/ChildList", "IntLeaf", MDD_AGG_MIN));
+    ASSERT_EQ(2, value(min));
+}
+
+TEST_F(DataAggTest, should_count_pending_edits_once)
+{
+    int sum = repo_agg_register("Data/ChildList", "IntLeaf", MDD_AGG_SUM);
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=1]/IntLeaf", 100));
+    ASSERT_EQ(39, value(sum));
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(138, value(sum));
+
+    /* registered over pending edits, it waits for their commit instead of loading them */
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=2]/IntLeaf", 200));
+    int late = repo_agg_register("Data/ChildList", "IntLeaf", MDD_AGG_SUM);
+    ASSERT_LE(0, late);
+    long long val = 0;
+    ASSERT_EQ(-1, repo_agg_get(late, &val));
+    ASSERT_EQ(138, value(sum));
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(336, value(late));
+    ASSERT_EQ(336, value(sum));
+}
+
+TEST_F(DataAggTest, should_follow_full_edits)
+{
+    int count = repo_agg_register("Data/ChildList/SubChildList", NULL, MDD_AGG_COUNT);
+    int max = repo_agg_register("Data/ChildList", "IntLeaf", MDD_AGG_MAX);
+
+    ASSERT_EQ(0, repo_edit(R"({"Data": {"ChildList": [{"Id": 7, "IntLeaf": 70,
+            "SubChildList": [{"Id": 1}, {"Id": 2}, {"Id": 3}]}]}})"));
+    ASSERT_EQ(3, value(count));
+    ASSERT_EQ(70, value(max));
+
+    ASSERT_EQ(0, repo_edit(R"({"Data": {"Name": "Empty"}})"));
+    ASSERT_EQ(0, value(count));
+    long long val = 0;
+    ASSERT_EQ(-1, repo_agg_get(max, &val));
+}
+
+TEST_F(DataAggTest, should_serve_column_snapshot_lists_from_snapshot)
+{
+    repo_free();
+    std::ofstream("testmodel_agg.json") << R"({"Data": {"@attr": {"mtype": "container"},
+        "Name": {"@attr": {"mtype": "leaf", "dtype": "string"}},
+        "PortList": {"@attr": {"mtype": "list", "snapshot": "columnar"},
+            "Id": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+            "Speed": {"@attr": {"mtype": "leaf", "dtype": "int"}}}}})";
+    std::ofstream("testdata_agg.json") << R"({"Data": {"Name": "sw", "PortList": [
+        {"Id": 1, "Speed": 10}, {"Id": 2, "Speed": 40}, {"Id": 3}]}})";
+    ASSERT_EQ(0, repo_init("testmodel_agg.json", "testdata_agg.json"));
+
+    int count = repo_agg_register("Data/PortList", NULL, MDD_AGG_COUNT);
+    int sum = repo_agg_register("Data/PortList", "Speed", MDD_AGG_SUM);
+    int max = repo_agg_register("Data/PortList", "Speed", MDD_AGG_MAX);
+    ASSERT_EQ(3, value(count));
+    ASSERT_EQ(50, value(sum));
+    ASSERT_EQ(40, value(max));
+
+    ASSERT_EQ(0, repo_set_str("Data/Name", "core"));
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(50, value(sum));
+
+    ASSERT_EQ(0, repo_set_int("Data/PortList[Id=1]/Speed", 100));
+    ASSERT_EQ(0, repo_delete("Data/PortList[Id=3]"));
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(2, value(count));
+    ASSERT_EQ(140, value(sum));
+    ASSERT_EQ(100, value(max));
+
+    ASSERT_EQ(0, repo_edit(R"({"Data": {"Name": "Empty"}})"));
+    ASSERT_EQ(0, value(count));
+    long long val = 0;
+    ASSERT_EQ(-1, repo_agg_get(max, &val));
+    ASSERT_EQ(0, repo_edit(R"({"Data": {"PortList": [{"Id": 9, "Speed": 7}]}})"));
+    ASSERT_EQ(7, value(max));
+    remove("testmodel_agg.json");
+}
+
+TEST_F(DataAggTest, should_take_column_snapshot_of_committed_edits_only)
+{
+    repo_free();
+    std::ofstream("testmodel_agg.json") << R"({"Data": {"@attr": {"mtype": "container"},
+        "PortList": {"@attr": {"mtype": "list", "snapshot": "columnar"},
+            "Id": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+            "Speed": {"@attr": {"mtype": "leaf", "dtype": "int"}}}}})";
+    std::ofstream("testdata_agg.json") << R"({"Data": {"PortList": [{"Id": 1, "Speed": 10}, {"Id": 2, "Speed": 40}]}})";
+    ASSERT_EQ(0, repo_init("testmodel_agg.json", "testdata_agg.json"));
+
+    int sum = repo_agg_register("Data/PortList", "Speed", MDD_AGG_SUM);
+    ASSERT_EQ(50, value(sum));
+    ASSERT_EQ(0, repo_set_int("Data/PortList[Id=1]/Speed", 100));
+    ASSERT_EQ(0, repo_commit());
+
+    /* the snapshot is due, but not over an edit that gets aborted */
+    ASSERT_EQ(0, repo_set_int("Data/PortList[Id=2]/Speed", 400));
+    long long val = 0;
+    ASSERT_EQ(-1, repo_agg_get(sum, &val));
+    repo_abort();
+    ASSERT_EQ(140, value(sum));
+
+    ASSERT_EQ(0, repo_set_int("Data/PortList[Id=2]/Speed", 400));
+    ASSERT_EQ(140, value(sum));
+    int late = repo_agg_register("Data/PortList", "Speed", MDD_AGG_SUM);
+    ASSERT_EQ(-1, repo_agg_get(late, &val));
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(500, value(sum));
+    ASSERT_EQ(500, value(late));
+    remove("testmodel_agg.json");
+}
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include <string>
+
+extern "C" {
+#include "model_test_util.h"
+#include "data_parser.h"
+#include "data_agg.h"
+#include "data_column.h"
+}
+
+using namespace std;
+using namespace testing;
+
+static const char *COLUMN_MODEL_JSON = R"({
+    "Data": {
+        "@attr": {"mtype": "container"},
+        "Name": {"@attr": {"mtype": "leaf", "dtype": "string"}},
+        "PortList": {
+            "@attr": {"mtype": "list", "snapshot": "columnar"},
+            "Id": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+            "Speed": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+            "Desc": {"@attr": {"mtype": "leaf", "dtype": "string"}},
+            "State": {"@attr": {"mtype": "leaf", "dtype": "enum", "enum": ["down", "up"]}}
+        }
+    }
+})";
+
+class DataColumnTest: public ModelTestUtil, public Test
+{
+public:
+    void SetUp()
+    {
+        schema = mds_load_model(COLUMN_MODEL_JSON);
+        ASSERT_TRUE(NULL != schema);
+        ports = mds_find_child_schema(schema, "PortList");
+        speed = mds_find_child_schema(ports, "Speed");
+        desc = mds_find_child_schema(ports, "Desc");
+        state = mds_find_child_schema(ports, "State");
+    }
+
+    void TearDown()
+    {
+        mds_free_model(schema);
+    }
+
+    struct mds_node *schema;
+    struct mds_node *ports;
+    struct mds_node *speed;
+    struct mds_node *desc;
+    struct mds_node *state;
+};
+
+TEST_F(DataColumnTest, should_hold_list_as_sorted_columns)
+{
+    struct mdd_node *data = mdd_parse_data(schema, R"({"Data": {"Name": "sw", "PortList": [
+        {"Id": 30, "Speed": 100, "Desc": "uplink to the core switch", "State": "up"},
+        {"Id": 10, "Speed": 10, "State": "down"},
+        {"Id": 20, "Desc": "spare"}]}})");
+    ASSERT_TRUE(NULL != data);
+    struct mdd_columns *cols = mdd_columns_snapshot(data, ports, 1);
+    ASSERT_TRUE(NULL != cols);
+    ASSERT_EQ(3u, mdd_columns_rows(cols));
+    ASSERT_EQ(10, mdd_columns_key(cols, 0));
+    ASSERT_EQ(30, mdd_columns_key(cols, 2));
+
+    ASSERT_EQ(2, mdd_columns_find(cols, 30));
+    ASSERT_EQ(-1, mdd_columns_find(cols, 25));
+    long long val = 0;
+    ASSERT_EQ(0, mdd_columns_int(cols, 2, speed, &val));
+    ASSERT_EQ(100, val);
+    ASSERT_EQ(-1, mdd_columns_int(cols, 1, speed, &val));
+    ASSERT_EQ(-1, mdd_columns_int(cols, 1, desc, &val));
+    ASSERT_STREQ("spare", mdd_columns_str(cols, 1, desc));
+    ASSERT_STREQ("uplink to the core switch", mdd_columns_str(cols, 2, desc));
+    ASSERT_STREQ("down", mdd_columns_str(cols, 0, state));
+    ASSERT_TRUE(NULL == mdd_columns_str(cols, 1, state));
+
+    struct mdd_column_cursor cursor;
+    ASSERT_EQ(0, mdd_columns_range(cols, 15, 30, &cursor));
+    ASSERT_EQ(1, mdd_columns_next(&cursor));
+    ASSERT_EQ(2, mdd_columns_next(&cursor));
+    ASSERT_EQ(-1, mdd_columns_next(&cursor));
+    ASSERT_EQ(-1, mdd_columns_next(&cursor));
+
+    /* a row turned back into an instance dumps like the one it came from */
+    struct mdd_node *node = mdd_columns_node(cols, 2);
+    ASSERT_TRUE(NULL != node);
+    char *json = NULL;
+    ASSERT_EQ(0, mdd_dump_subtree(node, &json));
+    ASSERT_STREQ(R"({"Id":30,"Speed":100,"Desc":"uplink to the core switch","State":"up"})", json);
+    free(json);
+    mdd_free_data(node);
+
+    mdd_columns_free(cols);
+    mdd_free_data(data);
+}
+
+TEST_F(DataColumnTest, should_keep_snapshot_apart_from_later_edits)
+{
+    struct mdd_node *data = mdd_parse_data(schema, R"({"Data": {"PortList": [{"Id": 1, "Speed": 10}, {"Id": 2}]}})");
+    ASSERT_TRUE(NULL != data);
+    struct mdd_columns *cols = mdd_columns_snapshot(data, ports, 7);
+    ASSERT_TRUE(NULL != cols);
+    ASSERT_EQ(7u, mdd_columns_version(cols));
+
+    struct mdd_track track;
+    mdd_track_init(&track);
+    ASSERT_EQ(0, mdd_set_int(&track, mdd_get_data(data, "Data/PortList[Id=1]/Speed"), 99));
+    long long val = 0;
+    ASSERT_EQ(0, mdd_columns_int(cols, 0, speed, &val));
+    ASSERT_EQ(10, val);
+
+    struct mdd_columns *next = mdd_columns_snapshot(data, ports, 8);
+    ASSERT_EQ(8u, mdd_columns_version(next));
+    ASSERT_EQ(0, mdd_columns_int(next, 0, speed, &val));
+    ASSERT_EQ(99, val);
+
+    mdd_columns_free(next);
+    mdd_columns_free(cols);
+    mdd_track_free(&track);
+    mdd_free_data(data);
+}
+
+TEST_F(DataColumnTest, should_aggregate_like_node_walk)
+{
+    string json = R"({"Data": {"PortList": [)";
+    for (int i = 0; i < 300; i++) {
+        json += (i ? "," : "") + string("{\"Id\": ") + to_string(i);
+        json += i % 7 ? ", \"Speed\": " + to_string(i * 37 % 1000 - 400) + "}" : "}";
+    }
+    json += "]}}";
+    struct mdd_node *data = mdd_parse_data(schema, json.c_str());
+    ASSERT_TRUE(NULL != data);
+    struct mdd_columns *cols = mdd_columns_snapshot(data, ports, 1);
+    ASSERT_TRUE(NULL != cols);
+
+    for (mdd_agg_type type : {MDD_AGG_COUNT, MDD_AGG_SUM, MDD_AGG_MIN, MDD_AGG_MAX}) {
+        struct mdd_agg *agg = mdd_agg_create(schema, "Data/PortList", "Speed", type);
+        ASSERT_EQ(0, mdd_agg_load(agg, data));
+        long long expect = 0, val = 0;
+        ASSERT_EQ(0, mdd_agg_value(agg, &expect));
+        ASSERT_EQ(0, mdd_columns_agg(cols, speed, type, &val));
+        ASSERT_EQ(expect, val) << "type " << type;
+        mdd_agg_free(agg);
+    }
+    long long val = 0;
+    ASSERT_EQ(0, mdd_columns_agg(cols, NULL, MDD_AGG_COUNT, &val));
+    ASSERT_EQ(300, val);
+    ASSERT_EQ(-1, mdd_columns_agg(cols, desc, MDD_AGG_SUM, &val));
+    ASSERT_EQ(0, mdd_columns_agg(cols, desc, MDD_AGG_COUNT, &val));
+    ASSERT_EQ(0, val);
+    ASSERT_EQ(-1, mdd_columns_agg(cols, desc, MDD_AGG_MAX, &val));
+
+    mdd_columns_free(cols);
+    mdd_free_data(data);
+}
+
+TEST_F(DataColumnTest, should_reject_lists_not_declared_column_snapshot)
+{
+    struct mdd_node *data = mdd_parse_data(schema, R"({"Data": {"PortList": [{"Id": 1}, {"Id": 1}]}})");
+    ASSERT_TRUE(NULL != data);
+    ASSERT_TRUE(NULL == mdd_columns_snapshot(data, ports, 1));
+    ASSERT_TRUE(NULL == mdd_columns_snapshot(data, speed, 1));
+    mdd_free_data(data);
+
+    data = mdd_parse_data(schema, R"({"Data": {"Name": "empty"}})");
+    struct mdd_columns *cols = mdd_columns_snapshot(data, ports, 1);
+    ASSERT_TRUE(NULL != cols);
+    ASSERT_EQ(0u, mdd_columns_rows(cols));
+    ASSERT_EQ(-1, mdd_columns_find(cols, 0));
+    mdd_columns_free(cols);
+    mdd_free_data(data);
+
+    ASSERT_TRUE(NULL == mds_load_model(R"({"Data": {"@attr": {"mtype": "container"},
+        "L": {"@attr": {"mtype": "list", "snapshot": "columnar"},
+            "Id": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+            "Sub": {"@attr": {"mtype": "container"}}}}})"));
+    ASSERT_TRUE(NULL == mds_load_model(R"({"Data": {"@attr": {"mtype": "container"},
+        "L": {"@attr": {"mtype": "list", "snapshot": "columnar"},
+            "Id": {"@attr": {"mtype": "leaf", "dtype": "string"}}}}})"));
+}
@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+#include <string>
+
+extern "C" {
+#include "model_test_util.h"
+#include "data_parser.h"
+#include "data_pack.h"
+}
+
+using namespace std;
+using namespace testing;
+
+static const char *PACK_MODEL_JSON = R"({
+    "Data": {
+        "@attr": {"mtype": "container"},
+        "Name": {"@attr": {"mtype": "leaf", "dtype": "string"}},
+        "Mode": {"@attr": {"mtype": "leaf", "dtype": "enum", "enum": ["off", "on"]}},
+        "ChildList": {
+            "@attr": {"mtype": "list", "index": "ordered"},
+            "Id": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+            "Value": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+            "SubChildList": {
+                "@attr": {"mtype": "list"},
+                "Id": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+                "StrLeaf": {"@attr": {"mtype": "leaf", "dtype": "string"}}
+            }
+        }
+    }
+})";
+
+static const char *PACK_DATA_JSON = R"({"Data":{"Name":"a name longer than fifteen bytes","Mode":"on",)"
+        R"("ChildList":[{"Id":1,"Value":-5,"SubChildList":[{"Id":1,"StrLeaf":"x"},{"Id":2,"StrLeaf":""}]},)"
+        R"({"Id":7,"Value":70}]}})";
+
+class DataPackTest: public ModelTestUtil, public Test
+{
+public:
+    void SetUp()
+    {
+        schema = mds_load_model(PACK_MODEL_JSON);
+        data = mdd_parse_data(schema, PACK_DATA_JSON);
+        ASSERT_TRUE(NULL != data);
+    }
+
+    void TearDown()
+    {
+        mdd_free_data(data);
+        mds_free_model(schema);
+    }
+
+    string dump(struct mdd_node *root)
+    {
+        char *json = NULL;
+        EXPECT_EQ(0, mdd_dump_data(root, &json));
+        string rlt = json ? json : "";
+        free(json);
+        return rlt;
+    }
+
+    /* walks both copies in step and counts the nodes */
+    size_t assert_same_tree(const struct mdd_pack *pack, mdd_ref ref, struct mdd_node *node)
+    {
+        size_t cnt = 0;
+        for (; node; node = node->next, ref = mdd_pack_next(pack, ref)) {
+            EXPECT_NE(MDD_REF_NULL, ref);
+            EXPECT_EQ(node->schema, mdd_pack_schema(pack, ref));
+            if (is_leaf_node(node->schema)) {
+                EXPECT_TRUE(mdd_ref_is_leaf(ref));
+                long long val = 0;
+                if (is_str_leaf((struct mds_leaf*) node->schema)) {
+                    EXPECT_STREQ(str_leaf_val(node), mdd_pack_str(pack, ref));
+                    EXPECT_EQ(-1, mdd_pack_int(pack, ref, &val));
+                } else {
+                    EXPECT_EQ(0, mdd_pack_int(pack, ref, &val));
+                    EXPECT_EQ(((struct mdd_leaf*) node)->value.intv, val);
+                }
+            } else {
+                cnt += assert_same_tree(pack, mdd_pack_child(pack, ref), node->child);
+            }
+            cnt++;
+        }
+        EXPECT_EQ(MDD_REF_NULL, ref);
+        return cnt;
+    }
+
+    struct mds_node *schema;
+    struct mdd_node *data;
+};
+
+TEST_F(DataPackTest, should_walk_pack_like_tree)
+{
+    struct mdd_pack *pack = mdd_pack_build(data);
+    ASSERT_TRUE(NULL != pack);
+    ASSERT_EQ(15u, assert_same_tree(pack, mdd_pack_root(pack), data));
+
+    mdd_ref list = mdd_pack_find(pack, mdd_pack_root(pack), mds_find_child_schema(schema, "ChildList"));
+    ASSERT_NE(MDD_REF_NULL, list);
+    ASSERT_FALSE(mdd_ref_is_leaf(list));
+    ASSERT_EQ(mdd_pack_root(pack), mdd_pack_parent(pack, list));
+    mdd_ref id = mdd_pack_child(pack, list);
+    ASSERT_EQ(list, mdd_pack_parent(pack, id));
+    ASSERT_EQ(MDD_REF_NULL, mdd_pack_child(pack, id));
+
+    mdd_ref mode = mdd_pack_find(pack, mdd_pack_root(pack), mds_find_child_schema(schema, "Mode"));
+    ASSERT_STREQ("on", mdd_pack_str(pack, mode));
+    ASSERT_EQ(MDD_REF_NULL, mdd_pack_parent(pack, mdd_pack_root(pack)));
+    ASSERT_TRUE(NULL == mdd_pack_schema(pack, 0xfffffff0u));
+    ASSERT_LT(mdd_pack_bytes(pack), 64 * 1024u);
+    mdd_pack_free(pack);
+}
+
+TEST_F(DataPackTest, should_turn_pack_back_into_nodes)
+{
+    struct mdd_pack *pack = mdd_pack_build(data);
+    ASSERT_TRUE(NULL != pack);
+
+    struct mdd_node *root = mdd_pack_node(pack, mdd_pack_root(pack));
+    ASSERT_TRUE(NULL != root);
+    ASSERT_EQ(dump(data), dump(root));
+    ASSERT_TRUE(NULL != mdd_find_list(root, mds_find_child_schema(schema, "ChildList"), 7));
+    mdd_diff *diff = mdd_get_diff(schema, data, root);
+    ASSERT_TRUE(NULL != diff);
+    ASSERT_EQ(0u, diff->size);
+    mdd_free_diff(diff);
+    mdd_free_data(root);
+
+    mdd_ref list = mdd_pack_find(pack, mdd_pack_root(pack), mds_find_child_schema(schema, "ChildList"));
+    struct mdd_node *inst = mdd_pack_node(pack, list);
+    char *json = NULL;
+    ASSERT_EQ(0, mdd_dump_subtree(inst, &json));
+    ASSERT_STREQ(R"({"Id":1,"Value":-5,"SubChildList":[{"Id":1,"StrLeaf":"x"},{"Id":2,"StrLeaf":""}]})", json);
+    free(json);
+    mdd_free_data(inst);
+
+    ASSERT_TRUE(NULL == mdd_pack_node(pack, MDD_REF_NULL));
+    mdd_pack_free(pack);
+}
+
+TEST_F(DataPackTest, should_get_pack_nodes_by_path)
+{
+    struct mdd_pack *pack = mdd_pack_build(data);
+    ASSERT_TRUE(NULL != pack);
+    long long val = 0;
+
+    ASSERT_EQ(mdd_pack_root(pack), mdd_pack_get(pack, "Data"));
+    ASSERT_EQ(0, mdd_pack_int(pack, mdd_pack_get(pack, "Data/ChildList[Id=7]/Value"), &val));
+    ASSERT_EQ(70, val);
+    ASSERT_EQ(0, mdd_pack_int(pack, mdd_pack_get(pack, "Data/ChildList[Id=01]/Value"), &val));
+    ASSERT_EQ(-5, val);
+    ASSERT_STREQ("", mdd_pack_str(pack, mdd_pack_get(pack, "Data/ChildList[Id=1]/SubChildList[Id=2]/StrLeaf")));
+    ASSERT_STREQ("x", mdd_pack_str(pack, mdd_pack_get(pack, "Data/ChildList[Value=-5]/SubChildList[StrLeaf=x]/StrLeaf")));
+    ASSERT_EQ(mdd_pack_get(pack, "Data/ChildList[Id=7]"), mdd_pack_get(pack, "Data[Mode=on]/ChildList[Value=70]"));
+    ASSERT_EQ(0, mdd_pack_int(pack, mdd_pack_get(pack, "Data/Mode"), &val));
+    ASSERT_EQ(1, val);
+
+    ASSERT_EQ(MDD_REF_NULL, mdd_pack_get(pack, "Data/ChildList[Id=2]"));
+    ASSERT_EQ(MDD_REF_NULL, mdd_pack_get(pack, "Data/ChildList[Id=7x]"));
+    ASSERT_EQ(MDD_REF_NULL, mdd_pack_get(pack, "Data/ChildList[Id=1]/SubChildList[Id=3]"));
+    ASSERT_EQ(MDD_REF_NULL, mdd_pack_get(pack, "Data[Mode=off]/Name"));
+    ASSERT_EQ(MDD_REF_NULL, mdd_pack_get(pack, "Other/Name"));
+    ASSERT_EQ(MDD_REF_NULL, mdd_pack_get(pack, "Data/Other"));
+    ASSERT_EQ(MDD_REF_NULL, mdd_pack_get(pack, "Data/Name/Other"));
+    ASSERT_EQ(MDD_REF_NULL, mdd_pack_get(pack, ""));
+    mdd_pack_free(pack);
+}
+
+TEST_F(DataPackTest, should_hold_leaves_in_mo_value_arrays)
+{
+    struct mdd_node *tree = mdd_parse_data(schema, R"({"Data":{"ChildList":[{"Id":3,"SubChildList":[{"Id":1}]}],)"
+            R"("Name":"a name longer than fifteen bytes","Mode":"off"}})");
+    ASSERT_TRUE(NULL != tree);
+    struct mdd_pack *pack = mdd_pack_build(tree);
+    ASSERT_TRUE(NULL != pack);
+
+    /* leaves come first in schema order, absent ones are skipped */
+    mdd_ref root = mdd_pack_root(pack);
+    mdd_ref name = mdd_pack_child(pack, root);
+    ASSERT_TRUE(mdd_ref_is_leaf(name));
+    ASSERT_EQ(mds_find_child_schema(schema, "Name"), mdd_pack_schema(pack, name));
+    ASSERT_EQ(root, mdd_pack_parent(pack, name));
+    mdd_ref mode = mdd_pack_next(pack, name);
+    ASSERT_STREQ("off", mdd_pack_str(pack, mode));
+    mdd_ref inst = mdd_pack_next(pack, mode);
+    ASSERT_FALSE(mdd_ref_is_leaf(inst));
+    ASSERT_EQ(MDD_REF_NULL, mdd_pack_next(pack, inst));
+
+    struct mds_node *list = mds_find_child_schema(schema, "ChildList");
+    ASSERT_EQ(MDD_REF_NULL, mdd_pack_find(pack, inst, mds_find_child_schema(list, "Value")));
+    mdd_ref id = mdd_pack_find(pack, inst, mds_find_child_schema(list, "Id"));
+    ASSERT_EQ(mdd_pack_child(pack, inst), id);
+    ASSERT_FALSE(mdd_ref_is_leaf(mdd_pack_next(pack, id)));
+    ASSERT_EQ(MDD_REF_NULL, mdd_pack_find(pack, root, mds_find_child_schema(list, "Id")));
+
+    /* views read like parsed leaves without being allocated */
+    struct mdd_leaf view;
+    ASSERT_EQ(0, mdd_pack_view(pack, name, &view));
+    assert_data_string_leaf("Name", "a name longer than fifteen bytes", (struct mdd_node*) &view);
+    ASSERT_EQ(0, mdd_pack_view(pack, id, &view));
+    assert_data_int_leaf("Id", 3, (struct mdd_node*) &view);
+    ASSERT_EQ(0, mdd_pack_view(pack, mdd_pack_get(pack, "Data/ChildList[Id=3]/SubChildList[Id=1]/Id"), &view));
+    assert_data_int_leaf("Id", 1, (struct mdd_node*) &view);
+    ASSERT_EQ(-1, mdd_pack_view(pack, inst, &view));
+    ASSERT_EQ(-1, mdd_pack_view(pack, id + 2, &view));
+
+    mdd_pack_free(pack);
+    mdd_free_data(tree);
+}
@@ -1,4 +1,6 @@
 #include "gtest/gtest.h"
+#include <climits>
+#include <string>
 
 extern "C" {
 #include "data_parser.h"
@@ -338,6 +340,162 @@ TEST_F(DataParser, test_should_dump_multi_layer_list)
     free(dump);
 }
 
+TEST_F(DataParser, should_parse_escapes_and_full_range_ints)
+{
+    data = mdd_parse_data(schema, "{\"Data\" : {\"Na\\u006de\": \"a\\\"b\\\\c\\u00e9\\n\",\n"
+            "\"Value\": -1234567890123, \"ChildList\": [{\"Id\": 1e2, \"Value\": 9223372036854775807}, {\"Id\": 2.9, \"SubChildList\": []}]}}");
+    ASSERT_TRUE(NULL != data);
+    ASSERT_STREQ("a\"b\\c\xc3\xa9\n", str_leaf_val((struct mdd_leaf*) mdd_get_data(data, "Data/Name")));
+    ASSERT_EQ(-1234567890123LL, ((struct mdd_leaf*) mdd_get_data(data, "Data/Value"))->value.intv);
+    ASSERT_EQ(9223372036854775807LL, ((struct mdd_leaf*) mdd_get_data(data, "Data/ChildList[Id=100]/Value"))->value.intv);
+    ASSERT_TRUE(NULL != mdd_get_data(data, "Data/ChildList[Id=2]"));
+}
+
+TEST_F(DataParser, should_read_19_digit_ints_exactly)
+{
+    const char *NUMS[] = {"9007199254740993", "9223372036854775807", "9223372036854775806", "-9223372036854775808",
+            "-9223372036854775807", "1000000000000000001", "-1000000000000000001", "9223372036854775808",
+            "-9223372036854775809", "99999999999999999999", "1.5e3"};
+    const long long VALS[] = {9007199254740993LL, LLONG_MAX, LLONG_MAX - 1, LLONG_MIN, LLONG_MIN + 1,
+            1000000000000000001LL, -1000000000000000001LL, LLONG_MAX, LLONG_MIN, LLONG_MAX, 1500};
+    std::string json = R"({"Data": {"ChildList": [)";
+    for (size_t i = 0; i < sizeof(NUMS) / sizeof(NUMS[0]); i++) {
+        json += (i ? "," : "") + std::string(R"({"Id": )") + std::to_string(i) + R"(, "Value": )" + NUMS[i] + "}";
+    }
+    data = mdd_parse_data(schema, (json + "]}}").c_str());
+    ASSERT_TRUE(NULL != data);
+
+    for (size_t i = 0; i < sizeof(NUMS) / sizeof(NUMS[0]); i++) {
+        std::string path = "Data/ChildList[Id=" + std::to_string(i) + "]/Value";
+        ASSERT_EQ(VALS[i], ((struct mdd_leaf*) mdd_get_data(data, path.c_str()))->value.intv) << NUMS[i];
+    }
+}
+
+TEST_F(DataParser, should_reject_malformed_data)
+{
+    const char *BAD_JSONS[] = {
+        "", "{}", "{\"Data\": {}} x", "{\"Data\": {}, \"More\": {}}", "{\"Data\": {\"Value\": 1 \"Name\": \"a\"}}",
+        "{\"Data\": {\"Other\": 1}}", "{\"Data\": {\"Value\": \"1\"}}", "{\"Data\": {\"Name\": 1}}",
+        "{\"Data\": {\"Value\": 01}}", "{\"Data\": {\"Value\": 1.}}", "{\"Data\": {\"Value\": -}}",
+        "{\"Data\": {\"Value\": true}}", "{\"Data\": {\"Name\": \"a\\x\"}}", "{\"Data\": {\"Name\": \"a}}",
+        "{\"Data\": {\"ChildList\": {\"Id\": 1}}}", "{\"Data\": {\"ChildList\": [{\"Id\": 1},]}}",
+        "{\"Data\": {\"ChildData\": [{\"Id\": 1}]}}", "{\"Data\": {\"Name\": \"a\",}}"
+    };
+    for (const char *json : BAD_JSONS) {
+        ASSERT_TRUE(NULL == mdd_parse_data(schema, json)) << json;
+    }
+}
+
+TEST_F(DataParser, should_parse_same_tree_as_cjson)
+{
+    const char *TEST_DATA_JSON = R"({"Data": {"Name": "vc\"1000", "Value": 7, "ChildData": {"Id": 3},
+        "ChildList": [{"Id": 1, "Value": -1, "SubChildList": [{"Id": 1, "IntLeaf": 100}, {"Id": 2}]},
+        {"Id": 2}, {"Id": 3, "Value": 3}]}})";
+    data = mdd_parse_data(schema, TEST_DATA_JSON);
+    cJSON *json = cJSON_Parse(TEST_DATA_JSON);
+    struct mdd_node *other = mdd_parse_json(schema, json);
+    cJSON_Delete(json);
+
+    char *dump = NULL, *other_dump = NULL;
+    ASSERT_EQ(0, mdd_dump_data(data, &dump));
+    ASSERT_EQ(0, mdd_dump_data(other, &other_dump));
+    ASSERT_STREQ(other_dump, dump);
+    free(dump);
+    free(other_dump);
+    mdd_free_data(other);
+}
+
+TEST_F(DataParser, should_parse_enum_leafs_as_codes)
+{
+    const char *ENUM_MODEL_JSON = R"({"Data": {"@attr": {"mtype": "container"},
+        "Admin": {"@attr": {"mtype": "leaf", "dtype": "enum", "enum": ["up", "down"]}},
+        "Ports": {"@attr": {"mtype": "list"},
+            "Id": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+            "Mode": {"@attr": {"mtype": "leaf", "dtype": "enum", "enum": ["access", "trunk"], "index": "multi"}}}}})";
+    const char *ENUM_DATA_JSON = R"({"Data": {"Admin": "do\u0077n", "Ports": [{"Id": 1, "Mode": "trunk"},
+        {"Id": 2, "Mode": "access"}, {"Id": 3, "Mode": "trunk"}]}})";
+    struct mds_node *enums = mds_load_model(ENUM_MODEL_JSON);
+    data = mdd_parse_data(enums, ENUM_DATA_JSON);
+    ASSERT_TRUE(NULL != data);
+    ASSERT_EQ(1, ((struct mdd_leaf*) mdd_get_data(data, "Data/Admin"))->value.intv);
+    ASSERT_EQ(0, ((struct mdd_leaf*) mdd_get_data(data, "Data/Ports[Id=2]/Mode"))->value.intv);
+    ASSERT_EQ(mdd_get_data(data, "Data/Ports[Id=2]"), mdd_get_data(data, "Data/Ports[Mode=access]"));
+    ASSERT_TRUE(NULL == mdd_get_data(data, "Data/Ports[Mode=hybrid]"));
+
+    char *dump = NULL;
+    ASSERT_EQ(0, mdd_dump_data(data, &dump));
+    ASSERT_STREQ(R"({"Data":{"Admin":"down","Ports":[{"Id":1,"Mode":"trunk"},{"Id":2,"Mode":"access"},)"
+            R"({"Id":3,"Mode":"trunk"}]}})", dump);
+    cJSON *json = cJSON_Parse(dump);
+    struct mdd_node *other = mdd_parse_json(enums, json);
+    cJSON_Delete(json);
+    free(dump);
+    ASSERT_TRUE(NULL != other);
+
+    char *snap = NULL;
+    size_t snap_len = 0;
+    ASSERT_EQ(0, mdd_dump_snapshot(other, &snap, &snap_len));
+    struct mdd_node *loaded = mdd_load_snapshot(enums, snap, snap_len);
+    free(snap);
+    ASSERT_TRUE(NULL != loaded);
+    ASSERT_EQ(1, ((struct mdd_leaf*) mdd_get_data(loaded, "Data/Admin"))->value.intv);
+    mdd_free_data(loaded);
+
+    /* equal codes give no diff, then a set by name is diffed as an int */
+    mdd_diff *diff = mdd_get_diff(enums, data, other);
+    ASSERT_EQ(0, diff->size);
+    mdd_free_diff(diff);
+    struct mdd_track track;
+    ASSERT_EQ(0, mdd_track_init(&track));
+    ASSERT_EQ(-1, mdd_set_str(&track, mdd_get_data(other, "Data/Admin"), "testing"));
+    ASSERT_EQ(-1, mdd_set_int(&track, mdd_get_data(other, "Data/Admin"), 0));
+    ASSERT_EQ(0, mdd_set_str(&track, mdd_get_data(other, "Data/Admin"), "up"));
+    diff = mdd_get_diff(enums, data, other);
+    ASSERT_EQ(1, diff->size);
+    ASSERT_EQ(1, diff->vec[0]->leaf_cnt);
+    mdd_free_diff(diff);
+    mdd_track_free(&track);
+    mdd_free_data(other);
+
+    const char *BAD_JSONS[] = {R"({"Data": {"Admin": "UP"}})", R"({"Data": {"Admin": 0}})",
+        R"({"Data": {"Ports": [{"Id": 1, "Mode": "hybrid"}]}})"};
+    for (const char *bad : BAD_JSONS) {
+        ASSERT_TRUE(NULL == mdd_parse_data(enums, bad)) << bad;
+        json = cJSON_Parse(bad);
+        ASSERT_TRUE(NULL == mdd_parse_json(enums, json)) << bad;
+        cJSON_Delete(json);
+    }
+    mdd_free_data(data);
+    data = NULL;
+    mds_free_model(enums);
+}
+
+TEST_F(DataParser, should_reject_taken_key_or_unique_value_at_parse)
+{
+    const char *INDEX_MODEL_JSON = R"({"Data": {"@attr": {"mtype": "container"},
+        "Ports": {"@attr": {"mtype": "list", "index": "ordered"},
+            "Id": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+            "Name": {"@attr": {"mtype": "leaf", "dtype": "string", "index": "unique"}},
+            "Mode": {"@attr": {"mtype": "leaf", "dtype": "int", "index": "multi"}}}}})";
+    struct mds_node *indexed = mds_load_model(INDEX_MODEL_JSON);
+    data = mdd_parse_data(indexed, R"({"Data": {"Ports": [{"Id": 1, "Name": "a", "Mode": 1},
+        {"Id": 2, "Name": "b", "Mode": 1}]}})");
+    ASSERT_TRUE(NULL != data);
+    ASSERT_EQ(mdd_get_data(data, "Data/Ports[Id=2]"), mdd_get_data(data, "Data/Ports[Name=b]"));
+
+    const char *BAD_JSONS[] = {R"({"Data": {"Ports": [{"Id": 1, "Name": "a"}, {"Id": 2, "Name": "a"}]}})",
+        R"({"Data": {"Ports": [{"Id": 1, "Name": "a"}, {"Id": 1, "Name": "b"}]}})"};
+    for (const char *bad : BAD_JSONS) {
+        ASSERT_TRUE(NULL == mdd_parse_data(indexed, bad)) << bad;
+        cJSON *json = cJSON_Parse(bad);
+        ASSERT_TRUE(NULL == mdd_parse_json(indexed, json)) << bad;
+        cJSON_Delete(json);
+    }
+    mdd_free_data(data);
+    data = NULL;
+    mds_free_model(indexed);
+}
+
 TEST_F(DataParser, test_should_get_root_container_diff)
 {
     const char *TEST_DATA_JSON_1 = R"({
@@ -362,7 +520,7 @@ TEST_F(DataParser, test_should_get_root_container_diff)
 
     struct mdd_mo_diff* modiff = (struct mdd_mo_diff*)diff->vec[0];
     ASSERT_EQ(DF_MODIFY, modiff->type);
-    ASSERT_EQ(1, modiff->diff_leafs.size);
+    ASSERT_EQ(1, modiff->leaf_cnt);
 
     mdd_free_diff(diff);
 
@@ -394,7 +552,7 @@ TEST_F(DataParser, test_should_get_root_container_diff_2_leaf)
 
     struct mdd_mo_diff* modiff = (struct mdd_mo_diff*)diff->vec[0];
     ASSERT_EQ(DF_MODIFY, modiff->type);
-    ASSERT_EQ(2, modiff->diff_leafs.size);
+    ASSERT_EQ(2, modiff->leaf_cnt);
 
     mdd_free_diff(diff);
 
@@ -402,6 +560,53 @@ TEST_F(DataParser, test_should_get_root_container_diff_2_leaf)
     mdd_free_data(data2);
 }
 
+TEST_F(DataParser, test_should_get_changed_leafs_by_position)
+{
+    struct mdd_node *data1 = mdd_parse_data(schema, R"({"Data": {"Name": "vc1000", "Value": 100}})");
+    struct mdd_node *data2 = mdd_parse_data(schema, R"({"Data": {"Name": "vc1000"}})");
+
+    mdd_diff *diff = mdd_get_diff(schema, data1, data2);
+    ASSERT_EQ(1, diff->size);
+
+    struct mdd_mo_diff *modiff = diff->vec[0];
+    ASSERT_EQ(((struct mds_mo*) schema)->leaf_cnt, modiff->nbits);
+    int pos = mdd_diff_next_leaf(modiff, 0);
+    ASSERT_STREQ("Value", mds_leaf_at(schema, pos)->name);
+    ASSERT_EQ(-1, mdd_diff_next_leaf(modiff, pos + 1));
+
+    struct mdd_leaf *run_leaf = NULL, *edit_leaf = NULL;
+    ASSERT_EQ(0, mdd_diff_leaf(modiff, pos, &run_leaf, &edit_leaf));
+    ASSERT_EQ(100, run_leaf->value.intv);
+    ASSERT_TRUE(NULL == edit_leaf);
+
+    mdd_free_diff(diff);
+    mdd_free_data(data1);
+    mdd_free_data(data2);
+}
+
+TEST_F(DataParser, test_should_copy_diff_into_one_block)
+{
+    struct mdd_node *data1 = mdd_parse_data(schema, R"({"Data": {"Name": "vc1000", "Value": 100}})");
+    struct mdd_node *data2 = mdd_parse_data(schema, R"({"Data": {"Name": "vc2000", "ChildData": {"Id": 1}}})");
+
+    mdd_diff *diff = mdd_get_diff(schema, data1, data2);
+    mdd_diff *copy = mdd_copy_diff(diff);
+    ASSERT_TRUE(NULL != copy);
+    ASSERT_EQ(diff->size, copy->size);
+    for (size_t i = 0; i < diff->size; i++) {
+        ASSERT_NE(diff->vec[i], copy->vec[i]);
+        ASSERT_EQ(diff->vec[i]->type, copy->vec[i]->type);
+        ASSERT_EQ(diff->vec[i]->edit_data, copy->vec[i]->edit_data);
+        ASSERT_EQ(diff->vec[i]->leaf_cnt, copy->vec[i]->leaf_cnt);
+    }
+    mdd_free_diff(diff);
+
+    ASSERT_EQ(2, copy->vec[0]->leaf_cnt);
+    mdd_free_diff(copy);
+    mdd_free_data(data1);
+    mdd_free_data(data2);
+}
+
 TEST_F(DataParser, test_should_get_multi_layer_diff)
 {
     const char *TEST_DATA_JSON_1 = R"({
@@ -429,11 +634,11 @@ TEST_F(DataParser, test_should_get_multi_layer_diff)
 
     struct mdd_mo_diff* modiff = (struct mdd_mo_diff*)diff->vec[0];
     ASSERT_EQ(DF_MODIFY, modiff->type);
-    ASSERT_EQ(2, modiff->diff_leafs.size);
+    ASSERT_EQ(2, modiff->leaf_cnt);
 
     modiff = (struct mdd_mo_diff*)diff->vec[1];
     ASSERT_EQ(DF_ADD, modiff->type);
-    ASSERT_EQ(0, modiff->diff_leafs.size);
+    ASSERT_EQ(0, modiff->leaf_cnt);
 
     mdd_free_diff(diff);
 
@@ -467,11 +672,11 @@ TEST_F(DataParser, test_should_get_multi_layer_diff2)
 
     struct mdd_mo_diff* modiff = (struct mdd_mo_diff*)diff->vec[0];
     ASSERT_EQ(DF_MODIFY, modiff->type);
-    ASSERT_EQ(1, modiff->diff_leafs.size);
+    ASSERT_EQ(1, modiff->leaf_cnt);
 
     modiff = (struct mdd_mo_diff*)diff->vec[1];
     ASSERT_EQ(DF_DELETE, modiff->type);
-    ASSERT_EQ(0, modiff->diff_leafs.size);
+    ASSERT_EQ(0, modiff->leaf_cnt);
 
     mdd_free_diff(diff);
 
@@ -582,10 +787,787 @@ TEST_F(DataParser, test_should_get_root_container_diff_when_edit_json)
 
     struct mdd_mo_diff* modiff = (struct mdd_mo_diff*)diff->vec[0];
     ASSERT_EQ(DF_MODIFY, modiff->type);
-    ASSERT_EQ(1, modiff->diff_leafs.size);
+    ASSERT_EQ(1, modiff->leaf_cnt);
+
+    mdd_free_diff(diff);
+
+    mdd_free_data(data1);
+    mdd_free_data(data2);
+}
+
+const char *TRACK_DATA_JSON = R"({
+    "Data": {
+        "Name": "vc1000",
+        "Value": 100,
+        "ChildList": [
+            {"Id": 1, "Value": 1, "SubChildList": [{"Id": 1, "IntLeaf": 100}]},
+            {"Id": 2, "Value": 2}
+        ]
+    }
+})";
+
+class DataTrack: public DataParser
+{
+public:
+    void SetUp()
+    {
+        DataParser::SetUp();
+        data = mdd_parse_data(schema, TRACK_DATA_JSON);
+        ASSERT_EQ(0, mdd_track_init(&track));
+        ASSERT_EQ(0, mdd_frag_init(&frags));
+        track.frags = &frags;
+    }
+
+    void TearDown()
+    {
+        mdd_track_free(&track);
+        mdd_frag_free(&frags);
+        DataParser::TearDown();
+    }
+
+    bool cached(struct mdd_node *node)
+    {
+        return NULL != hmap_get(&frags.frags, (uintptr_t) node);
+    }
+
+    struct mdd_track track;
+    struct mdd_frag_cache frags;
+};
+
+TEST_F(DataTrack, should_mark_root_pending_when_set)
+{
+    struct mdd_node *leaf = mdd_get_data(data, "Data/ChildList[Id=1]/SubChildList[Id=1]/IntLeaf");
+    ASSERT_EQ(0, mdd_set_int(&track, leaf, 200));
+
+    ASSERT_TRUE(data->flags & MDD_F_PENDING);
+    ASSERT_EQ(data, track.root);
+    ASSERT_EQ(0, leaf->flags);
+    ASSERT_EQ(0, leaf->parent->flags);
+    assert_data_int_leaf("IntLeaf", 200, leaf);
+    ASSERT_TRUE(NULL == mdd_compact_tree(data, NULL));
+}
+
+TEST_F(DataTrack, should_get_data_by_typed_predicates)
+{
+    const char *path = "Data/ChildList[Id=1]/SubChildList[Id=1]/IntLeaf";
+    assert_data_int_leaf("IntLeaf", 100, mdd_get_data(data, path));
+    ASSERT_EQ(mdd_get_data(data, "Data/Value"), mdd_get_data(data, "Data[Name=vc1000]/Value"));
+    ASSERT_EQ(mdd_get_data(data, "Data/ChildList[Id=2]"), mdd_get_data(data, "Data/ChildList[Id=02]"));
+
+    ASSERT_TRUE(NULL == mdd_get_data(data, "Data[Name=vc100]/Value"));
+    ASSERT_TRUE(NULL == mdd_get_data(data, "Data/ChildList[Id=2x]"));
+    ASSERT_TRUE(NULL == mdd_get_data(data, "Data/ChildList[Id]"));
+    ASSERT_TRUE(NULL == mdd_get_data(data, "Data/Child"));
+    ASSERT_TRUE(NULL == mdd_get_data(data, "Data/ValueX"));
+}
+
+TEST_F(DataTrack, should_get_dirty_diff_and_clear_marks)
+{
+    struct mdd_node *leaf = mdd_get_data(data, "Data/ChildList[Id=2]/Value");
+    ASSERT_EQ(0, mdd_set_int(&track, leaf, 20));
+    ASSERT_EQ(0, mdd_set_int(&track, leaf, 30));
+    ASSERT_EQ(0, mdd_set_str(&track, data->child, "vc2000"));
+
+    mdd_diff *diff = mdd_get_dirty_diff(&track);
+    ASSERT_TRUE(NULL != diff);
+    ASSERT_EQ(2, diff->size);
+
+    struct mdd_mo_diff *modiff = (struct mdd_mo_diff*) diff->vec[0];
+    ASSERT_EQ(DF_MODIFY, modiff->type);
+    ASSERT_EQ(1, modiff->leaf_cnt);
+    struct mdd_leaf *run_leaf = NULL, *edit_leaf = NULL;
+    int pos = mdd_diff_next_leaf(modiff, 0);
+    ASSERT_EQ(0, mdd_diff_leaf(modiff, pos, &run_leaf, &edit_leaf));
+    ASSERT_EQ(2, run_leaf->value.intv);
+    ASSERT_EQ(30, edit_leaf->value.intv);
+    ASSERT_EQ(-1, mdd_diff_next_leaf(modiff, pos + 1));
+
+    modiff = (struct mdd_mo_diff*) diff->vec[1];
+    ASSERT_EQ(DF_MODIFY, modiff->type);
+    ASSERT_EQ(data, (struct mdd_node*) modiff->edit_data);
+    mdd_free_diff(diff);
 
+    ASSERT_EQ(0, data->flags & MDD_F_PENDING);
+    ASSERT_TRUE(NULL == track.root);
+
+    diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(0, diff->size);
+    mdd_free_diff(diff);
+}
+
+TEST_F(DataTrack, should_skip_leaf_set_back_to_old_value)
+{
+    struct mdd_node *leaf = mdd_get_data(data, "Data/Value");
+    ASSERT_EQ(0, mdd_set_int(&track, leaf, 200));
+    ASSERT_EQ(0, mdd_set_int(&track, leaf, 100));
+
+    mdd_diff *diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(0, diff->size);
+    mdd_free_diff(diff);
+}
+
+TEST_F(DataTrack, should_get_add_and_delete_diff_for_list_inst)
+{
+    cJSON *json = cJSON_Parse(R"([{"Id": 3, "SubChildList": [{"Id": 1}]}])");
+    struct mdd_node *inst = mdd_parse_child(mds_find_child_schema(schema, "ChildList"), json);
+    cJSON_Delete(json);
+    ASSERT_EQ(0, mdd_insert_node(&track, data, inst));
+    ASSERT_EQ(0, mdd_delete_node(&track, mdd_get_data(data, "Data/ChildList[Id=1]")));
+
+    ASSERT_EQ(inst, mdd_get_data(data, "Data/ChildList[Id=3]"));
+    ASSERT_EQ(inst, mdd_get_data(data, "Data/ChildList[Id=2]")->next);
+    ASSERT_TRUE(NULL == mdd_get_data(data, "Data/ChildList[Id=1]"));
+
+    mdd_diff *diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(4, diff->size);
+    ASSERT_EQ(DF_ADD, ((struct mdd_mo_diff*) diff->vec[0])->type);
+    ASSERT_EQ(DF_ADD, ((struct mdd_mo_diff*) diff->vec[1])->type);
+    ASSERT_EQ(DF_DELETE, ((struct mdd_mo_diff*) diff->vec[2])->type);
+    ASSERT_EQ(DF_DELETE, ((struct mdd_mo_diff*) diff->vec[3])->type);
     mdd_free_diff(diff);
+    ASSERT_EQ(0, inst->flags);
+}
+
+TEST_F(DataTrack, should_get_no_diff_when_insert_then_delete)
+{
+    cJSON *json = cJSON_Parse(R"([{"Id": 3, "Value": 3}])");
+    struct mdd_node *inst = mdd_parse_child(mds_find_child_schema(schema, "ChildList"), json);
+    cJSON_Delete(json);
+    ASSERT_EQ(0, mdd_insert_node(&track, data, inst));
+    ASSERT_EQ(0, mdd_set_int(&track, inst->child->next, 30));
+    ASSERT_EQ(0, mdd_delete_node(&track, inst));
+
+    mdd_diff *diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(0, diff->size);
+    mdd_free_diff(diff);
+}
+
+TEST_F(DataTrack, should_restore_tree_when_abort)
+{
+    char *before = NULL;
+    ASSERT_EQ(0, mdd_dump_data(data, &before));
+
+    cJSON *json = cJSON_Parse(R"([{"Id": 3, "Value": 3}])");
+    struct mdd_node *inst = mdd_parse_child(mds_find_child_schema(schema, "ChildList"), json);
+    cJSON_Delete(json);
+    ASSERT_EQ(0, mdd_set_str(&track, mdd_get_data(data, "Data/Name"), "a much longer name than before"));
+    ASSERT_EQ(0, mdd_set_int(&track, mdd_get_data(data, "Data/Value"), 200));
+    ASSERT_EQ(0, mdd_delete_node(&track, mdd_get_data(data, "Data/Value")));
+    ASSERT_EQ(0, mdd_insert_node(&track, data, inst));
+    ASSERT_EQ(0, mdd_set_int(&track, mdd_get_data(data, "Data/ChildList[Id=1]/SubChildList[Id=1]/IntLeaf"), 7));
+    ASSERT_EQ(0, mdd_delete_node(&track, mdd_get_data(data, "Data/ChildList[Id=1]")));
+    ASSERT_EQ(0, mdd_delete_node(&track, mdd_get_data(data, "Data/ChildList[Id=2]/Value")));
+    ASSERT_TRUE(mdd_track_pending(&track));
+
+    mdd_track_abort(&track);
+    ASSERT_FALSE(mdd_track_pending(&track));
+    ASSERT_EQ(0, data->flags & MDD_F_PENDING);
+    char *after = NULL;
+    ASSERT_EQ(0, mdd_dump_data(data, &after));
+    ASSERT_STREQ(before, after);
+    free(before);
+    free(after);
+
+    mdd_diff *diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(0, diff->size);
+    mdd_free_diff(diff);
+
+    /* the track goes on with the next edit */
+    ASSERT_EQ(0, mdd_set_int(&track, mdd_get_data(data, "Data/ChildList[Id=1]/Value"), 10));
+    diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(1, diff->size);
+    mdd_free_diff(diff);
+}
+
+TEST_F(DataTrack, should_reject_list_key_out_of_int_range)
+{
+    const char *BAD_JSONS[] = {R"({"Data": {"ChildList": [{"Id": 4294967298}]}})",
+        R"({"Data": {"ChildList": [{"Id": -2}]}})"};
+    for (const char *bad : BAD_JSONS) {
+        ASSERT_TRUE(NULL == mdd_parse_data(schema, bad)) << bad;
+        cJSON *json = cJSON_Parse(bad);
+        ASSERT_TRUE(NULL == mdd_parse_json(schema, json)) << bad;
+        cJSON_Delete(json);
+    }
+
+    struct mdd_node *id = mdd_get_data(data, "Data/ChildList[Id=2]/Id");
+    ASSERT_EQ(-1, mdd_set_int(&track, id, 4294967298LL));
+    ASSERT_EQ(-1, mdd_set_int(&track, id, -1));
+    ASSERT_EQ(0, mdd_set_int(&track, id, INT_MAX));
+    ASSERT_EQ(0, mdd_set_int(&track, mdd_get_data(data, "Data/ChildList[Id=1]/Value"), 4294967298LL));
+
+    cJSON *json = cJSON_Parse(R"({"Id": 4294967299})");
+    ASSERT_TRUE(NULL == mdd_parse_child(mds_find_child_schema(schema, "ChildList"), json));
+    cJSON_Delete(json);
+}
+
+TEST_F(DataTrack, should_reject_duplicate_list_key)
+{
+    cJSON *json = cJSON_Parse(R"([{"Id": 2}])");
+    struct mdd_node *inst = mdd_parse_child(mds_find_child_schema(schema, "ChildList"), json);
+    cJSON_Delete(json);
+    ASSERT_EQ(-1, mdd_insert_node(&track, data, inst));
+    mdd_free_data(inst);
+}
+
+TEST_F(DataTrack, should_get_leaf_diff_when_delete_leaf)
+{
+    struct mdd_node *leaf = mdd_get_data(data, "Data/Value");
+    ASSERT_EQ(0, mdd_set_int(&track, leaf, 200));
+    ASSERT_EQ(0, mdd_delete_node(&track, leaf));
+
+    mdd_diff *diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(1, diff->size);
+    struct mdd_mo_diff *modiff = (struct mdd_mo_diff*) diff->vec[0];
+    struct mdd_leaf *run_leaf = NULL, *edit_leaf = NULL;
+    ASSERT_EQ(0, mdd_diff_leaf(modiff, mdd_diff_next_leaf(modiff, 0), &run_leaf, &edit_leaf));
+    ASSERT_EQ(100, run_leaf->value.intv);
+    ASSERT_TRUE(NULL == edit_leaf);
+    mdd_free_diff(diff);
+}
+
+static std::string dump_subtree(struct mdd_node *node, struct mdd_frag_cache *frags = NULL)
+{
+    char *dump = NULL;
+    EXPECT_EQ(0, mdd_dump_subtree_cached(frags, node, &dump));
+    std::string rlt = dump ? dump : "";
+    free(dump);
+    return rlt;
+}
+
+TEST_F(DataTrack, should_keep_parsed_leafs_in_mo_slots)
+{
+    struct mdd_mo *entry = (struct mdd_mo*) mdd_get_data(data, "Data/ChildList[Id=1]");
+    struct mds_node *value_schema = mds_find_child_schema(entry->schema, "Value");
+    struct mdd_node *value = mdd_get_data(data, "Data/ChildList[Id=1]/Value");
+    ASSERT_TRUE((struct mdd_node*) &entry->slots[((struct mds_leaf*) value_schema)->leaf_idx] == value);
+
+    /* a deleted slot leaf is diffed against a copy, a leaf inserted back is allocated alone */
+    ASSERT_EQ(0, mdd_delete_node(&track, value));
+    ASSERT_TRUE(NULL == mdd_get_data(data, "Data/ChildList[Id=1]/Value"));
+    cJSON *json = cJSON_Parse("5");
+    struct mdd_node *inserted = mdd_parse_child(value_schema, json);
+    cJSON_Delete(json);
+    ASSERT_EQ(0, mdd_insert_node(&track, (struct mdd_node*) entry, inserted));
+    ASSERT_EQ(inserted, mdd_get_data(data, "Data/ChildList[Id=1]/Value"));
+
+    mdd_diff *diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(1, diff->size);
+    struct mdd_leaf *run_leaf = NULL, *edit_leaf = NULL;
+    ASSERT_EQ(0, mdd_diff_leaf(diff->vec[0], mdd_diff_next_leaf(diff->vec[0], 0), &run_leaf, &edit_leaf));
+    ASSERT_EQ(1, run_leaf->value.intv);
+    ASSERT_EQ(5, edit_leaf->value.intv);
+    mdd_free_diff(diff);
+
+    ASSERT_EQ(0, mdd_delete_node(&track, inserted));
+    diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(1, diff->size);
+    mdd_free_diff(diff);
+    ASSERT_EQ(R"({"Id":1,"SubChildList":[{"Id":1,"IntLeaf":100}]})", dump_subtree((struct mdd_node*) entry));
+}
+
+TEST_F(DataTrack, should_give_slots_only_to_leafs_present)
+{
+    struct mdd_node *sparse = mdd_parse_data(schema, R"({"Data": {"ChildList": [{"Id": 3}]}})");
+    ASSERT_TRUE(NULL != sparse);
+    ASSERT_TRUE(NULL == ((struct mdd_mo*) sparse)->slots);
+    struct mdd_mo *entry = (struct mdd_mo*) mdd_get_data(sparse, "Data/ChildList[Id=3]");
+    ASSERT_EQ((struct mdd_node*) &entry->slots[0], mdd_get_data(sparse, "Data/ChildList[Id=3]/Id"));
+    ASSERT_EQ((struct mdd_node*) &entry->slots[0], entry->child);
+
+    char *buf = NULL;
+    size_t len = 0;
+    ASSERT_EQ(0, mdd_dump_snapshot(sparse, &buf, &len));
+    struct mdd_node *loaded = mdd_load_snapshot(schema, buf, len);
+    free(buf);
+    ASSERT_TRUE(NULL != loaded);
+    struct mdd_mo *loaded_entry = (struct mdd_mo*) mdd_get_data(loaded, "Data/ChildList[Id=3]");
+    ASSERT_EQ((struct mdd_node*) &loaded_entry->slots[0], loaded_entry->child);
+    mdd_free_data(loaded);
+
+    /* a leaf inserted later is allocated alone until compaction lays it out with the others */
+    cJSON *json = cJSON_Parse("7");
+    struct mdd_node *value = mdd_parse_child(mds_find_child_schema(entry->schema, "Value"), json);
+    cJSON_Delete(json);
+    ASSERT_EQ(0, mdd_insert_node(&track, (struct mdd_node*) entry, value));
+    mdd_free_diff(mdd_get_dirty_diff(&track));
+    sparse = mdd_compact_tree(sparse, NULL);
+    ASSERT_TRUE(NULL != sparse);
+    entry = (struct mdd_mo*) mdd_get_data(sparse, "Data/ChildList[Id=3]");
+    ASSERT_EQ((struct mdd_node*) &entry->slots[1], mdd_get_data(sparse, "Data/ChildList[Id=3]/Value"));
+    ASSERT_EQ(7, entry->slots[1].value.intv);
+    mdd_free_data(sparse);
+}
+
+TEST_F(DataTrack, should_keep_short_strings_inline)
+{
+    struct mdd_leaf *name = (struct mdd_leaf*) data->child;
+    ASSERT_EQ(0, name->value.sso[MDD_SSO_LEN]);
+
+    const char *LONG_NAME = "a name of sixteen";
+    const char *FULL_NAME = "fifteen bytes!!";
+    ASSERT_EQ(0, mdd_set_str(&track, (struct mdd_node*) name, LONG_NAME));
+    ASSERT_NE(0, name->value.sso[MDD_SSO_LEN]);
+    ASSERT_STREQ(LONG_NAME, str_leaf_val(name));
+    ASSERT_EQ(0, mdd_set_str(&track, (struct mdd_node*) name, FULL_NAME));
+    ASSERT_EQ(0, name->value.sso[MDD_SSO_LEN]);
+    ASSERT_STREQ(FULL_NAME, str_leaf_val(name));
+
+    /* the old value kept for the diff is a copy that outlives the heap value replaced */
+    mdd_diff *diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(1, diff->size);
+    struct mdd_leaf *run_leaf = NULL, *edit_leaf = NULL;
+    ASSERT_EQ(0, mdd_diff_leaf(diff->vec[0], mdd_diff_next_leaf(diff->vec[0], 0), &run_leaf, &edit_leaf));
+    ASSERT_STREQ("vc1000", str_leaf_val(run_leaf));
+    ASSERT_STREQ(FULL_NAME, str_leaf_val(edit_leaf));
+    mdd_free_diff(diff);
+
+    ASSERT_EQ(0, mdd_set_str(&track, (struct mdd_node*) name, "vc1000"));
+    diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(1, diff->size);
+    mdd_free_diff(diff);
+    ASSERT_EQ(R"("vc1000")", dump_subtree((struct mdd_node*) name));
+}
+
+TEST_F(DataTrack, should_share_interned_long_strings_with_shadow)
+{
+    const char *LONG_NAME = "a name of sixteen";
+    struct mdd_leaf *name = (struct mdd_leaf*) data->child;
+    size_t base = strpool_count();
+    ASSERT_EQ(0, mdd_set_str(&track, (struct mdd_node*) name, LONG_NAME));
+    ASSERT_EQ(base + 1, strpool_count());
+    mdd_free_diff(mdd_get_dirty_diff(&track));
+
+    /* the old value kept for the diff holds the same pooled string, not a copy */
+    ASSERT_EQ(0, mdd_set_str(&track, (struct mdd_node*) name, "another long name"));
+    mdd_diff *diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(1, diff->size);
+    struct mdd_leaf *run_leaf = NULL, *edit_leaf = NULL;
+    ASSERT_EQ(0, mdd_diff_leaf(diff->vec[0], mdd_diff_next_leaf(diff->vec[0], 0), &run_leaf, &edit_leaf));
+    ASSERT_TRUE(strpool_intern(LONG_NAME, strlen(LONG_NAME)) == run_leaf->value.strv);
+    strpool_release(run_leaf->value.strv);
+    ASSERT_EQ(base + 2, strpool_count());
+    mdd_free_diff(diff);
+
+    /* setting the same value again is no change */
+    ASSERT_EQ(0, mdd_set_str(&track, (struct mdd_node*) name, "another long name"));
+    diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(0, diff->size);
+    mdd_free_diff(diff);
+
+    ASSERT_EQ(0, mdd_set_str(&track, (struct mdd_node*) name, "vc1000"));
+    mdd_free_diff(mdd_get_dirty_diff(&track));
+    mdd_free_diff(mdd_get_dirty_diff(&track));
+    ASSERT_EQ(base, strpool_count());
+}
+
+TEST_F(DataTrack, should_compact_tree_in_pre_order_and_keep_editing)
+{
+    ASSERT_EQ(0, mdd_set_str(&track, data->child, "a name of sixteen"));
+    cJSON *json = cJSON_Parse(R"({"Id": 9, "Value": 90})");
+    ASSERT_EQ(0, mdd_insert_node(&track, data, mdd_parse_child(mds_find_child_schema(data->schema, "ChildList"), json)));
+    cJSON_Delete(json);
+    ASSERT_TRUE(NULL == mdd_compact_tree(data, NULL));
+    mdd_free_diff(mdd_get_dirty_diff(&track));
+
+    std::string before = dump_subtree(data, &frags);
+    size_t bytes = mdd_frag_bytes(&frags);
+    size_t strs = strpool_count();
+    struct mdd_hmap moved;
+    ASSERT_EQ(0, hmap_init(&moved, 0));
+    struct mdd_node *old = mdd_get_data(data, "Data/ChildList[Id=9]");
+    struct mdd_node *root = mdd_compact_tree(data, &moved);
+    ASSERT_TRUE(NULL != root);
+    data = root;
+    mdd_frag_relocate(&frags, &moved);
+    ASSERT_TRUE(cached(data));
+    ASSERT_EQ(bytes, mdd_frag_bytes(&frags));
+    ASSERT_EQ(before, dump_subtree(data));
+    ASSERT_EQ(strs, strpool_count());
+
+    /* each mo is followed by its slot bitmaps and slots, then by its first child mo */
+    struct mdd_mo *entry = (struct mdd_mo*) mdd_get_data(data, "Data/ChildList[Id=9]");
+    ASSERT_EQ(entry, hmap_get(&moved, (uintptr_t) old));
+    ASSERT_TRUE(entry->flags & MDD_F_CHUNK);
+    ASSERT_TRUE(entry->slots == (struct mdd_leaf*) ((uint64_t*) (entry + 1) + 2));
+    ASSERT_EQ((struct mdd_node*) &entry->slots[0], entry->child);
+    struct mdd_mo *first = (struct mdd_mo*) mdd_get_data(data, "Data/ChildList[Id=1]");
+    struct mdd_node *sub = mdd_get_data(data, "Data/ChildList[Id=1]/SubChildList[Id=1]");
+    ASSERT_TRUE((char*) sub > (char*) first && (char*) sub < (char*) entry);
+    ASSERT_EQ((struct mdd_node*) entry, mdd_find_list(data, entry->schema, 9));
+    hmap_free(&moved);
+
+    /* the copy takes edits like a parsed tree, nodes leave their chunk one by one */
+    ASSERT_EQ(0, mdd_set_int(&track, mdd_get_data(data, "Data/ChildList[Id=9]/Value"), 91));
+    ASSERT_EQ(0, mdd_delete_node(&track, mdd_get_data(data, "Data/ChildList[Id=1]")));
+    mdd_diff *diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(3u, diff->size);
+    mdd_free_diff(diff);
+    ASSERT_TRUE(NULL == mdd_get_data(data, "Data/ChildList[Id=1]"));
+    ASSERT_FALSE(cached(data));
+    ASSERT_EQ(R"({"Id":9,"Value":91})", dump_subtree((struct mdd_node*) entry, &frags));
+    ASSERT_EQ(0, mdd_get_data(data, "Data/ChildList[Id=9]/Value")->flags);
+}
+
+TEST_F(DataTrack, should_dump_subtree_and_drop_fragments_on_edit)
+{
+    struct mdd_node *entry = mdd_get_data(data, "Data/ChildList[Id=1]");
+    ASSERT_EQ(R"({"Id":1,"Value":1,"SubChildList":[{"Id":1,"IntLeaf":100}]})", dump_subtree(entry, &frags));
+    ASSERT_EQ(R"("vc1000")", dump_subtree(mdd_get_data(data, "Data/Name"), &frags));
+    ASSERT_EQ(R"({"Id":2,"Value":2})", dump_subtree(mdd_get_data(data, "Data/ChildList[Id=2]"), &frags));
+    ASSERT_TRUE(cached(entry));
+
+    /* the second set of a leaf before the diff must drop the fragments cached since the first */
+    struct mdd_node *leaf = mdd_get_data(data, "Data/ChildList[Id=1]/SubChildList[Id=1]/IntLeaf");
+    ASSERT_EQ(0, mdd_set_int(&track, leaf, 200));
+    ASSERT_FALSE(cached(entry));
+    ASSERT_TRUE(cached(mdd_get_data(data, "Data/ChildList[Id=2]")));
+    ASSERT_EQ(R"({"Id":1,"Value":1,"SubChildList":[{"Id":1,"IntLeaf":200}]})", dump_subtree(entry, &frags));
+    ASSERT_EQ(0, mdd_set_int(&track, leaf, 300));
+    ASSERT_EQ(R"({"Id":1,"Value":1,"SubChildList":[{"Id":1,"IntLeaf":300}]})", dump_subtree(entry, &frags));
+
+    /* a deleted mo leaves no fragment behind for its address to find again */
+    struct mdd_node *gone = mdd_get_data(data, "Data/ChildList[Id=2]");
+    ASSERT_EQ(0, mdd_delete_node(&track, gone));
+    ASSERT_FALSE(cached(gone));
+    ASSERT_EQ(0, mdd_delete_node(&track, mdd_get_data(data, "Data/Value")));
+    char *dump = NULL;
+    ASSERT_EQ(0, mdd_dump_data_cached(&frags, data, &dump));
+    ASSERT_STREQ(R"({"Data":{"Name":"vc1000","ChildList":[{"Id":1,"Value":1,"SubChildList":[{"Id":1,"IntLeaf":300}]}]}})",
+            dump);
+    free(dump);
+}
+
+TEST_F(DataTrack, should_leave_tree_untouched_on_plain_dumps)
+{
+    char *dump = NULL;
+    ASSERT_EQ(0, mdd_dump_data(data, &dump));
+    free(dump);
+    dump_subtree(mdd_get_data(data, "Data/ChildList[Id=1]"));
+    ASSERT_EQ(0u, frags.frags.size);
+    ASSERT_EQ(0u, mdd_frag_bytes(&frags));
+
+    /* an inserted mo dumped before an abort drops its fragment with it */
+    cJSON *json = cJSON_Parse(R"({"Id": 9, "Value": 90})");
+    struct mdd_node *added = mdd_parse_child(mds_find_child_schema(data->schema, "ChildList"), json);
+    cJSON_Delete(json);
+    ASSERT_EQ(0, mdd_insert_node(&track, data, added));
+    ASSERT_EQ(R"({"Id":9,"Value":90})", dump_subtree(added, &frags));
+    ASSERT_TRUE(cached(added));
+    mdd_track_abort(&track);
+    ASSERT_EQ(0u, frags.frags.size);
+    ASSERT_EQ(0u, mdd_frag_bytes(&frags));
+}
+
+TEST_F(DataTrack, should_hold_each_dumped_byte_in_one_fragment)
+{
+    struct mdd_node *entry = mdd_get_data(data, "Data/ChildList[Id=1]");
+    struct mdd_node *sub = mdd_get_data(data, "Data/ChildList[Id=1]/SubChildList[Id=1]");
+    char *dump = NULL;
+    ASSERT_EQ(0, mdd_dump_data_cached(&frags, data, &dump));
+    size_t body = strlen(dump) - strlen("{\"Data\":}");
+    free(dump);
+    ASSERT_TRUE(cached(data));
+    ASSERT_FALSE(cached(entry));
+    ASSERT_FALSE(cached(sub));
+    ASSERT_EQ(sizeof(size_t) + body, mdd_frag_bytes(&frags));
+
+    /* a subtree under a cached mo is served without caching it twice */
+    dump_subtree(entry, &frags);
+    ASSERT_FALSE(cached(entry));
+
+    ASSERT_EQ(0, mdd_set_int(&track, mdd_get_data(data, "Data/ChildList[Id=1]/SubChildList[Id=1]/IntLeaf"), 200));
+    ASSERT_EQ(0u, mdd_frag_bytes(&frags));
+    dump_subtree(entry, &frags);
+    ASSERT_TRUE(cached(entry));
+    ASSERT_FALSE(cached(sub));
+
+    /* a body too big to cache is rebuilt from the fragments of its children */
+    ASSERT_EQ(0, mdd_set_str(&track, mdd_get_data(data, "Data/Name"), std::string(5000, 'n').c_str()));
+    ASSERT_EQ(0, mdd_dump_data_cached(&frags, data, &dump));
+    ASSERT_FALSE(cached(data));
+    ASSERT_TRUE(cached(entry));
+    std::string first(dump);
+    free(dump);
+    ASSERT_EQ(0, mdd_dump_data_cached(&frags, data, &dump));
+    ASSERT_EQ(first, dump);
+    free(dump);
+    ASSERT_LT(mdd_frag_bytes(&frags), first.size() - 5000);
+}
+
+TEST_F(DataTrack, should_escape_string_leafs_on_dump)
+{
+    /* long enough to put escapes both inside and after the vector blocks */
+    std::string value = "say \"hi\" to C:\\tmp\n\tthen\x01 stop, a long clean run of text with no escapes in it/";
+    struct mdd_node *name = mdd_get_data(data, "Data/Name");
+    ASSERT_EQ(0, mdd_set_str(&track, name, value.c_str()));
+    ASSERT_EQ(R"("say \"hi\" to C:\\tmp\n\tthen\u0001 stop, a long clean run of text with no escapes in it/")",
+            dump_subtree(name));
+
+    char *dump = NULL;
+    ASSERT_EQ(0, mdd_dump_data(data, &dump));
+    struct mdd_node *copy = mdd_parse_data(schema, dump);
+    free(dump);
+    ASSERT_TRUE(NULL != copy);
+    ASSERT_STREQ(value.c_str(), str_leaf_val((struct mdd_leaf*) mdd_get_data(copy, "Data/Name")));
+    mdd_free_data(copy);
+}
+
+TEST_F(DataTrack, should_round_trip_binary_snapshot)
+{
+    ASSERT_EQ(0, mdd_set_int(&track, mdd_get_data(data, "Data/Value"), -1234567890123LL));
+    char *snap = NULL;
+    size_t len = 0;
+    ASSERT_EQ(0, mdd_dump_snapshot(data, &snap, &len));
+    ASSERT_TRUE(mdd_is_snapshot(snap, len));
+
+    struct mdd_node *copy = mdd_load_snapshot(schema, snap, len);
+    ASSERT_TRUE(NULL != copy);
+    assert_data_int_leaf("Value", -1234567890123LL, mdd_get_data(copy, "Data/Value"));
+    char *expect = NULL;
+    char *dump = NULL;
+    ASSERT_EQ(0, mdd_dump_data(data, &expect));
+    ASSERT_EQ(0, mdd_dump_data(copy, &dump));
+    ASSERT_STREQ(expect, dump);
+    free(expect);
+    free(dump);
+    mdd_free_data(copy);
+
+    /* truncated or foreign snapshots are rejected */
+    ASSERT_TRUE(NULL == mdd_load_snapshot(schema, snap, len - 1));
+    ASSERT_TRUE(NULL == mdd_load_snapshot(schema, TRACK_DATA_JSON, strlen(TRACK_DATA_JSON)));
+    struct mds_node *other = mds_load_model(R"({"Data": {"@attr": {"mtype": "container"}}})");
+    ASSERT_TRUE(NULL == mdd_load_snapshot(other, snap, len));
+    mds_free_model(other);
+    free(snap);
+}
+
+const char *PATCH_EDIT_JSON = R"({"Data": {"Name": "vc2000",
+        "ChildList": [{"Id": 2, "Value": 2}, {"Id": 3, "SubChildList": [{"Id": 1}]}]}})";
+
+TEST_F(DataTrack, should_dump_minimal_patch_keyed_by_path)
+{
+    struct mdd_node *edit = mdd_parse_data(schema, PATCH_EDIT_JSON);
+    mdd_diff *diff = mdd_get_diff(schema, data, edit);
+
+    char *patch = NULL;
+    ASSERT_EQ(0, mdd_diff_to_patch(diff, &patch));
+    ASSERT_STREQ(R"([{"op":"replace","path":"Data/Name","value":"vc2000"},)"
+            R"({"op":"remove","path":"Data/Value"},)"
+            R"({"op":"remove","path":"Data/ChildList[Id=1]"},)"
+            R"({"op":"add","path":"Data/ChildList[Id=3]","value":{"Id":3,"SubChildList":[{"Id":1}]}}])", patch);
+
+    free(patch);
+    mdd_free_diff(diff);
+    mdd_free_data(edit);
+}
+
+TEST_F(DataTrack, should_apply_patch_to_replica)
+{
+    struct mdd_node *edit = mdd_parse_data(schema, PATCH_EDIT_JSON);
+    mdd_diff *diff = mdd_get_diff(schema, data, edit);
+    char *patch = NULL;
+    ASSERT_EQ(0, mdd_diff_to_patch(diff, &patch));
+    mdd_free_diff(diff);
+
+    ASSERT_EQ(0, mdd_apply_patch(&track, data, patch));
+    diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(5, diff->size);
+    mdd_free_diff(diff);
+
+    diff = mdd_get_diff(schema, data, edit);
+    ASSERT_EQ(0, diff->size);
+
+    free(patch);
+    mdd_free_diff(diff);
+    mdd_free_data(edit);
+}
+
+TEST_F(DataTrack, should_replay_dirty_diff_patch_on_replica)
+{
+    struct mdd_node *replica = mdd_parse_data(schema, TRACK_DATA_JSON);
+    struct mdd_track replica_track;
+    ASSERT_EQ(0, mdd_track_init(&replica_track));
+
+    cJSON *json = cJSON_Parse(R"({"Id": 5, "Value": 5})");
+    struct mdd_node *inst = mdd_parse_child(mds_find_child_schema(schema, "ChildList"), json);
+    cJSON_Delete(json);
+    ASSERT_EQ(0, mdd_insert_node(&track, data, inst));
+    ASSERT_EQ(0, mdd_set_int(&track, mdd_get_data(data, "Data/ChildList[Id=1]/SubChildList[Id=1]/IntLeaf"), 7));
+    ASSERT_EQ(0, mdd_delete_node(&track, mdd_get_data(data, "Data/ChildList[Id=2]")));
+
+    mdd_diff *diff = mdd_get_dirty_diff(&track);
+    char *patch = NULL;
+    ASSERT_EQ(0, mdd_diff_to_patch(diff, &patch));
+    mdd_free_diff(diff);
+
+    ASSERT_EQ(0, mdd_apply_patch(&replica_track, replica, patch));
+    diff = mdd_get_diff(schema, data, replica);
+    ASSERT_EQ(0, diff->size);
+
+    free(patch);
+    mdd_free_diff(diff);
+    mdd_track_free(&replica_track);
+    mdd_free_data(replica);
+}
+
+TEST_F(DataTrack, should_replace_int_leaf_beyond_int_range_by_patch)
+{
+    ASSERT_EQ(0, mdd_apply_patch(&track, data, R"([{"op":"replace","path":"Data/Value","value":5000000000}])"));
+    ASSERT_EQ(5000000000LL, ((struct mdd_leaf*) mdd_get_data(data, "Data/Value"))->value.intv);
+    ASSERT_EQ(0, mdd_apply_patch(&track, data, R"([{"op":"replace","path":"Data/Value","value":-5000000000}])"));
+    ASSERT_EQ(-5000000000LL, ((struct mdd_leaf*) mdd_get_data(data, "Data/Value"))->value.intv);
+}
+
+TEST_F(DataTrack, should_reject_patch_on_missing_path)
+{
+    ASSERT_EQ(-1, mdd_apply_patch(&track, data, R"([{"op":"remove","path":"Data/ChildList[Id=9]"}])"));
+    ASSERT_EQ(-1, mdd_apply_patch(&track, data, R"([{"op":"replace","path":"Data/Name","value":1}])"));
+    ASSERT_EQ(-1, mdd_apply_patch(&track, data, R"([{"op":"move","path":"Data/Name"}])"));
+}
+
+extern "C" {
+#include "thread_pool.h"
+}
+
+class DataParallelDiff: public DataParser
+{
+public:
+    void TearDown()
+    {
+        pool_destroy(pool);
+        DataParser::TearDown();
+    }
+
+    void assert_same_diff(mdd_diff *expect, mdd_diff *target)
+    {
+        ASSERT_TRUE(NULL != expect);
+        ASSERT_TRUE(NULL != target);
+        ASSERT_EQ(expect->size, target->size);
+        for (size_t i = 0; i < expect->size; i++) {
+            struct mdd_mo_diff *e = (struct mdd_mo_diff*) expect->vec[i];
+            struct mdd_mo_diff *t = (struct mdd_mo_diff*) target->vec[i];
+            ASSERT_EQ(e->type, t->type) << "at " << i;
+            ASSERT_EQ(e->run_data, t->run_data) << "at " << i;
+            ASSERT_EQ(e->edit_data, t->edit_data) << "at " << i;
+            ASSERT_EQ(e->leaf_cnt, t->leaf_cnt) << "at " << i;
+            ASSERT_EQ(e->nbits, t->nbits) << "at " << i;
+            for (unsigned int j = 0; j < (e->nbits + 63) / 64; j++) {
+                ASSERT_EQ(e->leaf_bits[j], t->leaf_bits[j]) << "at " << i;
+            }
+        }
+    }
+
+    std::string build_list_data(int cnt, int shift)
+    {
+        std::string json = R"({"Data": {"Name": "vc1000", "ChildData": {"Id": )" + std::to_string(shift)
+                + R"(}, "ChildList": [)";
+        for (int i = shift; i < cnt + shift; i++) {
+            if (i != shift) {
+                json += ",";
+            }
+            json += R"({"Id": )" + std::to_string(i) + R"(, "Value": )" + std::to_string(i % 7 ? i : i + shift)
+                    + R"(, "SubChildList": [{"Id": 1, "IntLeaf": )" + std::to_string(i % 5 ? 1 : shift) + "}]}";
+        }
+        return json + "]}}";
+    }
+
+    struct mdd_pool *pool = NULL;
+};
+
+TEST_F(DataParallelDiff, should_get_same_diff_as_sequential_for_small_tree)
+{
+    struct mdd_node *data1 = mdd_parse_data(schema, TRACK_DATA_JSON);
+    struct mdd_node *data2 = mdd_parse_data(schema, R"({"Data": {"Name": "vc2000", "ChildData": {"Id": 1},
+            "ChildList": [{"Id": 2, "Value": 3}, {"Id": 3, "SubChildList": [{"Id": 1}]}]}})");
+    pool = pool_create(3);
+
+    mdd_diff *expect = mdd_get_diff(schema, data1, data2);
+    mdd_diff *target = mdd_get_diff_parallel(schema, data1, data2, pool);
+    assert_same_diff(expect, target);
+
+    mdd_free_diff(expect);
+    mdd_free_diff(target);
+    mdd_free_data(data1);
+    mdd_free_data(data2);
+}
+
+TEST_F(DataParallelDiff, should_get_same_diff_as_sequential_for_chunked_list)
+{
+    struct mdd_node *data1 = mdd_parse_data(schema, build_list_data(1000, 0).c_str());
+    struct mdd_node *data2 = mdd_parse_data(schema, build_list_data(1000, 300).c_str());
+    pool = pool_create(4);
+
+    mdd_diff *expect = mdd_get_diff(schema, data1, data2);
+    mdd_diff *target = mdd_get_diff_parallel(schema, data1, data2, pool);
+    assert_same_diff(expect, target);
+    ASSERT_LT(600u, target->size);
+
+    mdd_free_diff(expect);
+    mdd_free_diff(target);
+    mdd_free_data(data1);
+    mdd_free_data(data2);
+}
+
+TEST_F(DataParallelDiff, should_pair_reordered_list_instances_by_key)
+{
+    std::string run = R"({"Data": {"Name": "vc1000", "ChildList": [)";
+    std::string edit = run;
+    for (int i = 0; i < 200; i++) {
+        run += (i ? "," : "") + std::string(R"({"Id": )") + std::to_string(i) + R"(, "Value": )" + std::to_string(i) + "}";
+    }
+    for (int i = 209; i >= 10; i--) {
+        edit += (i != 209 ? "," : "") + std::string(R"({"Id": )") + std::to_string(i) + R"(, "Value": )"
+                + std::to_string(i % 10 == 3 ? i + 1 : i) + "}";
+    }
+    struct mdd_node *data1 = mdd_parse_data(schema, (run + "]}}").c_str());
+    struct mdd_node *data2 = mdd_parse_data(schema, (edit + "]}}").c_str());
+    pool = pool_create(2);
+
+    mdd_diff *expect = mdd_get_diff(schema, data1, data2);
+    ASSERT_TRUE(NULL != expect);
+    int types[3] = {0, 0, 0};
+    for (size_t i = 0; i < expect->size; i++) {
+        types[((struct mdd_mo_diff*) expect->vec[i])->type]++;
+    }
+    ASSERT_EQ(10, types[DF_ADD]);
+    ASSERT_EQ(10, types[DF_DELETE]);
+    ASSERT_EQ(19, types[DF_MODIFY]);
+
+    mdd_diff *target = mdd_get_diff_parallel(schema, data1, data2, pool);
+    assert_same_diff(expect, target);
+
+    mdd_free_diff(expect);
+    mdd_free_diff(target);
+    mdd_free_data(data1);
+    mdd_free_data(data2);
+}
+
+TEST_F(DataParallelDiff, should_match_repeated_keys_as_sequential)
+{
+    /* keys repeat in both trees, in different orders and beyond one chunk */
+    std::string run = R"({"Data": {"Name": "vc1000", "ChildList": [)";
+    std::string edit = run;
+    for (int i = 0; i < 700; i++) {
+        run += (i ? "," : "") + std::string(R"({"Id": )") + std::to_string(i % 300) + R"(, "Value": )" + std::to_string(i)
+                + "}";
+        int j = (i * 7) % 700;
+        edit += (i ? "," : "") + std::string(R"({"Id": )") + std::to_string(j % 310) + R"(, "Value": )"
+                + std::to_string(j % 3 ? j : i) + "}";
+    }
+    struct mdd_node *data1 = mdd_parse_data(schema, (run + "]}}").c_str());
+    struct mdd_node *data2 = mdd_parse_data(schema, (edit + "]}}").c_str());
+    ASSERT_TRUE(NULL != data1);
+    ASSERT_TRUE(NULL != data2);
+    pool = pool_create(4);
+
+    mdd_diff *expect = mdd_get_diff(schema, data1, data2);
+    mdd_diff *target = mdd_get_diff_parallel(schema, data1, data2, pool);
+    assert_same_diff(expect, target);
+    ASSERT_LT(100u, target->size);
 
+    mdd_free_diff(expect);
+    mdd_free_diff(target);
     mdd_free_data(data1);
     mdd_free_data(data2);
 }
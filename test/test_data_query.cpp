@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include <string>
+
+extern "C" {
+#include "model_test_util.h"
+#include "data_repo.h"
+#include "data_query.h"
+}
+
+using namespace std;
+using namespace testing;
+
+static struct mdd_node* get_id(struct mdd_node *node)
+{
+    for (struct mdd_node *iter = node ? node->child : NULL; iter; iter = iter->next) {
+        if (!strcmp(iter->schema->name, "Id")) {
+            return iter;
+        }
+    }
+    return NULL;
+}
+
+class DataQueryTest: public ModelTestUtil, public Test
+{
+public:
+    const char *model = "../test/testdata/testmodel.json";
+
+    void SetUp()
+    {
+        int rlt = repo_init(model, "../test/testdata/testdata.json");
+        ASSERT_EQ(0, rlt);
+    }
+
+    void TearDown()
+    {
+        repo_free();
+    }
+
+    /* list ids or leaf names of all matches, space separated */
+    string collect(const char *expr)
+    {
+        struct mdd_query_iter *iter = repo_query(expr);
+        EXPECT_TRUE(NULL != iter) << expr;
+
+        string rlt;
+        for (struct mdd_node *node = mdd_query_next(iter); node; node = mdd_query_next(iter)) {
+            struct mdd_node *id = get_id(node);
+            rlt += (rlt.empty() ? "" : " ") + (id ? to_string(int_leaf_val(id)) : string(node->schema->name));
+        }
+        EXPECT_TRUE(NULL == mdd_query_next(iter));
+        mdd_query_close(iter);
+        return rlt;
+    }
+};
+
+TEST_F(DataQueryTest, should_query_all_list_entries)
+{
+    ASSERT_EQ("1 2 3 11 22", collect("Data/ChildList"));
+    ASSERT_EQ("Data", collect("Data"));
+    ASSERT_EQ("", collect("Other"));
+}
+
+TEST_F(DataQueryTest, should_query_by_wildcard)
+{
+    ASSERT_EQ("Name Value ChildData 1 2 3 11 22", collect("Data/*"));
+    ASSERT_EQ("22 222", collect("Data/*/SubChildList"));
+    ASSERT_EQ("SubChildContainer", collect("Data/ChildList/*[StrLeaf=aa]"));
+}
+
+TEST_F(DataQueryTest, should_query_by_int_comparisons)
+{
+    ASSERT_EQ("11 22", collect("Data/ChildList[IntLeaf>3]"));
+    ASSERT_EQ("1 2 3", collect("Data/ChildList[IntLeaf<=3]"));
+    ASSERT_EQ("2 3 11", collect("Data/ChildList[IntLeaf>=2][IntLeaf<22]"));
+    ASSERT_EQ("1 3 11 22", collect("Data/ChildList[IntLeaf!=2]"));
+    ASSERT_EQ("222", collect("Data/ChildList[Id>20]/SubChildList[Id>100]"));
+}
+
+TEST_F(DataQueryTest, should_query_by_string_predicates)
+{
+    ASSERT_EQ("22", collect("Data/ChildList/SubChildList[StrLeaf=22]"));
+    ASSERT_EQ("222", collect("Data/ChildList/SubChildList[StrLeaf!=22]"));
+    ASSERT_EQ("Data", collect("Data[Name=TestData][Value=100]"));
+    ASSERT_EQ("", collect("Data[Name=TestData][Value=101]"));
+}
+
+TEST_F(DataQueryTest, should_query_by_list_key)
+{
+    ASSERT_EQ("11", collect("Data/ChildList[Id=11]"));
+    ASSERT_EQ("", collect("Data/ChildList[Id=11][IntLeaf=12]"));
+    ASSERT_EQ("", collect("Data/ChildList[Id=4]"));
+    ASSERT_EQ("222", collect("Data/ChildList[Id=22]/SubChildList[Id=222]"));
+    ASSERT_EQ("IntLeaf", collect("Data/ChildList[Id=3]/IntLeaf"));
+}
+
+TEST_F(DataQueryTest, should_yield_matches_lazily)
+{
+    struct mdd_query *query = mdd_query_compile("Data/ChildList[IntLeaf>1]");
+    ASSERT_TRUE(NULL != query);
+
+    struct mdd_node *root = NULL;
+    ASSERT_EQ(0, repo_get("Data", &root));
+
+    /* one compiled query serves several independent iterators */
+    struct mdd_query_iter *first = mdd_query_open(query, root);
+    struct mdd_query_iter *second = mdd_query_open(query, root);
+    ASSERT_EQ(2, int_leaf_val(get_id(mdd_query_next(first))));
+    ASSERT_EQ(2, int_leaf_val(get_id(mdd_query_next(second))));
+    ASSERT_EQ(3, int_leaf_val(get_id(mdd_query_next(first))));
+    mdd_query_close(first);
+    mdd_query_close(second);
+    mdd_query_free(query);
+}
+
+TEST_F(DataQueryTest, should_reject_malformed_query)
+{
+    ASSERT_TRUE(NULL == mdd_query_compile(""));
+    ASSERT_TRUE(NULL == mdd_query_compile("Data/ChildList[IntLeaf>3"));
+    ASSERT_TRUE(NULL == mdd_query_compile("Data/ChildList[IntLeaf]"));
+    ASSERT_TRUE(NULL == mdd_query_compile("Data/ChildList[=3]"));
+    ASSERT_TRUE(NULL == mdd_query_compile("Data/ChildList[IntLeaf<abc]"));
+    ASSERT_TRUE(NULL == mdd_query_compile("Data/ChildList[Id=1]x"));
+    ASSERT_TRUE(NULL == repo_query(NULL));
+}
+
+/* the same data under a model with an ordered ChildList and indexed leaves */
+class DataQueryIndexTest: public DataQueryTest
+{
+public:
+    DataQueryIndexTest()
+    {
+        model = "../test/testdata/testmodel_indexed.json";
+    }
+};
+
+TEST_F(DataQueryIndexTest, should_query_by_indexed_leaf)
+{
+    ASSERT_EQ("3", collect("Data/ChildList[IntLeaf=3]"));
+    ASSERT_EQ("", collect("Data/ChildList[IntLeaf=4]"));
+    ASSERT_EQ("", collect("Data/ChildList[IntLeaf=3][Id!=3]"));
+    ASSERT_EQ("222", collect("Data/*/SubChildList[StrLeaf=222]"));
+
+    /* a multi index yields every instance holding the value */
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=1]/IntLeaf", 3));
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=22]/IntLeaf", 3));
+    ASSERT_EQ("3 1 22", collect("Data/ChildList[IntLeaf=3]"));
+    ASSERT_EQ("1", collect("Data/ChildList[IntLeaf=3][Id!=3][Id<10]"));
+    ASSERT_EQ("22", collect("Data/ChildList[Id>10][IntLeaf=3]"));
+}
@@ -1,4 +1,7 @@
 #include <gtest/gtest.h>
+#include <climits>
+#include <fstream>
+#include <string>
 
 extern "C" {
 #include "model_test_util.h"
@@ -79,3 +82,407 @@ TEST_F(DataRepoTest, should_get_child_list_child_list_by_key_succ)
     assert_data_string_leaf("StrLeaf", "222", out);
 }
 
+TEST_F(DataRepoTest, should_get_many_paths_in_one_walk)
+{
+    const char *paths[] = {"Data/ChildList[Id=1]/IntLeaf", "Data/ChildList[Id=2]/IntLeaf", "Data/ChildList[Id=3]",
+            "Data/ChildList[Id=11]/IntLeaf", "Data/ChildList[Id=22]/SubChildList[Id=222]/StrLeaf",
+            "Data/ChildList[Id=22]/IntLeaf", "Data/Name", "Data/Value", "Data/ChildData/IntLeaf",
+            "Data/ChildList[Id=1]/IntLeaf", "Data/ChildList[Id=22]"};
+    size_t n = sizeof(paths) / sizeof(paths[0]);
+    struct mdd_node *out[sizeof(paths) / sizeof(paths[0])];
+
+    ASSERT_EQ(0, repo_get_many(paths, n, out));
+    for (size_t i = 0; i < n; i++) {
+        struct mdd_node *expect = NULL;
+        ASSERT_EQ(0, repo_get(paths[i], &expect));
+        ASSERT_EQ(expect, out[i]) << paths[i];
+    }
+}
+
+TEST_F(DataRepoTest, should_get_many_with_missing_path)
+{
+    const char *paths[] = {"Data/ChildList[Id=4]/IntLeaf", "Data/ChildList[Id=2]/IntLeaf", "Other/Name"};
+    struct mdd_node *out[3];
+
+    ASSERT_EQ(-1, repo_get_many(paths, 3, out));
+    ASSERT_TRUE(NULL == out[0]);
+    assert_data_int_leaf("IntLeaf", 2, out[1]);
+    ASSERT_TRUE(NULL == out[2]);
+}
+
+
+class DataRepoEditTest: public ModelTestUtil, public Test
+{
+public:
+    const char *model = "../test/testdata/testmodel.json";
+
+    void SetUp()
+    {
+        std::ifstream src("../test/testdata/testdata.json", std::ios::binary);
+        std::ofstream dst("testdata_edit.json", std::ios::binary);
+        dst << src.rdbuf();
+        dst.close();
+
+        int rlt = repo_init(model, "testdata_edit.json");
+        ASSERT_EQ(0, rlt);
+    }
+
+    void TearDown()
+    {
+        repo_free();
+        remove("testdata_edit.json");
+    }
+};
+
+TEST_F(DataRepoEditTest, should_set_leaf_and_commit_succ)
+{
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=2]/IntLeaf", 200));
+    ASSERT_EQ(0, repo_set_str("Data/Name", "NewName"));
+    ASSERT_EQ(0, repo_commit());
+
+    repo_free();
+    ASSERT_EQ(0, repo_init(model, "testdata_edit.json"));
+
+    struct mdd_node *out = NULL;
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=2]/IntLeaf", &out));
+    assert_data_int_leaf("IntLeaf", 200, out);
+    ASSERT_EQ(0, repo_get("Data/Name", &out));
+    assert_data_string_leaf("Name", "NewName", out);
+}
+
+TEST_F(DataRepoEditTest, should_insert_and_delete_list_inst_succ)
+{
+    ASSERT_EQ(0, repo_insert("Data", R"({"ChildList": [{"Id": 5, "IntLeaf": 5}]})"));
+    ASSERT_EQ(0, repo_delete("Data/ChildList[Id=1]"));
+    ASSERT_EQ(0, repo_commit());
+
+    struct mdd_node *out = NULL;
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=5]/IntLeaf", &out));
+    assert_data_int_leaf("IntLeaf", 5, out);
+    ASSERT_EQ(-1, repo_get("Data/ChildList[Id=1]", &out));
+}
+
+TEST_F(DataRepoEditTest, should_apply_patch_and_persist_succ)
+{
+    ASSERT_EQ(0, repo_apply_patch(R"([{"op":"replace","path":"Data/ChildList[Id=2]/IntLeaf","value":22},)"
+            R"({"op":"add","path":"Data/ChildList[Id=6]","value":{"Id":6,"IntLeaf":6}}])"));
+
+    repo_free();
+    ASSERT_EQ(0, repo_init(model, "testdata_edit.json"));
+
+    struct mdd_node *out = NULL;
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=2]/IntLeaf", &out));
+    assert_data_int_leaf("IntLeaf", 22, out);
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=6]/IntLeaf", &out));
+    assert_data_int_leaf("IntLeaf", 6, out);
+}
+
+TEST_F(DataRepoEditTest, should_reject_whole_edits_while_edits_pending)
+{
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=2]/IntLeaf", 20));
+    ASSERT_EQ(-1, repo_edit(R"({"Data": {"Name": "Edited"}})"));
+    ASSERT_EQ(-1, repo_apply_patch(R"([{"op":"replace","path":"Data/ChildList[Id=1]/IntLeaf","value":10}])"));
+    ASSERT_EQ(0u, repo_version());
+    ASSERT_EQ(1, repo_pending());
+
+    struct mdd_node *out = NULL;
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=1]/IntLeaf", &out));
+    assert_data_int_leaf("IntLeaf", 1, out);
+
+    repo_abort();
+    ASSERT_EQ(0, repo_edit(R"({"Data": {"Name": "Edited"}})"));
+    ASSERT_EQ(1u, repo_version());
+    ASSERT_EQ(0, repo_get("Data/Name", &out));
+    assert_data_string_leaf("Name", "Edited", out);
+}
+
+/* the same data under a model with an ordered ChildList and indexed leaves */
+class DataRepoIndexTest: public DataRepoEditTest
+{
+public:
+    DataRepoIndexTest()
+    {
+        model = "../test/testdata/testmodel_indexed.json";
+    }
+};
+
+TEST_F(DataRepoIndexTest, should_read_values_of_committed_tree_and_pending_edits)
+{
+    long long val = 0;
+    char buf[16];
+    ASSERT_EQ(0, repo_read_int("Data/ChildList[Id=22]/IntLeaf", &val));
+    ASSERT_EQ(22, val);
+    ASSERT_EQ(0, repo_read_str("Data/ChildList[Id=22]/SubChildList[Id=222]/StrLeaf", buf, sizeof(buf)));
+    ASSERT_STREQ("222", buf);
+    ASSERT_EQ(-1, repo_read_str("Data/Name", buf, 8));
+    ASSERT_EQ(-1, repo_read_int("Data/Name", &val));
+    ASSERT_EQ(-1, repo_read_int("Data/ChildList[Id=4]/IntLeaf", &val));
+
+    /* pending edits are read at once, the pack follows them after their commit */
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=22]/IntLeaf", 7));
+    ASSERT_EQ(0, repo_insert("Data", R"({"ChildList": [{"Id": 5, "IntLeaf": 5}]})"));
+    ASSERT_EQ(0, repo_read_int("Data/ChildList[Id=22]/IntLeaf", &val));
+    ASSERT_EQ(7, val);
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(0, repo_read_int("Data/ChildList[Id=5]/IntLeaf", &val));
+    ASSERT_EQ(5, val);
+    ASSERT_EQ(0, repo_read_int("Data/ChildList[Id=22]/IntLeaf", &val));
+    ASSERT_EQ(7, val);
+
+    ASSERT_EQ(0, repo_delete("Data/ChildList[Id=5]"));
+    ASSERT_EQ(-1, repo_read_int("Data/ChildList[Id=5]/IntLeaf", &val));
+    repo_abort();
+    ASSERT_EQ(0, repo_read_int("Data/ChildList[Id=5]/IntLeaf", &val));
+    ASSERT_EQ(0, repo_edit(R"({"Data": {"Name": "Edited"}})"));
+    ASSERT_EQ(0, repo_read_str("Data/Name", buf, sizeof(buf)));
+    ASSERT_STREQ("Edited", buf);
+    ASSERT_EQ(-1, repo_read_int("Data/ChildList[Id=5]/IntLeaf", &val));
+}
+
+TEST_F(DataRepoEditTest, should_leave_tree_untouched_when_patch_fails)
+{
+    char *before = NULL;
+    ASSERT_EQ(0, repo_dump(&before));
+    ASSERT_EQ(-1, repo_apply_patch(R"([{"op":"replace","path":"Data/ChildList[Id=2]/IntLeaf","value":22},)"
+            R"({"op":"remove","path":"Data/ChildList[Id=1]"},{"op":"replace","path":"Data/NoLeaf","value":1}])"));
+    ASSERT_EQ(0u, repo_version());
+    ASSERT_EQ(0, repo_pending());
+
+    char *after = NULL;
+    ASSERT_EQ(0, repo_dump(&after));
+    ASSERT_STREQ(before, after);
+    free(before);
+    free(after);
+}
+
+static string list_range(const char *path, long long lo, long long hi)
+{
+    struct mdd_list_cursor cursor;
+    if (repo_list_range(path, lo, hi, &cursor)) {
+        return "error";
+    }
+
+    string rlt;
+    for (struct mdd_node *node = mdd_list_next(&cursor); node; node = mdd_list_next(&cursor)) {
+        struct mdd_node *id = node->child;
+        while (id && strcmp(id->schema->name, "Id")) {
+            id = id->next;
+        }
+        rlt += (rlt.empty() ? "" : " ") + to_string(int_leaf_val(id));
+    }
+    return rlt;
+}
+
+TEST_F(DataRepoIndexTest, should_scan_ordered_list_by_key_range)
+{
+    ASSERT_EQ("1 2 3 11 22", list_range("Data/ChildList", LLONG_MIN, LLONG_MAX));
+    ASSERT_EQ("2 3 11", list_range("Data/ChildList", 2, 11));
+    ASSERT_EQ("", list_range("Data/ChildList", 4, 10));
+    ASSERT_EQ("error", list_range("Data/ChildList[Id=22]/SubChildList", 0, 1000));
+    ASSERT_EQ("error", list_range("Data/NoList", 0, 1000));
+}
+
+TEST_F(DataRepoIndexTest, should_keep_ordered_index_through_edits)
+{
+    ASSERT_EQ(0, repo_insert("Data", R"({"ChildList": [{"Id": 7, "IntLeaf": 7}, {"Id": 0, "IntLeaf": 0}]})"));
+    ASSERT_EQ(0, repo_delete("Data/ChildList[Id=2]"));
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=11]/IntLeaf", 12));
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=3]/Id", 30));
+    ASSERT_EQ(-1, repo_set_int("Data/ChildList[Id=1]/Id", 22));
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ("0 1 7 11 22 30", list_range("Data/ChildList", LLONG_MIN, LLONG_MAX));
+
+    struct mdd_node *out = NULL;
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=30]/IntLeaf", &out));
+    assert_data_int_leaf("IntLeaf", 3, out);
+    ASSERT_EQ(-1, repo_get("Data/ChildList[Id=3]", &out));
+
+    ASSERT_EQ(0, repo_delete("Data/ChildList[Id=1]/Id"));
+    ASSERT_EQ("0 7 11 22 30", list_range("Data/ChildList", LLONG_MIN, LLONG_MAX));
+    ASSERT_EQ(0, repo_commit());
+
+    /* a full edit reparses the tree and rebuilds the index */
+    ASSERT_EQ(0, repo_edit(R"({"Data": {"ChildList": [{"Id": 9}, {"Id": 4}]}})"));
+    ASSERT_EQ("4 9", list_range("Data/ChildList", LLONG_MIN, LLONG_MAX));
+}
+
+TEST_F(DataRepoIndexTest, should_get_by_indexed_leaf_through_edits)
+{
+    struct mdd_node *out = NULL;
+    ASSERT_EQ(0, repo_get("Data/ChildList[IntLeaf=11]/Id", &out));
+    assert_data_int_leaf("Id", 11, out);
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=22]/SubChildList[StrLeaf=222]/Id", &out));
+    assert_data_int_leaf("Id", 222, out);
+
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=11]/IntLeaf", 110));
+    ASSERT_EQ(-1, repo_get("Data/ChildList[IntLeaf=11]", &out));
+    ASSERT_EQ(0, repo_get("Data/ChildList[IntLeaf=110]/Id", &out));
+    assert_data_int_leaf("Id", 11, out);
+
+    /* unique leaves reject a value held by a sibling instance, multi ones accept it */
+    ASSERT_EQ(-1, repo_set_str("Data/ChildList[Id=22]/SubChildList[Id=22]/StrLeaf", "222"));
+    ASSERT_EQ(-1, repo_insert("Data/ChildList[Id=22]", R"({"SubChildList": [{"Id": 7, "StrLeaf": "22"}]})"));
+    ASSERT_EQ(0, repo_insert("Data/ChildList[Id=22]", R"({"SubChildList": [{"Id": 7, "StrLeaf": "7"}]})"));
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=2]/IntLeaf", 3));
+
+    ASSERT_EQ(0, repo_delete("Data/ChildList[Id=22]/SubChildList[StrLeaf=222]"));
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(-1, repo_get("Data/ChildList[Id=22]/SubChildList[StrLeaf=222]", &out));
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=22]/SubChildList[StrLeaf=7]/Id", &out));
+    assert_data_int_leaf("Id", 7, out);
+    ASSERT_EQ(0, repo_set_str("Data/ChildList[Id=22]/SubChildList[Id=22]/StrLeaf", "222"));
+}
+
+TEST_F(DataRepoIndexTest, should_keep_entry_indexed_after_deleting_indexed_leaf)
+{
+    ASSERT_EQ(0, repo_delete("Data/ChildList[Id=2]/IntLeaf"));
+
+    struct mdd_node *out = NULL;
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=2]/Id", &out));
+    assert_data_int_leaf("Id", 2, out);
+    ASSERT_EQ(-1, repo_get("Data/ChildList[IntLeaf=2]", &out));
+    ASSERT_EQ("1 2 3 11 22", list_range("Data/ChildList", LLONG_MIN, LLONG_MAX));
+
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=2]/Id", &out));
+    ASSERT_EQ("2 3", list_range("Data/ChildList", 2, 3));
+}
+
+TEST_F(DataRepoIndexTest, should_abort_edits_and_keep_indexes)
+{
+    char *before = NULL;
+    ASSERT_EQ(0, repo_dump(&before));
+
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=3]/Id", 30));
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=2]/Id", 3));
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=11]/IntLeaf", 12));
+    ASSERT_EQ(0, repo_delete("Data/ChildList[Id=1]"));
+    ASSERT_EQ(0, repo_insert("Data", R"({"ChildList": [{"Id": 1, "IntLeaf": 11}]})"));
+    ASSERT_EQ(0, repo_set_str("Data/ChildList[Id=22]/SubChildList[Id=222]/StrLeaf", "x"));
+    ASSERT_EQ("1 3 11 22 30", list_range("Data/ChildList", LLONG_MIN, LLONG_MAX));
+    ASSERT_EQ(1, repo_pending());
+
+    repo_abort();
+    ASSERT_EQ(0, repo_pending());
+    char *after = NULL;
+    ASSERT_EQ(0, repo_dump(&after));
+    ASSERT_STREQ(before, after);
+    free(before);
+    free(after);
+    ASSERT_EQ("1 2 3 11 22", list_range("Data/ChildList", LLONG_MIN, LLONG_MAX));
+
+    struct mdd_node *out = NULL;
+    ASSERT_EQ(0, repo_get("Data/ChildList[IntLeaf=11]/Id", &out));
+    assert_data_int_leaf("Id", 11, out);
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=22]/SubChildList[StrLeaf=222]/Id", &out));
+    assert_data_int_leaf("Id", 222, out);
+
+    /* nothing was committed, so the data file still holds the old tree */
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(0u, repo_version());
+}
+
+TEST_F(DataRepoEditTest, should_get_subtree_json_after_commits)
+{
+    char *json = NULL;
+    ASSERT_EQ(0, repo_get_json("Data/ChildList[Id=22]/SubChildList[Id=222]", &json));
+    ASSERT_STREQ(R"({"Id":222,"StrLeaf":"222"})", json);
+    free(json);
+    ASSERT_EQ(-1, repo_get_json("Data/ChildList[Id=4]", &json));
+
+    ASSERT_EQ(0, repo_set_str("Data/ChildList[Id=22]/SubChildList[Id=222]/StrLeaf", "new"));
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(0, repo_get_json("Data/ChildList[Id=22]", &json));
+    ASSERT_STREQ(R"({"Id":22,"IntLeaf":22,"SubChildList":[{"Id":22,"StrLeaf":"22"},{"Id":222,"StrLeaf":"new"}]})", json);
+    free(json);
+
+    /* the fragments cached before a compaction follow the mos and are still dropped by edits */
+    ASSERT_EQ(0, repo_compact());
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=22]/IntLeaf", 7));
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(0, repo_get_json("Data/ChildList[Id=22]", &json));
+    ASSERT_STREQ(R"({"Id":22,"IntLeaf":7,"SubChildList":[{"Id":22,"StrLeaf":"22"},{"Id":222,"StrLeaf":"new"}]})", json);
+    free(json);
+}
+
+TEST_F(DataRepoIndexTest, should_restart_from_binary_snapshot)
+{
+    ASSERT_EQ(0, repo_save_snapshot("testdata_edit.snap"));
+    repo_free();
+    ASSERT_EQ(0, repo_init(model, "testdata_edit.snap"));
+
+    struct mdd_node *out = NULL;
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=22]/SubChildList[StrLeaf=222]/Id", &out));
+    assert_data_int_leaf("Id", 222, out);
+    ASSERT_EQ("2 3 11", list_range("Data/ChildList", 2, 20));
+
+    /* commits keep the data file in the format it was loaded in */
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=11]/IntLeaf", -11));
+    ASSERT_EQ(0, repo_commit());
+    repo_free();
+    ASSERT_EQ(0, repo_init(model, "testdata_edit.snap"));
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=11]/IntLeaf", &out));
+    assert_data_int_leaf("IntLeaf", -11, out);
+    remove("testdata_edit.snap");
+}
+
+TEST_F(DataRepoEditTest, should_keep_mapped_store_as_data_file)
+{
+    ASSERT_EQ(0, repo_save_store("testdata_edit.mdm"));
+    repo_free();
+    ASSERT_EQ(0, repo_init(model, "testdata_edit.mdm"));
+
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=11]/IntLeaf", -11));
+    ASSERT_EQ(0, repo_insert("Data", R"({"ChildList": [{"Id": 5, "IntLeaf": 5}]})"));
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(0, repo_edit(R"({"Data": {"Name": "Edited", "ChildList": [{"Id": 7, "IntLeaf": 70}]}})"));
+    ASSERT_EQ(0, repo_delete("Data/ChildList[Id=7]/IntLeaf"));
+    ASSERT_EQ(0, repo_commit());
+    repo_free();
+
+    ASSERT_EQ(0, repo_init(model, "testdata_edit.mdm"));
+    char *json = NULL;
+    ASSERT_EQ(0, repo_dump(&json));
+    ASSERT_STREQ(R"({"Data":{"Name":"Edited","ChildList":[{"Id":7}]}})", json);
+    free(json);
+    remove("testdata_edit.mdm");
+}
+
+TEST_F(DataRepoIndexTest, should_compact_running_tree_and_keep_store_records)
+{
+    ASSERT_EQ(0, repo_save_store("testdata_edit.mdm"));
+    repo_free();
+    ASSERT_EQ(0, repo_init(model, "testdata_edit.mdm"));
+    ASSERT_EQ(0, repo_set_compact_interval(2));
+
+    struct mdd_node *top = NULL;
+    ASSERT_EQ(0, repo_get("Data", &top));
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=11]/IntLeaf", -11));
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(0, repo_get("Data", &top));
+    ASSERT_FALSE(top->flags & MDD_F_CHUNK);
+
+    /* the second commit lays the tree out again, the store follows its mos */
+    ASSERT_EQ(0, repo_insert("Data", R"({"ChildList": [{"Id": 5, "IntLeaf": 5}]})"));
+    ASSERT_EQ(0, repo_commit());
+    ASSERT_EQ(0, repo_get("Data", &top));
+    ASSERT_TRUE(top->flags & MDD_F_CHUNK);
+    ASSERT_EQ("2 3 5 11", list_range("Data/ChildList", 2, 20));
+
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=5]/IntLeaf", 50));
+    ASSERT_EQ(0, repo_compact());
+    char *json = NULL;
+    ASSERT_EQ(0, repo_dump(&json));
+    std::string expect = json;
+    free(json);
+    repo_free();
+
+    ASSERT_EQ(0, repo_init(model, "testdata_edit.mdm"));
+    ASSERT_EQ(0, repo_dump(&json));
+    ASSERT_EQ(expect, json);
+    free(json);
+    struct mdd_node *out = NULL;
+    ASSERT_EQ(0, repo_get("Data/ChildList[Id=5]/IntLeaf", &out));
+    assert_data_int_leaf("IntLeaf", 50, out);
+    remove("testdata_edit.mdm");
+}
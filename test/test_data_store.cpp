@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+
+extern "C" {
+#include "model_test_util.h"
+#include "data_parser.h"
+#include "data_store.h"
+}
+
+using namespace std;
+using namespace testing;
+
+#define STORE_FILE "testdata_store.mdm"
+
+static const char *STORE_MODEL_JSON = R"({
+    "Data": {
+        "@attr": {"mtype": "container"},
+        "Name": {"@attr": {"mtype": "leaf", "dtype": "string"}},
+        "Value": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+        "ChildList": {
+            "@attr": {"mtype": "list", "index": "ordered"},
+            "Id": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+            "Value": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+            "SubChildList": {
+                "@attr": {"mtype": "list"},
+                "Id": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+                "StrLeaf": {"@attr": {"mtype": "leaf", "dtype": "string"}}
+            }
+        }
+    }
+})";
+
+static const char *STORE_DATA_JSON = R"({
+    "Data": {
+        "Name": "store",
+        "Value": -7,
+        "ChildList": [
+            {"Id": 1, "Value": 1, "SubChildList": [{"Id": 1, "StrLeaf": "a"}, {"Id": 2, "StrLeaf": ""}]},
+            {"Id": 2, "Value": 2}
+        ]
+    }
+})";
+
+class DataStoreTest: public ModelTestUtil, public Test
+{
+public:
+    void SetUp()
+    {
+        schema = mds_load_model(STORE_MODEL_JSON);
+        data = mdd_parse_data(schema, STORE_DATA_JSON);
+        ASSERT_EQ(0, mdd_track_init(&track));
+    }
+
+    void TearDown()
+    {
+        mdd_track_free(&track);
+        mdd_free_data(data);
+        mds_free_model(schema);
+        remove(STORE_FILE);
+    }
+
+    string dump(struct mdd_node *root)
+    {
+        char *json = NULL;
+        EXPECT_EQ(0, mdd_dump_data(root, &json));
+        string rlt = json ? json : "";
+        free(json);
+        return rlt;
+    }
+
+    /* reopens the file and returns the dump of what it holds */
+    string reopen()
+    {
+        struct mdd_node *root = NULL;
+        struct mdd_store *store = mdd_store_open(STORE_FILE, schema, &root);
+        EXPECT_TRUE(NULL != store);
+        string rlt = root ? dump(root) : "";
+        mdd_free_data(root);
+        mdd_store_close(store);
+        return rlt;
+    }
+
+    struct mds_node *schema;
+    struct mdd_node *data;
+    struct mdd_track track;
+};
+
+TEST_F(DataStoreTest, should_reopen_created_store)
+{
+    struct mdd_store *store = mdd_store_create(STORE_FILE, schema, data);
+    ASSERT_TRUE(NULL != store);
+    mdd_store_close(store);
+    ASSERT_EQ(1, mdd_store_probe(STORE_FILE));
+    ASSERT_EQ(dump(data), reopen());
+
+    struct mdd_node *root = NULL;
+    store = mdd_store_open(STORE_FILE, schema, &root);
+    ASSERT_TRUE(NULL != store);
+    ASSERT_TRUE(NULL != mdd_find_list(root, mds_find_child_schema(schema, "ChildList"), 2));
+    mdd_free_data(root);
+    mdd_store_close(store);
+}
+
+TEST_F(DataStoreTest, should_append_only_touched_spine_on_commit)
+{
+    struct mdd_store *store = mdd_store_create(STORE_FILE, schema, data);
+    ASSERT_TRUE(NULL != store);
+    mdd_store_close(store);
+    mdd_free_data(data);
+
+    store = mdd_store_open(STORE_FILE, schema, &data);
+    ASSERT_TRUE(NULL != store);
+    size_t before = mdd_store_size(store);
+
+    ASSERT_EQ(0, mdd_set_str(&track, mdd_get_data(data, "Data/ChildList[Id=1]/SubChildList[Id=1]/StrLeaf"), "b"));
+    mdd_diff *diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(0, mdd_store_commit(store, data, diff));
+    mdd_free_diff(diff);
+
+    /* the changed instance, its list parent and the root are rewritten, nothing else */
+    size_t grown = mdd_store_size(store) - before;
+    ASSERT_LT(grown, 3 * 128u);
+    ASSERT_EQ(dump(data), reopen());
+
+    ASSERT_EQ(0, mdd_delete_node(&track, mdd_get_data(data, "Data/ChildList[Id=1]")));
+    ASSERT_EQ(0, mdd_set_int(&track, mdd_get_data(data, "Data/Value"), 70));
+    diff = mdd_get_dirty_diff(&track);
+    ASSERT_EQ(0, mdd_store_commit(store, data, diff));
+    mdd_free_diff(diff);
+    ASSERT_EQ(R"({"Data":{"Name":"store","Value":70,"ChildList":[{"Id":2,"Value":2}]}})", reopen());
+
+    ASSERT_EQ(0, mdd_store_commit(store, data, NULL));
+    ASSERT_EQ(dump(data), reopen());
+    mdd_store_close(store);
+}
+
+TEST_F(DataStoreTest, should_reject_foreign_files)
+{
+    struct mdd_store *store = mdd_store_create(STORE_FILE, schema, data);
+    ASSERT_TRUE(NULL != store);
+    mdd_store_close(store);
+
+    struct mds_node *other = mds_load_model(R"({"Data": {"@attr": {"mtype": "container"}}})");
+    struct mdd_node *root = NULL;
+    ASSERT_TRUE(NULL == mdd_store_open(STORE_FILE, other, &root));
+    mds_free_model(other);
+
+    ASSERT_EQ(0, mdd_store_probe("../test/testdata/testdata.json"));
+    ASSERT_TRUE(NULL == mdd_store_open("../test/testdata/testdata.json", schema, &root));
+    ASSERT_TRUE(NULL == root);
+}
+
+TEST_F(DataStoreTest, should_reject_store_with_bad_used_size)
+{
+    struct mdd_store *store = mdd_store_create(STORE_FILE, schema, data);
+    ASSERT_TRUE(NULL != store);
+    mdd_store_close(store);
+
+    /* used follows magic, version, fingerprint, reserved and root in the header */
+    int fd = open(STORE_FILE, O_RDWR);
+    ASSERT_GE(fd, 0);
+    uint64_t used = 0;
+    ASSERT_EQ((ssize_t) sizeof(used), pread(fd, &used, sizeof(used), 24));
+    for (uint64_t bad : {used + 4, (uint64_t) 8}) {
+        ASSERT_EQ((ssize_t) sizeof(bad), pwrite(fd, &bad, sizeof(bad), 24));
+        struct mdd_node *root = NULL;
+        ASSERT_TRUE(NULL == mdd_store_open(STORE_FILE, schema, &root)) << bad;
+        ASSERT_TRUE(NULL == root);
+    }
+    ASSERT_EQ((ssize_t) sizeof(used), pwrite(fd, &used, sizeof(used), 24));
+    close(fd);
+    ASSERT_EQ(dump(data), reopen());
+}
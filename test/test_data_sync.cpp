@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+extern "C" {
+#include "model_test_util.h"
+#include "data_repo.h"
+#include "data_sync.h"
+}
+
+using namespace std;
+using namespace testing;
+
+#define SYNC_MODEL "../test/testdata/testmodel.json"
+#define LEADER_DATA "testdata_leader.json"
+#define FOLLOWER_DATA "testdata_follower.json"
+
+static void copy_file(const char *from, const char *to)
+{
+    std::ifstream src(from, std::ios::binary);
+    std::ofstream dst(to, std::ios::binary);
+    dst << src.rdbuf();
+}
+
+static long long get_int(const char *path)
+{
+    struct mdd_node *out = NULL;
+    return repo_get(path, &out) ? -1 : int_leaf_val(out);
+}
+
+/* runs in the child process, the exit code tells the parent whether the replica caught up */
+static int run_follower(int fd, unsigned long long expect)
+{
+    if (repo_init(SYNC_MODEL, FOLLOWER_DATA)) {
+        return 1;
+    }
+
+    struct repo_sync *sync = sync_follower_create(fd, 0);
+    for (int i = 0; sync && i < 100 && sync_version(sync) < expect; i++) {
+        if (sync_poll(sync, 100) < 0) {
+            break;
+        }
+    }
+
+    struct mdd_node *out = NULL;
+    int ok = sync_version(sync) == expect && get_int("Data/ChildList[Id=2]/IntLeaf") == 200
+            && get_int("Data/ChildList[Id=5]/IntLeaf") == 5 && repo_get("Data/ChildList[Id=1]", &out) == -1;
+    sync_destroy(sync);
+    repo_free();
+    return ok ? 0 : 1;
+}
+
+class DataSyncTest: public Test
+{
+public:
+    void SetUp()
+    {
+        copy_file("../test/testdata/testdata.json", LEADER_DATA);
+        copy_file("../test/testdata/testdata.json", FOLLOWER_DATA);
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    }
+
+    void TearDown()
+    {
+        sync_destroy(leader);
+        repo_free();
+        remove(LEADER_DATA);
+        remove(FOLLOWER_DATA);
+    }
+
+    void start_follower(unsigned long long expect)
+    {
+        child = fork();
+        ASSERT_NE(-1, child);
+        if (!child) {
+            close(fds[0]);
+            _exit(run_follower(fds[1], expect));
+        }
+        close(fds[1]);
+    }
+
+    void commit_changes_from(unsigned long long version)
+    {
+        ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=2]/IntLeaf", 200));
+        ASSERT_EQ(0, repo_commit());
+        ASSERT_EQ(0, repo_insert("Data", R"({"ChildList": [{"Id": 5, "IntLeaf": 5}]})"));
+        ASSERT_EQ(0, repo_commit());
+        ASSERT_EQ(0, repo_delete("Data/ChildList[Id=1]"));
+        ASSERT_EQ(0, repo_commit());
+        ASSERT_EQ(version + 3, repo_version());
+    }
+
+    void commit_changes()
+    {
+        commit_changes_from(0);
+    }
+
+    void wait_follower(unsigned long long expect)
+    {
+        for (int i = 0; i < 100 && sync_acked(leader) < expect; i++) {
+            ASSERT_LE(0, sync_poll(leader, 100));
+        }
+        ASSERT_EQ(expect, sync_acked(leader));
+
+        int status = -1;
+        ASSERT_EQ(child, waitpid(child, &status, 0));
+        ASSERT_TRUE(WIFEXITED(status));
+        ASSERT_EQ(0, WEXITSTATUS(status));
+    }
+
+    int fds[2];
+    pid_t child = -1;
+    struct repo_sync *leader = NULL;
+};
+
+TEST_F(DataSyncTest, should_replicate_change_sets_to_follower_process)
+{
+    start_follower(3);
+    ASSERT_EQ(0, repo_init(SYNC_MODEL, LEADER_DATA));
+    leader = sync_leader_create(16);
+    ASSERT_TRUE(NULL != leader);
+    ASSERT_EQ(0, sync_leader_add(leader, fds[0]));
+
+    commit_changes();
+    ASSERT_EQ(3, sync_version(leader));
+    wait_follower(3);
+}
+
+TEST_F(DataSyncTest, should_send_snapshot_when_follower_behind_backlog)
+{
+    start_follower(3);
+    ASSERT_EQ(0, repo_init(SYNC_MODEL, LEADER_DATA));
+    leader = sync_leader_create(1);
+    ASSERT_TRUE(NULL != leader);
+
+    commit_changes();
+    ASSERT_EQ(0, sync_leader_add(leader, fds[0]));
+    wait_follower(3);
+}
+
+TEST_F(DataSyncTest, should_hold_snapshot_back_while_edits_are_pending)
+{
+    start_follower(3);
+    ASSERT_EQ(0, repo_init(SYNC_MODEL, LEADER_DATA));
+    leader = sync_leader_create(1);
+    ASSERT_TRUE(NULL != leader);
+
+    commit_changes();
+    ASSERT_EQ(0, repo_set_int("Data/ChildList[Id=2]/IntLeaf", 999));
+    ASSERT_EQ(0, sync_leader_add(leader, fds[0]));
+    for (int i = 0; i < 5; i++) {
+        ASSERT_LE(0, sync_poll(leader, 20));
+    }
+    ASSERT_EQ(0u, sync_acked(leader));
+
+    repo_abort();
+    wait_follower(3);
+}
+
+TEST_F(DataSyncTest, should_commit_without_waiting_for_follower_to_read)
+{
+    ASSERT_EQ(0, repo_init(SYNC_MODEL, LEADER_DATA));
+    leader = sync_leader_create(16);
+    ASSERT_TRUE(NULL != leader);
+    int sndbuf = 4096;
+    ASSERT_EQ(0, setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)));
+    ASSERT_EQ(0, sync_leader_add(leader, fds[0]));
+
+    /* nobody reads yet, a blocking write would hang the commit past the alarm */
+    alarm(10);
+    for (int i = 0; i < 8; i++) {
+        ASSERT_EQ(0, repo_set_str("Data/Name", string(32 * 1024, 'a' + i).c_str()));
+        ASSERT_EQ(0, repo_commit());
+        ASSERT_LE(0, sync_poll(leader, 0));
+    }
+    alarm(0);
+    commit_changes_from(8);
+
+    start_follower(11);
+    wait_follower(11);
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <random>
+#include <string.h>
+
+extern "C" {
+#include "json_scan.h"
+}
+
+using namespace std;
+using namespace testing;
+
+class JsonScanTest: public Test
+{
+public:
+    /* the structural offsets by a byte at a time state machine */
+    static vector<uint32_t> reference(const string &json)
+    {
+        vector<uint32_t> out;
+        bool in_str = false, escaped = false, scalar = false;
+        for (size_t i = 0; i < json.size(); i++) {
+            char c = json[i];
+            if (in_str) {
+                if (escaped) {
+                    escaped = false;
+                } else if (c == '\\') {
+                    escaped = true;
+                } else if (c == '"') {
+                    in_str = false;
+                    out.push_back(i);
+                }
+                continue;
+            }
+            bool op = c && strchr("{}[]:,", c), ws = c && strchr(" \t\n\r", c);
+            if (c == '"' || op) {
+                in_str = c == '"';
+                out.push_back(i);
+            } else if (!ws && !scalar) {
+                out.push_back(i);
+            }
+            scalar = !ws && !op && c != '"';
+        }
+        return out;
+    }
+
+    static vector<uint32_t> scan(const string &json, json_kernel kernel)
+    {
+        struct json_index index;
+        EXPECT_EQ(0, json_index_build(&index, json.data(), json.size(), kernel));
+        vector<uint32_t> out(index.pos, index.pos + index.cnt);
+        json_index_free(&index);
+        return out;
+    }
+
+    /* tokens with backslashes only inside strings, runs of them long enough to cross blocks */
+    static string random_text(mt19937 &rng, size_t tokens)
+    {
+        static const char *OPS[] = {"{", "}", "[", "]", ":", ",", " ", "\n\t", "-12", "true", "3.5e7"};
+        string text;
+        for (size_t t = 0; t < tokens; t++) {
+            if (rng() % 3) {
+                text += OPS[rng() % (sizeof(OPS) / sizeof(OPS[0]))];
+                continue;
+            }
+            text += '"';
+            for (size_t n = rng() % 80; n; n--) {
+                unsigned r = rng() % 10;
+                text += r == 0 ? string(rng() % 7 * 2, '\\') : r == 1 ? "\\\"" : r == 2 ? "{:," : string(1, 'a' + r);
+            }
+            text += '"';
+        }
+        return text;
+    }
+};
+
+TEST_F(JsonScanTest, should_index_structurals_and_scalar_starts)
+{
+    string json = R"({"a\"b": [1, -2,true],"c\\":"x{y}"} )";
+    vector<uint32_t> expect = {0, 1, 6, 7, 9, 10, 11, 13, 15, 16, 20, 21, 22, 26, 27, 28, 33, 34};
+    ASSERT_EQ(expect, reference(json));
+    ASSERT_EQ(expect, scan(json, JSON_KERNEL_AUTO));
+    ASSERT_TRUE(scan("", JSON_KERNEL_AUTO).empty());
+}
+
+TEST_F(JsonScanTest, should_match_reference_on_every_kernel)
+{
+    mt19937 rng(2024);
+    for (int round = 0; round < 200; round++) {
+        string json = random_text(rng, rng() % 200);
+        vector<uint32_t> expect = reference(json);
+        for (json_kernel kernel : {JSON_KERNEL_SCALAR, JSON_KERNEL_SSE2, JSON_KERNEL_AVX2}) {
+            if (json_kernel_supported(kernel)) {
+                ASSERT_EQ(expect, scan(json, kernel)) << "kernel " << kernel << " on " << json;
+            }
+        }
+    }
+}
+
+TEST_F(JsonScanTest, should_reject_unterminated_string)
+{
+    struct json_index index;
+    string json = "{\"a\": \"b" + string(100, 'c') + "\\\"}";
+    for (json_kernel kernel : {JSON_KERNEL_SCALAR, JSON_KERNEL_SSE2, JSON_KERNEL_AVX2}) {
+        if (json_kernel_supported(kernel)) {
+            ASSERT_EQ(-1, json_index_build(&index, json.data(), json.size(), kernel));
+            ASSERT_TRUE(NULL == index.pos);
+        }
+    }
+    ASSERT_TRUE(json_kernel_supported(json_kernel_best()));
+}
@@ -1,4 +1,5 @@
 #include "gtest/gtest.h"
+#include <string>
 
 extern "C" {
 #include "model_parser.h"
@@ -170,3 +171,58 @@ TEST_F(ModelTest, should_load_complicated_schema_succ)
     assert_model_leaf("Id", MDS_DT_INT, root->child->next->child);
     assert_model_leaf("Value", MDS_DT_INT, root->child->next->next);
 }
+
+TEST_F(ModelTest, should_load_index_attrs_succ)
+{
+    const char *VALID_MODEL_JSON = R"({
+    "Data": {
+        "@attr": {"mtype": "container"},
+        "Lists": {
+            "@attr": {"mtype": "list", "index": "ordered"},
+            "Id": {"@attr": {"mtype": "leaf", "dtype": "int"}},
+            "Name": {"@attr": {"mtype": "leaf", "dtype": "string", "index": "unique"}},
+            "Kind": {"@attr": {"mtype": "leaf", "dtype": "int", "index": "multi"}}
+        },
+        "Plain": {
+            "@attr": {"mtype": "list"},
+            "Id": {"@attr": {"mtype": "leaf", "dtype": "int"}}
+        }
+    }
+})";
+
+    root = mds_load_model(VALID_MODEL_JSON);
+    struct mds_node *lists = mds_find_child_schema(root, "Lists");
+    ASSERT_EQ(MDS_F_ORDERED | MDS_F_LEAF_INDEX, ((struct mds_mo*) lists)->flags);
+    ASSERT_EQ(0, ((struct mds_leaf*) mds_find_child_schema(lists, "Id"))->flags);
+    ASSERT_EQ(MDS_F_INDEXED | MDS_F_UNIQUE, ((struct mds_leaf*) mds_find_child_schema(lists, "Name"))->flags);
+    ASSERT_EQ(MDS_F_INDEXED, ((struct mds_leaf*) mds_find_child_schema(lists, "Kind"))->flags);
+    ASSERT_EQ(0, ((struct mds_mo*) mds_find_child_schema(root, "Plain"))->flags);
+}
+
+TEST_F(ModelTest, should_load_enum_values_and_reject_bad_ones)
+{
+    const char *VALID_MODEL_JSON = R"({
+    "Data": {
+        "@attr": {"mtype": "container"},
+        "Admin": {"@attr": {"mtype": "leaf", "dtype": "enum", "enum": ["up", "down", "testing"]}}
+    }
+})";
+
+    root = mds_load_model(VALID_MODEL_JSON);
+    assert_model_leaf("Admin", MDS_DT_ENUM, root->child);
+    ASSERT_EQ(3, ((struct mds_leaf*) root->child)->enum_cnt);
+    ASSERT_EQ(1, mds_enum_code(root->child, "down", 4));
+    ASSERT_EQ(-1, mds_enum_code(root->child, "dow", 3));
+    ASSERT_EQ(-1, mds_enum_code(root->child, "downx", 5));
+    ASSERT_STREQ("testing", mds_enum_name(root->child, 2));
+    ASSERT_TRUE(NULL == mds_enum_name(root->child, 3));
+    ASSERT_TRUE(NULL == mds_enum_name(root->child, -1));
+
+    const char *BAD_ENUMS[] = {R"("dtype": "enum")", R"("dtype": "enum", "enum": [])",
+        R"("dtype": "enum", "enum": ["up", 1])", R"("dtype": "enum", "enum": ["up", "up"])"};
+    for (const char *attr : BAD_ENUMS) {
+        string model = string(R"({"Data": {"@attr": {"mtype": "container"}, "Admin": {"@attr": {"mtype": "leaf", )")
+                + attr + "}}}}";
+        ASSERT_TRUE(NULL == mds_load_model(model.c_str())) << attr;
+    }
+}
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#include <atomic>
+
+extern "C" {
+#include "thread_pool.h"
+}
+
+using namespace std;
+using namespace testing;
+
+class ThreadPoolTest: public Test
+{
+public:
+    void SetUp()
+    {
+        pool = NULL;
+    }
+
+    void TearDown()
+    {
+        pool_destroy(pool);
+    }
+
+    static void add_one(void *arg)
+    {
+        ((atomic<int>*) arg)->fetch_add(1);
+    }
+
+    struct mdd_pool *pool;
+};
+
+TEST_F(ThreadPoolTest, should_reject_invalid_thread_count)
+{
+    ASSERT_TRUE(NULL == pool_create(0));
+}
+
+TEST_F(ThreadPoolTest, should_run_all_tasks_before_wait_return)
+{
+    pool = pool_create(4);
+    ASSERT_TRUE(NULL != pool);
+    ASSERT_EQ(4, pool_threads(pool));
+
+    atomic<int> cnt(0);
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(0, pool_submit(pool, add_one, &cnt));
+    }
+    pool_wait(pool);
+    ASSERT_EQ(1000, cnt.load());
+
+    for (int i = 0; i < 10; i++) {
+        ASSERT_EQ(0, pool_submit(pool, add_one, &cnt));
+    }
+    pool_wait(pool);
+    ASSERT_EQ(1010, cnt.load());
+}
+
+TEST_F(ThreadPoolTest, should_return_when_wait_without_task)
+{
+    pool = pool_create(2);
+    pool_wait(pool);
+}